@@ -25,10 +25,10 @@ public:
                                                             double theta, double theta_goal);
 };
 
-std::tuple<double, double, double> PathFinderController::calc_control_command(double x_diff,
-                                                                              double y_diff,
-                                                                              double theta,
-                                                                              double theta_goal) {
+inline std::tuple<double, double, double> PathFinderController::calc_control_command(double x_diff,
+                                                                                     double y_diff,
+                                                                                     double theta,
+                                                                                     double theta_goal) {
     double rho = hypot(x_diff, y_diff);
     double alpha = std::fmod(std::atan2(y_diff, x_diff) - theta + M_PI, 2 * M_PI) - M_PI;
     double beta = std::fmod(theta_goal - theta - alpha + M_PI, 2 * M_PI) - M_PI;
@@ -10,6 +10,7 @@
 #include "PathFinderController.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using namespace Eigen;
 namespace plt = matplotlibcpp;
@@ -19,7 +20,7 @@ double dt = 0.01;
 
 constexpr int MAX_LINEAR_SPEED = 15;
 constexpr int MAX_ANGULAR_SPEED = 10;
-bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 void plot_vehicle(double x, double y, double theta, const std::vector<double>& x_traj,
                   const std::vector<double>& y_traj) {
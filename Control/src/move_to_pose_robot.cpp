@@ -11,6 +11,7 @@
 #include "PathFinderController.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using namespace Eigen;
 using std::string;
@@ -19,7 +20,7 @@ namespace plt = matplotlibcpp;
 constexpr int TIME_DURATION = 1000;
 constexpr double TIME_STEP = 0.01;
 constexpr double AT_TARGET_ACCEPTANCE_THRESHOLD = 0.01;
-constexpr bool SHOW_ANIMATION = true;
+constexpr bool SHOW_ANIMATION = utils::viz::ANIMATE;
 constexpr int PLOT_WINDOW_SIZE_X = 20;
 constexpr int PLOT_WINDOW_SIZE_Y = 20;
 constexpr int PLOT_FONT_SIZE = 8;
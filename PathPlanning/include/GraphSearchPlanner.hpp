@@ -4,11 +4,16 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include <memory>
 #include <unordered_map>
 #include <vector>
 
+#include "IndexedHeap.hpp"
+#include "occupancy_grid.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 class Node {
@@ -31,6 +36,67 @@ public:
     ~Node() {}
 };
 
+// flat per-cell search state indexed by iy * xwidth + ix. entries are only valid when their
+// stamp matches the current search, so a reused arena never clears or reallocates its tables.
+class SearchArena {
+public:
+    std::vector<double> cost;
+    std::vector<int> parent;
+    std::vector<bool> closed;
+    std::vector<unsigned int> stamp;
+    IndexedHeap<> open_set;
+    unsigned int search_id = 0;
+    size_t expanded = 0;
+
+    SearchArena() {}
+    ~SearchArena() {}
+
+    void reset(int ncells) {
+        if (static_cast<int>(stamp.size()) != ncells) {
+            cost.assign(ncells, 0.0);
+            parent.assign(ncells, -1);
+            closed.assign(ncells, false);
+            stamp.assign(ncells, 0);
+            search_id = 0;
+        }
+        open_set.reserve(ncells);
+        open_set.clear();
+        expanded = 0;
+        if (++search_id == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            search_id = 1;
+        }
+    }
+
+    bool visited(int index) const { return stamp[index] == search_id; }
+
+    bool is_closed(int index) const { return visited(index) && closed[index]; }
+
+    void visit(int index, double c, int p) {
+        stamp[index] = search_id;
+        cost[index] = c;
+        parent[index] = p;
+        closed[index] = false;
+    }
+};
+
+// one (start, goal) request for plan_batch, the result is written back in place
+class Query {
+public:
+    double sx;
+    double sy;
+    double gx;
+    double gy;
+    bool found = false;
+    size_t expanded = 0;
+    double search_ms = 0.0;  // wall time of the search alone
+    std::vector<std::vector<double>> path;
+
+    Query() {}
+    Query(double _sx, double _sy, double _gx, double _gy) : sx(_sx), sy(_sy), gx(_gx), gy(_gy) {}
+    ~Query() {}
+};
+
 class GraphSearchPlanner {
 private:
     double minx;
@@ -41,8 +107,13 @@ private:
     double ywidth;
     double map_resolution;
     double robot_radius;
-    std::vector<std::vector<bool>> obstacle_map;
+    utils::OccupancyGrid obstacle_map;
+    // bumped on every change of obstacle_map, lets derived planners drop cached results
+    unsigned int map_version = 0;
     std::vector<std::vector<double>> motion;
+    SearchArena search_arena;
+    std::vector<SearchArena> batch_arenas;
+    std::unique_ptr<utils::ThreadPool> pool;
 
 public:
     GraphSearchPlanner() {}
@@ -52,24 +123,72 @@ public:
         calc_obstacle_map(ox, oy);
         motion = get_motion_model();
     }
+    // plan on an already inflated grid, e.g. one loaded with OccupancyGrid::load
+    explicit GraphSearchPlanner(utils::OccupancyGrid grid) {
+        map_resolution = grid.get_resolution();
+        robot_radius = 0.0;
+        minx = grid.get_minx();
+        miny = grid.get_miny();
+        xwidth = grid.get_xwidth();
+        ywidth = grid.get_ywidth();
+        maxx = minx + xwidth * map_resolution;
+        maxy = miny + ywidth * map_resolution;
+        obstacle_map = std::move(grid);
+        motion = get_motion_model();
+    }
     virtual ~GraphSearchPlanner() {}
     void calc_obstacle_map(const std::vector<double>& ox, const std::vector<double>& oy);
     std::vector<std::vector<double>> get_motion_model(void);
-    double calc_grid_position(int index, double minp);
-    double calc_xyindex(double position, double min_pos);
+    double calc_grid_position(int index, double minp) const;
+    double calc_xyindex(double position, double min_pos) const;
     double calc_grid_index(std::shared_ptr<Node> node);
     bool verify_node(std::shared_ptr<Node> node);
     std::vector<std::vector<double>> calc_final_path(
         std::shared_ptr<Node> ngoal, std::unordered_map<double, std::shared_ptr<Node>>& closed_set);
 
+    int calc_cell_index(int ix, int iy) const { return iy * static_cast<int>(xwidth) + ix; }
+    bool verify_cell(int ix, int iy) const;
+    // mark one grid cell occupied or free, for planners that follow map changes. planners with
+    // tables derived from the map override it to keep them in sync
+    virtual void set_obstacle(int ix, int iy, bool occupied);
+    bool best_first_search(SearchArena& arena, int sx, int sy, int gx, int gy, double weight,
+                           const std::function<void(int, int, size_t)>& on_expand = nullptr) const;
+    // best_first_search restricted to the cells xlo <= ix <= xhi, ylo <= iy <= yhi. with gx < 0
+    // there is no goal and the whole window is flooded (use weight 0).
+    bool windowed_search(SearchArena& arena, int sx, int sy, int gx, int gy, int xlo, int ylo,
+                         int xhi, int yhi, double weight,
+                         const std::function<void(int, int, size_t)>& on_expand = nullptr) const;
+    std::vector<std::vector<double>> calc_final_path(const SearchArena& arena, int gx,
+                                                     int gy) const;
+
+    // reentrant search on grid indices, only touches the given arena. weighted A* by default
+    virtual bool search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                        const std::function<void(int, int, size_t)>& on_expand = nullptr) const;
+    virtual std::vector<std::vector<double>> extract_path(const SearchArena& arena, int gx,
+                                                          int gy) const;
+
     virtual std::vector<std::vector<double>> planning(double sx, double sy, double gx,
                                                       double gy) = 0;
 
+    // answer all queries with search() on num_threads threads (0: one per core), sharing the
+    // obstacle map read-only. every thread keeps its own arena between batches.
+    void plan_batch(std::vector<Query>& queries, int num_threads = 0);
+
     double get_minx(void) const { return minx; }
 
     double get_miny(void) const { return miny; }
 
     std::vector<std::vector<double>> get_motion(void) const { return motion; }
+
+    int get_xwidth(void) const { return xwidth; }
+
+    int get_ywidth(void) const { return ywidth; }
+
+    SearchArena& get_search_arena(void) { return search_arena; }
+
+    const utils::OccupancyGrid& get_obstacle_map(void) const { return obstacle_map; }
+
+    unsigned int get_map_version(void) const { return map_version; }
 };
 
 #endif
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef __INDEXEDHEAP_HPP
+#define __INDEXEDHEAP_HPP
+
+#include <utility>
+#include <vector>
+
+// binary min-heap over integer keys in [0, capacity) with O(log n) decrease-key. Priority only
+// needs operator< and operator<=, e.g. the lexicographic key pair of D* Lite.
+template <typename Priority = double>
+class IndexedHeap {
+private:
+    std::vector<std::pair<Priority, int>> heap;
+    std::vector<int> position;
+
+    void swap_nodes(int i, int j) {
+        std::swap(heap[i], heap[j]);
+        position[heap[i].second] = i;
+        position[heap[j].second] = j;
+    }
+
+    void sift_up(int i) {
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (heap[parent].first <= heap[i].first) {
+                break;
+            }
+            swap_nodes(i, parent);
+            i = parent;
+        }
+    }
+
+    void sift_down(int i) {
+        int n = heap.size();
+        while (true) {
+            int left = 2 * i + 1;
+            int right = left + 1;
+            int smallest = i;
+            if (left < n && heap[left].first < heap[smallest].first) {
+                smallest = left;
+            }
+            if (right < n && heap[right].first < heap[smallest].first) {
+                smallest = right;
+            }
+            if (smallest == i) {
+                break;
+            }
+            swap_nodes(i, smallest);
+            i = smallest;
+        }
+    }
+
+public:
+    IndexedHeap() {}
+    explicit IndexedHeap(int capacity) { reserve(capacity); }
+    ~IndexedHeap() {}
+
+    void reserve(int capacity) {
+        if (static_cast<int>(position.size()) < capacity) {
+            position.resize(capacity, -1);
+        }
+    }
+
+    bool empty(void) const { return heap.empty(); }
+
+    size_t size(void) const { return heap.size(); }
+
+    bool contains(int key) const { return position[key] >= 0; }
+
+    const Priority& priority(int key) const { return heap[position[key]].first; }
+
+    int top(void) const { return heap.front().second; }
+
+    const Priority& top_priority(void) const { return heap.front().first; }
+
+    // insert key, or move it to the new priority if it is already queued
+    void push(int key, const Priority& priority) {
+        int i = position[key];
+        if (i < 0) {
+            heap.emplace_back(priority, key);
+            i = heap.size() - 1;
+            position[key] = i;
+            sift_up(i);
+        } else if (priority < heap[i].first) {
+            heap[i].first = priority;
+            sift_up(i);
+        } else {
+            heap[i].first = priority;
+            sift_down(i);
+        }
+    }
+
+    int pop(void) {
+        int key = heap.front().second;
+        swap_nodes(0, heap.size() - 1);
+        heap.pop_back();
+        position[key] = -1;
+        if (!heap.empty()) {
+            sift_down(0);
+        }
+
+        return key;
+    }
+
+    void erase(int key) {
+        int i = position[key];
+        if (i < 0) {
+            return;
+        }
+        int last = heap.size() - 1;
+        swap_nodes(i, last);
+        heap.pop_back();
+        position[key] = -1;
+        if (i < last) {
+            int moved = heap[i].second;
+            sift_up(i);
+            sift_down(position[moved]);
+        }
+    }
+
+    // give every queued key the priority fn(key) and rebuild the heap, O(size)
+    template <typename Fn>
+    void rekey(Fn fn) {
+        for (std::pair<Priority, int>& item : heap) {
+            item.first = fn(item.second);
+        }
+        for (int i = static_cast<int>(heap.size()) / 2 - 1; i >= 0; --i) {
+            sift_down(i);
+        }
+    }
+
+    // O(size) reset, the key table keeps its capacity
+    void clear(void) {
+        for (const std::pair<Priority, int>& item : heap) {
+            position[item.second] = -1;
+        }
+        heap.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#pragma once
+#ifndef __BEZIER_CURVE_HPP
+#define __BEZIER_CURVE_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Bernstein polynomials of a degree and of the two degrees below it at a grid of t, stored one
+// array per polynomial, b[k][j] = B(degree, k)(t[j]). they are built by the recurrence
+// B(n, k) = (1 - t) B(n - 1, k) + t B(n - 1, k - 1), so there are no binomials to overflow. one
+// basis serves every curve of the degree sampled at the same t
+class BernsteinBasis {
+public:
+    int degree = 0;
+    std::vector<double> t;
+    std::vector<std::vector<double>> b;
+    std::vector<std::vector<double>> b1;  // degree - 1, for the first derivative
+    std::vector<std::vector<double>> b2;  // degree - 2, for the second derivative
+
+    BernsteinBasis() {}
+    BernsteinBasis(int _degree, const std::vector<double>& _t) : degree(_degree), t(_t) {
+        std::vector<std::vector<double>> cur(1, std::vector<double>(t.size(), 1.0));
+        for (int n = 0;; ++n) {
+            if (n == degree - 2) {
+                b2 = cur;
+            } else if (n == degree - 1) {
+                b1 = cur;
+            } else if (n == degree) {
+                b.swap(cur);
+                break;
+            }
+            std::vector<std::vector<double>> next(n + 2, std::vector<double>(t.size(), 0.0));
+            for (int k = 0; k <= n; ++k) {
+                for (size_t j = 0; j < t.size(); ++j) {
+                    next[k][j] += (1.0 - t[j]) * cur[k][j];
+                    next[k + 1][j] += t[j] * cur[k][j];
+                }
+            }
+            cur.swap(next);
+        }
+    }
+    // n_points + 1 uniform t from 0 to 1, both ends included
+    BernsteinBasis(int _degree, int n_points) : BernsteinBasis(_degree, uniform(n_points)) {}
+    ~BernsteinBasis() {}
+
+    size_t size(void) const { return t.size(); }
+
+    static std::vector<double> uniform(int n_points) {
+        std::vector<double> ts(n_points + 1);
+        for (int j = 0; j <= n_points; ++j) {
+            ts[j] = static_cast<double>(j) / n_points;
+        }
+        return ts;
+    }
+};
+
+// planar Bezier curve with its control points and the control points of its first and second
+// derivative curves, n (P[k + 1] - P[k]) and n (n - 1) (P[k + 2] - 2 P[k + 1] + P[k])
+class BezierCurve {
+public:
+    int degree = 0;
+    std::vector<double> px;
+    std::vector<double> py;
+    std::vector<double> dpx;
+    std::vector<double> dpy;
+    std::vector<double> ddpx;
+    std::vector<double> ddpy;
+
+    BezierCurve() {}
+    // control points as {x list, y list}
+    explicit BezierCurve(const std::vector<std::vector<double>>& control_points) {
+        set_control_points(control_points[0].data(), control_points[1].data(),
+                           control_points[0].size());
+    }
+    ~BezierCurve() {}
+
+    void set_control_points(const double* x, const double* y, size_t n) {
+        degree = n - 1;
+        px.assign(x, x + n);
+        py.assign(y, y + n);
+        dpx.resize(degree > 0 ? degree : 0);
+        dpy.resize(dpx.size());
+        for (int k = 0; k < degree; ++k) {
+            dpx[k] = degree * (px[k + 1] - px[k]);
+            dpy[k] = degree * (py[k + 1] - py[k]);
+        }
+        ddpx.resize(degree > 1 ? degree - 1 : 0);
+        ddpy.resize(ddpx.size());
+        for (int k = 0; k + 1 < degree; ++k) {
+            ddpx[k] = (degree - 1) * (dpx[k + 1] - dpx[k]);
+            ddpy[k] = (degree - 1) * (dpy[k + 1] - dpy[k]);
+        }
+    }
+
+    // the curve at every t of basis, which has to be of the same degree. each output holds
+    // basis.size(), the derivatives may be nullptr
+    void evaluate(const BernsteinBasis& basis, double* x, double* y, double* dx = nullptr,
+                  double* dy = nullptr, double* ddx = nullptr, double* ddy = nullptr) const {
+        size_t n = basis.size();
+        combine(basis.b, px, py, n, x, y);
+        if (dx != nullptr && dy != nullptr) {
+            combine(basis.b1, dpx, dpy, n, dx, dy);
+        }
+        if (ddx != nullptr && ddy != nullptr) {
+            combine(basis.b2, ddpx, ddpy, n, ddx, ddy);
+        }
+    }
+
+    // sum of cx[k] b[k] and cy[k] b[k], the inner loops run over t and vectorize
+    static void combine(const std::vector<std::vector<double>>& b, const std::vector<double>& cx,
+                        const std::vector<double>& cy, size_t n, double* x, double* y) {
+        for (size_t j = 0; j < n; ++j) {
+            x[j] = 0.0;
+            y[j] = 0.0;
+        }
+        for (size_t k = 0; k < cx.size(); ++k) {
+            const double* bk = b[k].data();
+            double ckx = cx[k];
+            double cky = cy[k];
+            for (size_t j = 0; j < n; ++j) {
+                x[j] += ckx * bk[j];
+                y[j] += cky * bk[j];
+            }
+        }
+    }
+};
+
+// curves of one degree, e.g. the smoothing candidates of a cycle. the curves are kept in slots
+// that clear() does not release, so refilling the batch does not allocate once it has held as
+// many curves before. the outputs of evaluate hold size() rows of basis.size() samples, row i
+// belonging to curve i
+class BezierBatch {
+public:
+    BezierBatch() {}
+    explicit BezierBatch(int _degree) : degree(_degree) {}
+    ~BezierBatch() {}
+
+    void clear(void) { count = 0; }
+    size_t size(void) const { return count; }
+    const BezierCurve& operator[](size_t i) const { return curves[i]; }
+
+    // x and y hold degree + 1 control points
+    void add(const double* x, const double* y) {
+        if (count == curves.size()) {
+            curves.emplace_back();
+        }
+        curves[count++].set_control_points(x, y, degree + 1);
+    }
+
+    void evaluate(const BernsteinBasis& basis, double* x, double* y, double* dx = nullptr,
+                  double* dy = nullptr, double* ddx = nullptr, double* ddy = nullptr) const {
+        size_t n = basis.size();
+        for (size_t i = 0; i < count; ++i) {
+            size_t row = i * n;
+            curves[i].evaluate(basis, x + row, y + row, dx != nullptr ? dx + row : nullptr,
+                               dy != nullptr ? dy + row : nullptr,
+                               ddx != nullptr ? ddx + row : nullptr,
+                               ddy != nullptr ? ddy + row : nullptr);
+        }
+    }
+
+private:
+    int degree = 0;
+    std::vector<BezierCurve> curves;
+    size_t count = 0;
+};
+
+#endif
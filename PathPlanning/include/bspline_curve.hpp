@@ -0,0 +1,201 @@
+#pragma once
+#ifndef __BSPLINE_CURVE_HPP
+#define __BSPLINE_CURVE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+// B-spline basis of a knot vector at a grid of u. only the order (degree + 1) functions that
+// are non-zero on the knot span of a u are stored, with up to two derivatives, so a curve
+// over the grid is a short weighted sum per point. the functions come from the triangular
+// de Boor-Cox scheme instead of the recursion, which costs O(order^2) per u. one basis serves
+// every curve with the same knots sampled at the same u
+class BSplineBasis {
+public:
+    int order = 0;
+    int ders = 0;
+    std::vector<double> u;
+    std::vector<int> span;  // knot span of every u, functions span - degree .. span are non-zero
+    // values[d][j * order + r] is derivative d of function span[j] - degree + r at u[j]
+    std::vector<std::vector<double>> values;
+
+    BSplineBasis() {}
+    // the knots cover order + number of control points, u has to lie within
+    // [knots[order - 1], knots[knots.size() - order]]
+    BSplineBasis(int _order, const std::vector<double>& knots, const std::vector<double>& _u,
+                 int _ders = 2)
+        : order(_order), ders(std::min(_ders, _order - 1)), u(_u) {
+        span.resize(u.size());
+        values.assign(ders + 1, std::vector<double>(u.size() * order));
+        std::vector<double> out((ders + 1) * order);
+        int hint = order - 1;
+        for (size_t j = 0; j < u.size(); ++j) {
+            hint = find_span(order, knots, u[j], hint);
+            span[j] = hint;
+            calc_basis(knots, hint, u[j], out.data());
+            for (int d = 0; d <= ders; ++d) {
+                std::copy(out.begin() + d * order, out.begin() + (d + 1) * order,
+                          values[d].begin() + j * order);
+            }
+        }
+    }
+    ~BSplineBasis() {}
+
+    size_t size(void) const { return u.size(); }
+
+    // span i with knots[i] <= uu < knots[i + 1] among the spans of the curve, the end of the
+    // curve belongs to its last non-empty span. spans at or after hint are tried first
+    static int find_span(int order, const std::vector<double>& knots, double uu, int hint) {
+        int first = order - 1;
+        int last = knots.size() - order - 1;
+        if (uu < knots[first] || uu > knots[last + 1]) {
+            throw std::invalid_argument("received value out of the pre-defined range");
+        }
+        while (last > first && knots[last] >= knots[last + 1]) {
+            --last;
+        }
+        if (uu >= knots[last]) {
+            return last;
+        }
+        if (hint >= first && hint <= last && knots[hint] <= uu) {
+            while (!(uu < knots[hint + 1])) {
+                ++hint;
+            }
+            return hint;
+        }
+        auto it = std::upper_bound(knots.begin() + first, knots.begin() + last + 1, uu);
+        return std::distance(knots.begin(), it) - 1;
+    }
+
+private:
+    std::vector<double> left;
+    std::vector<double> right;
+    // ndu[j][r] below the diagonal: knot differences, on and above it: basis values
+    std::vector<std::vector<double>> ndu;
+    std::vector<std::vector<double>> a;
+
+    // the order non-zero functions on span at uu and their derivatives up to ders, out holds
+    // (ders + 1) * order values, derivative d first at out[d * order]
+    void calc_basis(const std::vector<double>& knots, int span, double uu, double* out) {
+        int p = order - 1;
+        int n_ders = ders;
+        left.resize(order);
+        right.resize(order);
+        ndu.resize(order, std::vector<double>(order));
+        a.resize(2, std::vector<double>(order));
+        ndu[0][0] = 1.0;
+        for (int j = 1; j <= p; ++j) {
+            left[j] = uu - knots[span + 1 - j];
+            right[j] = knots[span + j] - uu;
+            double saved = 0.0;
+            for (int r = 0; r < j; ++r) {
+                ndu[j][r] = right[r + 1] + left[j - r];
+                double temp = ndu[r][j - 1] / ndu[j][r];
+                ndu[r][j] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            }
+            ndu[j][j] = saved;
+        }
+        for (int r = 0; r <= p; ++r) {
+            out[r] = ndu[r][p];
+        }
+
+        for (int r = 0; r <= p; ++r) {
+            int s1 = 0;
+            int s2 = 1;
+            a[0][0] = 1.0;
+            for (int k = 1; k <= n_ders; ++k) {
+                double d = 0.0;
+                int rk = r - k;
+                int pk = p - k;
+                if (r >= k) {
+                    a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+                    d = a[s2][0] * ndu[rk][pk];
+                }
+                int j1 = rk >= -1 ? 1 : -rk;
+                int j2 = r - 1 <= pk ? k - 1 : p - r;
+                for (int j = j1; j <= j2; ++j) {
+                    a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+                    d += a[s2][j] * ndu[rk + j][pk];
+                }
+                if (r <= pk) {
+                    a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+                    d += a[s2][k] * ndu[r][pk];
+                }
+                out[k * order + r] = d;
+                std::swap(s1, s2);
+            }
+        }
+        double factor = p;
+        for (int k = 1; k <= n_ders; ++k) {
+            for (int r = 0; r <= p; ++r) {
+                out[k * order + r] *= factor;
+            }
+            factor *= p - k;
+        }
+    }
+};
+
+// planar B-spline of some order over a knot vector with knots.size() - order control points
+class BSplineCurve {
+public:
+    int order = 0;
+    std::vector<double> knots;
+    std::vector<double> px;
+    std::vector<double> py;
+
+    BSplineCurve() {}
+    // control points as {x list, y list}
+    BSplineCurve(int _order, const std::vector<double>& _knots,
+                 const std::vector<std::vector<double>>& control_points)
+        : order(_order), knots(_knots), px(control_points[0]), py(control_points[1]) {
+        if (order < 1 || knots.size() != px.size() + order) {
+            throw std::invalid_argument("Bspline illegal parameter !");
+        }
+    }
+    ~BSplineCurve() {}
+
+    double get_begin(void) const { return knots[order - 1]; }
+    double get_end(void) const { return knots[px.size()]; }
+
+    // n_points + 1 uniform u over the curve, both ends included
+    std::vector<double> uniform(int n_points) const {
+        std::vector<double> u(n_points + 1);
+        for (int j = 0; j <= n_points; ++j) {
+            u[j] = get_begin() + (get_end() - get_begin()) * j / n_points;
+        }
+        return u;
+    }
+
+    // the curve at every u of basis, which has to be built on the knots of this curve. each
+    // output holds basis.size(), the derivatives may be nullptr and are zero beyond
+    // basis.ders
+    void evaluate(const BSplineBasis& basis, double* x, double* y, double* dx = nullptr,
+                  double* dy = nullptr, double* ddx = nullptr, double* ddy = nullptr) const {
+        double* outs[3][2] = {{x, y}, {dx, dy}, {ddx, ddy}};
+        for (int d = 0; d <= 2; ++d) {
+            if (outs[d][0] == nullptr || outs[d][1] == nullptr) {
+                continue;
+            }
+            for (size_t j = 0; j < basis.size(); ++j) {
+                double sx = 0.0;
+                double sy = 0.0;
+                if (d <= basis.ders) {
+                    const double* n = basis.values[d].data() + j * order;
+                    int first = basis.span[j] - (order - 1);
+                    for (int r = 0; r < order; ++r) {
+                        sx += n[r] * px[first + r];
+                        sy += n[r] * py[first + r];
+                    }
+                }
+                outs[d][0][j] = sx;
+                outs[d][1][j] = sy;
+            }
+        }
+    }
+};
+
+#endif
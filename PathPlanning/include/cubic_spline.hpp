@@ -14,24 +14,45 @@ private:
     std::vector<double> c;
     std::vector<double> d;
     std::vector<double> h;
-    int nx;
+    std::vector<double> cp;  // forward elimination of the tridiagonal system for c
+    std::vector<double> dp;
+    int nx = 0;
+
+    int solve(int first_row);
 
 public:
     CubicSpline() {}
     CubicSpline(std::vector<double> _x, std::vector<double> _y);
     ~CubicSpline() {}
-    Eigen::MatrixXd calc_A(void);
-    Eigen::VectorXd calc_B(void);
+    // continues the spline through more points, _x has to go on ascending from the last knot.
+    // the result equals building the spline over all points, but only the pieces whose
+    // coefficients change are recomputed. returns the first of them
+    int append(const std::vector<double>& _x, const std::vector<double>& _y);
     double calc_position(double _x) const;
     double calc_first_derivative(double _x) const;
     double calc_second_derivative(double _x) const;
     double operator()(double _x, int dd = 0) const;
+
+    // polynomial piece [0, nx - 2] that _x falls in, the knot at the end belongs to the last
+    // one. the search starts from the piece hint, so a query next to the previous one costs
+    // O(1); throws if _x is out of range
+    int calc_segment(double _x, int hint = 0) const;
+    // value and first two derivatives at _x on the piece segment, any of them may be nullptr
+    void calc_derivatives(double _x, int segment, double* value, double* dy, double* ddy) const;
+
+    const std::vector<double>& get_y(void) const { return y; }
 };
 
 class CubicSpline2D {
 private:
     CubicSpline sx;
     CubicSpline sy;
+    int lut_samples = 0;  // per piece, 0 if there is no table
+    std::vector<double> lut_s;
+    std::vector<double> lut_arc;
+
+    double calc_arc_length(double s0, double s1, int segment) const;
+    void extend_arc_length_table(int first_piece);
 
 public:
     std::vector<double> s;
@@ -40,11 +61,40 @@ public:
     CubicSpline2D(std::vector<double> _x, std::vector<double> _y);
     ~CubicSpline2D() {}
     std::vector<double> calc_s(std::vector<double> _x, std::vector<double> _y);
+    // continues the path through more points, the arc length table is kept up to date
+    void append(const std::vector<double>& _x, const std::vector<double>& _y);
     Eigen::Vector2d calc_position(double _s) const;
     double calc_yaw(double _s) const;
     double calc_curvature(double _s) const;
     Eigen::Vector2d operator()(double _s, int n = 0) const;
 
+    // position, yaw and curvature at _s, any of them may be nullptr. segment is a cursor kept
+    // by the caller, start it at 0 and the pieces are found in O(1) while _s moves in small
+    // steps
+    void evaluate(double _s, int& segment, double* x, double* y, double* yaw,
+                  double* kappa) const;
+    // the same for every s of _s, the outputs are resized to it. out_kappa may be nullptr
+    void evaluate(const std::vector<double>& _s, std::vector<double>& out_x,
+                  std::vector<double>& out_y, std::vector<double>& out_yaw,
+                  std::vector<double>* out_kappa = nullptr) const;
+    // position and its first two derivatives by s at _s, with the same cursor
+    void calc_derivatives(double _s, int& segment, Eigen::Vector2d& xy, Eigen::Vector2d& dxy,
+                          Eigen::Vector2d& ddxy) const;
+
+    // s in [s0, s1] of the point nearest to p. the interval is searched at steps of ds, the
+    // best sample is then refined by Newton steps on (xy(s) - p) . dxy(s) = 0. segment is a
+    // cursor as in evaluate and ends on the piece of the result
+    double calc_nearest_s(const Eigen::Vector2d& p, double s0, double s1, int& segment,
+                          double ds = 0.5) const;
+
+    // s is the length of the polyline through the points, the arc length of the spline is
+    // longer where it bends. the table holds the arc length at samples points of every piece,
+    // integrated with Gauss-Legendre
+    void build_arc_length_table(int samples = 8);
+    double get_arc_length(void) const { return lut_arc.empty() ? 0.0 : lut_arc.back(); }
+    // s at which the arc length from the start is arc, needs the table
+    double calc_s_from_arc_length(double arc) const;
+
     static std::vector<std::vector<double>> calc_spline_course(std::vector<double> x,
                                                                std::vector<double> y,
                                                                double ds = 0.1);
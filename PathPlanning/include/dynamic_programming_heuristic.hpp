@@ -2,58 +2,41 @@
 #ifndef __DYNAMIC_PROGRAMMING_HEURISTIC_HPP
 #define __DYNAMIC_PROGRAMMING_HEURISTIC_HPP
 
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-class Node {
+std::vector<std::vector<double>> calc_holonomic_heuristic_with_obstacle(
+    double gx, double gy, const std::vector<std::vector<double>>& obs, double reso, double rr);
+
+// holonomic heuristic fields of the most recently used goal cells. the version of the obstacle
+// map is a fingerprint of (obs, reso, rr) taken on every lookup, a different map drops all
+// fields, so repeated queries to the same goal skip the grid Dijkstra.
+class HolonomicHeuristicCache {
 public:
-    int xind;
-    int yind;
-    int yawind;
-    int direction;
-    std::vector<double> x;
-    std::vector<double> y;
-    std::vector<double> yaw;
-    std::vector<double> yawt;
-    std::vector<int> directions;
-    double steer;
-    double cost;
-    int pind;
+    explicit HolonomicHeuristicCache(size_t _capacity = 4) : capacity(_capacity) {}
+    ~HolonomicHeuristicCache() {}
 
-    Node(int _xi, int _yi, int _yawi, int _d, std::vector<double> _x, std::vector<double> _y,
-         std::vector<double> _yaw, std::vector<int> _ds, double _s, double _c, int _p)
-        : xind(_xi),
-          yind(_yi),
-          yawind(_yawi),
-          direction(_d),
-          x(_x),
-          y(_y),
-          yaw(_yaw),
-          directions(_ds),
-          steer(_s),
-          cost(_c),
-          pind(_p) {}
-    Node(int _xi, int _yi, int _yawi, int _d, std::vector<double> _x, std::vector<double> _y,
-         std::vector<double> _yaw, std::vector<double> _yawt, std::vector<int> _ds, double _s,
-         double _c, int _p)
-        : xind(_xi),
-          yind(_yi),
-          yawind(_yawi),
-          direction(_d),
-          x(_x),
-          y(_y),
-          yaw(_yaw),
-          yawt(_yawt),
-          directions(_ds),
-          steer(_s),
-          cost(_c),
-          pind(_p) {}
-    Node() {}
-    ~Node() {}
-};
+    const std::vector<std::vector<double>>& get(double gx, double gy,
+                                                const std::vector<std::vector<double>>& obs,
+                                                double reso, double rr);
 
-std::vector<std::vector<double>> calc_holonomic_heuristic_with_obstacle(
-    std::shared_ptr<Node> node, const std::vector<std::vector<double>>& obs, double reso,
-    double rr);
+    size_t get_hits(void) const { return hits; }
+    size_t get_misses(void) const { return misses; }
+
+private:
+    size_t capacity;
+    uint64_t map_version = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    // front is newest
+    std::list<int64_t> lru;
+    std::unordered_map<int64_t,
+                       std::pair<std::vector<std::vector<double>>, std::list<int64_t>::iterator>>
+        fields;
+};
 
 #endif
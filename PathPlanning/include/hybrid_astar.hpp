@@ -0,0 +1,771 @@
+#pragma once
+#ifndef __HYBRID_ASTAR_HPP
+#define __HYBRID_ASTAR_HPP
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dynamic_programming_heuristic.hpp"
+#include "footprint_checker.hpp"
+#include "hybrid_search_arena.hpp"
+#include "motion_primitives.hpp"
+#include "occupancy_grid.hpp"
+#include "profiler.hpp"
+#include "reeds_shepp_path.hpp"
+#include "rs_heuristic_table.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+// kinematic model policies of HybridAstar. all tuning constants are per model, the trailer
+// heading and its checks are only compiled in for models with HAS_TRAILER.
+class CarModel {
+public:
+    using State = Eigen::Vector3d;  // x, y, yaw
+
+    static constexpr bool HAS_TRAILER = false;
+    static constexpr int N_STEER = 3;                          // steer command number
+    static constexpr double XY_RESO = 2.0;                     // [m]
+    static constexpr double YAW_RESO = 15 * M_PI / 180;        // [rad]
+    static constexpr double MOVE_STEP = 0.4;                   // [m] path interporate resolution
+    static constexpr int COLLISION_CHECK_STEP = 5;             // skip number for collision check
+    static constexpr double EXTEND_AREA = 0.0;                 // [m] search area around obstacles
+    static constexpr double COLLISION_RESO = 0.25;             // [m] collision map resolution
+    static constexpr double GEAR_COST = 100.0;                 // switch back penalty cost
+    static constexpr double BACKWARD_COST = 5.0;               // backward penalty cost
+    static constexpr double STEER_CHANGE_COST = 5.0;           // steer angle change penalty cost
+    static constexpr double STEER_ANGLE_COST = 1.0;            // steer angle penalty cost
+    static constexpr double SCISSORS_COST = 0.0;               // hitch angle penalty cost
+    static constexpr double H_COST = 15.0;                     // Heuristic cost penalty cost
+    static constexpr double PRIMITIVE_LENGTH = XY_RESO * 2.5;  // [m] arc of one expansion
+    static constexpr int RS_INTERVAL = 5;                      // pops between analytic expansions
+    static constexpr double RS_NEAR_DIST = 10.0;               // [m] try every pop closer than this
+    static constexpr int RS_CANDIDATES = 64;                   // cheapest RS words checked
+    static constexpr double GOAL_YAW_ERROR = M_PI;             // [rad] trailer yaw at goal
+    static constexpr double MAX_HITCH = M_PI;                  // [rad] jackknife bound
+};
+
+// the constants have the meaning of the CarModel ones
+class TrailerModel {
+public:
+    using State = Eigen::Vector4d;  // x, y, yaw, trailer yaw
+
+    static constexpr bool HAS_TRAILER = true;
+    static constexpr int N_STEER = 20;
+    static constexpr double XY_RESO = 2.0;
+    static constexpr double YAW_RESO = 15 * M_PI / 180;
+    static constexpr double MOVE_STEP = 0.2;
+    static constexpr int COLLISION_CHECK_STEP = 10;
+    static constexpr double EXTEND_AREA = 5.0;
+    static constexpr double COLLISION_RESO = 0.25;
+    static constexpr double GEAR_COST = 100.0;
+    static constexpr double BACKWARD_COST = 5.0;
+    static constexpr double STEER_CHANGE_COST = 5.0;
+    static constexpr double STEER_ANGLE_COST = 1.0;
+    static constexpr double SCISSORS_COST = 200.0;
+    static constexpr double H_COST = 10.0;
+    static constexpr double PRIMITIVE_LENGTH = XY_RESO * 2.0;
+    static constexpr int RS_INTERVAL = 1;
+    static constexpr double RS_NEAR_DIST = 0.0;
+    static constexpr int RS_CANDIDATES = 1;
+    static constexpr double GOAL_YAW_ERROR = M_PI / 60;
+    static constexpr double MAX_HITCH = 80 * M_PI / 180;
+};
+
+// Hybrid A* over a kinematic model policy. the primitives, footprints, search arena and
+// heuristic cache belong to the planner and are reused by every query, so keep one planner per
+// vehicle and thread.
+template <typename Model>
+class HybridAstar {
+public:
+    using State = typename Model::State;
+    using Arena = HybridSearchArena<Model::HAS_TRAILER>;
+    using ExpandCallback =
+        std::function<void(const std::vector<double>&, const std::vector<double>&)>;
+    using ImproveCallback = std::function<void(const Path&, double)>;
+
+    // the primitives only depend on the vehicle and the model. primitive_file, if not empty,
+    // keeps them between runs: they are loaded from it, or built and saved to it
+    explicit HybridAstar(const utils::VehicleConfig& _vc, const std::string& primitive_file = "");
+    ~HybridAstar() {}
+
+    // goal frame Reeds-Shepp heuristic owned by the caller, nullptr uses the holonomic one only
+    void set_rs_table(const RSHeuristicTable* table) { rs_table = table; }
+
+    // evaluate the successors of a node on pool, nullptr evaluates them on the calling thread
+    void set_thread_pool(utils::ThreadPool* _pool) { pool = _pool; }
+
+    // called with the poses of every successor that is added to or improved in the open set
+    void set_expand_callback(ExpandCallback fn) { on_expand = fn; }
+
+    // obs are the obstacle points [m], an empty path is returned if the goal is not reachable
+    Path planning(const State& start, const State& goal,
+                  const std::vector<std::vector<double>>& obs);
+
+    // anytime mode (ARA*): the heuristic weight starts at H_COST and is lowered round by round,
+    // every round continues from the nodes and costs of the previous one. on_improve gets each
+    // better path and its cost. returns the best path found within time_budget [ms], empty if
+    // there is none by then
+    Path planning_anytime(const State& start, const State& goal,
+                          const std::vector<std::vector<double>>& obs, double time_budget,
+                          ImproveCallback on_improve = nullptr);
+
+    // weight schedule of planning_anytime: multiplied by decay per round down to final_weight
+    void set_anytime_weights(double _final_weight, double _decay) {
+        final_weight = _final_weight;
+        decay = _decay;
+    }
+
+    const Arena& get_arena(void) const { return arena; }
+    const HolonomicHeuristicCache& get_heuristics(void) const { return heuristics; }
+    const utils::VehicleConfig& get_vehicle(void) const { return vc; }
+
+private:
+    // successors of one node, one slot per primitive. the poses are primitive-major, see
+    // MotionPrimitiveTable::apply_all
+    class SuccessorBatch {
+    public:
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> yaw;
+        std::vector<double> yawt;
+        std::vector<double> hitch_cost;  // sum of |hitch angle| over the samples of a slot
+        std::vector<double> max_hitch;
+        std::vector<char> valid;
+        std::vector<int> states;
+        std::vector<HybridNode> nodes;
+    };
+
+    utils::VehicleConfig vc;
+    MotionPrimitiveTable primitives;
+    utils::FootprintChecker footprint;
+    utils::FootprintChecker trailer_footprint;
+    Arena arena;
+    HolonomicHeuristicCache heuristics;
+    SuccessorBatch batch;
+    const RSHeuristicTable* rs_table = nullptr;
+    utils::ThreadPool* pool = nullptr;
+    ExpandCallback on_expand;
+    double weight = Model::H_COST;
+    double final_weight = 1.0;
+    double decay = 0.5;
+
+    // search grid of the current query in cells of XY_RESO and YAW_RESO
+    int minx = 0;
+    int miny = 0;
+    int minyaw = 0;
+    int maxx = 0;
+    int maxy = 0;
+    int xw = 0;
+    int yw = 0;
+    int yaww = 0;
+    std::vector<std::vector<double>> grid_obs;
+    utils::OccupancyGrid collision_map;
+    const std::vector<std::vector<double>>* hmap = nullptr;
+    State goal_state;
+
+    void calc_parameters(const std::vector<std::vector<double>>& obs);
+    int calc_index(const HybridNode& node, double yawt) const;
+    double calc_hybrid_cost(const HybridNode& node, double x, double y, double yaw) const;
+    bool is_collision(const double* x, const double* y, const double* yaw, const double* yawt,
+                      size_t n) const;
+    double calc_rs_path_cost(const Path& rspath) const;
+    Path analystic_expantion(int id) const;
+    int update_node_with_analystic_expantion(int id);
+    void rollout_trailer(int id);
+    void calc_next_node(int id, size_t prim);
+    void calc_successors(int id);
+    Path extract_path(int fid) const;
+    void copy_successor(size_t prim, int nid);
+    void init_search(const State& start, const State& goal,
+                     const std::vector<std::vector<double>>& obs);
+    double calc_node_cost(int id) const;
+};
+
+template <typename Model>
+HybridAstar<Model>::HybridAstar(const utils::VehicleConfig& _vc, const std::string& primitive_file)
+    : vc(_vc),
+      // rectangles with a 1 m margin on every side, both hang off the rear axle
+      footprint(_vc.RF + 1.0, _vc.RB + 1.0, _vc.W / 2.0 + 1.0, Model::COLLISION_RESO) {
+    if constexpr (Model::HAS_TRAILER) {
+        trailer_footprint = utils::FootprintChecker(_vc.RTF + 1.0, _vc.RTB + 1.0,
+                                                    _vc.W / 2.0 + 1.0, Model::COLLISION_RESO);
+    }
+    if (primitive_file.empty() || !primitives.load(primitive_file) ||
+        !primitives.matches(vc, Model::N_STEER, Model::MOVE_STEP, Model::PRIMITIVE_LENGTH)) {
+        primitives =
+            MotionPrimitiveTable(vc, Model::N_STEER, Model::MOVE_STEP, Model::PRIMITIVE_LENGTH);
+        if (!primitive_file.empty()) {
+            primitives.save(primitive_file);
+        }
+    }
+}
+
+template <typename Model>
+void HybridAstar<Model>::calc_parameters(const std::vector<std::vector<double>>& obs) {
+    grid_obs = obs;
+    double minxm = utils::min(obs[0]) - Model::EXTEND_AREA;
+    double minym = utils::min(obs[1]) - Model::EXTEND_AREA;
+    double maxxm = utils::max(obs[0]) + Model::EXTEND_AREA;
+    double maxym = utils::max(obs[1]) + Model::EXTEND_AREA;
+    if constexpr (Model::EXTEND_AREA > 0.0) {
+        // corner points, so the holonomic heuristic covers the extended area
+        grid_obs[0].push_back(minxm);
+        grid_obs[1].push_back(minym);
+        grid_obs[0].push_back(maxxm);
+        grid_obs[1].push_back(maxym);
+    }
+
+    minx = round(minxm / Model::XY_RESO);
+    miny = round(minym / Model::XY_RESO);
+    maxx = round(maxxm / Model::XY_RESO);
+    maxy = round(maxym / Model::XY_RESO);
+    xw = maxx - minx;
+    yw = maxy - miny;
+    minyaw = round(-M_PI / Model::YAW_RESO) - 1;
+    int maxyaw = round(M_PI / Model::YAW_RESO);
+    yaww = maxyaw - minyaw;
+}
+
+template <typename Model>
+int HybridAstar<Model>::calc_index(const HybridNode& node, double yawt) const {
+    int ind = (node.yawind - minyaw) * xw * yw + (node.yind - miny) * xw + (node.xind - minx);
+    if constexpr (Model::HAS_TRAILER) {
+        int yawt_ind = round(yawt / Model::YAW_RESO);
+        ind += (yawt_ind - minyaw) * xw * yw * (yaww + 1);
+    }
+
+    return ind;
+}
+
+// the heuristic is the max of the holonomic with obstacles and the non-holonomic without
+// obstacles one, both in hmap units: grid cells of XY_RESO
+template <typename Model>
+double HybridAstar<Model>::calc_hybrid_cost(const HybridNode& node, double x, double y,
+                                            double yaw) const {
+    double h = (*hmap)[node.xind - minx][node.yind - miny];
+    if (rs_table != nullptr && !rs_table->empty()) {
+        double rs = rs_table->get(x, y, yaw, goal_state[0], goal_state[1], goal_state[2]);
+        h = std::max(h, rs / Model::XY_RESO);
+    }
+
+    return node.cost + weight * h;
+}
+
+// every COLLISION_CHECK_STEP-th of the n poses, yawt is only read for models with a trailer
+template <typename Model>
+bool HybridAstar<Model>::is_collision(const double* x, const double* y, const double* yaw,
+                                      const double* yawt, size_t n) const {
+    PROFILE_ZONE("hybrid_astar/collision_check");
+    for (size_t idx = 0; idx < n; idx += Model::COLLISION_CHECK_STEP) {
+        if constexpr (Model::HAS_TRAILER) {
+            if (trailer_footprint.is_collision(collision_map, x[idx], y[idx], yawt[idx])) {
+                return true;
+            }
+        }
+        if (footprint.is_collision(collision_map, x[idx], y[idx], yaw[idx])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Model>
+double HybridAstar<Model>::calc_rs_path_cost(const Path& rspath) const {
+    double cost = 0.0;
+
+    for (double lr : rspath.lengths) {
+        if (lr >= 0) {
+            cost += 1;
+        } else {
+            cost += std::abs(lr) * Model::BACKWARD_COST;
+        }
+    }
+    for (size_t idx = 0; idx < rspath.lengths.size() - 1; idx++) {
+        if (rspath.lengths[idx] * rspath.lengths[idx + 1] < 0.0) {
+            cost += Model::GEAR_COST;
+        }
+    }
+    for (char ctype : rspath.ctypes) {
+        if (ctype != 'S') {
+            cost += Model::STEER_ANGLE_COST * std::abs(vc.MAX_STEER);
+        }
+    }
+
+    std::vector<double> ulist(rspath.ctypes.size(), 0.0);
+    for (size_t idx = 0; idx < rspath.ctypes.size(); ++idx) {
+        if (rspath.ctypes[idx] == 'R') {
+            ulist[idx] = -vc.MAX_STEER;
+        } else if (rspath.ctypes[idx] == 'L') {
+            ulist[idx] = vc.MAX_STEER;
+        }
+    }
+    for (size_t idx = 0; idx < rspath.ctypes.size() - 1; ++idx) {
+        cost += (Model::STEER_CHANGE_COST * std::abs(ulist[idx + 1] - ulist[idx]));
+    }
+
+    if constexpr (Model::HAS_TRAILER) {
+        for (size_t idx = 0; idx < rspath.yaw.size(); ++idx) {
+            double hitch = utils::pi_2_pi(rspath.yaw[idx] - rspath.yawt[idx]);
+            cost += Model::SCISSORS_COST * std::abs(hitch);
+        }
+    }
+
+    return cost;
+}
+
+// the word cost of a car does not depend on the samples, so its candidates are interpolated
+// cheapest first and only until one is collision free. the hitch angle cost of a trailer needs
+// the samples of every candidate.
+template <typename Model>
+Path HybridAstar<Model>::analystic_expantion(int id) const {
+    PROFILE_ZONE("hybrid_astar/rs_expansion");
+    int last = arena.nodes[id].end - 1;
+    Eigen::Vector3d start(arena.x[last], arena.y[last], arena.yaw[last]);
+    Eigen::Vector3d goal(goal_state[0], goal_state[1], goal_state[2]);
+    double maxc = tan(vc.MAX_STEER) / vc.WB;
+    std::vector<Path> paths = calc_rs_words(start, goal, maxc, Model::MOVE_STEP);
+
+    std::vector<std::pair<double, size_t>> costs;
+    for (size_t idx = 0; idx < paths.size(); ++idx) {
+        if constexpr (Model::HAS_TRAILER) {
+            Path& path = paths[idx];
+            interpolate_rs_path(path, start, maxc, Model::MOVE_STEP);
+            path.yawt.assign(path.yaw.size(), arena.yawt[last]);
+            double max_hitch = 0.0;
+            for (size_t k = 1; k < path.yaw.size(); ++k) {
+                double step = Model::MOVE_STEP * path.directions[k - 1];
+                path.yawt[k] =
+                    path.yawt[k - 1] + step / vc.RTR * sin(path.yaw[k - 1] - path.yawt[k - 1]);
+                max_hitch =
+                    std::max(max_hitch, std::abs(utils::pi_2_pi(path.yaw[k] - path.yawt[k])));
+            }
+            if (max_hitch > Model::MAX_HITCH) {
+                continue;
+            }
+        }
+        costs.emplace_back(calc_rs_path_cost(paths[idx]), idx);
+    }
+    std::sort(costs.begin(), costs.end());
+    if (costs.size() > static_cast<size_t>(Model::RS_CANDIDATES)) {
+        costs.resize(Model::RS_CANDIDATES);
+    }
+
+    for (const std::pair<double, size_t>& candidate : costs) {
+        Path& path = paths[candidate.second];
+        if constexpr (!Model::HAS_TRAILER) {
+            interpolate_rs_path(path, start, maxc, Model::MOVE_STEP);
+        }
+        if (!is_collision(path.x.data(), path.y.data(), path.yaw.data(), path.yawt.data(),
+                          path.x.size())) {
+            return path;
+        }
+    }
+
+    return Path();
+}
+
+// on success the goal node, i.e. the analytic path without its end points, is added to the arena
+// and its id is returned, -1 otherwise
+template <typename Model>
+int HybridAstar<Model>::update_node_with_analystic_expantion(int id) {
+    Path path = analystic_expantion(id);
+    if (path.x.empty() || path.y.empty() || path.yaw.empty()) {
+        return -1;
+    }
+    if constexpr (Model::HAS_TRAILER) {
+        if (std::abs(utils::pi_2_pi(path.yawt.back() - goal_state[3])) >= Model::GOAL_YAW_ERROR) {
+            return -1;
+        }
+    }
+
+    const HybridNode& n_curr = arena.nodes[id];
+    double fcost = n_curr.cost + calc_rs_path_cost(path);
+    HybridNode fnode(n_curr.xind, n_curr.yind, n_curr.yawind, n_curr.direction, 0.0, fcost, id);
+    int n = path.x.size() - 2;
+    int fid = arena.add_node(-1, fnode, n);
+    int begin = arena.nodes[fid].begin;
+    std::copy(path.x.begin() + 1, path.x.end() - 1, arena.x.begin() + begin);
+    std::copy(path.y.begin() + 1, path.y.end() - 1, arena.y.begin() + begin);
+    std::copy(path.yaw.begin() + 1, path.yaw.end() - 1, arena.yaw.begin() + begin);
+    if constexpr (Model::HAS_TRAILER) {
+        std::copy(path.yawt.begin() + 1, path.yawt.end() - 1, arena.yawt.begin() + begin);
+    }
+    std::copy(path.directions.begin() + 1, path.directions.end() - 1,
+              arena.directions.begin() + begin);
+
+    return fid;
+}
+
+// successor of node id along primitive prim, written to slot prim of the batch
+template <typename Model>
+void HybridAstar<Model>::calc_next_node(int id, size_t prim) {
+    const HybridNode& n_curr = arena.nodes[id];
+    size_t n = primitives.get_samples();
+    size_t begin = prim * n;
+    double step = Model::PRIMITIVE_LENGTH;
+    double u = primitives[prim].steer;
+    int d = primitives[prim].direction;
+    const double* xlist = &batch.x[begin];
+    const double* ylist = &batch.y[begin];
+    const double* yawlist = &batch.yaw[begin];
+    const double* yawtlist = nullptr;
+    bool jackknifed = false;
+    if constexpr (Model::HAS_TRAILER) {
+        yawtlist = &batch.yawt[begin];
+        jackknifed = batch.max_hitch[prim] > Model::MAX_HITCH;
+    }
+
+    int xind = round(xlist[n - 1] / Model::XY_RESO);
+    int yind = round(ylist[n - 1] / Model::XY_RESO);
+    int yawind = round(yawlist[n - 1] / Model::YAW_RESO);
+
+    batch.valid[prim] = xind > minx && xind < maxx && yind > miny && yind < maxy && !jackknifed &&
+                        !is_collision(xlist, ylist, yawlist, yawtlist, n);
+    if (!batch.valid[prim]) {
+        return;
+    }
+
+    double cost = 0.0;
+    int direction = 1;
+    if (d > 0) {
+        direction = 1;
+        cost += std::abs(step);
+    } else {
+        direction = -1;
+        cost += std::abs(step) * Model::BACKWARD_COST;
+    }
+    if (direction != n_curr.direction) {
+        cost += Model::GEAR_COST;
+    }
+    cost += Model::STEER_ANGLE_COST * std::abs(u);
+    cost += Model::STEER_CHANGE_COST * std::abs(n_curr.steer - u);
+    if constexpr (Model::HAS_TRAILER) {
+        cost += Model::SCISSORS_COST * batch.hitch_cost[prim];
+    }
+    cost = n_curr.cost + cost;
+    batch.nodes[prim] = HybridNode(xind, yind, yawind, direction, u, cost, id);
+    batch.states[prim] = calc_index(batch.nodes[prim], yawtlist ? yawtlist[n - 1] : 0.0);
+}
+
+// trailer heading of every batch slot behind the tractor poses from the primitive table, plus the
+// hitch angle sum and maximum of each slot. the recurrence is serial along a primitive, so the
+// inner loop runs across the independent primitives and is branch free: one step never moves
+// the heading by more than 2 pi, so a single wrap is the same as utils::pi_2_pi.
+template <typename Model>
+void HybridAstar<Model>::rollout_trailer(int id) {
+    size_t m = primitives.size();
+    size_t n = primitives.get_samples();
+    int last = arena.nodes[id].end - 1;
+    double yawt0 = arena.yawt[last];
+    double step0 = Model::MOVE_STEP / vc.RTR * sin(arena.yaw[last] - yawt0);
+    double* yaw = batch.yaw.data();
+    double* yawt = batch.yawt.data();
+    double* hitch_cost = batch.hitch_cost.data();
+    double* max_hitch = batch.max_hitch.data();
+
+    auto wrap = [](double theta) {
+        theta = theta > M_PI ? theta - 2.0 * M_PI : theta;
+        return theta < -M_PI ? theta + 2.0 * M_PI : theta;
+    };
+    for (size_t prim = 0; prim < m; ++prim) {
+        double t = wrap(yawt0 + primitives[prim].direction * step0);
+        double hitch = std::abs(wrap(yaw[prim * n] - t));
+        yawt[prim * n] = t;
+        hitch_cost[prim] = hitch;
+        max_hitch[prim] = hitch;
+    }
+    for (size_t k = 1; k < n; ++k) {
+        for (size_t prim = 0; prim < m; ++prim) {
+            size_t idx = prim * n + k;
+            double dt = primitives[prim].direction * Model::MOVE_STEP / vc.RTR;
+            double t = wrap(yawt[idx - 1] + dt * sin(yaw[idx - 1] - yawt[idx - 1]));
+            double hitch = std::abs(wrap(yaw[idx] - t));
+            yawt[idx] = t;
+            hitch_cost[prim] += hitch;
+            max_hitch[prim] = std::max(max_hitch[prim], hitch);
+        }
+    }
+}
+
+// the poses of every primitive are rolled out in one flat loop, the per primitive bound,
+// footprint and cost evaluation optionally fans out over the thread pool. the results land in
+// per primitive slots, so merging them in primitive order afterwards is identical to expanding
+// one primitive after the other.
+template <typename Model>
+void HybridAstar<Model>::calc_successors(int id) {
+    PROFILE_ZONE("hybrid_astar/expansion");
+    int last = arena.nodes[id].end - 1;
+    primitives.apply_all(arena.x[last], arena.y[last], arena.yaw[last], batch.x, batch.y,
+                         batch.yaw);
+    if constexpr (Model::HAS_TRAILER) {
+        batch.yawt.resize(batch.x.size());
+        batch.hitch_cost.resize(primitives.size());
+        batch.max_hitch.resize(primitives.size());
+        rollout_trailer(id);
+    }
+    batch.valid.resize(primitives.size());
+    batch.states.resize(primitives.size());
+    batch.nodes.resize(primitives.size());
+
+    if (pool != nullptr) {
+        pool->parallel_for(primitives.size(),
+                           [&](size_t prim, int) { calc_next_node(id, prim); });
+    } else {
+        for (size_t prim = 0; prim < primitives.size(); ++prim) {
+            calc_next_node(id, prim);
+        }
+    }
+}
+
+// poses of batch slot prim into node nid of the arena
+template <typename Model>
+void HybridAstar<Model>::copy_successor(size_t prim, int nid) {
+    size_t n = primitives.get_samples();
+    std::vector<double>::const_iterator xlist = batch.x.begin() + prim * n;
+    std::vector<double>::const_iterator ylist = batch.y.begin() + prim * n;
+    std::vector<double>::const_iterator yawlist = batch.yaw.begin() + prim * n;
+    int begin = arena.nodes[nid].begin;
+    std::copy(xlist, xlist + n, arena.x.begin() + begin);
+    std::copy(ylist, ylist + n, arena.y.begin() + begin);
+    std::copy(yawlist, yawlist + n, arena.yaw.begin() + begin);
+    if constexpr (Model::HAS_TRAILER) {
+        std::vector<double>::const_iterator yawtlist = batch.yawt.begin() + prim * n;
+        std::copy(yawtlist, yawtlist + n, arena.yawt.begin() + begin);
+    }
+
+    if (on_expand) {
+        on_expand(std::vector<double>(xlist, xlist + n), std::vector<double>(ylist, ylist + n));
+    }
+}
+
+template <typename Model>
+Path HybridAstar<Model>::extract_path(int fid) const {
+    std::vector<double> rx;
+    std::vector<double> ry;
+    std::vector<double> ryaw;
+    std::vector<double> ryawt;
+    std::vector<int> direc;
+
+    for (int id = fid; id >= 0; id = arena.nodes[id].parent) {
+        const HybridNode& node = arena.nodes[id];
+        for (int idx = node.end - 1; idx >= node.begin; --idx) {
+            rx.push_back(arena.x[idx]);
+            ry.push_back(arena.y[idx]);
+            ryaw.push_back(arena.yaw[idx]);
+            if constexpr (Model::HAS_TRAILER) {
+                ryawt.push_back(arena.yawt[idx]);
+            }
+            direc.push_back(arena.directions[idx]);
+        }
+    }
+
+    std::reverse(rx.begin(), rx.end());
+    std::reverse(ry.begin(), ry.end());
+    std::reverse(ryaw.begin(), ryaw.end());
+    std::reverse(ryawt.begin(), ryawt.end());
+    std::reverse(direc.begin(), direc.end());
+    direc[0] = direc[1];
+
+    if constexpr (Model::HAS_TRAILER) {
+        return Path(rx, ry, ryaw, ryawt, direc);
+    } else {
+        return Path(rx, ry, ryaw, direc);
+    }
+}
+
+template <typename Model>
+void HybridAstar<Model>::init_search(const State& start, const State& goal,
+                                     const std::vector<std::vector<double>>& obs) {
+    goal_state = goal;
+    double reach = footprint.get_reach();
+    if constexpr (Model::HAS_TRAILER) {
+        reach = std::max(reach, trailer_footprint.get_reach());
+    }
+    {
+        PROFILE_ZONE("hybrid_astar/obstacle_map");
+        collision_map = utils::calc_footprint_grid(obs[0], obs[1], Model::COLLISION_RESO, reach);
+    }
+    calc_parameters(obs);
+    {
+        PROFILE_ZONE("hybrid_astar/heuristic");
+        hmap = &heuristics.get(goal[0], goal[1], grid_obs, Model::XY_RESO, 1.0);
+    }
+
+    int nstates = (yaww + 1) * xw * yw * (Model::HAS_TRAILER ? yaww + 1 : 1);
+    arena.reset(nstates);
+    int sxr = round(start[0] / Model::XY_RESO);
+    int syr = round(start[1] / Model::XY_RESO);
+    int syawr = round(utils::pi_2_pi(start[2]) / Model::YAW_RESO);
+    HybridNode nstart(sxr, syr, syawr, 1, 0.0, 0.0, -1);
+    double syawt = 0.0;
+    if constexpr (Model::HAS_TRAILER) {
+        syawt = start[3];
+    }
+    int sind = calc_index(nstart, syawt);
+    arena.add_node(sind, nstart, 1);
+    arena.x[0] = start[0];
+    arena.y[0] = start[1];
+    arena.yaw[0] = start[2];
+    if constexpr (Model::HAS_TRAILER) {
+        arena.yawt[0] = syawt;
+    }
+    arena.open_set.push(sind, calc_hybrid_cost(nstart, start[0], start[1], start[2]));
+}
+
+// open set priority of node id under the current weight
+template <typename Model>
+double HybridAstar<Model>::calc_node_cost(int id) const {
+    const HybridNode& node = arena.nodes[id];
+    int last = node.end - 1;
+
+    return calc_hybrid_cost(node, arena.x[last], arena.y[last], arena.yaw[last]);
+}
+
+template <typename Model>
+Path HybridAstar<Model>::planning(const State& start, const State& goal,
+                                  const std::vector<std::vector<double>>& obs) {
+    PROFILE_ZONE("hybrid_astar/planning");
+    weight = Model::H_COST;
+    init_search(start, goal, obs);
+
+    size_t n = primitives.get_samples();
+    int fid = -1;
+    int npop = 0;
+    while (true) {
+        if (arena.open_set.empty()) {
+            return Path();
+        }
+        int ind = arena.open_set.pop();
+        arena.close(ind);
+        int id = arena.find(ind);
+
+        const HybridNode& n_curr = arena.nodes[id];
+        double hdist = (*hmap)[n_curr.xind - minx][n_curr.yind - miny] * Model::XY_RESO;
+        if (npop++ % Model::RS_INTERVAL == 0 || hdist <= Model::RS_NEAR_DIST) {
+            fid = update_node_with_analystic_expantion(id);
+            if (fid >= 0) {
+                break;
+            }
+        }
+
+        calc_successors(id);
+        for (size_t idx = 0; idx < primitives.size(); ++idx) {
+            if (!batch.valid[idx]) {
+                continue;
+            }
+            const HybridNode& node = batch.nodes[idx];
+            int node_ind = batch.states[idx];
+            if (arena.is_closed(node_ind)) {
+                continue;
+            }
+
+            int nid = arena.find(node_ind);
+            if (nid < 0) {
+                nid = arena.add_node(node_ind, node, n);
+            } else if (arena.nodes[nid].cost > node.cost) {
+                arena.replace_node(nid, node);
+            } else {
+                continue;
+            }
+            copy_successor(idx, nid);
+            arena.open_set.push(node_ind, calc_node_cost(nid));
+        }
+    }
+
+    return extract_path(fid);
+}
+
+// ARA* on the hybrid states. a node that is in the open set has no children yet and is improved
+// in place, a state that was expanded before gets a new node instead, so the paths through its
+// old node stay intact. states improved after they were closed in the current round wait in
+// incons for the next round.
+template <typename Model>
+Path HybridAstar<Model>::planning_anytime(const State& start, const State& goal,
+                                          const std::vector<std::vector<double>>& obs,
+                                          double time_budget, ImproveCallback on_improve) {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::microseconds(static_cast<long long>(time_budget * 1000.0));
+    weight = Model::H_COST;
+    init_search(start, goal, obs);
+
+    size_t n = primitives.get_samples();
+    Path best;
+    double best_cost = std::numeric_limits<double>::infinity();
+    std::vector<int> incons;
+    int npop = 0;
+    while (true) {
+        while (!arena.open_set.empty() && arena.open_set.top_priority() < best_cost) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return best;
+            }
+            int ind = arena.open_set.pop();
+            arena.close(ind);
+            int id = arena.find(ind);
+            if (arena.nodes[id].cost >= best_cost) {
+                continue;
+            }
+
+            const HybridNode& n_curr = arena.nodes[id];
+            double hdist = (*hmap)[n_curr.xind - minx][n_curr.yind - miny] * Model::XY_RESO;
+            if (npop++ % Model::RS_INTERVAL == 0 || hdist <= Model::RS_NEAR_DIST) {
+                int fid = update_node_with_analystic_expantion(id);
+                if (fid >= 0 && arena.nodes[fid].cost < best_cost) {
+                    best_cost = arena.nodes[fid].cost;
+                    best = extract_path(fid);
+                    if (on_improve) {
+                        on_improve(best, best_cost);
+                    }
+                }
+            }
+
+            calc_successors(id);
+            for (size_t idx = 0; idx < primitives.size(); ++idx) {
+                if (!batch.valid[idx] || batch.nodes[idx].cost >= best_cost) {
+                    continue;
+                }
+                const HybridNode& node = batch.nodes[idx];
+                int node_ind = batch.states[idx];
+                int nid = arena.find(node_ind);
+                if (nid >= 0 && arena.nodes[nid].cost <= node.cost) {
+                    continue;
+                }
+
+                if (nid >= 0 && arena.open_set.contains(node_ind)) {
+                    arena.replace_node(nid, node);
+                } else {
+                    nid = arena.add_node(node_ind, node, n);
+                }
+                copy_successor(idx, nid);
+                if (arena.is_closed(node_ind)) {
+                    incons.push_back(node_ind);
+                } else {
+                    arena.open_set.push(node_ind, calc_node_cost(nid));
+                }
+            }
+        }
+
+        if (weight <= final_weight || arena.open_set.size() + incons.size() == 0) {
+            break;
+        }
+        weight = std::max(final_weight, weight * decay);
+        for (int state : incons) {
+            arena.open_set.push(state, 0.0);
+        }
+        incons.clear();
+        arena.open_set.rekey([this](int state) { return calc_node_cost(arena.find(state)); });
+        arena.reopen_all();
+    }
+
+    return best;
+}
+
+#endif
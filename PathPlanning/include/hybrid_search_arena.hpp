@@ -0,0 +1,139 @@
+#pragma once
+#ifndef __HYBRID_SEARCH_ARENA_HPP
+#define __HYBRID_SEARCH_ARENA_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "IndexedHeap.hpp"
+
+// one Hybrid A* node. its intermediate poses are the samples [begin, end) of the trajectory
+// buffer of the arena it lives in, the last sample is the pose of the node.
+class HybridNode {
+public:
+    int xind;
+    int yind;
+    int yawind;
+    int direction;
+    double steer;
+    double cost;
+    int parent;  // node id of the predecessor, -1 for the start
+    int begin;
+    int end;
+
+    HybridNode() {}
+    HybridNode(int _xi, int _yi, int _yawi, int _d, double _s, double _c, int _p)
+        : xind(_xi), yind(_yi), yawind(_yawi), direction(_d), steer(_s), cost(_c), parent(_p) {}
+    ~HybridNode() {}
+};
+
+// node pool, SoA trajectory buffer and open / closed state of one Hybrid A* search. states
+// are the discrete (x, y, yaw) cells, their tables are only valid when the stamp matches the
+// current search, so a reused arena neither clears nor reallocates between searches.
+// yawt, the trailer heading of each sample, is only stored WITH_TRAILER.
+template <bool WITH_TRAILER = false>
+class HybridSearchArena {
+public:
+    std::vector<HybridNode> nodes;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> yaw;
+    std::vector<double> yawt;
+    std::vector<int> directions;
+    std::vector<int> state_node;
+    std::vector<unsigned int> closed;  // closed while it equals closed_mark
+    std::vector<unsigned int> stamp;
+    IndexedHeap<> open_set;
+    unsigned int search_id = 0;
+    unsigned int closed_mark = 1;
+
+    HybridSearchArena() {}
+    ~HybridSearchArena() {}
+
+    void reset(int nstates) {
+        if (static_cast<int>(stamp.size()) != nstates) {
+            state_node.assign(nstates, -1);
+            closed.assign(nstates, 0);
+            stamp.assign(nstates, 0);
+            search_id = 0;
+        }
+        open_set.reserve(nstates);
+        open_set.clear();
+        nodes.clear();
+        x.clear();
+        y.clear();
+        yaw.clear();
+        yawt.clear();
+        directions.clear();
+        if (++search_id == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            search_id = 1;
+        }
+    }
+
+    // node id of a state, -1 if the search has not reached it yet
+    int find(int state) const { return stamp[state] == search_id ? state_node[state] : -1; }
+
+    bool is_closed(int state) const {
+        return stamp[state] == search_id && closed[state] == closed_mark;
+    }
+
+    void close(int state) { closed[state] = closed_mark; }
+
+    // reopen every closed state at once, the nodes and their costs are kept
+    void reopen_all(void) {
+        if (++closed_mark == 0) {
+            std::fill(closed.begin(), closed.end(), 0);
+            closed_mark = 1;
+        }
+    }
+
+    // add a node with n samples, the poses of the new node are returned uninitialized. a state
+    // that is already reached is pointed to the new node and keeps its closed mark
+    int add_node(int state, const HybridNode& node, int n) {
+        nodes.push_back(node);
+        nodes.back().begin = x.size();
+        nodes.back().end = x.size() + n;
+        x.resize(x.size() + n);
+        y.resize(y.size() + n);
+        yaw.resize(yaw.size() + n);
+        if constexpr (WITH_TRAILER) {
+            yawt.resize(yawt.size() + n);
+        }
+        directions.resize(directions.size() + n, node.direction);
+        if (state >= 0) {
+            if (stamp[state] != search_id) {
+                stamp[state] = search_id;
+                closed[state] = 0;
+            }
+            state_node[state] = nodes.size() - 1;
+        }
+
+        return nodes.size() - 1;
+    }
+
+    // replace node id by a cheaper one that has the same number of samples, in place
+    void replace_node(int id, const HybridNode& node) {
+        int begin = nodes[id].begin;
+        int end = nodes[id].end;
+        nodes[id] = node;
+        nodes[id].begin = begin;
+        nodes[id].end = end;
+        std::fill(directions.begin() + begin, directions.begin() + end, node.direction);
+    }
+
+    // heap memory held by the arena including reserved capacity, approximately [bytes]. the
+    // open set keeps one position per state and its queued entries
+    size_t get_bytes(void) const {
+        size_t node_bytes = nodes.capacity() * sizeof(HybridNode);
+        size_t sample_bytes =
+            (x.capacity() + y.capacity() + yaw.capacity() + yawt.capacity()) * sizeof(double) +
+            directions.capacity() * sizeof(int);
+        size_t state_bytes = stamp.size() * (sizeof(int) + 3 * sizeof(unsigned int)) +
+                             open_set.size() * sizeof(std::pair<double, int>);
+
+        return node_bytes + sample_bytes + state_bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef __MOTION_PRIMITIVES_HPP
+#define __MOTION_PRIMITIVES_HPP
+
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+// one constant steer, constant direction arc of the kinematic bicycle model, sampled every
+// move_step and expressed in the frame of its start pose (x = y = yaw = 0)
+class MotionPrimitive {
+public:
+    double steer;
+    int direction;
+    std::vector<double> x;    // [m]
+    std::vector<double> y;    // [m]
+    std::vector<double> yaw;  // [rad] heading change, not normalized
+
+    MotionPrimitive() {}
+    ~MotionPrimitive() {}
+};
+
+// the expansion set of Hybrid A*: every steer in [-MAX_STEER, MAX_STEER] (n_steer steps on
+// each side) forward and backward. the bicycle model is invariant to rotation, so the arcs are
+// integrated once and an expansion is only a rotation + translation of the table entry.
+// all primitives of a table have the same number of samples.
+//
+// file format, little-endian on every host (see byte_order.hpp):
+//   0   char[8]   magic "MPRIMTB\0"
+//   8   uint32    format version (1)
+//   12  double    wheel base [m], max steer [rad], move step [m], length [m]
+//   44  int32     n_steer
+//   48  uint32    primitives, then per primitive: double steer, int32 direction,
+//                 uint32 samples, double x[samples], y[samples], yaw[samples]
+class MotionPrimitiveTable {
+public:
+    MotionPrimitiveTable() {}
+    MotionPrimitiveTable(const utils::VehicleConfig& vc, int _n_steer, double _move_step,
+                         double _length);
+    ~MotionPrimitiveTable() {}
+
+    size_t size(void) const { return primitives.size(); }
+
+    const MotionPrimitive& operator[](size_t index) const { return primitives[index]; }
+
+    // sample poses of primitive index started at (x0, y0, yaw0), the outputs are resized, so
+    // reused buffers do not allocate. yaw is normalized to [-pi, pi]
+    void apply(size_t index, double x0, double y0, double yaw0, std::vector<double>& x,
+               std::vector<double>& y, std::vector<double>& yaw) const;
+
+    // sample poses of all primitives at once, primitive-major: sample k of primitive p is at
+    // p * get_samples() + k. the same values as apply, but one flat loop the compiler vectorizes
+    void apply_all(double x0, double y0, double yaw0, std::vector<double>& x,
+                   std::vector<double>& y, std::vector<double>& yaw) const;
+
+    // number of samples of every primitive
+    size_t get_samples(void) const { return samples; }
+
+    // true when the table was built for this vehicle and these parameters
+    bool matches(const utils::VehicleConfig& vc, int _n_steer, double _move_step,
+                 double _length) const;
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+    double get_move_step(void) const { return move_step; }
+
+private:
+    double wheel_base = 0.0;
+    double max_steer = 0.0;
+    int n_steer = 0;
+    double move_step = 0.0;
+    double length = 0.0;
+    std::vector<MotionPrimitive> primitives;
+    size_t samples = 0;
+    // the primitives flattened in apply_all order
+    std::vector<double> flat_x;
+    std::vector<double> flat_y;
+    std::vector<double> flat_yaw;
+
+    void flatten(void);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef __PRM_ROADMAP_HPP
+#define __PRM_ROADMAP_HPP
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IndexedHeap.hpp"
+#include "flat_kdtree.hpp"
+
+// probabilistic roadmap among circular obstacles {x, y, radius} for a round robot. the
+// vertices are connected to their k nearest neighbors, the undirected edges are kept in CSR
+// form: the neighbors of vertex v are targets[offsets[v] .. offsets[v + 1]). a roadmap is built
+// once and answers any number of queries, start and goal are only connected for the query.
+//
+// a lazy roadmap is built without checking its edges for collision. a query searches the
+// roadmap, checks the edges of the path found and searches again without the blocked ones
+// until a path is free. the result of every check is kept, so later queries reuse it.
+//
+// file format, little-endian on every host (see byte_order.hpp):
+//   0   char[8]   magic "PRMROAD\0"
+//   8   uint32    format version (2, version 1 has no edge states and all edges free)
+//   12  uint32    vertices
+//   16  uint32    directed edges, every undirected edge is stored in both directions
+//   20  uint32    obstacles
+//   24  uint32    n_knn
+//   28  uint32    reserved
+//   32  double    robot radius [m]
+//   40  double    max edge length [m]
+//   48  double[]  obstacles (x, y, radius), x, y, int32 offsets, int32 targets, double weights,
+//                 uint8 edge states (0 unchecked, 1 free, 2 blocked)
+class Roadmap {
+public:
+    Roadmap() {}
+    Roadmap(const std::vector<std::vector<double>>& _obstacles, double _robot_radius)
+        : obstacles(_obstacles), robot_radius(_robot_radius) {}
+    ~Roadmap() {}
+
+    // n collision free vertices uniform in [min_rand, max_rand]^2, every one linked to its
+    // n_knn nearest vertices that are at most max_edge_len away and have a free edge to it.
+    // lazy leaves the edges unchecked until a query needs them
+    void build(int n, double min_rand, double max_rand, unsigned int seed, int _n_knn = 10,
+               double _max_edge_len = 30.0, bool lazy = false);
+
+    // shortest roadmap path from start to goal as {x list, y list}, empty if there is none.
+    // start and goal are linked like a vertex. A* with the euclidean heuristic, Dijkstra if
+    // use_heuristic is false; the search state is reused, so a query does not allocate
+    std::vector<std::vector<double>> query(const Eigen::Vector2d& start,
+                                           const Eigen::Vector2d& goal, bool use_heuristic = true);
+
+    bool save(const std::string& file) const;
+    // the roadmap of file, it has to be built for the obstacles and robot radius of this one
+    bool load(const std::string& file);
+
+    size_t size(void) const { return x.size(); }
+    size_t num_edges(void) const { return targets.size() / 2; }
+    // vertices expanded and edges checked for collision by the last query
+    int get_expanded(void) const { return expanded; }
+    int get_checked(void) const { return checked; }
+
+    const std::vector<double>& get_x(void) const { return x; }
+    const std::vector<double>& get_y(void) const { return y; }
+    const std::vector<int>& get_offsets(void) const { return offsets; }
+    const std::vector<int>& get_targets(void) const { return targets; }
+    const std::vector<uint8_t>& get_edge_state(void) const { return edge_state; }
+
+    // true if the robot at (px, py) is clear of all obstacles
+    bool is_free(double px, double py) const;
+    // true if the straight edge between the two points is clear
+    bool is_free(Eigen::Vector2d node1, Eigen::Vector2d node2) const;
+
+    enum EdgeState : uint8_t { UNCHECKED = 0, FREE = 1, BLOCKED = 2 };
+
+private:
+    std::vector<std::vector<double>> obstacles;
+    double robot_radius = 0.0;
+    int n_knn = 10;
+    double max_edge_len = 30.0;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<double> weights;
+    std::vector<uint8_t> edge_state;  // of every directed edge, both directions agree
+    utils::KDTree<2> tree;
+
+    // query state, only valid while the stamps match the query / search
+    std::vector<double> g;
+    std::vector<int> parent;
+    std::vector<int> parent_edge;  // roadmap edge from the parent, -1 for a start / goal link
+    std::vector<unsigned int> stamp;
+    std::vector<double> goal_link;  // edge length to the goal of a vertex linked to it
+    std::vector<unsigned int> goal_stamp;
+    std::vector<std::pair<int, double>> start_link;  // vertex, edge length
+    double direct_link = -1.0;                       // start to goal length, -1 if not free
+    unsigned int query_id = 0;
+    unsigned int search_id = 0;
+    IndexedHeap<> open_set;
+    int expanded = 0;
+    int checked = 0;
+    std::vector<size_t> knn_index;
+    std::vector<double> knn_dist2;
+
+    template <typename Fn>
+    void link_point(double px, double py, Fn fn);
+    void init_query_state(void);
+    bool search(const Eigen::Vector2d& start, const Eigen::Vector2d& goal, bool use_heuristic);
+    bool check_path(void);
+};
+
+#endif
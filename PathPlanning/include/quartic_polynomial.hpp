@@ -6,6 +6,8 @@
 #include <Eigen/Eigen>
 #include <cmath>
 
+#include "time_basis.hpp"
+
 class QuarticPolynomial {
 private:
     double a0;
@@ -54,6 +56,33 @@ public:
 
         return xt;
     }
+
+    // the polynomial and its derivatives at every time of basis, each output holds basis.size()
+    void calc_batch(const TimeBasis& basis, double* x, double* dx, double* ddx,
+                    double* dddx) const {
+        const double* t = basis.t.data();
+        const double* t2 = basis.t2.data();
+        const double* t3 = basis.t3.data();
+        const double* t4 = basis.t4.data();
+        size_t n = basis.size();
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = a0 + a1 * t[i] + a2 * t2[i] + a3 * t3[i] + a4 * t4[i];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dx[i] = a1 + 2 * a2 * t[i] + 3 * a3 * t2[i] + 4 * a4 * t3[i];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ddx[i] = 2 * a2 + 6 * a3 * t[i] + 12 * a4 * t2[i];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dddx[i] = 6 * a3 + 24 * a4 * t[i];
+        }
+    }
+
+    void calc_batch(const TimeBasis& basis, PolynomialSamples& out) const {
+        out.resize(basis.size());
+        calc_batch(basis, out.p.data(), out.v.data(), out.a.data(), out.jerk.data());
+    }
 };
 
 #endif
@@ -26,6 +26,11 @@ public:
     ~Path() {}
 };
 
+// candidate words from s to g, only lengths [m], ctypes and L are set
+std::vector<Path> calc_rs_words(Eigen::Vector3d s, Eigen::Vector3d g, double maxc,
+                                double step_size);
+// fill x, y, yaw and directions of a word returned by calc_rs_words for the same s and maxc
+void interpolate_rs_path(Path& path, Eigen::Vector3d s, double maxc, double step_size);
 std::vector<Path> calc_rs_paths(Eigen::Vector3d s, Eigen::Vector3d g, double maxc,
                                 double step_size);
 Path reeds_shepp_path(Eigen::Vector3d s, Eigen::Vector3d g, double maxc, double step_size = 0.2);
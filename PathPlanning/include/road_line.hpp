@@ -35,7 +35,7 @@ public:
     std::vector<std::vector<double>> design_boundary_right(void) override;
 };
 
-std::vector<std::vector<double>> CruiseRoadLine::design_reference_line(void) {
+inline std::vector<std::vector<double>> CruiseRoadLine::design_reference_line(void) {
     std::vector<std::vector<double>> rxy(2);
     double step_curve = M_PI * 0.1;
     size_t step_line = 4;
@@ -90,7 +90,7 @@ std::vector<std::vector<double>> CruiseRoadLine::design_reference_line(void) {
     return rxy;
 }
 
-std::vector<std::vector<double>> CruiseRoadLine::design_boundary_left(void) {
+inline std::vector<std::vector<double>> CruiseRoadLine::design_boundary_left(void) {
     std::vector<std::vector<double>> rxy(2);
     double step_curve = M_PI * 0.1;
     size_t step_line = 2;
@@ -145,7 +145,7 @@ std::vector<std::vector<double>> CruiseRoadLine::design_boundary_left(void) {
     return rxy;
 }
 
-std::vector<std::vector<double>> CruiseRoadLine::design_boundary_right(void) {
+inline std::vector<std::vector<double>> CruiseRoadLine::design_boundary_right(void) {
     std::vector<std::vector<double>> rxy(2);
     double step_curve = M_PI * 0.05;
     size_t step_line = 2;
@@ -210,7 +210,7 @@ public:
     std::vector<std::vector<double>> design_boundary_right(void) override;
 };
 
-std::vector<std::vector<double>> StopRoadLine::design_reference_line(void) {
+inline std::vector<std::vector<double>> StopRoadLine::design_reference_line(void) {
     std::vector<std::vector<double>> rxy(2);
 
     for (double i = 0.0; i < 60.0; i += 1.0) {
@@ -221,7 +221,7 @@ std::vector<std::vector<double>> StopRoadLine::design_reference_line(void) {
     return rxy;
 }
 
-std::vector<std::vector<double>> StopRoadLine::design_boundary_left(void) {
+inline std::vector<std::vector<double>> StopRoadLine::design_boundary_left(void) {
     std::vector<std::vector<double>> rxy(2);
 
     for (double i = 0.0; i < 60.0; i += 1.0) {
@@ -232,7 +232,7 @@ std::vector<std::vector<double>> StopRoadLine::design_boundary_left(void) {
     return rxy;
 }
 
-std::vector<std::vector<double>> StopRoadLine::design_boundary_right(void) {
+inline std::vector<std::vector<double>> StopRoadLine::design_boundary_right(void) {
     std::vector<std::vector<double>> rxy(2);
 
     for (double i = 0.0; i < 60.0; i += 1.0) {
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef __RS_HEURISTIC_TABLE_HPP
+#define __RS_HEURISTIC_TABLE_HPP
+
+#include <string>
+#include <vector>
+
+// the non-holonomic without obstacles heuristic of Hybrid A*: the shortest Reeds-Shepp length
+// from a pose to the goal. it only depends on the pose in the goal frame, so it is tabulated once
+// over [-range, range]^2 x [-pi, pi) for a given curvature. the file is a fixed little-endian
+// header followed by the floats, on a little-endian host load maps it instead of reading it.
+class RSHeuristicTable {
+public:
+    RSHeuristicTable() {}
+    RSHeuristicTable(double _maxc, double _range, double _reso, int _yaw_bins);
+    RSHeuristicTable(const RSHeuristicTable&) = delete;
+    RSHeuristicTable& operator=(const RSHeuristicTable&) = delete;
+    ~RSHeuristicTable();
+
+    // tabulate for curvature maxc, replacing the current table
+    void build(double _maxc, double _range, double _reso, int _yaw_bins);
+
+    // length [m] from (x, y, yaw) to the goal (gx, gy, gyaw), the euclidean distance outside the
+    // table. the entries belong to the cell centers, so this is an approximation
+    double get(double x, double y, double yaw, double gx, double gy, double gyaw) const;
+
+    bool empty(void) const { return data == nullptr; }
+
+    // true when the table was built for this curvature and layout
+    bool matches(double _maxc, double _range, double _reso, int _yaw_bins) const;
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+private:
+    double maxc = 0.0;
+    double range = 0.0;
+    double reso = 1.0;
+    int nxy = 0;
+    int yaw_bins = 0;
+    std::vector<float> table;
+    const float* data = nullptr;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    void unmap(void);
+};
+
+#endif
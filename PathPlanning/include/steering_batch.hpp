@@ -0,0 +1,44 @@
+#pragma once
+#ifndef __STEERING_BATCH_HPP
+#define __STEERING_BATCH_HPP
+
+#include <Eigen/Core>
+#include <cstddef>
+
+#include "reeds_shepp_path.hpp"
+
+// n poses as separate x [m], y [m] and yaw [rad] arrays
+class PoseArrays {
+public:
+    const double* x;
+    const double* y;
+    const double* yaw;
+};
+
+// shortest Reeds-Shepp / Dubins word of every start / goal pair, meant for steering functions
+// of sampling planners that need the length of many pairs and the path of only a few. the word
+// families are evaluated one after the other over blocks of pairs in branch free loops the
+// compiler can vectorize, nothing is allocated and nothing is interpolated.
+//
+// per pair i, word[i] is the id of the shortest word (-1 if there is none), length[i] its
+// length [m] and, if segments is not nullptr, segments[3 * i + k] the length [m] of its segment
+// k, negative when driven backward.
+
+// the words of calc_rs_words, maxc is the maximum curvature [1/m]. calc_rs_words drops a word
+// when one of its type is already found, so reeds_shepp_path can return a slightly longer one
+void calc_rs_shortest_batch(const PoseArrays& s, const PoseArrays& g, size_t n, double maxc,
+                            int* word, double* length, double* segments = nullptr);
+
+// forward only words of the dubins_path demo, maxc is the maximum curvature [1/m]
+void calc_dubins_shortest_batch(const PoseArrays& s, const PoseArrays& g, size_t n, double maxc,
+                                int* word, double* length, double* segments = nullptr);
+
+// segment types of a word id, e.g. "LSR"
+const char* rs_batch_word(int word);
+const char* dubins_batch_word(int word);
+
+// interpolated path of one batch result, on request
+Path interpolate_rs_batch_path(int word, const double* segments, Eigen::Vector3d s, double maxc,
+                               double step_size);
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef __TIME_BASIS_HPP
+#define __TIME_BASIS_HPP
+
+#include <cstddef>
+#include <vector>
+
+// powers t^1 .. t^5 of the sample times 0, step, 2 * step, ... below end, stored one array per
+// power so that polynomials over them evaluate in plain vectorizable loops. one basis serves
+// every polynomial sampled at the same times
+class TimeBasis {
+public:
+    std::vector<double> t;
+    std::vector<double> t2;
+    std::vector<double> t3;
+    std::vector<double> t4;
+    std::vector<double> t5;
+
+    TimeBasis() {}
+    TimeBasis(double end, double step) {
+        for (double time = 0.0; time < end; time += step) {
+            t.push_back(time);
+        }
+        size_t n = t.size();
+        t2.resize(n);
+        t3.resize(n);
+        t4.resize(n);
+        t5.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            t2[i] = t[i] * t[i];
+            t3[i] = t2[i] * t[i];
+            t4[i] = t3[i] * t[i];
+            t5[i] = t4[i] * t[i];
+        }
+    }
+    ~TimeBasis() {}
+
+    size_t size(void) const { return t.size(); }
+};
+
+// a polynomial and its first three derivatives at the times of a TimeBasis
+class PolynomialSamples {
+public:
+    std::vector<double> p;
+    std::vector<double> v;
+    std::vector<double> a;
+    std::vector<double> jerk;
+
+    void resize(size_t n) {
+        p.resize(n);
+        v.resize(n);
+        a.resize(n);
+        jerk.resize(n);
+    }
+};
+
+#endif
@@ -3,52 +3,19 @@
 #include <string>
 #include <vector>
 
+#include "bezier_curve.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
 
 using std::vector;
 namespace plt = matplotlibcpp;
 
-uint64_t factorial(int n) {
-    uint64_t result = 1;
-    for (int i = 2; i <= n; ++i) {
-        result *= i;
-    }
-
-    return result;
-}
-
-uint64_t comb(int n, int k) {
-    if (k < 0 || k > n) {
-        return 0;
-    }
-
-    return factorial(n) / (factorial(k) * factorial(n - k));
-}
-
-double bernstein_poly(int n, int i, double t) { return comb(n, i) * pow(t, i) * pow(1 - t, n - i); }
-
-vector<double> bezier(double t, const vector<vector<double>>& control_points) {
-    int n = control_points[0].size() - 1;
-    vector<double> point = {0.0, 0.0};
-    for (size_t idx = 0; idx < (n + 1); ++idx) {
-        double poly = bernstein_poly(n, idx, t);
-        point[0] += (poly * control_points[0][idx]);
-        point[1] += (poly * control_points[1][idx]);
-    }
-
-    return point;
-}
-
 vector<vector<double>> calc_bezier_path(const vector<vector<double>>& control_points,
                                         int n_points = 100) {
-    vector<vector<double>> traj(2);
-    double step = 1.0 / n_points;
-    for (double t = 0.0; t <= 1.0; t += step) {
-        vector<double> point = bezier(t, control_points);
-        traj[0].push_back(point[0]);
-        traj[1].push_back(point[1]);
-    }
+    BezierCurve curve(control_points);
+    BernsteinBasis basis(curve.degree, n_points);
+    vector<vector<double>> traj(2, vector<double>(basis.size()));
+    curve.evaluate(basis, traj[0].data(), traj[1].data());
 
     return traj;
 }
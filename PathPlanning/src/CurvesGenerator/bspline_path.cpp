@@ -1,10 +1,12 @@
 #include <fmt/core.h>
 
 #include <Eigen/Core>
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <vector>
 
+#include "bspline_curve.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
 
@@ -53,48 +55,16 @@ void plot_curvature(const vector<vector<double>>& path, std::string style = "-c"
     }
 }
 
-double bspline_bfunc(int i, int k, double uu, const vector<double>& u) {
-    double bfunc = 0.0;
-    if (k == 1) {
-        if (u[i] <= uu && uu < u[i + 1]) {
-            bfunc = 1.0;
-        } else {
-            bfunc = 0.0;
-        }
-    } else if (k >= 2) {
-        double A = 0.0;
-        double B = 0.0;
-
-        if (u[i + k - 1] - u[i] == 0.0) {
-            A = 0.0;
-        } else {
-            A = (uu - u[i]) / (u[i + k - 1] - u[i]);
-        }
-
-        if (u[i + k] - u[i + 1] == 0.0) {
-            B = 0.0;
-        } else {
-            B = (u[i + k] - uu) / (u[i + k] - u[i + 1]);
-        }
-
-        bfunc = A * bspline_bfunc(i, k - 1, uu, u) + B * bspline_bfunc(i + 1, k - 1, uu, u);
-    }
-
-    return bfunc;
-}
-
 vector<vector<double>> plan_Bspline_path(int k, Type _type, vector<vector<double>> p) {
     double delta_u = 0.01;
-    int order = k;
     int n = p[0].size() - 1;
-    if (order > n + 1 || p.empty()) {
+    if (k > n + 1 || p.empty()) {
         throw std::invalid_argument("Bspline illegal parameter !");
         return {};
     }
 
     vector<double> u;
     Type type = _type;
-    vector<vector<double>> control_point = p;
 
     double u_tmp = 0.0;
     u.push_back(u_tmp);
@@ -120,22 +90,12 @@ vector<vector<double>> plan_Bspline_path(int k, Type _type, vector<vector<double
         }
     }
 
-    double u_begin = u[k - 1];
-    double u_end = u[n + 1];
-
-    vector<vector<double>> path(2);
-    for (double uu = u_begin; uu <= u_end; uu += delta_u) {
-        Vector2d p_u(0.0, 0.0);
-        for (size_t idx = 0; idx < n + 1; ++idx) {
-            double xtmp = control_point[0][idx];
-            double ytmp = control_point[1][idx];
-            double bfunc_tmp = bspline_bfunc(idx, order, uu, u);
-            p_u[0] += xtmp * bfunc_tmp;
-            p_u[1] += ytmp * bfunc_tmp;
-        }
-        path[0].push_back(p_u[0]);
-        path[1].push_back(p_u[1]);
-    }
+    BSplineCurve curve(k, u, p);
+    int n_points = std::max(1, static_cast<int>(round((curve.get_end() - curve.get_begin()) /
+                                                      delta_u)));
+    BSplineBasis basis(k, u, curve.uniform(n_points), 0);
+    vector<vector<double>> path(2, vector<double>(basis.size()));
+    curve.evaluate(basis, path[0].data(), path[1].data());
 
     return path;
 }
@@ -1,5 +1,11 @@
 #include "cubic_spline.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "profiler.hpp"
 #include "utils.hpp"
 
 using std::vector;
@@ -15,84 +21,128 @@ CubicSpline::CubicSpline(vector<double> _x, vector<double> _y) {
         throw std::invalid_argument("x coordinates must be sorted in ascending order");
     }
     a = y;
-    MatrixXd A = calc_A();
-    VectorXd B = calc_B();
-    VectorXd c_eigen = A.colPivHouseholderQr().solve(B);
-    double* c_pointer = c_eigen.data();
-    c.assign(c_pointer, c_pointer + c_eigen.rows());
-
-    for (size_t idx = 0; idx < (nx - 1); ++idx) {
-        double d_tmp = (c[idx + 1] - c[idx]) / (3.0 * h[idx]);
-        double b_tmp = (a[idx + 1] - a[idx]) / h[idx] - h[idx] * (c[idx + 1] + 2 * c[idx]) / 3.0;
-        d.emplace_back(d_tmp);
-        b.emplace_back(b_tmp);
-    }
+    solve(0);
 }
 
-MatrixXd CubicSpline::calc_A(void) {
-    MatrixXd A = MatrixXd::Zero(nx, nx);
-    A(0, 0) = 1.0;
-
-    for (size_t idx = 0; idx < (nx - 1); ++idx) {
-        if (idx != nx - 2) {
-            A(idx + 1, idx + 1) = 2.0 * (h[idx] + h[idx + 1]);
+int CubicSpline::append(const vector<double>& _x, const vector<double>& _y) {
+    if (nx == 0) {
+        *this = CubicSpline(_x, _y);
+        return 0;
+    }
+    for (size_t idx = 0; idx < _x.size(); ++idx) {
+        double prev = idx == 0 ? x.back() : _x[idx - 1];
+        if (_x[idx] < prev) {
+            throw std::invalid_argument("x coordinates must be sorted in ascending order");
         }
-        A(idx + 1, idx) = h[idx];
-        A(idx, idx + 1) = h[idx];
+        h.push_back(_x[idx] - prev);
     }
-    A(0, 1) = 0.0;
-    A(nx - 1, nx - 2) = 0.0;
-    A(nx - 1, nx - 1) = 1.0;
+    x.insert(x.end(), _x.begin(), _x.end());
+    y.insert(y.end(), _y.begin(), _y.end());
+    a.insert(a.end(), _y.begin(), _y.end());
+    int first_row = nx - 1;
+    nx = x.size();
 
-    return A;
+    return solve(first_row);
 }
 
-VectorXd CubicSpline::calc_B(void) {
-    VectorXd B = VectorXd::Zero(nx);
+// c of the natural spline from the tridiagonal system
+//   c[0] = 0, h[i - 1] c[i - 1] + 2 (h[i - 1] + h[i]) c[i] + h[i] c[i + 1] = B[i], c[nx - 1] = 0
+// by the Thomas algorithm in O(nx). rows before first_row are still eliminated from the last
+// call, and the back substitution stops at the first c that comes out unchanged, all the ones
+// before it would too. b and d follow for the changed pieces, the first of them is returned
+int CubicSpline::solve(int first_row) {
+    PROFILE_ZONE("spline/fit");
+    cp.resize(nx);
+    dp.resize(nx);
+    for (int i = first_row; i < nx; ++i) {
+        if (i == 0 || i == nx - 1) {
+            cp[i] = 0.0;
+            dp[i] = 0.0;
+            continue;
+        }
+        double rhs = 3.0 * (a[i + 1] - a[i]) / h[i] - 3.0 * (a[i] - a[i - 1]) / h[i - 1];
+        double m = 2.0 * (h[i - 1] + h[i]) - h[i - 1] * cp[i - 1];
+        cp[i] = h[i] / m;
+        dp[i] = (rhs - h[i - 1] * dp[i - 1]) / m;
+    }
+
+    int solved = c.size();
+    c.resize(nx);
+    c[nx - 1] = dp[nx - 1];
+    int first = 0;
+    for (int i = nx - 2; i >= 0; --i) {
+        double ci = dp[i] - cp[i] * c[i + 1];
+        if (i <= first_row && i < solved && ci == c[i]) {
+            first = i;
+            break;
+        }
+        c[i] = ci;
+    }
 
-    for (size_t idx = 0; idx < (nx - 2); ++idx) {
-        B(idx + 1) =
-            3.0 * (a[idx + 2] - a[idx + 1]) / h[idx + 1] - 3.0 * (a[idx + 1] - a[idx]) / h[idx];
+    b.resize(nx - 1);
+    d.resize(nx - 1);
+    for (int idx = first; idx < nx - 1; ++idx) {
+        d[idx] = (c[idx + 1] - c[idx]) / (3.0 * h[idx]);
+        b[idx] = (a[idx + 1] - a[idx]) / h[idx] - h[idx] * (c[idx + 1] + 2 * c[idx]) / 3.0;
     }
 
-    return B;
+    return first;
 }
 
-double CubicSpline::calc_position(double _x) const {
+int CubicSpline::calc_segment(double _x, int hint) const {
     if (_x < x[0] || _x > x.back()) {
         throw std::invalid_argument("received value out of the pre-defined range");
     }
 
+    int last = nx - 2;
+    if (hint >= 0 && hint <= last) {
+        if (x[hint] <= _x) {
+            for (int step = 0; step < 4 && hint < last && x[hint + 1] <= _x; ++step) {
+                ++hint;
+            }
+            if (hint == last || _x < x[hint + 1]) {
+                return hint;
+            }
+        } else if (hint > 0 && x[hint - 1] <= _x) {
+            return hint - 1;
+        }
+    }
+
     auto it = std::upper_bound(x.begin(), x.end(), _x);
-    int idx = std::distance(x.begin(), it) - 1;
-    double dx = _x - x[idx];
-    double position = a[idx] + b[idx] * dx + c[idx] * pow(dx, 2) + d[idx] * pow(dx, 3);
+    return std::min(static_cast<int>(std::distance(x.begin(), it)) - 1, last);
+}
+
+void CubicSpline::calc_derivatives(double _x, int segment, double* value, double* dy,
+                                   double* ddy) const {
+    double dx = _x - x[segment];
+    if (value != nullptr) {
+        *value = a[segment] + dx * (b[segment] + dx * (c[segment] + dx * d[segment]));
+    }
+    if (dy != nullptr) {
+        *dy = b[segment] + dx * (2.0 * c[segment] + dx * 3.0 * d[segment]);
+    }
+    if (ddy != nullptr) {
+        *ddy = 2.0 * c[segment] + 6.0 * d[segment] * dx;
+    }
+}
+
+double CubicSpline::calc_position(double _x) const {
+    double position = 0.0;
+    calc_derivatives(_x, calc_segment(_x), &position, nullptr, nullptr);
 
     return position;
 }
 
 double CubicSpline::calc_first_derivative(double _x) const {
-    if (_x < x[0] || _x > x.back()) {
-        throw std::invalid_argument("received value out of the pre-defined range");
-    }
-
-    auto it = std::upper_bound(x.begin(), x.end(), _x);
-    int idx = std::distance(x.begin(), it) - 1;
-    double dx = _x - x[idx];
-    double dy = b[idx] + 2.0 * c[idx] * dx + 3.0 * d[idx] * pow(dx, 2);
+    double dy = 0.0;
+    calc_derivatives(_x, calc_segment(_x), nullptr, &dy, nullptr);
 
     return dy;
 }
 
 double CubicSpline::calc_second_derivative(double _x) const {
-    if (_x < x[0] || _x > x.back()) {
-        throw std::invalid_argument("received value out of the pre-defined range");
-    }
-
-    auto it = std::upper_bound(x.begin(), x.end(), _x);
-    int idx = std::distance(x.begin(), it) - 1;
-    double dx = _x - x[idx];
-    double ddy = 2.0 * c[idx] + 6.0 * d[idx] * dx;
+    double ddy = 0.0;
+    calc_derivatives(_x, calc_segment(_x), nullptr, nullptr, &ddy);
 
     return ddy;
 }
@@ -134,6 +184,31 @@ vector<double> CubicSpline2D::calc_s(vector<double> _x, vector<double> _y) {
     return s;
 }
 
+void CubicSpline2D::append(const vector<double>& _x, const vector<double>& _y) {
+    if (s.empty()) {
+        *this = CubicSpline2D(_x, _y);
+        return;
+    }
+
+    // the same sums calc_s does over the whole path
+    vector<double> new_s;
+    double last = s.back();
+    double px = sx.get_y().back();
+    double py = sy.get_y().back();
+    for (size_t idx = 0; idx < _x.size(); ++idx) {
+        last += hypot(_x[idx] - px, _y[idx] - py);
+        new_s.push_back(last);
+        px = _x[idx];
+        py = _y[idx];
+    }
+    s.insert(s.end(), new_s.begin(), new_s.end());
+    int first = std::min(sx.append(new_s, _x), sy.append(new_s, _y));
+
+    if (lut_samples > 0) {
+        extend_arc_length_table(first);
+    }
+}
+
 Vector2d CubicSpline2D::calc_position(double _s) const {
     double _x = sx.calc_position(_s);
     double _y = sy.calc_position(_s);
@@ -165,19 +240,182 @@ Vector2d CubicSpline2D::operator()(double _s, int n) const {
     return p;
 }
 
+void CubicSpline2D::evaluate(double _s, int& segment, double* x, double* y, double* yaw,
+                             double* kappa) const {
+    segment = sx.calc_segment(_s, segment);
+    double dx = 0.0;
+    double ddx = 0.0;
+    double dy = 0.0;
+    double ddy = 0.0;
+    bool derivatives = yaw != nullptr || kappa != nullptr;
+    sx.calc_derivatives(_s, segment, x, derivatives ? &dx : nullptr,
+                        kappa != nullptr ? &ddx : nullptr);
+    sy.calc_derivatives(_s, segment, y, derivatives ? &dy : nullptr,
+                        kappa != nullptr ? &ddy : nullptr);
+    if (yaw != nullptr) {
+        *yaw = atan2(dy, dx);
+    }
+    if (kappa != nullptr) {
+        double v2 = dx * dx + dy * dy;
+        *kappa = (ddy * dx - ddx * dy) / (v2 * sqrt(v2));
+    }
+}
+
+void CubicSpline2D::calc_derivatives(double _s, int& segment, Vector2d& xy, Vector2d& dxy,
+                                     Vector2d& ddxy) const {
+    segment = sx.calc_segment(_s, segment);
+    sx.calc_derivatives(_s, segment, &xy[0], &dxy[0], &ddxy[0]);
+    sy.calc_derivatives(_s, segment, &xy[1], &dxy[1], &ddxy[1]);
+}
+
+double CubicSpline2D::calc_nearest_s(const Vector2d& p, double s0, double s1, int& segment,
+                                     double ds) const {
+    s0 = std::clamp(s0, s.front(), s.back());
+    s1 = std::clamp(s1, s0, s.back());
+    int n = std::max(1, static_cast<int>(ceil((s1 - s0) / ds)));
+    double step = (s1 - s0) / n;
+
+    Vector2d xy;
+    double best_s = s0;
+    double best_dist = std::numeric_limits<double>::max();
+    int best_segment = segment;
+    for (int i = 0; i <= n; ++i) {
+        double si = i < n ? s0 + i * step : s1;
+        evaluate(si, segment, &xy[0], &xy[1], nullptr, nullptr);
+        double dist = (xy - p).squaredNorm();
+        if (dist < best_dist) {
+            best_dist = dist;
+            best_s = si;
+            best_segment = segment;
+        }
+    }
+
+    // the minimum lies within a step of the best sample
+    double lo = std::max(s0, best_s - step);
+    double hi = std::min(s1, best_s + step);
+    double si = best_s;
+    segment = best_segment;
+    Vector2d dxy, ddxy;
+    for (int iter = 0; iter < 8; ++iter) {
+        calc_derivatives(si, segment, xy, dxy, ddxy);
+        Vector2d d = xy - p;
+        double f = d.dot(dxy);
+        double df = dxy.squaredNorm() + d.dot(ddxy);
+        if (df <= 0.0) {
+            break;
+        }
+        double next = std::clamp(si - f / df, lo, hi);
+        if (fabs(next - si) < 1e-9) {
+            break;
+        }
+        si = next;
+    }
+    evaluate(si, segment, &xy[0], &xy[1], nullptr, nullptr);
+    if ((xy - p).squaredNorm() < best_dist) {
+        best_s = si;
+        best_segment = segment;
+    }
+    segment = best_segment;
+
+    return best_s;
+}
+
+void CubicSpline2D::evaluate(const vector<double>& _s, vector<double>& out_x,
+                             vector<double>& out_y, vector<double>& out_yaw,
+                             vector<double>* out_kappa) const {
+    PROFILE_ZONE("spline/evaluate");
+    out_x.resize(_s.size());
+    out_y.resize(_s.size());
+    out_yaw.resize(_s.size());
+    if (out_kappa != nullptr) {
+        out_kappa->resize(_s.size());
+    }
+
+    int segment = 0;
+    for (size_t i = 0; i < _s.size(); ++i) {
+        evaluate(_s[i], segment, &out_x[i], &out_y[i], &out_yaw[i],
+                 out_kappa != nullptr ? &(*out_kappa)[i] : nullptr);
+    }
+}
+
+// arc length between s0 and s1 on one piece, 5 point Gauss-Legendre
+double CubicSpline2D::calc_arc_length(double s0, double s1, int segment) const {
+    static const double nodes[5] = {0.0, -0.5384693101056831, 0.5384693101056831,
+                                    -0.9061798459386640, 0.9061798459386640};
+    static const double weights[5] = {0.5688888888888889, 0.4786286704993665,
+                                      0.4786286704993665, 0.2369268850561891,
+                                      0.2369268850561891};
+    double mid = (s0 + s1) / 2.0;
+    double half = (s1 - s0) / 2.0;
+    double length = 0.0;
+    for (int k = 0; k < 5; ++k) {
+        double dx, dy;
+        sx.calc_derivatives(mid + half * nodes[k], segment, nullptr, &dx, nullptr);
+        sy.calc_derivatives(mid + half * nodes[k], segment, nullptr, &dy, nullptr);
+        length += weights[k] * hypot(dx, dy);
+    }
+
+    return length * half;
+}
+
+void CubicSpline2D::build_arc_length_table(int samples) {
+    lut_samples = std::max(1, samples);
+    extend_arc_length_table(0);
+}
+
+// the table up to first_piece stays, the pieces from it on are integrated again
+void CubicSpline2D::extend_arc_length_table(int first_piece) {
+    lut_s.resize(first_piece * lut_samples + 1);
+    lut_arc.resize(lut_s.size());
+    lut_s[0] = s.front();
+    lut_arc[0] = 0.0;
+
+    for (size_t piece = first_piece; piece + 1 < s.size(); ++piece) {
+        double step = (s[piece + 1] - s[piece]) / lut_samples;
+        double arc = lut_arc[piece * lut_samples];
+        for (int k = 1; k <= lut_samples; ++k) {
+            double s0 = s[piece] + (k - 1) * step;
+            double s1 = k == lut_samples ? s[piece + 1] : s[piece] + k * step;
+            arc += calc_arc_length(s0, s1, piece);
+            lut_s.push_back(s1);
+            lut_arc.push_back(arc);
+        }
+    }
+}
+
+double CubicSpline2D::calc_s_from_arc_length(double arc) const {
+    if (lut_arc.empty() || arc < 0.0 || arc > lut_arc.back()) {
+        throw std::invalid_argument("received value out of the pre-defined range");
+    }
+
+    auto it = std::upper_bound(lut_arc.begin(), lut_arc.end(), arc);
+    size_t idx = std::min(static_cast<size_t>(std::distance(lut_arc.begin(), it)) - 1,
+                          lut_arc.size() - 2);
+    int segment = idx / lut_samples;
+    double s0 = lut_s[idx];
+    double s1 = lut_s[idx + 1];
+    double t = (arc - lut_arc[idx]) / (lut_arc[idx + 1] - lut_arc[idx]);
+
+    // the table interval is close to straight, one Newton step on the linear guess is enough
+    double guess = s0 + t * (s1 - s0);
+    double dx, dy;
+    sx.calc_derivatives(guess, segment, nullptr, &dx, nullptr);
+    sy.calc_derivatives(guess, segment, nullptr, &dy, nullptr);
+    double error = lut_arc[idx] + calc_arc_length(s0, guess, segment) - arc;
+    double _s = guess - error / hypot(dx, dy);
+
+    return std::clamp(_s, s0, s1);
+}
+
 vector<vector<double>> CubicSpline2D::calc_spline_course(vector<double> x, vector<double> y,
                                                          double ds) {
-    CubicSpline2D* sp = new CubicSpline2D(x, y);
-    vector<vector<double>> output(4);
-
-    for (double s = sp->s.front(); s < sp->s.back(); s += ds) {
-        Vector2d ixy = sp->calc_position(s);
-        output[0].push_back(ixy[0]);
-        output[1].push_back(ixy[1]);
-        output[2].push_back(sp->calc_yaw(s));
-        output[3].push_back(sp->calc_curvature(s));
+    CubicSpline2D sp(x, y);
+    vector<double> s;
+    for (double si = sp.s.front(); si < sp.s.back(); si += ds) {
+        s.push_back(si);
     }
-    delete sp;
+    vector<vector<double>> output(4);
+    sp.evaluate(s, output[0], output[1], output[2], &output[3]);
 
     // [x, y, yaw, curvature]
     return output;
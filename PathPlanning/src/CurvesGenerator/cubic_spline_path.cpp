@@ -44,13 +44,9 @@ int main(int argc, char** argv) {
         vector<double> s;
 
         for (double ds = 0; ds < sp.s.back(); ds += 0.1) {
-            Vector2d ixy = sp.calc_position(ds);
-            rx.push_back(ixy[0]);
-            ry.push_back(ixy[1]);
-            ryaw.push_back(sp.calc_yaw(ds));
-            rk.push_back(sp.calc_curvature(ds));
             s.push_back(ds);
         }
+        sp.evaluate(s, rx, ry, ryaw, &rk);
 
         plt::figure();
         plt::named_plot("Data points", x, y, "xb");
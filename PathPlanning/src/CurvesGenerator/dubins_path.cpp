@@ -7,6 +7,7 @@
 
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::string;
 using std::vector;
@@ -14,7 +15,7 @@ using namespace Eigen;
 namespace plt = matplotlibcpp;
 
 typedef Matrix<double, 5, 1> Vector5d;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 double mod2pi(double theta) { return std::fmod(theta, 2 * M_PI); }
 
@@ -3,15 +3,17 @@
 #include <Eigen/Core>
 #include <algorithm>
 #include <cmath>
-#include <numeric>
 #include <string>
 #include <vector>
 
 #include "cubic_spline.hpp"
+#include "distance_field.hpp"
 #include "matplotlibcpp.h"
 #include "quartic_polynomial.hpp"
 #include "quintic_polynomial.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::vector;
 using namespace Eigen;
@@ -38,7 +40,7 @@ constexpr double K_LAT = 1.0;
 constexpr double K_LON = 1.0;
 
 constexpr size_t SIM_LOOP = 500;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class FrenetPath {
 public:
@@ -69,139 +71,241 @@ public:
     ~FrenetPath() {}
 };
 
-vector<FrenetPath> calc_frenet_paths(double c_speed, double c_accel, double c_d, double c_d_d,
-                                     double c_d_dd, double s0) {
-    vector<FrenetPath> frenet_paths;
+// one (di, Ti, tv) sample, its polynomials are only evaluated along t if it gets that far
+class FrenetCandidate {
+public:
+    int lat;  // index into the lateral and longitudinal samples of FrenetPlanner
+    int lon;
+    int order;  // generation order, equal costs are resolved in favor of the later one
+    double cd;
+    double cv;
+    double cf;
+};
 
-    for (double di = -MAX_ROAD_WIDTH; di < MAX_ROAD_WIDTH; di += D_ROAD_W) {
-        for (double Ti = MIN_T; Ti < MAX_T; Ti += DT) {
-            FrenetPath fp;
-            QuinticPolynomial lat_qp(c_d, c_d_d, c_d_dd, di, 0.0, 0.0, Ti);
+class LateralSample {
+public:
+    QuinticPolynomial qp;
+    double Ti;
+    double cd;
+};
+
+class LongitudinalSample {
+public:
+    QuarticPolynomial qp;
+    double Ti;
+    double cv;
+};
+
+// staged candidate pipeline. the lateral (di, Ti) and longitudinal (Ti, tv) polynomials are
+// sampled once each and the longitudinal ones over the speed or acceleration limit are dropped
+// before any pair is formed, costs are known in Frenet space. the pairs are then converted to
+// Cartesian and checked in cost order, pool size at a time, and the first valid one is the
+// result. all buffers are kept across calls
+class FrenetPlanner {
+public:
+    explicit FrenetPlanner(utils::ThreadPool* _pool = nullptr) : pool(_pool) {
+        slots.resize(pool != nullptr ? pool->size() : 1);
+        valid.resize(slots.size());
+    }
+    ~FrenetPlanner() {}
+
+    // false if no candidate is valid, best is left untouched then
+    bool planning(const CubicSpline2D& csp, double s0, double c_speed, double c_accel,
+                  double c_d, double c_d_d, double c_d_dd, const utils::DistanceField& field,
+                  FrenetPath& best);
+
+    // candidates formed and converted to Cartesian by the last call
+    size_t get_candidates(void) const { return candidates.size(); }
+    size_t get_evaluated(void) const { return evaluated; }
+
+private:
+    utils::ThreadPool* pool;
+    vector<LateralSample> lat_samples;
+    vector<LongitudinalSample> lon_samples;
+    vector<FrenetCandidate> candidates;
+    vector<FrenetPath> slots;  // one path per candidate of a round
+    vector<char> valid;
+    size_t evaluated = 0;
+
+    void calc_samples(double c_speed, double c_accel, double c_d, double c_d_d, double c_d_dd,
+                      double s0);
+    void calc_frenet_path(const FrenetCandidate& cand, FrenetPath& fp);
+};
+
+void FrenetPlanner::calc_samples(double c_speed, double c_accel, double c_d, double c_d_d,
+                                 double c_d_dd, double s0) {
+    lat_samples.clear();
+    lon_samples.clear();
+    candidates.clear();
 
+    vector<double> Ts;
+    for (double Ti = MIN_T; Ti < MAX_T; Ti += DT) {
+        Ts.push_back(Ti);
+    }
+    // longitudinal samples of every Ti, -1 when over the limits
+    vector<int> lon_index;
+    for (double Ti : Ts) {
+        for (double tv = TARGET_SPEED - D_T_S * N_S_SAMPLE;
+             tv < TARGET_SPEED + D_T_S * N_S_SAMPLE; tv += D_T_S) {
+            QuarticPolynomial lon_qp(s0, c_speed, c_accel, tv, 0.0, Ti);
+            double max_speed = 0.0;
+            double max_accel = 0.0;
+            double Js = 0.0;
+            double s_d = 0.0;
             for (double t = 0.; t < Ti; t += DT) {
-                fp.t.push_back(t);
-                fp.d.push_back(lat_qp.calc_point(t));
-                fp.d_d.push_back(lat_qp.calc_first_derivative(t));
-                fp.d_dd.push_back(lat_qp.calc_second_derivative(t));
-                fp.d_ddd.push_back(lat_qp.calc_third_derivative(t));
+                s_d = lon_qp.calc_first_derivative(t);
+                max_speed = std::max(max_speed, s_d);
+                max_accel = std::max(max_accel, lon_qp.calc_second_derivative(t));
+                Js += pow(lon_qp.calc_third_derivative(t), 2);
             }
-
-            for (double tv = TARGET_SPEED - D_T_S * N_S_SAMPLE;
-                 tv < TARGET_SPEED + D_T_S * N_S_SAMPLE; tv += D_T_S) {
-                FrenetPath tfp = fp;
-                QuarticPolynomial lon_qp(s0, c_speed, c_accel, tv, 0.0, Ti);
-
-                for (double t : fp.t) {
-                    tfp.s.push_back(lon_qp.calc_point(t));
-                    tfp.s_d.push_back(lon_qp.calc_first_derivative(t));
-                    tfp.s_dd.push_back(lon_qp.calc_second_derivative(t));
-                    tfp.s_ddd.push_back(lon_qp.calc_third_derivative(t));
-                    if (tfp.s_d.back() > tfp.max_speed) {
-                        tfp.max_speed = tfp.s_d.back();
-                    }
-                    if (tfp.s_dd.back() > tfp.max_accel) {
-                        tfp.max_accel = tfp.s_dd.back();
-                    }
-                }
-                std::transform(tfp.d_ddd.begin(), tfp.d_ddd.end(), tfp.d_ddd.begin(),
-                               [](int x) { return x * x; });
-                std::transform(tfp.s_ddd.begin(), tfp.s_ddd.end(), tfp.s_ddd.begin(),
-                               [](int x) { return x * x; });
-                double Jp = std::accumulate(tfp.d_ddd.begin(), tfp.d_ddd.end(), 0.0);
-                double Js = std::accumulate(tfp.s_ddd.begin(), tfp.s_ddd.end(), 0.0);
-
-                double ds = pow(TARGET_SPEED - tfp.s_d.back(), 2);
-                tfp.cd = K_J * Jp + K_T * Ti + K_D * pow(tfp.d.back(), 2);
-                tfp.cv = K_J * Js + K_T * Ti + K_D * ds;
-                tfp.cf = K_LAT * tfp.cd + K_LON * tfp.cv;
-
-                frenet_paths.push_back(tfp);
+            if (max_speed < MAX_SPEED && max_accel < MAX_ACCEL) {
+                double ds = pow(TARGET_SPEED - s_d, 2);
+                lon_samples.push_back({lon_qp, Ti, K_J * Js + K_T * Ti + K_D * ds});
+                lon_index.push_back(lon_samples.size() - 1);
+            } else {
+                lon_index.push_back(-1);
             }
         }
     }
+    size_t num_tv = lon_index.size() / Ts.size();
 
-    return frenet_paths;
-}
-
-void calc_global_paths(vector<FrenetPath>& fplist, CubicSpline2D& csp) {
-    for (FrenetPath& fp : fplist) {
-        for (size_t idx = 0; idx < fp.s.size(); ++idx) {
-            if (fp.s[idx] > csp.s.back()) {
-                break;
+    int order = 0;
+    for (double di = -MAX_ROAD_WIDTH; di < MAX_ROAD_WIDTH; di += D_ROAD_W) {
+        for (size_t k = 0; k < Ts.size(); ++k) {
+            double Ti = Ts[k];
+            QuinticPolynomial lat_qp(c_d, c_d_d, c_d_dd, di, 0.0, 0.0, Ti);
+            double Jp = 0.0;
+            double d = 0.0;
+            for (double t = 0.; t < Ti; t += DT) {
+                d = lat_qp.calc_point(t);
+                Jp += pow(lat_qp.calc_third_derivative(t), 2);
             }
+            lat_samples.push_back({lat_qp, Ti, K_J * Jp + K_T * Ti + K_D * pow(d, 2)});
 
-            Vector2d ixy = csp.calc_position(fp.s[idx]);
-            double i_yaw = csp.calc_yaw(fp.s[idx]);
-            double di = fp.d[idx];
-            double fx = ixy[0] + di * cos(i_yaw + M_PI_2);
-            double fy = ixy[1] + di * sin(i_yaw + M_PI_2);
-            fp.x.emplace_back(fx);
-            fp.y.emplace_back(fy);
-        }
-
-        for (size_t idx = 0; idx + 1 < fp.x.size(); ++idx) {
-            double dx = fp.x[idx + 1] - fp.x[idx];
-            double dy = fp.y[idx + 1] - fp.y[idx];
-            fp.yaw.emplace_back(atan2(dy, dx));
-            fp.ds.emplace_back(hypot(dx, dy));
-        }
-        if (!fp.yaw.empty()) {
-            fp.yaw.push_back(fp.yaw.back());
-            fp.ds.push_back(fp.ds.back());
-
-            for (size_t idx = 0; idx < fp.yaw.size() - 1; ++idx) {
-                fp.c.emplace_back((fp.yaw[idx + 1] - fp.yaw[idx]) / fp.ds[idx]);
-                if (fp.c.back() > fp.max_curvature) {
-                    fp.max_curvature = fp.c.back();
+            for (size_t v = 0; v < num_tv; ++v, ++order) {
+                int lon = lon_index[k * num_tv + v];
+                if (lon < 0) {
+                    continue;
                 }
+                FrenetCandidate cand;
+                cand.lat = lat_samples.size() - 1;
+                cand.lon = lon;
+                cand.order = order;
+                cand.cd = lat_samples.back().cd;
+                cand.cv = lon_samples[lon].cv;
+                cand.cf = K_LAT * cand.cd + K_LON * cand.cv;
+                candidates.push_back(cand);
             }
         }
     }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const FrenetCandidate& a, const FrenetCandidate& b) {
+                  return a.cf < b.cf || (a.cf == b.cf && a.order > b.order);
+              });
 }
 
-bool check_collision(const FrenetPath& fp, const vector<vector<double>>& obs) {
-    for (size_t i = 0; i < obs[0].size(); ++i) {
-        for (size_t j = 0; j < fp.x.size(); ++j) {
-            double dist = hypot(fp.x[j] - obs[0][i], fp.y[j] - obs[1][i]);
-            if (dist <= ROBOT_RADIUS) {
-                return false;
-            }
-        }
+// samples of one candidate along t, the buffers of fp are reused
+void FrenetPlanner::calc_frenet_path(const FrenetCandidate& cand, FrenetPath& fp) {
+    LateralSample& lat = lat_samples[cand.lat];
+    LongitudinalSample& lon = lon_samples[cand.lon];
+    for (vector<double>* v : {&fp.t, &fp.d, &fp.d_d, &fp.d_dd, &fp.d_ddd, &fp.s, &fp.s_d,
+                              &fp.s_dd, &fp.s_ddd}) {
+        v->clear();
     }
-
-    return true;
+    fp.max_speed = 0.0;
+    fp.max_accel = 0.0;
+    for (double t = 0.; t < lat.Ti; t += DT) {
+        fp.t.push_back(t);
+        fp.d.push_back(lat.qp.calc_point(t));
+        fp.d_d.push_back(lat.qp.calc_first_derivative(t));
+        fp.d_dd.push_back(lat.qp.calc_second_derivative(t));
+        fp.d_ddd.push_back(lat.qp.calc_third_derivative(t));
+        fp.s.push_back(lon.qp.calc_point(t));
+        fp.s_d.push_back(lon.qp.calc_first_derivative(t));
+        fp.s_dd.push_back(lon.qp.calc_second_derivative(t));
+        fp.s_ddd.push_back(lon.qp.calc_third_derivative(t));
+        fp.max_speed = std::max(fp.max_speed, fp.s_d.back());
+        fp.max_accel = std::max(fp.max_accel, fp.s_dd.back());
+    }
+    fp.cd = cand.cd;
+    fp.cv = cand.cv;
+    fp.cf = cand.cf;
 }
 
-vector<FrenetPath> check_paths(vector<FrenetPath>& fplist, const vector<vector<double>>& obs) {
-    vector<FrenetPath> final_fp;
+void calc_global_path(FrenetPath& fp, const CubicSpline2D& csp) {
+    for (vector<double>* v : {&fp.x, &fp.y, &fp.yaw, &fp.ds, &fp.c}) {
+        v->clear();
+    }
+    fp.max_curvature = 0.0;
+    int segment = 0;
+    for (size_t idx = 0; idx < fp.s.size(); ++idx) {
+        if (fp.s[idx] > csp.s.back()) {
+            break;
+        }
 
-    for (size_t idx = 0; idx < fplist.size(); ++idx) {
-        if (fplist[idx].max_speed < MAX_SPEED && fplist[idx].max_accel < MAX_ACCEL &&
-            fplist[idx].max_curvature < MAX_CURVATURE && check_collision(fplist[idx], obs)) {
-            final_fp.push_back(fplist[idx]);
+        double ix, iy, i_yaw;
+        csp.evaluate(fp.s[idx], segment, &ix, &iy, &i_yaw, nullptr);
+        double di = fp.d[idx];
+        double fx = ix + di * cos(i_yaw + M_PI_2);
+        double fy = iy + di * sin(i_yaw + M_PI_2);
+        fp.x.emplace_back(fx);
+        fp.y.emplace_back(fy);
+    }
+
+    for (size_t idx = 0; idx + 1 < fp.x.size(); ++idx) {
+        double dx = fp.x[idx + 1] - fp.x[idx];
+        double dy = fp.y[idx + 1] - fp.y[idx];
+        fp.yaw.emplace_back(atan2(dy, dx));
+        fp.ds.emplace_back(hypot(dx, dy));
+    }
+    if (!fp.yaw.empty()) {
+        fp.yaw.push_back(fp.yaw.back());
+        fp.ds.push_back(fp.ds.back());
+
+        for (size_t idx = 0; idx < fp.yaw.size() - 1; ++idx) {
+            fp.c.emplace_back((fp.yaw[idx + 1] - fp.yaw[idx]) / fp.ds[idx]);
+            if (fp.c.back() > fp.max_curvature) {
+                fp.max_curvature = fp.c.back();
+            }
         }
     }
+}
 
-    return final_fp;
+bool check_collision(const FrenetPath& fp, const utils::DistanceField& field) {
+    return field.min_clearance(fp.x, fp.y) > ROBOT_RADIUS;
 }
 
-FrenetPath frenet_optimal_planning(CubicSpline2D& csp, double s0, double c_speed, double c_accel,
-                                   double c_d, double c_d_d, double c_d_dd,
-                                   const vector<vector<double>>& obs) {
-    vector<FrenetPath> fplist = calc_frenet_paths(c_speed, c_accel, c_d, c_d_d, c_d_dd, s0);
-    calc_global_paths(fplist, csp);
-    vector<FrenetPath> final_paths = check_paths(fplist, obs);
-
-    double min_cost = std::numeric_limits<double>::max();
-    FrenetPath best_path;
-    for (const FrenetPath& fp : final_paths) {
-        if (min_cost >= fp.cf) {
-            min_cost = fp.cf;
-            best_path = fp;
+bool FrenetPlanner::planning(const CubicSpline2D& csp, double s0, double c_speed,
+                             double c_accel, double c_d, double c_d_d, double c_d_dd,
+                             const utils::DistanceField& field, FrenetPath& best) {
+    calc_samples(c_speed, c_accel, c_d, c_d_d, c_d_dd, s0);
+    evaluated = 0;
+
+    auto evaluate = [&](size_t idx, int) {
+        FrenetPath& fp = slots[idx];
+        calc_frenet_path(candidates[evaluated + idx], fp);
+        calc_global_path(fp, csp);
+        valid[idx] = fp.max_curvature < MAX_CURVATURE && check_collision(fp, field);
+    };
+    while (evaluated < candidates.size()) {
+        size_t round = std::min(slots.size(), candidates.size() - evaluated);
+        if (pool != nullptr) {
+            pool->parallel_for(round, evaluate);
+        } else {
+            evaluate(0, 0);
+        }
+        for (size_t idx = 0; idx < round; ++idx) {
+            if (valid[idx]) {
+                evaluated += round;
+                std::swap(best, slots[idx]);
+                return true;
+            }
         }
+        evaluated += round;
     }
 
-    return best_path;
+    return false;
 }
 
 int main(int argc, char** argv) {
@@ -219,10 +323,37 @@ int main(int argc, char** argv) {
     double s0 = 0.0;
     double area = 20.0;
     utils::VehicleConfig vc(0.9);
+    utils::ThreadPool pool;
+    FrenetPlanner planner(&pool);
+    // the candidates stay within MAX_ROAD_WIDTH of the course
+    double margin = MAX_ROAD_WIDTH + ROBOT_RADIUS;
+    utils::DistanceField field = utils::DistanceField::from_bounds(
+        utils::min(spline[0]) - margin, utils::min(spline[1]) - margin,
+        utils::max(spline[0]) + margin, utils::max(spline[1]) + margin, 0.1, ROBOT_RADIUS + 1.0);
+    field.update(obs[0], obs[1]);
+    FrenetPath path;
+    double plan_time = 0.0;
     size_t iter = 0;
+    uint16_t optimal = utils::viz::channel("frenet/optimal");
+    uint16_t vehicle = utils::viz::channel("frenet/vehicle");
+    if (utils::viz::RECORD) {
+        uint16_t obstacles = utils::viz::channel("frenet/obstacles");
+        utils::viz::path(utils::viz::channel("frenet/course"), spline[0], spline[1]);
+        for (size_t i = 0; i < obs[0].size(); ++i) {
+            utils::viz::node(obstacles, obs[0][i], obs[1][i]);
+        }
+    }
     while (iter++ < SIM_LOOP) {
-        FrenetPath path =
-            frenet_optimal_planning(csp, s0, c_speed, c_accel, c_d, c_d_d, c_d_dd, obs);
+        utils::TicToc t_p;
+        if (!planner.planning(csp, s0, c_speed, c_accel, c_d, c_d_d, c_d_dd, field, path)) {
+            fmt::print("No valid trajectory\n");
+            break;
+        }
+        plan_time += t_p.toc();
+        // the whole trajectory is past the end of the course
+        if (path.x.size() < 2) {
+            break;
+        }
 
         s0 = path.s[1];
         c_d = path.d[1];
@@ -234,6 +365,9 @@ int main(int argc, char** argv) {
         if (hypot(path.x[1] - spline[0].back(), path.y[1] - spline[1].back()) <= 1.) {
             break;
         }
+        utils::viz::frame(optimal);
+        utils::viz::path(optimal, path.x, path.y);
+        utils::viz::pose(vehicle, path.x[0], path.y[0], path.yaw[0]);
         if (show_animation) {
             plt::cla();
             plt::named_plot("The planned spline path", spline[0], spline[1]);
@@ -254,6 +388,8 @@ int main(int argc, char** argv) {
         }
     }
 
+    fmt::print("planning: {:.3f} ms per cycle\n", plan_time / iter);
+
     if (show_animation) {
         plt::grid(true);
         plt::show();
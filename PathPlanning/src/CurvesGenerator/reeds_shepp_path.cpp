@@ -288,23 +288,10 @@ vector<vector<double>> generate_local_course(vector<double> lengths, vector<char
     return {xs, ys, yaws, directions};
 }
 
-vector<Path> calc_rs_paths(Vector3d s, Vector3d g, double maxc, double step_size) {
+vector<Path> calc_rs_words(Vector3d s, Vector3d g, double maxc, double step_size) {
     vector<Path> paths = generate_path(s, g, maxc, step_size);
 
     for (Path& path : paths) {
-        vector<vector<double>> states =
-            generate_local_course(path.lengths, path.ctypes, maxc, step_size * maxc);
-        for (size_t idx = 0; idx < states[0].size(); ++idx) {
-            double ix = states[0][idx];
-            double iy = states[1][idx];
-            double yaw = states[2][idx];
-            int direction = static_cast<int>(states[3][idx]);
-            path.x.emplace_back(cos(-s[2]) * ix + sin(-s[2]) * iy + s[0]);
-            path.y.emplace_back(-sin(-s[2]) * ix + cos(-s[2]) * iy + s[1]);
-            path.yaw.emplace_back(utils::pi_2_pi(yaw + s[2]));
-            path.directions.emplace_back(direction);
-        }
-
         for (size_t idx = 0; idx < path.lengths.size(); ++idx) {
             path.lengths[idx] /= maxc;
         }
@@ -314,8 +301,42 @@ vector<Path> calc_rs_paths(Vector3d s, Vector3d g, double maxc, double step_size
     return paths;
 }
 
+void interpolate_rs_path(Path& path, Vector3d s, double maxc, double step_size) {
+    vector<double> lengths = path.lengths;
+    for (double& length : lengths) {
+        length *= maxc;
+    }
+    vector<vector<double>> states =
+        generate_local_course(lengths, path.ctypes, maxc, step_size * maxc);
+
+    path.x.clear();
+    path.y.clear();
+    path.yaw.clear();
+    path.directions.clear();
+    for (size_t idx = 0; idx < states[0].size(); ++idx) {
+        double ix = states[0][idx];
+        double iy = states[1][idx];
+        double yaw = states[2][idx];
+        int direction = static_cast<int>(states[3][idx]);
+        path.x.emplace_back(cos(-s[2]) * ix + sin(-s[2]) * iy + s[0]);
+        path.y.emplace_back(-sin(-s[2]) * ix + cos(-s[2]) * iy + s[1]);
+        path.yaw.emplace_back(utils::pi_2_pi(yaw + s[2]));
+        path.directions.emplace_back(direction);
+    }
+}
+
+vector<Path> calc_rs_paths(Vector3d s, Vector3d g, double maxc, double step_size) {
+    vector<Path> paths = calc_rs_words(s, g, maxc, step_size);
+
+    for (Path& path : paths) {
+        interpolate_rs_path(path, s, maxc, step_size);
+    }
+
+    return paths;
+}
+
 Path reeds_shepp_path(Vector3d s, Vector3d g, double maxc, double step_size) {
-    vector<Path> paths = calc_rs_paths(s, g, maxc, step_size);
+    vector<Path> paths = calc_rs_words(s, g, maxc, step_size);
     int best_path_index = -1;
 
     for (size_t idx = 0; idx < paths.size(); ++idx) {
@@ -327,6 +348,7 @@ Path reeds_shepp_path(Vector3d s, Vector3d g, double maxc, double step_size) {
     if (best_path_index == -1) {
         return Path();
     }
+    interpolate_rs_path(paths[best_path_index], s, maxc, step_size);
 
     return paths[best_path_index];
 }
@@ -7,11 +7,12 @@
 #include "matplotlibcpp.h"
 #include "reeds_shepp_path.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::string;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 int main(int argc, char** argv) {
     Vector3d start(-10.0, -10.0, M_PI_4);
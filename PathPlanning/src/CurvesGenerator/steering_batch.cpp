@@ -0,0 +1,326 @@
+#include "steering_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Eigen;
+
+// pairs per block, the per block state lives on the stack
+static constexpr size_t BLOCK = 64;
+
+// utils::pi_2_pi without the loops, identical for angles within one turn of [-pi, pi]
+static inline double wrap_pi(double theta) {
+    double k = theta > M_PI ? ceil((theta - M_PI) / (2.0 * M_PI)) : 0.0;
+    k -= theta < -M_PI ? ceil((-M_PI - theta) / (2.0 * M_PI)) : 0.0;
+
+    return theta - k * 2.0 * M_PI;
+}
+
+// [0, 2 pi)
+static inline double mod2pi(double theta) {
+    return theta - 2.0 * M_PI * floor(theta / (2.0 * M_PI));
+}
+
+// normalized Reeds-Shepp families of reeds_shepp_path.cpp, branch free: every candidate is
+// computed and the return value tells if it is a valid word. sp and cp are sin(phi) and
+// cos(phi), shared by the mirrored variants
+enum RSFamily { SLS, LSL, LSR, LRL };
+
+template <RSFamily F>
+static inline bool rs_family(double x, double y, double phi, double sp, double cp, double& t,
+                             double& u, double& v) {
+    if constexpr (F == SLS) {
+        phi = wrap_pi(phi);
+        double xd = -y / tan(phi) + x;
+        double th = tan(phi / 2.0);
+        t = xd - th;
+        u = phi;
+        v = (y < 0 ? -1.0 : 1.0) * hypot(x - xd, y) - th;
+        return M_PI * 0.01 < phi && phi < M_PI * 0.99 && y != 0;
+    } else if constexpr (F == LSL) {
+        double px = x - sp;
+        double py = y - 1.0 + cp;
+        t = atan2(py, px);
+        u = hypot(px, py);
+        v = wrap_pi(phi - t);
+        return t >= 0.0 && v >= 0.0;
+    } else if constexpr (F == LSR) {
+        double px = x + sp;
+        double py = y - 1.0 - cp;
+        double u1 = px * px + py * py;
+        u = sqrt(std::max(u1 - 4.0, 0.0));
+        t = wrap_pi(atan2(py, px) + atan2(2.0, u));
+        v = wrap_pi(t - phi);
+        return u1 >= 4.0 && t >= 0.0 && v >= 0.0;
+    } else {
+        double px = x - sp;
+        double py = y - 1.0 + cp;
+        double r = hypot(px, py);
+        u = -2.0 * asin(std::min(0.25 * r, 1.0));
+        t = wrap_pi(atan2(py, px) + 0.5 * u + M_PI);
+        v = wrap_pi(phi - t + u);
+        return r <= 4.0 && t >= 0.0 && 0.0 >= u;
+    }
+}
+
+// one candidate of generate_path: a family on the mirrored (x, y, phi), time flipped (negated)
+// and / or backward (the goal seen from the start, segments reversed)
+class RSVariant {
+public:
+    RSFamily family;
+    bool backward;
+    double xs;
+    double ys;
+    double ps;
+    double flip;
+    const char* ctypes;
+};
+
+// in the order of generate_path, so ties go to the same word as reeds_shepp_path
+static constexpr RSVariant RS_VARIANTS[] = {
+    {SLS, false, 1, 1, 1, 1, "SLS"},   {SLS, false, 1, -1, -1, 1, "SRS"},
+    {LSL, false, 1, 1, 1, 1, "LSL"},   {LSL, false, -1, 1, -1, -1, "LSL"},
+    {LSL, false, 1, -1, -1, 1, "RSR"}, {LSL, false, -1, -1, 1, -1, "RSR"},
+    {LSR, false, 1, 1, 1, 1, "LSR"},   {LSR, false, -1, 1, -1, -1, "LSR"},
+    {LSR, false, 1, -1, -1, 1, "RSL"}, {LSR, false, -1, -1, 1, -1, "RSL"},
+    {LRL, false, 1, 1, 1, 1, "LRL"},   {LRL, false, -1, 1, -1, -1, "LRL"},
+    {LRL, false, 1, -1, -1, 1, "RLR"}, {LRL, false, -1, -1, 1, -1, "RLR"},
+    {LRL, true, 1, 1, 1, 1, "LRL"},    {LRL, true, -1, 1, -1, -1, "LRL"},
+    {LRL, true, 1, -1, -1, 1, "RLR"},  {LRL, true, -1, -1, 1, -1, "RLR"},
+};
+static constexpr int N_RS_VARIANTS = sizeof(RS_VARIANTS) / sizeof(RS_VARIANTS[0]);
+
+// best word of a block so far, segments normalized by the curvature
+class BlockBest {
+public:
+    double L[BLOCK];
+    double seg[3][BLOCK];
+    int word[BLOCK];
+
+    void init(size_t m) {
+        std::fill(L, L + m, std::numeric_limits<double>::infinity());
+        std::fill(word, word + m, -1);
+    }
+
+    void update(size_t i, bool ok, int id, double t, double u, double v) {
+        double l = std::abs(t) + std::abs(u) + std::abs(v);
+        bool better = ok && l < L[i];
+        L[i] = better ? l : L[i];
+        seg[0][i] = better ? t : seg[0][i];
+        seg[1][i] = better ? u : seg[1][i];
+        seg[2][i] = better ? v : seg[2][i];
+        word[i] = better ? id : word[i];
+    }
+
+    void store(size_t offset, size_t m, double maxc, int* _word, double* length,
+               double* segments) const {
+        for (size_t i = 0; i < m; ++i) {
+            _word[offset + i] = word[i];
+            length[offset + i] = word[i] < 0 ? std::numeric_limits<double>::infinity()
+                                             : L[i] / maxc;
+        }
+        if (segments != nullptr) {
+            for (size_t i = 0; i < m; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    segments[3 * (offset + i) + k] = word[i] < 0 ? 0.0 : seg[k][i] / maxc;
+                }
+            }
+        }
+    }
+};
+
+template <RSFamily F>
+static void rs_variant(const RSVariant& var, int id, const double* x, const double* y,
+                       const double* phi, const double* sp, const double* cp, size_t m,
+                       BlockBest& best) {
+    for (size_t i = 0; i < m; ++i) {
+        double t, u, v;
+        bool ok = rs_family<F>(var.xs * x[i], var.ys * y[i], var.ps * phi[i], var.ps * sp[i],
+                               cp[i], t, u, v);
+        t *= var.flip;
+        u *= var.flip;
+        v *= var.flip;
+        if (var.backward) {
+            std::swap(t, v);
+        }
+        best.update(i, ok, id, t, u, v);
+    }
+}
+
+void calc_rs_shortest_batch(const PoseArrays& s, const PoseArrays& g, size_t n, double maxc,
+                            int* word, double* length, double* segments) {
+    double x[BLOCK], y[BLOCK], phi[BLOCK], sp[BLOCK], cp[BLOCK], xb[BLOCK], yb[BLOCK];
+    BlockBest best;
+
+    for (size_t offset = 0; offset < n; offset += BLOCK) {
+        size_t m = std::min(BLOCK, n - offset);
+        // goal in the start frame, normalized by the curvature
+        for (size_t i = 0; i < m; ++i) {
+            size_t idx = offset + i;
+            double dx = g.x[idx] - s.x[idx];
+            double dy = g.y[idx] - s.y[idx];
+            double c = cos(s.yaw[idx]);
+            double sn = sin(s.yaw[idx]);
+            x[i] = (c * dx + sn * dy) * maxc;
+            y[i] = (-sn * dx + c * dy) * maxc;
+            phi[i] = g.yaw[idx] - s.yaw[idx];
+            sp[i] = sin(phi[i]);
+            cp[i] = cos(phi[i]);
+            xb[i] = x[i] * cp[i] + y[i] * sp[i];
+            yb[i] = x[i] * sp[i] - y[i] * cp[i];
+        }
+
+        best.init(m);
+        for (int id = 0; id < N_RS_VARIANTS; ++id) {
+            const RSVariant& var = RS_VARIANTS[id];
+            const double* vx = var.backward ? xb : x;
+            const double* vy = var.backward ? yb : y;
+            switch (var.family) {
+                case SLS:
+                    rs_variant<SLS>(var, id, vx, vy, phi, sp, cp, m, best);
+                    break;
+                case LSL:
+                    rs_variant<LSL>(var, id, vx, vy, phi, sp, cp, m, best);
+                    break;
+                case LSR:
+                    rs_variant<LSR>(var, id, vx, vy, phi, sp, cp, m, best);
+                    break;
+                case LRL:
+                    rs_variant<LRL>(var, id, vx, vy, phi, sp, cp, m, best);
+                    break;
+            }
+        }
+        best.store(offset, m, maxc, word, length, segments);
+    }
+}
+
+// normalized Dubins words of dubins_path.cpp in its order, with mod2pi wrapping to [0, 2 pi)
+enum DubinsWord { D_LSL, D_RSR, D_LSR, D_RSL, D_RLR, D_LRL, N_DUBINS_WORDS };
+
+static constexpr const char* DUBINS_WORDS[] = {"LSL", "RSR", "LSR", "RSL", "RLR", "LRL"};
+
+// trig of alpha and beta of a block, shared by the six words
+class DubinsTrig {
+public:
+    double sa[BLOCK];
+    double sb[BLOCK];
+    double ca[BLOCK];
+    double cb[BLOCK];
+    double cab[BLOCK];
+};
+
+template <DubinsWord W>
+static inline bool dubins_word(double alpha, double beta, double d, double sa, double sb,
+                               double ca, double cb, double cab, double& t, double& p,
+                               double& q) {
+    if constexpr (W == D_LSL) {
+        double p2 = 2 + d * d - 2 * cab + 2 * d * (sa - sb);
+        double tmp = atan2(cb - ca, d + sa - sb);
+        t = mod2pi(-alpha + tmp);
+        p = sqrt(std::max(p2, 0.0));
+        q = mod2pi(beta - tmp);
+        return p2 >= 0;
+    } else if constexpr (W == D_RSR) {
+        double p2 = 2 + d * d - 2 * cab + 2 * d * (sb - sa);
+        double tmp = atan2(ca - cb, d - sa + sb);
+        t = mod2pi(alpha - tmp);
+        p = sqrt(std::max(p2, 0.0));
+        q = mod2pi(-beta + tmp);
+        return p2 >= 0;
+    } else if constexpr (W == D_LSR) {
+        double p2 = -2 + d * d + 2 * cab + 2 * d * (sa + sb);
+        p = sqrt(std::max(p2, 0.0));
+        double tmp = atan2(-ca - cb, d + sa + sb) - atan2(-2.0, p);
+        t = mod2pi(-alpha + tmp);
+        q = mod2pi(-beta + tmp);
+        return p2 >= 0;
+    } else if constexpr (W == D_RSL) {
+        double p2 = d * d - 2 + 2 * cab - 2 * d * (sa + sb);
+        p = sqrt(std::max(p2, 0.0));
+        double tmp = atan2(ca + cb, d - sa - sb) - atan2(2.0, p);
+        t = mod2pi(alpha - tmp);
+        q = mod2pi(beta - tmp);
+        return p2 >= 0;
+    } else if constexpr (W == D_RLR) {
+        double tmp = (6.0 - d * d + 2.0 * cab + 2.0 * d * (sa - sb)) / 8.0;
+        p = mod2pi(2 * M_PI - acos(std::clamp(tmp, -1.0, 1.0)));
+        t = mod2pi(alpha - atan2(ca - cb, d - sa + sb) + p / 2.0);
+        q = mod2pi(alpha - beta - t + p);
+        return std::abs(tmp) <= 1.0;
+    } else {
+        double tmp = (6.0 - d * d + 2.0 * cab + 2.0 * d * (sb - sa)) / 8.0;
+        p = mod2pi(2 * M_PI - acos(std::clamp(tmp, -1.0, 1.0)));
+        t = mod2pi(-alpha - atan2(ca - cb, d + sa - sb) + p / 2.0);
+        q = mod2pi(beta - alpha - t + p);
+        return std::abs(tmp) <= 1.0;
+    }
+}
+
+template <DubinsWord W>
+static void dubins_block(const double* alpha, const double* beta, const double* d,
+                         const DubinsTrig& trig, size_t m, BlockBest& best) {
+    for (size_t i = 0; i < m; ++i) {
+        double t, p, q;
+        bool ok = dubins_word<W>(alpha[i], beta[i], d[i], trig.sa[i], trig.sb[i], trig.ca[i],
+                                 trig.cb[i], trig.cab[i], t, p, q);
+        best.update(i, ok, W, t, p, q);
+    }
+}
+
+void calc_dubins_shortest_batch(const PoseArrays& s, const PoseArrays& g, size_t n, double maxc,
+                                int* word, double* length, double* segments) {
+    double alpha[BLOCK], beta[BLOCK], d[BLOCK];
+    DubinsTrig trig;
+    BlockBest best;
+
+    for (size_t offset = 0; offset < n; offset += BLOCK) {
+        size_t m = std::min(BLOCK, n - offset);
+        for (size_t i = 0; i < m; ++i) {
+            size_t idx = offset + i;
+            double dx = g.x[idx] - s.x[idx];
+            double dy = g.y[idx] - s.y[idx];
+            double theta = mod2pi(atan2(dy, dx) - s.yaw[idx]);
+            d[i] = hypot(dx, dy) * maxc;
+            alpha[i] = mod2pi(-theta);
+            beta[i] = mod2pi(g.yaw[idx] - s.yaw[idx] - theta);
+            trig.sa[i] = sin(alpha[i]);
+            trig.sb[i] = sin(beta[i]);
+            trig.ca[i] = cos(alpha[i]);
+            trig.cb[i] = cos(beta[i]);
+            trig.cab[i] = cos(alpha[i] - beta[i]);
+        }
+
+        best.init(m);
+        dubins_block<D_LSL>(alpha, beta, d, trig, m, best);
+        dubins_block<D_RSR>(alpha, beta, d, trig, m, best);
+        dubins_block<D_LSR>(alpha, beta, d, trig, m, best);
+        dubins_block<D_RSL>(alpha, beta, d, trig, m, best);
+        dubins_block<D_RLR>(alpha, beta, d, trig, m, best);
+        dubins_block<D_LRL>(alpha, beta, d, trig, m, best);
+        best.store(offset, m, maxc, word, length, segments);
+    }
+}
+
+const char* rs_batch_word(int word) {
+    return word >= 0 && word < N_RS_VARIANTS ? RS_VARIANTS[word].ctypes : "";
+}
+
+const char* dubins_batch_word(int word) {
+    return word >= 0 && word < N_DUBINS_WORDS ? DUBINS_WORDS[word] : "";
+}
+
+Path interpolate_rs_batch_path(int word, const double* segments, Vector3d s, double maxc,
+                               double step_size) {
+    Path path;
+    if (word < 0 || word >= N_RS_VARIANTS) {
+        return path;
+    }
+    const char* ctypes = RS_VARIANTS[word].ctypes;
+    path.ctypes = {ctypes[0], ctypes[1], ctypes[2]};
+    path.lengths = {segments[0], segments[1], segments[2]};
+    path.L = std::abs(segments[0]) + std::abs(segments[1]) + std::abs(segments[2]);
+    interpolate_rs_path(path, s, maxc, step_size);
+
+    return path;
+}
@@ -1,10 +1,16 @@
 #include "GraphSearchPlanner.hpp"
 
+#include <chrono>
+
+#include "grid_inflation.hpp"
+#include "profiler.hpp"
+
 using std::shared_ptr;
 using std::unordered_map;
 using std::vector;
 
 void GraphSearchPlanner::calc_obstacle_map(const vector<double>& ox, const vector<double>& oy) {
+    PROFILE_ZONE("graph_search/obstacle_map");
     minx = round(utils::min(ox));
     miny = round(utils::min(oy));
     maxx = round(utils::max(ox));
@@ -19,21 +25,9 @@ void GraphSearchPlanner::calc_obstacle_map(const vector<double>& ox, const vecto
     fmt::print("x_width: {}\n", xwidth);
     fmt::print("y_width: {}\n", ywidth);
 
-    vector<vector<bool>> obsmap(xwidth, vector<bool>(ywidth, false));
-    obstacle_map = obsmap;
-    for (int ix = 0; ix < xwidth; ++ix) {
-        double x = calc_grid_position(ix, minx);
-        for (int iy = 0; iy < ywidth; ++iy) {
-            double y = calc_grid_position(iy, miny);
-            for (int idx = 0; idx < ox.size(); ++idx) {
-                double rho = hypot(ox[idx] - x, oy[idx] - y);
-                if (rho <= robot_radius) {
-                    obstacle_map[ix][iy] = true;
-                    break;
-                }
-            }
-        }
-    }
+    obstacle_map = utils::calc_inflated_obstacle_map(ox, oy, minx, miny, map_resolution, xwidth,
+                                                     ywidth, robot_radius);
+    ++map_version;
 }
 
 vector<vector<double>> GraphSearchPlanner::get_motion_model(void) {
@@ -43,11 +37,11 @@ vector<vector<double>> GraphSearchPlanner::get_motion_model(void) {
     return motion;
 }
 
-double GraphSearchPlanner::calc_grid_position(int index, double minp) {
+double GraphSearchPlanner::calc_grid_position(int index, double minp) const {
     return index * map_resolution + minp;
 }
 
-double GraphSearchPlanner::calc_xyindex(double position, double min_pos) {
+double GraphSearchPlanner::calc_xyindex(double position, double min_pos) const {
     return round((position - min_pos) / map_resolution);
 }
 
@@ -58,7 +52,8 @@ double GraphSearchPlanner::calc_grid_index(shared_ptr<Node> node) {
 bool GraphSearchPlanner::verify_node(shared_ptr<Node> node) {
     double px = calc_grid_position(node->x, minx);
     double py = calc_grid_position(node->y, miny);
-    if (px < minx || py < miny || px >= maxx || py >= maxy || obstacle_map[node->x][node->y]) {
+    if (px < minx || py < miny || px >= maxx || py >= maxy ||
+        obstacle_map.is_occupied(node->x, node->y)) {
         return false;
     }
 
@@ -78,3 +73,144 @@ vector<vector<double>> GraphSearchPlanner::calc_final_path(
 
     return path;
 }
+
+bool GraphSearchPlanner::verify_cell(int ix, int iy) const {
+    if (ix < 0 || iy < 0 || ix >= xwidth || iy >= ywidth) {
+        return false;
+    }
+    double px = ix * map_resolution + minx;
+    double py = iy * map_resolution + miny;
+    if (px < minx || py < miny || px >= maxx || py >= maxy || obstacle_map.is_occupied(ix, iy)) {
+        return false;
+    }
+
+    return true;
+}
+
+void GraphSearchPlanner::set_obstacle(int ix, int iy, bool occupied) {
+    if (ix < 0 || iy < 0 || ix >= xwidth || iy >= ywidth) {
+        return;
+    }
+    if (obstacle_map.is_occupied(ix, iy) != occupied) {
+        obstacle_map.set(ix, iy, occupied);
+        ++map_version;
+    }
+}
+
+bool GraphSearchPlanner::best_first_search(
+    SearchArena& arena, int sx, int sy, int gx, int gy, double weight,
+    const std::function<void(int, int, size_t)>& on_expand) const {
+    if (!verify_cell(gx, gy)) {
+        arena.reset(static_cast<int>(xwidth) * static_cast<int>(ywidth));
+        return false;
+    }
+
+    return windowed_search(arena, sx, sy, gx, gy, 0, 0, xwidth - 1, ywidth - 1, weight, on_expand);
+}
+
+bool GraphSearchPlanner::windowed_search(
+    SearchArena& arena, int sx, int sy, int gx, int gy, int xlo, int ylo, int xhi, int yhi,
+    double weight, const std::function<void(int, int, size_t)>& on_expand) const {
+    PROFILE_ZONE("graph_search/search");
+    int xw = xwidth;
+    arena.reset(xw * static_cast<int>(ywidth));
+    if (!verify_cell(sx, sy) || sx < xlo || sx > xhi || sy < ylo || sy > yhi) {
+        return false;
+    }
+
+    int start = calc_cell_index(sx, sy);
+    int goal = gx < 0 ? -1 : calc_cell_index(gx, gy);
+    arena.visit(start, 0.0, -1);
+    arena.open_set.push(start, weight * hypot(sx - gx, sy - gy));
+
+    while (!arena.open_set.empty()) {
+        int current = arena.open_set.pop();
+        int cx = current % xw;
+        int cy = current / xw;
+        arena.closed[current] = true;
+        if (on_expand) {
+            on_expand(cx, cy, arena.expanded);
+        }
+        ++arena.expanded;
+
+        if (current == goal) {
+            return true;
+        }
+
+        double ccost = arena.cost[current];
+        for (const vector<double>& m : motion) {
+            int nx = cx + static_cast<int>(m[0]);
+            int ny = cy + static_cast<int>(m[1]);
+            if (nx < xlo || nx > xhi || ny < ylo || ny > yhi || !verify_cell(nx, ny)) {
+                continue;
+            }
+            int n_id = calc_cell_index(nx, ny);
+            double ncost = ccost + m[2];
+            if (arena.visited(n_id)) {
+                if (arena.closed[n_id] || arena.cost[n_id] <= ncost) {
+                    continue;
+                }
+            }
+            arena.visit(n_id, ncost, current);
+            arena.open_set.push(n_id, ncost + weight * hypot(nx - gx, ny - gy));
+        }
+    }
+
+    return false;
+}
+
+vector<vector<double>> GraphSearchPlanner::calc_final_path(const SearchArena& arena, int gx,
+                                                           int gy) const {
+    vector<vector<double>> path = {{gx * map_resolution + minx}, {gy * map_resolution + miny}};
+    if (gx < 0 || gy < 0 || gx >= xwidth || gy >= ywidth) {
+        return path;
+    }
+    int goal = calc_cell_index(gx, gy);
+    if (goal >= static_cast<int>(arena.stamp.size()) || !arena.is_closed(goal)) {
+        return path;
+    }
+
+    int xw = xwidth;
+    for (int index = arena.parent[goal]; index >= 0; index = arena.parent[index]) {
+        path[0].emplace_back((index % xw) * map_resolution + minx);
+        path[1].emplace_back((index / xw) * map_resolution + miny);
+    }
+
+    return path;
+}
+
+bool GraphSearchPlanner::search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                                const std::function<void(int, int, size_t)>& on_expand) const {
+    return best_first_search(arena, sx, sy, gx, gy, 1.0, on_expand);
+}
+
+vector<vector<double>> GraphSearchPlanner::extract_path(const SearchArena& arena, int gx,
+                                                        int gy) const {
+    return calc_final_path(arena, gx, gy);
+}
+
+void GraphSearchPlanner::plan_batch(vector<Query>& queries, int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (pool == nullptr || pool->size() != num_threads) {
+        pool = std::make_unique<utils::ThreadPool>(num_threads);
+    }
+    if (static_cast<int>(batch_arenas.size()) < num_threads) {
+        batch_arenas.resize(num_threads);
+    }
+
+    pool->parallel_for(queries.size(), [&](size_t index, int worker) {
+        Query& q = queries[index];
+        SearchArena& arena = batch_arenas[worker];
+        int gx = calc_xyindex(q.gx, minx);
+        int gy = calc_xyindex(q.gy, miny);
+        auto start = std::chrono::steady_clock::now();
+        q.found = search(arena, calc_xyindex(q.sx, minx), calc_xyindex(q.sy, miny), gx, gy);
+        q.search_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+        q.expanded = arena.expanded;
+        q.path = extract_path(arena, gx, gy);
+    });
+}
@@ -4,6 +4,8 @@
 #include <queue>
 #include <unordered_map>
 
+#include "grid_inflation.hpp"
+#include "occupancy_grid.hpp"
 #include "utils.hpp"
 
 using std::unordered_map;
@@ -57,27 +59,13 @@ int calc_index(NNode node, const NPara& P) { return (node.y - P.miny) * P.xw + (
 
 double u_cost(vector<double> u) { return hypot(u[0], u[1]); }
 
-vector<vector<int>> calc_obsmap(const vector<double>& ox, const vector<double>& oy, double rr,
-                                const NPara& P) {
-    vector<vector<int>> obsmap(P.xw, vector<int>(P.yw, 0));
-    for (size_t x = 0; x < P.xw; ++x) {
-        int xx = x + P.minx;
-        for (size_t y = 0; y < P.yw; ++y) {
-            int yy = y + P.miny;
-            for (size_t idx = 0; idx < ox.size(); ++idx) {
-                if (hypot(ox[idx] - xx, oy[idx] - yy) <= rr / P.reso) {
-                    obsmap[x][y] = 1;
-                    break;
-                }
-            }
-        }
-    }
-
-    return obsmap;
+utils::OccupancyGrid calc_obsmap(const vector<double>& ox, const vector<double>& oy, double rr,
+                                 const NPara& P) {
+    return utils::calc_inflated_obstacle_map(ox, oy, P.minx, P.miny, 1.0, P.xw, P.yw, rr / P.reso);
 }
 
 NPara calc_parameters(const vector<double>& ox, const vector<double>& oy, double rr, double reso,
-                      vector<vector<int>>& obsmap) {
+                      utils::OccupancyGrid& obsmap) {
     int minx = round(utils::min(ox));
     int miny = round(utils::min(oy));
     int maxx = round(utils::max(ox));
@@ -92,26 +80,26 @@ NPara calc_parameters(const vector<double>& ox, const vector<double>& oy, double
     return P;
 }
 
-bool check_node(NNode n, NPara P, const vector<vector<int>>& obsmap) {
+bool check_node(NNode n, NPara P, const utils::OccupancyGrid& obsmap) {
     if (n.x <= P.minx || n.x >= P.maxx || n.y <= P.miny || n.y >= P.maxy ||
-        obsmap[n.x - P.minx][n.y - P.miny]) {
+        obsmap.is_occupied(n.x - P.minx, n.y - P.miny)) {
         return false;
     }
 
     return true;
 }
 
-vector<vector<double>> calc_holonomic_heuristic_with_obstacle(std::shared_ptr<Node> node,
+vector<vector<double>> calc_holonomic_heuristic_with_obstacle(double gx, double gy,
                                                               const vector<vector<double>>& obs,
                                                               double reso, double rr) {
-    NNode n_goal(round(node->x.back() / reso), round(node->y.back() / reso), 0.0, -1);
+    NNode n_goal(round(gx / reso), round(gy / reso), 0.0, -1);
     vector<double> ox;
     vector<double> oy;
     for (size_t idx = 0; idx < obs[0].size(); ++idx) {
         ox.push_back(obs[0][idx] / reso);
         oy.push_back(obs[1][idx] / reso);
     }
-    vector<vector<int>> obsmap;
+    utils::OccupancyGrid obsmap;
     NPara P = calc_parameters(ox, oy, reso, rr, obsmap);
     unordered_map<int, NNode> open_set;
     unordered_map<int, NNode> closed_set;
@@ -162,3 +150,50 @@ vector<vector<double>> calc_holonomic_heuristic_with_obstacle(std::shared_ptr<No
 
     return hmap;
 }
+
+// FNV-1a over the raw bytes
+static uint64_t fingerprint(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t idx = 0; idx < size; ++idx) {
+        hash = (hash ^ bytes[idx]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+const vector<vector<double>>& HolonomicHeuristicCache::get(double gx, double gy,
+                                                           const vector<vector<double>>& obs,
+                                                           double reso, double rr) {
+    uint64_t version = 14695981039346656037ull;
+    version = fingerprint(version, &reso, sizeof(reso));
+    version = fingerprint(version, &rr, sizeof(rr));
+    for (const vector<double>& o : obs) {
+        version = fingerprint(version, o.data(), o.size() * sizeof(double));
+    }
+    if (version != map_version) {
+        fields.clear();
+        lru.clear();
+        map_version = version;
+    }
+
+    int64_t goal = (static_cast<int64_t>(round(gx / reso)) << 32) ^
+                   static_cast<uint32_t>(static_cast<int32_t>(round(gy / reso)));
+    auto it = fields.find(goal);
+    if (it != fields.end()) {
+        ++hits;
+        lru.splice(lru.begin(), lru, it->second.second);
+        return it->second.first;
+    }
+
+    ++misses;
+    if (fields.size() >= capacity && !lru.empty()) {
+        fields.erase(lru.back());
+        lru.pop_back();
+    }
+    lru.push_front(goal);
+    auto& entry = fields[goal];
+    entry.first = calc_holonomic_heuristic_with_obstacle(gx, gy, obs, reso, rr);
+    entry.second = lru.begin();
+
+    return entry.first;
+}
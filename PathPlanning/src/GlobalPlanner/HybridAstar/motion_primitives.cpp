@@ -0,0 +1,202 @@
+#include "motion_primitives.hpp"
+
+#include <fmt/core.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "byte_order.hpp"
+
+using std::vector;
+
+static constexpr char MAGIC[8] = {'M', 'P', 'R', 'I', 'M', 'T', 'B', '\0'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+MotionPrimitiveTable::MotionPrimitiveTable(const utils::VehicleConfig& vc, int _n_steer,
+                                           double _move_step, double _length)
+    : wheel_base(vc.WB),
+      max_steer(vc.MAX_STEER),
+      n_steer(_n_steer),
+      move_step(_move_step),
+      length(_length) {
+    double step = max_steer / n_steer;
+    vector<double> steer_set;
+    for (double u = -max_steer; u <= max_steer; u += step) {
+        steer_set.push_back(u);
+    }
+
+    int nlist = ceil(length / move_step);
+    for (int d : {1, -1}) {
+        for (double u : steer_set) {
+            MotionPrimitive p;
+            p.steer = u;
+            p.direction = d;
+            double x = 0.0;
+            double y = 0.0;
+            double yaw = 0.0;
+            double dyaw = d * move_step / wheel_base * tan(u);
+            for (int idx = 0; idx < nlist; ++idx) {
+                x += d * move_step * cos(yaw);
+                y += d * move_step * sin(yaw);
+                yaw += dyaw;
+                p.x.push_back(x);
+                p.y.push_back(y);
+                p.yaw.push_back(yaw);
+            }
+            primitives.push_back(p);
+        }
+    }
+    flatten();
+}
+
+void MotionPrimitiveTable::flatten(void) {
+    samples = primitives.empty() ? 0 : primitives[0].x.size();
+    flat_x.clear();
+    flat_y.clear();
+    flat_yaw.clear();
+    for (const MotionPrimitive& p : primitives) {
+        flat_x.insert(flat_x.end(), p.x.begin(), p.x.end());
+        flat_y.insert(flat_y.end(), p.y.begin(), p.y.end());
+        flat_yaw.insert(flat_yaw.end(), p.yaw.begin(), p.yaw.end());
+    }
+}
+
+void MotionPrimitiveTable::apply(size_t index, double x0, double y0, double yaw0,
+                                 vector<double>& x, vector<double>& y, vector<double>& yaw) const {
+    const MotionPrimitive& p = primitives[index];
+    double c = cos(yaw0);
+    double s = sin(yaw0);
+    x.resize(p.x.size());
+    y.resize(p.x.size());
+    yaw.resize(p.x.size());
+    for (size_t idx = 0; idx < p.x.size(); ++idx) {
+        x[idx] = x0 + c * p.x[idx] - s * p.y[idx];
+        y[idx] = y0 + s * p.x[idx] + c * p.y[idx];
+        yaw[idx] = utils::pi_2_pi(yaw0 + p.yaw[idx]);
+    }
+}
+
+void MotionPrimitiveTable::apply_all(double x0, double y0, double yaw0, vector<double>& x,
+                                     vector<double>& y, vector<double>& yaw) const {
+    double c = cos(yaw0);
+    double s = sin(yaw0);
+    size_t n = flat_x.size();
+    x.resize(n);
+    y.resize(n);
+    yaw.resize(n);
+    // one wrap in each direction covers every heading change below 2 pi without a branch...
+    for (size_t idx = 0; idx < n; ++idx) {
+        x[idx] = x0 + c * flat_x[idx] - s * flat_y[idx];
+        y[idx] = y0 + s * flat_x[idx] + c * flat_y[idx];
+        double t = yaw0 + flat_yaw[idx];
+        t = t > M_PI ? t - 2.0 * M_PI : t;
+        t = t < -M_PI ? t + 2.0 * M_PI : t;
+        yaw[idx] = t;
+    }
+    // ...and finishing the rest with pi_2_pi gives exactly the values of apply
+    for (size_t idx = 0; idx < n; ++idx) {
+        if (yaw[idx] > M_PI || yaw[idx] < -M_PI) {
+            yaw[idx] = utils::pi_2_pi(yaw[idx]);
+        }
+    }
+}
+
+bool MotionPrimitiveTable::matches(const utils::VehicleConfig& vc, int _n_steer,
+                                   double _move_step, double _length) const {
+    return wheel_base == vc.WB && max_steer == vc.MAX_STEER && n_steer == _n_steer &&
+           move_step == _move_step && length == _length;
+}
+
+bool MotionPrimitiveTable::save(const std::string& file) const {
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (fp == nullptr) {
+        fmt::print("MotionPrimitiveTable: cannot open {} for writing\n", file);
+        return false;
+    }
+
+    const double params[4] = {wheel_base, max_steer, move_step, length};
+    int32_t nsteer = n_steer;
+    uint32_t count = primitives.size();
+    bool ok = fwrite(MAGIC, 1, 8, fp) == 8 &&
+              utils::write_little_endian(fp, &FORMAT_VERSION, 1) &&
+              utils::write_little_endian(fp, params, 4) &&
+              utils::write_little_endian(fp, &nsteer, 1) &&
+              utils::write_little_endian(fp, &count, 1);
+    for (size_t i = 0; ok && i < primitives.size(); ++i) {
+        const MotionPrimitive& p = primitives[i];
+        int32_t direction = p.direction;
+        uint32_t nsamples = p.x.size();
+        ok = utils::write_little_endian(fp, &p.steer, 1) &&
+             utils::write_little_endian(fp, &direction, 1) &&
+             utils::write_little_endian(fp, &nsamples, 1) &&
+             utils::write_little_endian(fp, p.x.data(), nsamples) &&
+             utils::write_little_endian(fp, p.y.data(), nsamples) &&
+             utils::write_little_endian(fp, p.yaw.data(), nsamples);
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        fmt::print("MotionPrimitiveTable: failed to write {}\n", file);
+    }
+
+    return ok;
+}
+
+bool MotionPrimitiveTable::load(const std::string& file) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (fp == nullptr) {
+        fmt::print("MotionPrimitiveTable: cannot open {}\n", file);
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version;
+    double params[4];  // wheel base, max steer, move step, length
+    int32_t nsteer;
+    uint32_t count;
+    bool ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, MAGIC, 8) == 0 &&
+              utils::read_little_endian(fp, &version, 1) && version == FORMAT_VERSION &&
+              utils::read_little_endian(fp, params, 4) &&
+              utils::read_little_endian(fp, &nsteer, 1) &&
+              utils::read_little_endian(fp, &count, 1) && count < (1u << 16);
+    vector<MotionPrimitive> table(ok ? count : 0);
+    for (MotionPrimitive& p : table) {
+        int32_t direction;
+        uint32_t nsamples;
+        ok = utils::read_little_endian(fp, &p.steer, 1) &&
+             utils::read_little_endian(fp, &direction, 1) &&
+             utils::read_little_endian(fp, &nsamples, 1) && nsamples < (1u << 20);
+        if (!ok) {
+            break;
+        }
+        p.direction = direction;
+        p.x.resize(nsamples);
+        p.y.resize(nsamples);
+        p.yaw.resize(nsamples);
+        ok = utils::read_little_endian(fp, p.x.data(), nsamples) &&
+             utils::read_little_endian(fp, p.y.data(), nsamples) &&
+             utils::read_little_endian(fp, p.yaw.data(), nsamples);
+        if (!ok) {
+            break;
+        }
+    }
+    fclose(fp);
+    for (const MotionPrimitive& p : table) {
+        ok = ok && p.x.size() == table[0].x.size();
+    }
+    if (!ok) {
+        fmt::print("MotionPrimitiveTable: {} is not a primitive table\n", file);
+        return false;
+    }
+
+    wheel_base = params[0];
+    max_steer = params[1];
+    move_step = params[2];
+    length = params[3];
+    n_steer = nsteer;
+    primitives = std::move(table);
+    flatten();
+
+    return true;
+}
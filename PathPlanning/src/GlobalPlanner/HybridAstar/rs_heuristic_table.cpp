@@ -0,0 +1,218 @@
+#include "rs_heuristic_table.hpp"
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "PathPlanning/include/reeds_shepp_path.hpp"
+#include "byte_order.hpp"
+#include "utils.hpp"
+
+using std::vector;
+
+static constexpr char MAGIC[8] = {'R', 'S', 'H', 'T', 'A', 'B', 'L', '\0'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+// file format, little-endian on every host (see byte_order.hpp):
+//   0   char[8]   magic "RSHTABL\0"
+//   8   uint32    format version (1)
+//   12  uint32    nxy, cells per side
+//   16  uint32    yaw bins
+//   20  uint32    reserved
+//   24  double    curvature [1/m]
+//   32  double    range [m]
+//   40  double    resolution [m]
+//   48  float[]   lengths [m], yaw bin major, then y, then x
+// 8 byte aligned, so a little-endian host uses the floats behind it in place
+class TableHeader {
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t nxy;
+    uint32_t yaw_bins;
+    uint32_t reserved;
+    double maxc;
+    double range;
+    double reso;
+};
+
+// host order to the little-endian order of the file and back
+static void convert_header(TableHeader& header) {
+    header.version = utils::little_endian(header.version);
+    header.nxy = utils::little_endian(header.nxy);
+    header.yaw_bins = utils::little_endian(header.yaw_bins);
+    header.reserved = utils::little_endian(header.reserved);
+    header.maxc = utils::little_endian(header.maxc);
+    header.range = utils::little_endian(header.range);
+    header.reso = utils::little_endian(header.reso);
+}
+
+RSHeuristicTable::RSHeuristicTable(double _maxc, double _range, double _reso, int _yaw_bins) {
+    build(_maxc, _range, _reso, _yaw_bins);
+}
+
+RSHeuristicTable::~RSHeuristicTable() { unmap(); }
+
+void RSHeuristicTable::build(double _maxc, double _range, double _reso, int _yaw_bins) {
+    unmap();
+    maxc = _maxc;
+    range = _range;
+    reso = _reso;
+    yaw_bins = _yaw_bins;
+    nxy = 2 * static_cast<int>(ceil(range / reso)) + 1;
+    table.resize(static_cast<size_t>(yaw_bins) * nxy * nxy);
+
+    double bin_width = 2.0 * M_PI / yaw_bins;
+    Eigen::Vector3d goal(0.0, 0.0, 0.0);
+    for (int bin = 0; bin < yaw_bins; ++bin) {
+        double yaw = -M_PI + (bin + 0.5) * bin_width;
+        for (int iy = 0; iy < nxy; ++iy) {
+            for (int ix = 0; ix < nxy; ++ix) {
+                Eigen::Vector3d start(ix * reso - range, iy * reso - range, yaw);
+                vector<Path> paths = calc_rs_words(start, goal, maxc, 0.1);
+                double length = hypot(start[0], start[1]);
+                if (!paths.empty()) {
+                    length = paths[0].L;
+                    for (const Path& path : paths) {
+                        length = std::min(length, path.L);
+                    }
+                }
+                table[(static_cast<size_t>(bin) * nxy + iy) * nxy + ix] = length;
+            }
+        }
+    }
+    data = table.data();
+}
+
+void RSHeuristicTable::unmap(void) {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+}
+
+double RSHeuristicTable::get(double x, double y, double yaw, double gx, double gy,
+                             double gyaw) const {
+    double dx = x - gx;
+    double dy = y - gy;
+    double c = cos(gyaw);
+    double s = sin(gyaw);
+    double lx = c * dx + s * dy;
+    double ly = -s * dx + c * dy;
+    int ix = static_cast<int>(round((lx + range) / reso));
+    int iy = static_cast<int>(round((ly + range) / reso));
+    if (data == nullptr || ix < 0 || ix >= nxy || iy < 0 || iy >= nxy) {
+        return hypot(dx, dy);
+    }
+
+    double lyaw = utils::pi_2_pi(yaw - gyaw);
+    int bin = static_cast<int>(floor((lyaw + M_PI) / (2.0 * M_PI) * yaw_bins)) % yaw_bins;
+    if (bin < 0) {
+        bin += yaw_bins;
+    }
+
+    return data[(static_cast<size_t>(bin) * nxy + iy) * nxy + ix];
+}
+
+bool RSHeuristicTable::matches(double _maxc, double _range, double _reso, int _yaw_bins) const {
+    return !empty() && maxc == _maxc && range == _range && reso == _reso &&
+           yaw_bins == _yaw_bins;
+}
+
+bool RSHeuristicTable::save(const std::string& file) const {
+    if (empty()) {
+        fmt::print("RSHeuristicTable: nothing to save\n");
+        return false;
+    }
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (fp == nullptr) {
+        fmt::print("RSHeuristicTable: cannot open {} for writing\n", file);
+        return false;
+    }
+
+    TableHeader header;
+    memcpy(header.magic, MAGIC, 8);
+    header.version = FORMAT_VERSION;
+    header.nxy = nxy;
+    header.yaw_bins = yaw_bins;
+    header.reserved = 0;
+    header.maxc = maxc;
+    header.range = range;
+    header.reso = reso;
+    convert_header(header);
+    size_t count = static_cast<size_t>(yaw_bins) * nxy * nxy;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              utils::write_little_endian(fp, data, count);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        fmt::print("RSHeuristicTable: failed to write {}\n", file);
+    }
+
+    return ok;
+}
+
+bool RSHeuristicTable::load(const std::string& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fmt::print("RSHeuristicTable: cannot open {}\n", file);
+        return false;
+    }
+
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(TableHeader)) {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fmt::print("RSHeuristicTable: cannot map {}\n", file);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    TableHeader header;
+    memcpy(&header, addr, sizeof(header));
+    convert_header(header);
+    size_t count = static_cast<size_t>(header.yaw_bins) * header.nxy * header.nxy;
+    bool ok = memcmp(header.magic, MAGIC, 8) == 0 && header.version == FORMAT_VERSION &&
+              header.nxy > 0 && header.yaw_bins > 0 && header.reso > 0.0 &&
+              size == sizeof(header) + count * sizeof(float);
+    if (!ok) {
+        munmap(addr, size);
+        fmt::print("RSHeuristicTable: {} is not a heuristic table\n", file);
+        return false;
+    }
+
+    unmap();
+    const float* values =
+        reinterpret_cast<const float*>(static_cast<const char*>(addr) + sizeof(header));
+    if (utils::LITTLE_ENDIAN_HOST) {
+        table.clear();
+        table.shrink_to_fit();
+        mapping = addr;
+        mapping_size = size;
+        data = values;
+    } else {
+        // the floats have to be swapped, a big-endian host reads a copy instead of the mapping
+        table.assign(values, values + count);
+        utils::little_endian(table.data(), count);
+        data = table.data();
+        munmap(addr, size);
+    }
+    nxy = header.nxy;
+    yaw_bins = header.yaw_bins;
+    maxc = header.maxc;
+    range = header.range;
+    reso = header.reso;
+
+    return true;
+}
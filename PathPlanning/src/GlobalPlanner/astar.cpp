@@ -1,106 +1,61 @@
 #include <fmt/core.h>
 
-#include <algorithm>
 #include <cmath>
-#include <memory>
-#include <unordered_map>
+#include <functional>
+#include <utility>
 #include <vector>
 
 #include "GraphSearchPlanner.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
-using std::shared_ptr;
-using std::unordered_map;
 using std::vector;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class AStarPlanner : public GraphSearchPlanner {
-private:
-    shared_ptr<Node> get_mincost_node(const unordered_map<double, shared_ptr<Node>>& node_set,
-                                      shared_ptr<Node> goal);
-    double calc_heuristic(shared_ptr<Node> node1, shared_ptr<Node> node2);
-
 public:
     AStarPlanner() {}
     AStarPlanner(vector<double> ox, vector<double> oy, double reso, double radius)
         : GraphSearchPlanner(ox, oy, reso, radius) {}
+    explicit AStarPlanner(utils::OccupancyGrid grid) : GraphSearchPlanner(std::move(grid)) {}
     ~AStarPlanner() override {}
 
     vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
 };
 
 vector<vector<double>> AStarPlanner::planning(double sx, double sy, double gx, double gy) {
-    shared_ptr<Node> nstart = std::make_shared<Node>(
-        calc_xyindex(sx, get_minx()), calc_xyindex(sy, get_miny()), 0.0, -1, nullptr);
-    shared_ptr<Node> ngoal = std::make_shared<Node>(calc_xyindex(gx, get_minx()),
-                                                    calc_xyindex(gy, get_miny()), 0.0, -1, nullptr);
-    unordered_map<double, shared_ptr<Node>> open_set;
-    unordered_map<double, shared_ptr<Node>> closed_set;
-    open_set[calc_grid_index(nstart)] = nstart;
-
-    while (true) {
-        if (open_set.size() == 0) {
-            fmt::print("Open set is empty..\n");
-            break;
-        }
-
-        shared_ptr<Node> current = get_mincost_node(open_set, ngoal);
-        double c_id = calc_grid_index(current);
-        open_set.erase(c_id);
-
-        if (show_animation) {
-            plt::plot({calc_grid_position(current->x, get_minx())},
-                      {calc_grid_position(current->y, get_miny())}, "xc");
-            if (closed_set.size() % 10 == 0) {
-                plt::pause(0.001);
-            }
-        }
-        if (current->x == ngoal->x && current->y == ngoal->y) {
-            fmt::print("Find goal\n");
-            ngoal->parent_index = current->parent_index;
-            ngoal->cost = current->cost;
-            break;
-        }
-
-        closed_set[c_id] = current;
-        for (const vector<double>& m : get_motion()) {
-            shared_ptr<Node> node = std::make_shared<Node>(current->x + m[0], current->y + m[1],
-                                                           current->cost + m[2], c_id, current);
-            double n_id = calc_grid_index(node);
-
-            if (!verify_node(node) || closed_set.find(n_id) != closed_set.end()) {
-                continue;
-            }
-
-            if (open_set.find(n_id) == open_set.end() || open_set[n_id]->cost >= node->cost) {
-                open_set[n_id] = node;
+    int six = calc_xyindex(sx, get_minx());
+    int siy = calc_xyindex(sy, get_miny());
+    int gix = calc_xyindex(gx, get_minx());
+    int giy = calc_xyindex(gy, get_miny());
+
+    std::function<void(int, int, size_t)> on_expand = nullptr;
+    if (show_animation || utils::viz::RECORD) {
+        static const uint16_t closed = utils::viz::channel("astar/closed");
+        on_expand = [this](int ix, int iy, size_t nclosed) {
+            double x = calc_grid_position(ix, get_minx());
+            double y = calc_grid_position(iy, get_miny());
+            utils::viz::node(closed, x, y);
+            if (show_animation) {
+                plt::plot({x}, {y}, "xc");
+                if (nclosed % 10 == 0) {
+                    plt::pause(0.001);
+                }
             }
-        }
+        };
     }
-    vector<vector<double>> path = calc_final_path(ngoal, closed_set);
-
-    return path;
-}
 
-shared_ptr<Node> AStarPlanner::get_mincost_node(
-    const unordered_map<double, shared_ptr<Node>>& node_set, shared_ptr<Node> goal) {
-    shared_ptr<Node> min_node = nullptr;
-    for (const auto& n : node_set) {
-        if (min_node == nullptr || ((min_node->cost + calc_heuristic(min_node, goal)) >
-                                    (n.second->cost + calc_heuristic(n.second, goal)))) {
-            min_node = n.second;
-        }
+    SearchArena& arena = get_search_arena();
+    if (search(arena, six, siy, gix, giy, on_expand)) {
+        fmt::print("Find goal\n");
+    } else {
+        fmt::print("Open set is empty..\n");
     }
-    return min_node;
-}
+    vector<vector<double>> path = extract_path(arena, gix, giy);
 
-double AStarPlanner::calc_heuristic(shared_ptr<Node> node1, shared_ptr<Node> node2) {
-    double weight = 1.0;
-    double distance = weight * hypot(node1->x - node2->x, node1->y - node2->y);
-
-    return distance;
+    return path;
 }
 
 int main(int argc, char** argv) {
@@ -146,9 +101,17 @@ int main(int argc, char** argv) {
         plt::axis("equal");
     }
 
+    if (utils::viz::RECORD) {
+        uint16_t obstacles = utils::viz::channel("astar/obstacles");
+        for (size_t i = 0; i < obstacle_x.size(); ++i) {
+            utils::viz::node(obstacles, obstacle_x[i], obstacle_y[i]);
+        }
+    }
+
     AStarPlanner astar(obstacle_x, obstacle_y, grid_size, robot_radius);
     vector<vector<double>> path = astar.planning(start_x, start_y, goal_x, goal_y);
 
+    utils::viz::path(utils::viz::channel("astar/path"), path[0], path[1]);
     if (show_animation) {
         plt::plot(path[0], path[1], "-r");
         plt::pause(0.01);
@@ -1,23 +1,63 @@
 #include <fmt/core.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "GraphSearchPlanner.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::shared_ptr;
 using std::unordered_map;
 using std::vector;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
+constexpr size_t YIELD_EVERY = 32;  // expansions of a frontier between yields
+
+// best known start-goal connection, shared by the two frontier threads
+class MeetingPoint {
+public:
+    std::atomic<double> mu{std::numeric_limits<double>::infinity()};
+    std::atomic<bool> done{false};
+    // frontiers that have set up their search, neither expands before both are there
+    std::atomic<int> ready{0};
+    std::mutex mutex;
+    int cell = -1;
+
+    void update(double cost, int c) {
+        if (cost >= mu.load()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cost < mu.load()) {
+            mu.store(cost);
+            cell = c;
+        }
+    }
+};
 
 class BidirectionalAStarPlanner : public GraphSearchPlanner {
 private:
+    bool concurrent = false;
+    // g values published by each frontier (0: from start, 1: from goal), read by the other one.
+    // entries touched by a query are reset to infinity before the next one.
+    std::unique_ptr<std::atomic<double>[]> shared_g[2];
+    int shared_size = 0;
+    std::vector<int> touched[2];
+    SearchArena arenas[2];
+
+    void search_frontier(int dir, int sx, int sy, int gx, int gy, MeetingPoint& meeting);
+    void append_chain(const SearchArena& arena, int cell, vector<vector<double>>& path) const;
+    vector<vector<double>> planning_concurrent(double sx, double sy, double gx, double gy);
     shared_ptr<Node> get_mincost_node(const unordered_map<double, shared_ptr<Node>>& node_set,
                                       shared_ptr<Node> goal);
     double calc_heuristic(shared_ptr<Node> node1, shared_ptr<Node> node2);
@@ -29,13 +69,22 @@ public:
     BidirectionalAStarPlanner() {}
     BidirectionalAStarPlanner(vector<double> ox, vector<double> oy, double reso, double radius)
         : GraphSearchPlanner(ox, oy, reso, radius) {}
+    explicit BidirectionalAStarPlanner(utils::OccupancyGrid grid)
+        : GraphSearchPlanner(std::move(grid)) {}
     ~BidirectionalAStarPlanner() override {}
 
+    // run the forward and backward frontiers on two threads
+    void set_concurrent(bool _concurrent) { concurrent = _concurrent; }
+
     vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
 };
 
 vector<vector<double>> BidirectionalAStarPlanner::planning(double sx, double sy, double gx,
                                                            double gy) {
+    if (concurrent) {
+        return planning_concurrent(sx, sy, gx, gy);
+    }
+
     shared_ptr<Node> nstart = std::make_shared<Node>(
         calc_xyindex(sx, get_minx()), calc_xyindex(sy, get_miny()), 0.0, -1, nullptr);
     shared_ptr<Node> ngoal = std::make_shared<Node>(calc_xyindex(gx, get_minx()),
@@ -141,6 +190,145 @@ vector<vector<double>> BidirectionalAStarPlanner::calc_final_bidirectional_path(
     return path1;
 }
 
+void BidirectionalAStarPlanner::search_frontier(int dir, int sx, int sy, int gx, int gy,
+                                                MeetingPoint& meeting) {
+    SearchArena& arena = arenas[dir];
+    std::atomic<double>* own_g = shared_g[dir].get();
+    std::atomic<double>* other_g = shared_g[1 - dir].get();
+    const vector<vector<double>> motion = get_motion();
+    int xw = get_xwidth();
+
+    int start = calc_cell_index(sx, sy);
+    arena.reset(xw * get_ywidth());
+    arena.visit(start, 0.0, -1);
+    arena.open_set.push(start, hypot(sx - gx, sy - gy));
+    meeting.ready.fetch_add(1);
+    while (meeting.ready.load() < 2) {
+        std::this_thread::yield();
+    }
+
+    // with consistent heuristics no path through this frontier can beat mu once its smallest f
+    // reaches mu, whatever the other thread is doing
+    while (!meeting.done.load(std::memory_order_relaxed)) {
+        if (arena.open_set.empty() || arena.open_set.top_priority() >= meeting.mu.load()) {
+            meeting.done.store(true);
+            break;
+        }
+
+        int current = arena.open_set.pop();
+        int cx = current % xw;
+        int cy = current / xw;
+        arena.closed[current] = true;
+        // with fewer cores than frontiers one of them could otherwise run the whole search
+        // in its time slice and reach the seed of the other before it starts
+        if (++arena.expanded % YIELD_EVERY == 0) {
+            std::this_thread::yield();
+        }
+
+        double ccost = arena.cost[current];
+        for (const vector<double>& m : motion) {
+            int nx = cx + static_cast<int>(m[0]);
+            int ny = cy + static_cast<int>(m[1]);
+            if (!verify_cell(nx, ny)) {
+                continue;
+            }
+            int n_id = calc_cell_index(nx, ny);
+            double ncost = ccost + m[2];
+            if (arena.visited(n_id)) {
+                if (arena.closed[n_id] || arena.cost[n_id] <= ncost) {
+                    continue;
+                }
+            } else {
+                touched[dir].push_back(n_id);
+            }
+            arena.visit(n_id, ncost, current);
+            arena.open_set.push(n_id, ncost + hypot(nx - gx, ny - gy));
+
+            // store our g before reading theirs, so at least one side sees the other
+            own_g[n_id].store(ncost);
+            double other = other_g[n_id].load();
+            if (other < std::numeric_limits<double>::infinity()) {
+                meeting.update(ncost + other, n_id);
+            }
+        }
+    }
+}
+
+void BidirectionalAStarPlanner::append_chain(const SearchArena& arena, int cell,
+                                             vector<vector<double>>& path) const {
+    int xw = get_xwidth();
+    for (int index = arena.parent[cell]; index >= 0; index = arena.parent[index]) {
+        path[0].emplace_back(calc_grid_position(index % xw, get_minx()));
+        path[1].emplace_back(calc_grid_position(index / xw, get_miny()));
+    }
+}
+
+vector<vector<double>> BidirectionalAStarPlanner::planning_concurrent(double sx, double sy,
+                                                                      double gx, double gy) {
+    int six = calc_xyindex(sx, get_minx());
+    int siy = calc_xyindex(sy, get_miny());
+    int gix = calc_xyindex(gx, get_minx());
+    int giy = calc_xyindex(gy, get_miny());
+    vector<vector<double>> path = {{calc_grid_position(gix, get_minx())},
+                                   {calc_grid_position(giy, get_miny())}};
+    if (!verify_cell(six, siy) || !verify_cell(gix, giy)) {
+        fmt::print("Open set is empty..\n");
+        return path;
+    }
+
+    int ncells = get_xwidth() * get_ywidth();
+    if (shared_size != ncells) {
+        for (int dir = 0; dir < 2; ++dir) {
+            shared_g[dir].reset(new std::atomic<double>[ncells]);
+            for (int idx = 0; idx < ncells; ++idx) {
+                shared_g[dir][idx].store(std::numeric_limits<double>::infinity());
+            }
+            touched[dir].clear();
+        }
+        shared_size = ncells;
+    }
+    for (int dir = 0; dir < 2; ++dir) {
+        for (int idx : touched[dir]) {
+            shared_g[dir][idx].store(std::numeric_limits<double>::infinity());
+        }
+        touched[dir].clear();
+    }
+
+    int start = calc_cell_index(six, siy);
+    int goal = calc_cell_index(gix, giy);
+    MeetingPoint meeting;
+    shared_g[0][start].store(0.0);
+    shared_g[1][goal].store(0.0);
+    touched[0].push_back(start);
+    touched[1].push_back(goal);
+    if (start == goal) {
+        meeting.update(0.0, start);
+    }
+
+    std::thread backward(&BidirectionalAStarPlanner::search_frontier, this, 1, gix, giy, six, siy,
+                         std::ref(meeting));
+    search_frontier(0, six, siy, gix, giy, meeting);
+    backward.join();
+
+    if (meeting.cell < 0) {
+        fmt::print("Open set is empty..\n");
+        return path;
+    }
+    fmt::print("Find goal, cost {:.3f}, expanded {} + {}\n", meeting.mu.load(),
+               arenas[0].expanded, arenas[1].expanded);
+
+    // meeting point back to the start, reversed, then on to the goal
+    int mx = meeting.cell % get_xwidth();
+    int my = meeting.cell / get_xwidth();
+    path = {{calc_grid_position(mx, get_minx())}, {calc_grid_position(my, get_miny())}};
+    append_chain(arenas[0], meeting.cell, path);
+    std::reverse(path[0].begin(), path[0].end());
+    std::reverse(path[1].begin(), path[1].end());
+    append_chain(arenas[1], meeting.cell, path);
+
+    return path;
+}
+
 int main(int argc, char** argv) {
     double start_x = 10;
     double start_y = 10;
@@ -187,8 +375,12 @@ int main(int argc, char** argv) {
     BidirectionalAStarPlanner bidir_a_star(obstacle_x, obstacle_y, grid_size, robot_radius);
     vector<vector<double>> path = bidir_a_star.planning(start_x, start_y, goal_x, goal_y);
 
+    bidir_a_star.set_concurrent(true);
+    vector<vector<double>> path_mt = bidir_a_star.planning(start_x, start_y, goal_x, goal_y);
+
     if (show_animation) {
         plt::plot(path[0], path[1], "-r");
+        plt::plot(path_mt[0], path_mt[1], "--b");
         plt::pause(0.01);
         plt::show();
     }
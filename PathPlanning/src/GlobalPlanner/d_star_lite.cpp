@@ -0,0 +1,349 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "GraphSearchPlanner.hpp"
+#include "IndexedHeap.hpp"
+#include "matplotlibcpp.h"
+#include "utils.hpp"
+#include "visualization.hpp"
+
+using std::vector;
+namespace plt = matplotlibcpp;
+constexpr bool show_animation = utils::viz::ANIMATE;
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+using Key = std::pair<double, double>;
+
+// keys and g values are sums of square roots, so values that are equal on paper can differ in
+// the last bits depending on the order of the additions. they only compare as different when
+// they are further apart than this
+constexpr double KEY_EPS = 1e-9;
+
+bool key_less(const Key& a, const Key& b) {
+    if (std::abs(a.first - b.first) > KEY_EPS) {
+        return a.first < b.first;
+    }
+    return a.second < b.second - KEY_EPS;
+}
+
+// D* Lite (optimized version, Koenig & Likhachev 2002). the search runs from the goal, so g
+// and rhs stay valid while the start moves and only cells around a map change are repaired.
+class DStarLitePlanner : public GraphSearchPlanner {
+private:
+    int xw;
+    int yw;
+    int start = -1;
+    int goal = -1;
+    int last_start = -1;
+    double km = 0.0;
+    vector<double> g;
+    vector<double> rhs;
+    IndexedHeap<Key> open_set;
+    vector<vector<double>> moves;
+    size_t expanded = 0;
+
+    // cell index of a world position, -1 outside the grid
+    int calc_cell(double x, double y) const;
+    double heuristic(int a, int b) const;
+    Key calc_key(int s) const;
+    bool is_consistent(int s) const { return g[s] == rhs[s] || std::abs(g[s] - rhs[s]) <= KEY_EPS; }
+    double edge_cost(int u, int v, double c) const;
+    void update_vertex(int u);
+    void compute_shortest_path(void);
+    vector<vector<double>> extract_path(void) const;
+
+public:
+    DStarLitePlanner() {}
+    DStarLitePlanner(vector<double> ox, vector<double> oy, double reso, double radius)
+        : GraphSearchPlanner(ox, oy, reso, radius) {
+        xw = get_xwidth();
+        yw = get_ywidth();
+        moves = get_motion();
+    }
+    explicit DStarLitePlanner(utils::OccupancyGrid grid) : GraphSearchPlanner(std::move(grid)) {
+        xw = get_xwidth();
+        yw = get_ywidth();
+        moves = get_motion();
+    }
+    ~DStarLitePlanner() override {}
+
+    vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
+    // cells = {{x, y, occupied}, ...} in world coordinates, one entry per changed grid cell
+    void update_cells(const vector<vector<double>>& cells);
+    vector<vector<double>> replan(double sx, double sy);
+
+    size_t get_expanded(void) const { return expanded; }
+};
+
+int DStarLitePlanner::calc_cell(double x, double y) const {
+    int ix = calc_xyindex(x, get_minx());
+    int iy = calc_xyindex(y, get_miny());
+    if (ix < 0 || iy < 0 || ix >= xw || iy >= yw) {
+        return -1;
+    }
+
+    return calc_cell_index(ix, iy);
+}
+
+double DStarLitePlanner::heuristic(int a, int b) const {
+    return hypot(a % xw - b % xw, a / xw - b / xw);
+}
+
+Key DStarLitePlanner::calc_key(int s) const {
+    double k2 = std::min(g[s], rhs[s]);
+    return {k2 + heuristic(start, s) + km, k2};
+}
+
+double DStarLitePlanner::edge_cost(int u, int v, double c) const {
+    if (!verify_cell(u % xw, u / xw) || !verify_cell(v % xw, v / xw)) {
+        return INF;
+    }
+
+    return c;
+}
+
+void DStarLitePlanner::update_vertex(int u) {
+    if (u != goal) {
+        double best = INF;
+        int ux = u % xw;
+        int uy = u / xw;
+        for (const vector<double>& m : moves) {
+            int nx = ux + static_cast<int>(m[0]);
+            int ny = uy + static_cast<int>(m[1]);
+            if (nx < 0 || ny < 0 || nx >= xw || ny >= yw) {
+                continue;
+            }
+            int v = calc_cell_index(nx, ny);
+            best = std::min(best, edge_cost(u, v, m[2]) + g[v]);
+        }
+        rhs[u] = best;
+    }
+
+    open_set.erase(u);
+    if (!is_consistent(u)) {
+        open_set.push(u, calc_key(u));
+    }
+}
+
+void DStarLitePlanner::compute_shortest_path(void) {
+    // cells whose key ties with the start key are expanded as well, a tie that rounding put
+    // on the wrong side must not end the search early
+    while (!open_set.empty() &&
+           (!key_less(calc_key(start), open_set.top_priority()) || !is_consistent(start))) {
+        int u = open_set.top();
+        Key k_old = open_set.top_priority();
+        Key k_new = calc_key(u);
+        ++expanded;
+
+        if (key_less(k_old, k_new)) {
+            open_set.push(u, k_new);
+            continue;
+        }
+
+        if (g[u] > rhs[u]) {
+            g[u] = rhs[u];
+            open_set.pop();
+        } else {
+            g[u] = INF;
+            update_vertex(u);
+        }
+
+        int ux = u % xw;
+        int uy = u / xw;
+        for (const vector<double>& m : moves) {
+            int nx = ux + static_cast<int>(m[0]);
+            int ny = uy + static_cast<int>(m[1]);
+            if (nx >= 0 && ny >= 0 && nx < xw && ny < yw) {
+                update_vertex(calc_cell_index(nx, ny));
+            }
+        }
+    }
+}
+
+vector<vector<double>> DStarLitePlanner::extract_path(void) const {
+    vector<vector<double>> path = {{calc_grid_position(goal % xw, get_minx())},
+                                   {calc_grid_position(goal / xw, get_miny())}};
+    if (g[start] == INF) {
+        return path;
+    }
+
+    // follow the steepest descent of g from the start, stored goal first like the other planners.
+    // every step has to lower g, otherwise the g values are not settled and the descent could
+    // run in circles
+    vector<int> cells = {start};
+    int s = start;
+    while (s != goal) {
+        int best = -1;
+        double best_cost = INF;
+        for (const vector<double>& m : moves) {
+            int nx = s % xw + static_cast<int>(m[0]);
+            int ny = s / xw + static_cast<int>(m[1]);
+            if (nx < 0 || ny < 0 || nx >= xw || ny >= yw) {
+                continue;
+            }
+            int v = calc_cell_index(nx, ny);
+            double c = edge_cost(s, v, m[2]) + g[v];
+            if (c < best_cost) {
+                best_cost = c;
+                best = v;
+            }
+        }
+        if (best < 0 || !(g[best] < g[s])) {
+            fmt::print("no descending step from cell {}, path extraction failed\n", s);
+            return {{calc_grid_position(goal % xw, get_minx())},
+                    {calc_grid_position(goal / xw, get_miny())}};
+        }
+        s = best;
+        cells.push_back(s);
+    }
+
+    for (int idx = static_cast<int>(cells.size()) - 2; idx >= 0; --idx) {
+        path[0].emplace_back(calc_grid_position(cells[idx] % xw, get_minx()));
+        path[1].emplace_back(calc_grid_position(cells[idx] / xw, get_miny()));
+    }
+
+    return path;
+}
+
+vector<vector<double>> DStarLitePlanner::planning(double sx, double sy, double gx, double gy) {
+    start = calc_cell(sx, sy);
+    goal = calc_cell(gx, gy);
+    if (start < 0 || goal < 0) {
+        fmt::print("start or goal is outside the map\n");
+        start = -1;
+        goal = -1;
+        return {{}, {}};
+    }
+    last_start = start;
+    km = 0.0;
+    expanded = 0;
+    g.assign(xw * yw, INF);
+    rhs.assign(xw * yw, INF);
+    open_set.reserve(xw * yw);
+    open_set.clear();
+
+    rhs[goal] = 0.0;
+    open_set.push(goal, calc_key(goal));
+    compute_shortest_path();
+    fmt::print("initial search expanded {} cells\n", expanded);
+
+    return extract_path();
+}
+
+void DStarLitePlanner::update_cells(const vector<vector<double>>& cells) {
+    for (const vector<double>& cell : cells) {
+        int ix = calc_xyindex(cell[0], get_minx());
+        int iy = calc_xyindex(cell[1], get_miny());
+        if (ix < 0 || iy < 0 || ix >= xw || iy >= yw) {
+            continue;
+        }
+        set_obstacle(ix, iy, cell[2] != 0.0);
+        if (goal < 0) {
+            continue;
+        }
+
+        // every edge touching the cell changed, so repair it and its neighbors
+        update_vertex(calc_cell_index(ix, iy));
+        for (const vector<double>& m : moves) {
+            int nx = ix + static_cast<int>(m[0]);
+            int ny = iy + static_cast<int>(m[1]);
+            if (nx >= 0 && ny >= 0 && nx < xw && ny < yw) {
+                update_vertex(calc_cell_index(nx, ny));
+            }
+        }
+    }
+}
+
+vector<vector<double>> DStarLitePlanner::replan(double sx, double sy) {
+    int new_start = calc_cell(sx, sy);
+    if (goal < 0 || new_start < 0) {
+        fmt::print("start is outside the map or there was no planning before\n");
+        return {{}, {}};
+    }
+    km += heuristic(last_start, new_start);
+    last_start = new_start;
+    start = new_start;
+
+    expanded = 0;
+    compute_shortest_path();
+    fmt::print("replan expanded {} cells\n", expanded);
+
+    return extract_path();
+}
+
+int main(int argc, char** argv) {
+    double start_x = 10;
+    double start_y = 10;
+    double goal_x = 50.0;
+    double goal_y = 50.0;
+    double grid_size = 2.0;
+    double robot_radius = 1.0;
+
+    std::vector<double> obstacle_x;
+    std::vector<double> obstacle_y;
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(-10.0);
+    }
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(60.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(60.0);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(-10.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 40; ++i) {
+        obstacle_x.emplace_back(20.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = 0; i < 40; ++i) {
+        obstacle_x.emplace_back(40.0);
+        obstacle_y.emplace_back(60.0 - i);
+    }
+    if (show_animation) {
+        plt::plot(obstacle_x, obstacle_y, "sk");
+        plt::plot({start_x}, {start_y}, "og");
+        plt::plot({goal_x}, {goal_x}, "xb");
+        plt::grid(true);
+        plt::title("D* Lite");
+        plt::axis("equal");
+    }
+
+    DStarLitePlanner dstar(obstacle_x, obstacle_y, grid_size, robot_radius);
+    vector<vector<double>> path = dstar.planning(start_x, start_y, goal_x, goal_y);
+    if (show_animation) {
+        plt::plot(path[0], path[1], "-r");
+        plt::pause(0.5);
+    }
+
+    // something blocks the lower part of the gap above the x = 20 wall
+    vector<vector<double>> blocked;
+    vector<double> bx;
+    vector<double> by;
+    for (double y = 40.0; y <= 50.0; y += grid_size) {
+        blocked.push_back({20.0, y, 1.0});
+        bx.push_back(20.0);
+        by.push_back(y);
+    }
+    dstar.update_cells(blocked);
+    path = dstar.replan(start_x, start_y);
+
+    if (show_animation) {
+        plt::plot(bx, by, "sm");
+        plt::plot(path[0], path[1], "-b");
+        plt::pause(0.01);
+        plt::show();
+    }
+
+    return 0;
+}
@@ -5,24 +5,28 @@
 #include <memory>
 #include <stack>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "GraphSearchPlanner.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::shared_ptr;
 using std::stack;
 using std::unordered_map;
 using std::vector;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class DepthFirstSearchPlanner : public GraphSearchPlanner {
 public:
     DepthFirstSearchPlanner() {}
     DepthFirstSearchPlanner(vector<double> ox, vector<double> oy, double reso, double radius)
         : GraphSearchPlanner(ox, oy, reso, radius) {}
+    explicit DepthFirstSearchPlanner(utils::OccupancyGrid grid)
+        : GraphSearchPlanner(std::move(grid)) {}
     ~DepthFirstSearchPlanner() override {}
 
     vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
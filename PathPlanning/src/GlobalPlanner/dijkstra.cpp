@@ -1,96 +1,173 @@
 #include <fmt/core.h>
 
 #include <cmath>
-#include <memory>
+#include <functional>
+#include <limits>
+#include <list>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "GraphSearchPlanner.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
-using std::shared_ptr;
-using std::unordered_map;
 using std::vector;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class Dijkstra : public GraphSearchPlanner {
 private:
-    shared_ptr<Node> get_mincost_node(const unordered_map<double, shared_ptr<Node>>& node_set);
+    // complete cost-to-goal fields of the most recently used goal cells, front is newest
+    size_t field_capacity = 0;
+    unsigned int field_version = 0;
+    std::list<int> field_lru;
+    std::unordered_map<int, std::pair<vector<double>, std::list<int>::iterator>> goal_fields;
+    SearchArena field_arena;
+
+    const vector<double>& get_goal_field(int gix, int giy);
+    vector<vector<double>> descend_goal_field(const vector<double>& field, int six, int siy,
+                                              int gix, int giy) const;
 
 public:
     Dijkstra() {}
     Dijkstra(vector<double> ox, vector<double> oy, double reso, double radius)
         : GraphSearchPlanner(ox, oy, reso, radius) {}
+    explicit Dijkstra(utils::OccupancyGrid grid) : GraphSearchPlanner(std::move(grid)) {}
     ~Dijkstra() override {}
 
-    vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
-};
-
-vector<vector<double>> Dijkstra::planning(double sx, double sy, double gx, double gy) {
-    shared_ptr<Node> nstart = std::make_shared<Node>(
-        calc_xyindex(sx, get_minx()), calc_xyindex(sy, get_miny()), 0.0, -1, nullptr);
-    shared_ptr<Node> ngoal = std::make_shared<Node>(calc_xyindex(gx, get_minx()),
-                                                    calc_xyindex(gy, get_miny()), 0.0, -1, nullptr);
+    bool search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                const std::function<void(int, int, size_t)>& on_expand = nullptr) const override {
+        return best_first_search(arena, sx, sy, gx, gy, 0.0, on_expand);
+    }
 
-    unordered_map<double, shared_ptr<Node>> open_set;
-    unordered_map<double, shared_ptr<Node>> closed_set;
-    open_set[calc_grid_index(nstart)] = nstart;
+    vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
 
-    while (true) {
-        if (open_set.size() == 0) {
-            fmt::print("Open set is empty..\n");
-            break;
+    // many-to-one mode: keep the cost-to-goal field of up to capacity goals and answer queries by
+    // descending it, O(path length) once the field of a goal exists. 0 turns the mode off.
+    // the fields are dropped whenever the obstacle map changes.
+    void set_goal_field_cache(size_t capacity) {
+        field_capacity = capacity;
+        while (goal_fields.size() > field_capacity) {
+            goal_fields.erase(field_lru.back());
+            field_lru.pop_back();
         }
+    }
+};
 
-        shared_ptr<Node> current = get_mincost_node(open_set);
-        double c_id = calc_grid_index(current);
-        open_set.erase(c_id);
+const vector<double>& Dijkstra::get_goal_field(int gix, int giy) {
+    if (field_version != get_map_version()) {
+        goal_fields.clear();
+        field_lru.clear();
+        field_version = get_map_version();
+    }
 
-        if (show_animation) {
-            plt::plot({calc_grid_position(current->x, get_minx())},
-                      {calc_grid_position(current->y, get_miny())}, "xc");
-            if (closed_set.size() % 10 == 0) {
-                plt::pause(0.001);
-            }
-        }
-        if (current->x == ngoal->x && current->y == ngoal->y) {
-            fmt::print("Find goal\n");
-            ngoal->parent_index = current->parent_index;
-            ngoal->cost = current->cost;
-            break;
+    int goal = calc_cell_index(gix, giy);
+    auto it = goal_fields.find(goal);
+    if (it != goal_fields.end()) {
+        field_lru.splice(field_lru.begin(), field_lru, it->second.second);
+        return it->second.first;
+    }
+
+    if (goal_fields.size() >= field_capacity) {
+        goal_fields.erase(field_lru.back());
+        field_lru.pop_back();
+    }
+    // the motion model is symmetric, so a flood from the goal gives the cost to reach it
+    windowed_search(field_arena, gix, giy, -1, -1, 0, 0, get_xwidth() - 1, get_ywidth() - 1, 0.0);
+    vector<double> field(get_xwidth() * get_ywidth(), std::numeric_limits<double>::infinity());
+    for (size_t index = 0; index < field.size(); ++index) {
+        if (field_arena.visited(index)) {
+            field[index] = field_arena.cost[index];
         }
+    }
+    field_lru.push_front(goal);
+    auto& entry = goal_fields[goal];
+    entry.first = std::move(field);
+    entry.second = field_lru.begin();
 
-        closed_set[c_id] = current;
-        for (const vector<double>& m : get_motion()) {
-            shared_ptr<Node> node = std::make_shared<Node>(current->x + m[0], current->y + m[1],
-                                                           current->cost + m[2], c_id, current);
-            double n_id = calc_grid_index(node);
+    return entry.first;
+}
 
-            if (!verify_node(node) || closed_set.find(n_id) != closed_set.end()) {
+// steepest descent: the next cell is the neighbor minimizing step cost + remaining cost, which
+// follows an optimal path since the field is exact. the start has to have a finite cost
+vector<vector<double>> Dijkstra::descend_goal_field(const vector<double>& field, int six,
+                                                    int siy, int gix, int giy) const {
+    vector<vector<double>> path = {{calc_grid_position(gix, get_minx())},
+                                   {calc_grid_position(giy, get_miny())}};
+
+    vector<vector<double>> motion = get_motion();
+    vector<double> px;
+    vector<double> py;
+    int ix = six;
+    int iy = siy;
+    while (ix != gix || iy != giy) {
+        px.emplace_back(calc_grid_position(ix, get_minx()));
+        py.emplace_back(calc_grid_position(iy, get_miny()));
+        double best = std::numeric_limits<double>::infinity();
+        int bx = ix;
+        int by = iy;
+        for (const vector<double>& m : motion) {
+            int nx = ix + static_cast<int>(m[0]);
+            int ny = iy + static_cast<int>(m[1]);
+            if (!verify_cell(nx, ny)) {
                 continue;
             }
-
-            if (open_set.find(n_id) == open_set.end() || open_set[n_id]->cost >= node->cost) {
-                open_set[n_id] = node;
+            double c = m[2] + field[calc_cell_index(nx, ny)];
+            if (c < best) {
+                best = c;
+                bx = nx;
+                by = ny;
             }
         }
+        ix = bx;
+        iy = by;
     }
-    vector<vector<double>> path = calc_final_path(ngoal, closed_set);
+
+    // goal first, like extract_path
+    path[0].insert(path[0].end(), px.rbegin(), px.rend());
+    path[1].insert(path[1].end(), py.rbegin(), py.rend());
 
     return path;
 }
 
-shared_ptr<Node> Dijkstra::get_mincost_node(
-    const unordered_map<double, shared_ptr<Node>>& node_set) {
-    shared_ptr<Node> min_node = nullptr;
-    for (const auto& n : node_set) {
-        if (min_node == nullptr || min_node->cost > n.second->cost) {
-            min_node = n.second;
+vector<vector<double>> Dijkstra::planning(double sx, double sy, double gx, double gy) {
+    int six = calc_xyindex(sx, get_minx());
+    int siy = calc_xyindex(sy, get_miny());
+    int gix = calc_xyindex(gx, get_minx());
+    int giy = calc_xyindex(gy, get_miny());
+
+    if (field_capacity > 0) {
+        if (!verify_cell(six, siy) || !verify_cell(gix, giy) ||
+            std::isinf(get_goal_field(gix, giy)[calc_cell_index(six, siy)])) {
+            fmt::print("Open set is empty..\n");
+            return {{calc_grid_position(gix, get_minx())}, {calc_grid_position(giy, get_miny())}};
         }
+        fmt::print("Find goal\n");
+        return descend_goal_field(get_goal_field(gix, giy), six, siy, gix, giy);
+    }
+
+    std::function<void(int, int, size_t)> on_expand = nullptr;
+    if (show_animation) {
+        on_expand = [this](int ix, int iy, size_t nclosed) {
+            plt::plot({calc_grid_position(ix, get_minx())}, {calc_grid_position(iy, get_miny())},
+                      "xc");
+            if (nclosed % 10 == 0) {
+                plt::pause(0.001);
+            }
+        };
+    }
+
+    SearchArena& arena = get_search_arena();
+    if (search(arena, six, siy, gix, giy, on_expand)) {
+        fmt::print("Find goal\n");
+    } else {
+        fmt::print("Open set is empty..\n");
     }
-    return min_node;
+    vector<vector<double>> path = extract_path(arena, gix, giy);
+
+    return path;
 }
 
 int main(int argc, char** argv) {
@@ -142,6 +219,21 @@ int main(int argc, char** argv) {
     if (show_animation) {
         plt::plot(path[0], path[1], "-r");
         plt::pause(0.01);
+    }
+
+    // many robots driving to the same dock only pay for one wavefront
+    dijkstra.set_goal_field_cache(4);
+    utils::TicToc t_m;
+    for (double y = -5.0; y <= 55.0; y += 10.0) {
+        path = dijkstra.planning(0.0, y, goal_x, goal_y);
+        if (show_animation) {
+            plt::plot(path[0], path[1], "-b");
+            plt::pause(0.01);
+        }
+    }
+    fmt::print("7 queries on the goal field took {:.3f} ms\n", t_m.toc());
+
+    if (show_animation) {
         plt::show();
     }
 
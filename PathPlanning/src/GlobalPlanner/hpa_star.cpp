@@ -0,0 +1,467 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GraphSearchPlanner.hpp"
+#include "matplotlibcpp.h"
+#include "utils.hpp"
+#include "visualization.hpp"
+
+using std::pair;
+using std::unordered_map;
+using std::vector;
+namespace plt = matplotlibcpp;
+constexpr bool show_animation = utils::viz::ANIMATE;
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+// hierarchical path-finding A* (Botea et al. 2004). the grid is cut into square clusters,
+// entrances on the cluster borders become abstract nodes, and the distances between the nodes
+// of one cluster are cached. a query searches the abstract graph and refines it cluster by
+// cluster with the windowed A* of GraphSearchPlanner.
+class HPAStarPlanner : public GraphSearchPlanner {
+private:
+    int xw;
+    int yw;
+    int csize;
+    int ncx;
+    int ncy;
+    // entrance cell pairs (inside, outside) on the east / north border of each cluster
+    vector<vector<pair<int, int>>> east_entrances;
+    vector<vector<pair<int, int>>> north_entrances;
+    // abstract nodes of each cluster and the cached distances between them
+    vector<vector<int>> cluster_nodes;
+    vector<vector<vector<double>>> cluster_dist;
+    unordered_map<int, int> node_index;
+    SearchArena local_arena;
+    SearchArena abstract_arena;
+
+    int cluster_of(int ix, int iy) const { return (iy / csize) * ncx + ix / csize; }
+    void cluster_bounds(int c, int& xlo, int& ylo, int& xhi, int& yhi) const;
+    void build_entrances(int c);
+    void build_cluster(int c);
+    void build_abstraction(void);
+    vector<double> calc_node_distances(int cell, int c);
+    bool refine(int from, int to, vector<int>& cells);
+
+public:
+    HPAStarPlanner() {}
+    HPAStarPlanner(vector<double> ox, vector<double> oy, double reso, double radius,
+                   int cluster_size = 10)
+        : GraphSearchPlanner(ox, oy, reso, radius), csize(cluster_size) {
+        build_abstraction();
+    }
+    HPAStarPlanner(utils::OccupancyGrid grid, int cluster_size = 10)
+        : GraphSearchPlanner(std::move(grid)), csize(cluster_size) {
+        build_abstraction();
+    }
+    ~HPAStarPlanner() override {}
+
+    vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
+    // cells = {{x, y, occupied}, ...}, rebuilds only the clusters next to a changed cell
+    void update_cells(const vector<vector<double>>& cells);
+
+    int get_abstract_node_num(void) const { return node_index.size(); }
+};
+
+void HPAStarPlanner::cluster_bounds(int c, int& xlo, int& ylo, int& xhi, int& yhi) const {
+    xlo = (c % ncx) * csize;
+    ylo = (c / ncx) * csize;
+    xhi = std::min(xlo + csize, xw) - 1;
+    yhi = std::min(ylo + csize, yw) - 1;
+}
+
+// runs of free cell pairs across a border get one entrance in the middle, long runs one at
+// each end
+void HPAStarPlanner::build_entrances(int c) {
+    int xlo, ylo, xhi, yhi;
+    cluster_bounds(c, xlo, ylo, xhi, yhi);
+
+    auto scan = [this](vector<pair<int, int>>& entrances, int length,
+                       const std::function<pair<int, int>(int)>& cell_pair) {
+        entrances.clear();
+        int run_start = -1;
+        for (int i = 0; i <= length; ++i) {
+            bool open = false;
+            if (i < length) {
+                pair<int, int> p = cell_pair(i);
+                open = verify_cell(p.first % xw, p.first / xw) &&
+                       verify_cell(p.second % xw, p.second / xw);
+            }
+            if (open && run_start < 0) {
+                run_start = i;
+            } else if (!open && run_start >= 0) {
+                int run_end = i - 1;
+                if (run_end - run_start + 1 < 6) {
+                    entrances.push_back(cell_pair((run_start + run_end) / 2));
+                } else {
+                    entrances.push_back(cell_pair(run_start));
+                    entrances.push_back(cell_pair(run_end));
+                }
+                run_start = -1;
+            }
+        }
+    };
+
+    if (xhi + 1 < xw) {
+        scan(east_entrances[c], yhi - ylo + 1, [&](int i) {
+            return pair<int, int>(calc_cell_index(xhi, ylo + i), calc_cell_index(xhi + 1, ylo + i));
+        });
+    } else {
+        east_entrances[c].clear();
+    }
+    if (yhi + 1 < yw) {
+        scan(north_entrances[c], xhi - xlo + 1, [&](int i) {
+            return pair<int, int>(calc_cell_index(xlo + i, yhi), calc_cell_index(xlo + i, yhi + 1));
+        });
+    } else {
+        north_entrances[c].clear();
+    }
+}
+
+vector<double> HPAStarPlanner::calc_node_distances(int cell, int c) {
+    int xlo, ylo, xhi, yhi;
+    cluster_bounds(c, xlo, ylo, xhi, yhi);
+    windowed_search(local_arena, cell % xw, cell / xw, -1, -1, xlo, ylo, xhi, yhi, 0.0);
+
+    vector<double> dist;
+    for (int node : cluster_nodes[c]) {
+        dist.push_back(local_arena.visited(node) ? local_arena.cost[node] : INF);
+    }
+
+    return dist;
+}
+
+void HPAStarPlanner::build_cluster(int c) {
+    for (int node : cluster_nodes[c]) {
+        node_index.erase(node);
+    }
+    cluster_nodes[c].clear();
+
+    // own east / north borders and the west / south ones owned by the neighbors
+    auto add_node = [this, c](int cell) {
+        if (node_index.find(cell) == node_index.end()) {
+            node_index[cell] = cluster_nodes[c].size();
+            cluster_nodes[c].push_back(cell);
+        }
+    };
+    for (const pair<int, int>& e : east_entrances[c]) {
+        add_node(e.first);
+    }
+    for (const pair<int, int>& e : north_entrances[c]) {
+        add_node(e.first);
+    }
+    if (c % ncx > 0) {
+        for (const pair<int, int>& e : east_entrances[c - 1]) {
+            add_node(e.second);
+        }
+    }
+    if (c / ncx > 0) {
+        for (const pair<int, int>& e : north_entrances[c - ncx]) {
+            add_node(e.second);
+        }
+    }
+
+    cluster_dist[c].clear();
+    for (int node : cluster_nodes[c]) {
+        cluster_dist[c].push_back(calc_node_distances(node, c));
+    }
+}
+
+void HPAStarPlanner::build_abstraction(void) {
+    xw = get_xwidth();
+    yw = get_ywidth();
+    ncx = (xw + csize - 1) / csize;
+    ncy = (yw + csize - 1) / csize;
+    east_entrances.assign(ncx * ncy, {});
+    north_entrances.assign(ncx * ncy, {});
+    cluster_nodes.assign(ncx * ncy, {});
+    cluster_dist.assign(ncx * ncy, {});
+    node_index.clear();
+
+    for (int c = 0; c < ncx * ncy; ++c) {
+        build_entrances(c);
+    }
+    for (int c = 0; c < ncx * ncy; ++c) {
+        build_cluster(c);
+    }
+}
+
+void HPAStarPlanner::update_cells(const vector<vector<double>>& cells) {
+    vector<bool> dirty(ncx * ncy, false);
+    for (const vector<double>& cell : cells) {
+        int ix = calc_xyindex(cell[0], get_minx());
+        int iy = calc_xyindex(cell[1], get_miny());
+        if (ix < 0 || iy < 0 || ix >= xw || iy >= yw) {
+            continue;
+        }
+        set_obstacle(ix, iy, cell[2] != 0.0);
+        dirty[cluster_of(ix, iy)] = true;
+    }
+
+    // a dirty cluster changes its own borders, which also belong to the west / south neighbors,
+    // and through them the node sets of the east / north neighbors
+    vector<bool> rebuild(ncx * ncy, false);
+    for (int c = 0; c < ncx * ncy; ++c) {
+        if (!dirty[c]) {
+            continue;
+        }
+        int cx = c % ncx;
+        int cy = c / ncx;
+        build_entrances(c);
+        if (cx > 0) {
+            build_entrances(c - 1);
+        }
+        if (cy > 0) {
+            build_entrances(c - ncx);
+        }
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if ((dx == 0 || dy == 0) && cx + dx >= 0 && cx + dx < ncx && cy + dy >= 0 &&
+                    cy + dy < ncy) {
+                    rebuild[c + dy * ncx + dx] = true;
+                }
+            }
+        }
+    }
+    int count = 0;
+    for (int c = 0; c < ncx * ncy; ++c) {
+        if (rebuild[c]) {
+            build_cluster(c);
+            ++count;
+        }
+    }
+    fmt::print("rebuilt {} of {} clusters\n", count, ncx * ncy);
+}
+
+// cells from `from` (excluded) to `to` (included) inside the cluster of `from`
+bool HPAStarPlanner::refine(int from, int to, vector<int>& cells) {
+    int fx = from % xw;
+    int fy = from / xw;
+    int tx = to % xw;
+    int ty = to / xw;
+    if (std::abs(fx - tx) + std::abs(fy - ty) == 1 && cluster_of(fx, fy) != cluster_of(tx, ty)) {
+        cells.push_back(to);
+        return true;
+    }
+
+    int xlo, ylo, xhi, yhi;
+    cluster_bounds(cluster_of(fx, fy), xlo, ylo, xhi, yhi);
+    if (!windowed_search(local_arena, fx, fy, tx, ty, xlo, ylo, xhi, yhi, 1.0)) {
+        return false;
+    }
+    size_t mark = cells.size();
+    for (int index = to; index != from; index = local_arena.parent[index]) {
+        cells.push_back(index);
+    }
+    std::reverse(cells.begin() + mark, cells.end());
+
+    return true;
+}
+
+vector<vector<double>> HPAStarPlanner::planning(double sx, double sy, double gx, double gy) {
+    int six = calc_xyindex(sx, get_minx());
+    int siy = calc_xyindex(sy, get_miny());
+    int gix = calc_xyindex(gx, get_minx());
+    int giy = calc_xyindex(gy, get_miny());
+    vector<vector<double>> path = {{calc_grid_position(gix, get_minx())},
+                                   {calc_grid_position(giy, get_miny())}};
+    if (!verify_cell(six, siy) || !verify_cell(gix, giy)) {
+        fmt::print("Open set is empty..\n");
+        return path;
+    }
+
+    int start = calc_cell_index(six, siy);
+    int goal = calc_cell_index(gix, giy);
+    int start_cluster = cluster_of(six, siy);
+    int goal_cluster = cluster_of(gix, giy);
+
+    // temporary edges of start and goal to the nodes of their clusters
+    vector<double> start_dist = calc_node_distances(start, start_cluster);
+    double direct = INF;
+    if (start_cluster == goal_cluster && local_arena.visited(goal)) {
+        direct = local_arena.cost[goal];
+    }
+    vector<double> goal_dist = calc_node_distances(goal, goal_cluster);
+
+    // A* over the abstract graph, cells are used as node ids
+    SearchArena& arena = abstract_arena;
+    arena.reset(xw * yw);
+    arena.visit(start, 0.0, -1);
+    arena.open_set.push(start, hypot(six - gix, siy - giy));
+    if (direct < INF) {
+        arena.visit(goal, direct, start);
+        arena.open_set.push(goal, direct);
+    }
+
+    auto relax = [&](int from, int to, double edge) {
+        double ncost = arena.cost[from] + edge;
+        if (arena.visited(to) && (arena.closed[to] || arena.cost[to] <= ncost)) {
+            return;
+        }
+        arena.visit(to, ncost, from);
+        arena.open_set.push(to, ncost + hypot(to % xw - gix, to / xw - giy));
+    };
+
+    bool found = false;
+    while (!arena.open_set.empty()) {
+        int current = arena.open_set.pop();
+        arena.closed[current] = true;
+        ++arena.expanded;
+        if (current == goal) {
+            found = true;
+            break;
+        }
+
+        if (current == start) {
+            for (size_t i = 0; i < cluster_nodes[start_cluster].size(); ++i) {
+                if (start_dist[i] < INF) {
+                    relax(current, cluster_nodes[start_cluster][i], start_dist[i]);
+                }
+            }
+        }
+        auto it = node_index.find(current);
+        if (it == node_index.end()) {
+            continue;
+        }
+
+        int c = cluster_of(current % xw, current / xw);
+        int i = it->second;
+        for (size_t j = 0; j < cluster_nodes[c].size(); ++j) {
+            if (cluster_dist[c][i][j] < INF && static_cast<int>(j) != i) {
+                relax(current, cluster_nodes[c][j], cluster_dist[c][i][j]);
+            }
+        }
+        if (c == goal_cluster && goal_dist[i] < INF) {
+            relax(current, goal, goal_dist[i]);
+        }
+
+        // inter-cluster edges, a border pair is one straight step
+        int cx = c % ncx;
+        int cy = c / ncx;
+        vector<const vector<pair<int, int>>*> borders = {&east_entrances[c], &north_entrances[c]};
+        if (cx > 0) {
+            borders.push_back(&east_entrances[c - 1]);
+        }
+        if (cy > 0) {
+            borders.push_back(&north_entrances[c - ncx]);
+        }
+        for (const vector<pair<int, int>>* border : borders) {
+            for (const pair<int, int>& e : *border) {
+                if (e.first == current) {
+                    relax(current, e.second, 1.0);
+                } else if (e.second == current) {
+                    relax(current, e.first, 1.0);
+                }
+            }
+        }
+    }
+    fmt::print("abstract search expanded {} of {} nodes\n", arena.expanded, node_index.size());
+    if (!found) {
+        fmt::print("Open set is empty..\n");
+        return path;
+    }
+
+    vector<int> abstract_path;
+    for (int index = goal; index >= 0; index = arena.parent[index]) {
+        abstract_path.push_back(index);
+    }
+    std::reverse(abstract_path.begin(), abstract_path.end());
+
+    vector<int> cells;
+    for (size_t idx = 0; idx + 1 < abstract_path.size(); ++idx) {
+        if (!refine(abstract_path[idx], abstract_path[idx + 1], cells)) {
+            fmt::print("refinement failed\n");
+            return path;
+        }
+    }
+    fmt::print("Find goal\n");
+
+    // goal first, like the other grid planners
+    for (int idx = static_cast<int>(cells.size()) - 2; idx >= 0; --idx) {
+        path[0].emplace_back(calc_grid_position(cells[idx] % xw, get_minx()));
+        path[1].emplace_back(calc_grid_position(cells[idx] / xw, get_miny()));
+    }
+    path[0].emplace_back(calc_grid_position(six, get_minx()));
+    path[1].emplace_back(calc_grid_position(siy, get_miny()));
+
+    return path;
+}
+
+int main(int argc, char** argv) {
+    double start_x = 10;
+    double start_y = 10;
+    double goal_x = 50.0;
+    double goal_y = 50.0;
+    double grid_size = 1.0;
+    double robot_radius = 1.0;
+
+    std::vector<double> obstacle_x;
+    std::vector<double> obstacle_y;
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(-10.0);
+    }
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(60.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(60.0);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(-10.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 40; ++i) {
+        obstacle_x.emplace_back(20.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = 0; i < 40; ++i) {
+        obstacle_x.emplace_back(40.0);
+        obstacle_y.emplace_back(60.0 - i);
+    }
+    if (show_animation) {
+        plt::plot(obstacle_x, obstacle_y, "sk");
+        plt::plot({start_x}, {start_y}, "og");
+        plt::plot({goal_x}, {goal_x}, "xb");
+        plt::grid(true);
+        plt::title("HPA*");
+        plt::axis("equal");
+    }
+
+    utils::TicToc t_m;
+    HPAStarPlanner hpa(obstacle_x, obstacle_y, grid_size, robot_radius, 10);
+    fmt::print("abstraction with {} nodes built in {:.3f} ms\n", hpa.get_abstract_node_num(),
+               t_m.toc());
+    t_m.tic();
+    vector<vector<double>> path = hpa.planning(start_x, start_y, goal_x, goal_y);
+    fmt::print("query took {:.3f} ms\n", t_m.toc());
+
+    if (show_animation) {
+        plt::plot(path[0], path[1], "-r");
+        plt::pause(0.5);
+    }
+
+    // narrow the gap above the x = 20 wall, only the clusters around it are rebuilt
+    vector<vector<double>> blocked;
+    for (double y = 40.0; y <= 52.0; y += grid_size) {
+        blocked.push_back({20.0, y, 1.0});
+    }
+    hpa.update_cells(blocked);
+    path = hpa.planning(start_x, start_y, goal_x, goal_y);
+
+    if (show_animation) {
+        plt::plot(path[0], path[1], "-b");
+        plt::pause(0.01);
+        plt::show();
+    }
+
+    return 0;
+}
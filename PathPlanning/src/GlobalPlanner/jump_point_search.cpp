@@ -0,0 +1,396 @@
+#include <fmt/core.h>
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "GraphSearchPlanner.hpp"
+#include "matplotlibcpp.h"
+#include "utils.hpp"
+#include "visualization.hpp"
+
+using std::vector;
+namespace plt = matplotlibcpp;
+constexpr bool show_animation = utils::viz::ANIMATE;
+
+// jump point search on the 8-connected grid of GraphSearchPlanner (diagonal moves may cut
+// corners, same as the A* motion model). straight jumps scan 64 cells per step over bit-packed
+// rows and columns of blocked cells.
+class JumpPointSearchPlanner : public GraphSearchPlanner {
+private:
+    int xw;
+    int yw;
+    // blocked bits, rows[iy] indexed by ix and cols[ix] indexed by iy. bits past the end are set
+    std::vector<std::vector<uint64_t>> rows;
+    std::vector<std::vector<uint64_t>> cols;
+    // map version the bits were built from
+    unsigned int bits_version = 0;
+
+    void build_blocked_bits(void);
+    void set_blocked_bit(int ix, int iy, bool blocked);
+    bool is_blocked(int ix, int iy) const;
+    uint64_t load_word(const std::vector<std::vector<uint64_t>>& bits, int line, int word) const;
+    int scan_line(const std::vector<std::vector<uint64_t>>& bits, int line, int length, int pos,
+                  int dir, int target) const;
+    int jump(int x, int y, int dx, int dy, int gx, int gy) const;
+    void get_successor_dirs(int x, int y, int parent, vector<vector<int>>& dirs) const;
+
+public:
+    JumpPointSearchPlanner() {}
+    JumpPointSearchPlanner(vector<double> ox, vector<double> oy, double reso, double radius)
+        : GraphSearchPlanner(ox, oy, reso, radius) {
+        build_blocked_bits();
+    }
+    explicit JumpPointSearchPlanner(utils::OccupancyGrid grid)
+        : GraphSearchPlanner(std::move(grid)) {
+        build_blocked_bits();
+    }
+    ~JumpPointSearchPlanner() override {}
+
+    bool search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                const std::function<void(int, int, size_t)>& on_expand = nullptr) const override;
+    vector<vector<double>> extract_path(const SearchArena& arena, int gx, int gy) const override;
+    vector<vector<double>> planning(double sx, double sy, double gx, double gy) override;
+    // patches the blocked bits of the cell along with the map
+    void set_obstacle(int ix, int iy, bool occupied) override;
+};
+
+void JumpPointSearchPlanner::build_blocked_bits(void) {
+    xw = get_xwidth();
+    yw = get_ywidth();
+    int row_words = (xw + 63) / 64;
+    int col_words = (yw + 63) / 64;
+    rows.assign(yw, vector<uint64_t>(row_words, ~uint64_t(0)));
+    cols.assign(xw, vector<uint64_t>(col_words, ~uint64_t(0)));
+
+    for (int ix = 0; ix < xw; ++ix) {
+        for (int iy = 0; iy < yw; ++iy) {
+            if (verify_cell(ix, iy)) {
+                set_blocked_bit(ix, iy, false);
+            }
+        }
+    }
+    bits_version = get_map_version();
+}
+
+void JumpPointSearchPlanner::set_blocked_bit(int ix, int iy, bool blocked) {
+    if (blocked) {
+        rows[iy][ix >> 6] |= uint64_t(1) << (ix & 63);
+        cols[ix][iy >> 6] |= uint64_t(1) << (iy & 63);
+    } else {
+        rows[iy][ix >> 6] &= ~(uint64_t(1) << (ix & 63));
+        cols[ix][iy >> 6] &= ~(uint64_t(1) << (iy & 63));
+    }
+}
+
+void JumpPointSearchPlanner::set_obstacle(int ix, int iy, bool occupied) {
+    GraphSearchPlanner::set_obstacle(ix, iy, occupied);
+    if (ix < 0 || iy < 0 || ix >= xw || iy >= yw) {
+        return;
+    }
+    // one cell changed since the bits were built, otherwise they are rebuilt as a whole
+    if (bits_version + 1 == get_map_version()) {
+        set_blocked_bit(ix, iy, !verify_cell(ix, iy));
+        bits_version = get_map_version();
+    } else if (bits_version != get_map_version()) {
+        build_blocked_bits();
+    }
+}
+
+bool JumpPointSearchPlanner::is_blocked(int ix, int iy) const {
+    if (ix < 0 || iy < 0 || ix >= xw || iy >= yw) {
+        return true;
+    }
+
+    return (rows[iy][ix >> 6] >> (ix & 63)) & 1;
+}
+
+uint64_t JumpPointSearchPlanner::load_word(const vector<vector<uint64_t>>& bits, int line,
+                                           int word) const {
+    if (line < 0 || line >= static_cast<int>(bits.size()) || word < 0 ||
+        word >= static_cast<int>(bits[line].size())) {
+        return ~uint64_t(0);
+    }
+
+    return bits[line][word];
+}
+
+// walk along one line starting at pos (inclusive) in direction dir and return the first jump
+// point: a cell with a forced neighbor on the adjacent lines, or target. -1 if a blocked cell
+// comes first.
+int JumpPointSearchPlanner::scan_line(const vector<vector<uint64_t>>& bits, int line, int length,
+                                      int pos, int dir, int target) const {
+    while (pos >= 0 && pos < length) {
+        int word = pos >> 6;
+        int bit = pos & 63;
+        uint64_t b0 = load_word(bits, line, word);
+        uint64_t bl = load_word(bits, line - 1, word);
+        uint64_t bh = load_word(bits, line + 1, word);
+        uint64_t forced;
+        uint64_t range;
+        if (dir > 0) {
+            // neighbor line blocked at p and free at p + 1
+            uint64_t bl_next = (bl >> 1) | (load_word(bits, line - 1, word + 1) << 63);
+            uint64_t bh_next = (bh >> 1) | (load_word(bits, line + 1, word + 1) << 63);
+            forced = (bl & ~bl_next) | (bh & ~bh_next);
+            range = ~uint64_t(0) << bit;
+        } else {
+            uint64_t bl_prev = (bl << 1) | (load_word(bits, line - 1, word - 1) >> 63);
+            uint64_t bh_prev = (bh << 1) | (load_word(bits, line + 1, word - 1) >> 63);
+            forced = (bl & ~bl_prev) | (bh & ~bh_prev);
+            range = ~uint64_t(0) >> (63 - bit);
+        }
+        uint64_t events = (b0 | forced) & range;
+        if (target >= 0 && (target >> 6) == word) {
+            uint64_t goal_bit = (uint64_t(1) << (target & 63)) & range;
+            events |= goal_bit;
+        }
+
+        if (events != 0) {
+            int p = dir > 0 ? __builtin_ctzll(events) : 63 - __builtin_clzll(events);
+            p += word << 6;
+            if (p >= length || ((b0 >> (p & 63)) & 1)) {
+                return -1;
+            }
+            return p;
+        }
+        pos = dir > 0 ? (word + 1) << 6 : (word << 6) - 1;
+    }
+
+    return -1;
+}
+
+int JumpPointSearchPlanner::jump(int x, int y, int dx, int dy, int gx, int gy) const {
+    if (dy == 0) {
+        int p = scan_line(rows, y, xw, x + dx, dx, y == gy ? gx : -1);
+        return p < 0 ? -1 : calc_cell_index(p, y);
+    }
+    if (dx == 0) {
+        int p = scan_line(cols, x, yw, y + dy, dy, x == gx ? gy : -1);
+        return p < 0 ? -1 : calc_cell_index(x, p);
+    }
+
+    while (true) {
+        x += dx;
+        y += dy;
+        if (is_blocked(x, y)) {
+            return -1;
+        }
+        if ((x == gx && y == gy) ||
+            (is_blocked(x - dx, y) && !is_blocked(x - dx, y + dy)) ||
+            (is_blocked(x, y - dy) && !is_blocked(x + dx, y - dy))) {
+            return calc_cell_index(x, y);
+        }
+        if (scan_line(rows, y, xw, x + dx, dx, y == gy ? gx : -1) >= 0 ||
+            scan_line(cols, x, yw, y + dy, dy, x == gx ? gy : -1) >= 0) {
+            return calc_cell_index(x, y);
+        }
+    }
+}
+
+void JumpPointSearchPlanner::get_successor_dirs(int x, int y, int parent,
+                                                vector<vector<int>>& dirs) const {
+    dirs.clear();
+    if (parent < 0) {
+        for (const vector<double>& m : get_motion()) {
+            dirs.push_back({static_cast<int>(m[0]), static_cast<int>(m[1])});
+        }
+        return;
+    }
+
+    int dx = utils::sign(x - parent % xw) * (x != parent % xw);
+    int dy = utils::sign(y - parent / xw) * (y != parent / xw);
+    if (dx != 0 && dy != 0) {
+        dirs.push_back({dx, dy});
+        dirs.push_back({dx, 0});
+        dirs.push_back({0, dy});
+        if (is_blocked(x - dx, y)) {
+            dirs.push_back({-dx, dy});
+        }
+        if (is_blocked(x, y - dy)) {
+            dirs.push_back({dx, -dy});
+        }
+    } else if (dx != 0) {
+        dirs.push_back({dx, 0});
+        if (is_blocked(x, y + 1)) {
+            dirs.push_back({dx, 1});
+        }
+        if (is_blocked(x, y - 1)) {
+            dirs.push_back({dx, -1});
+        }
+    } else {
+        dirs.push_back({0, dy});
+        if (is_blocked(x + 1, y)) {
+            dirs.push_back({1, dy});
+        }
+        if (is_blocked(x - 1, y)) {
+            dirs.push_back({-1, dy});
+        }
+    }
+}
+
+bool JumpPointSearchPlanner::search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                                    const std::function<void(int, int, size_t)>& on_expand) const {
+    arena.reset(xw * yw);
+    if (is_blocked(sx, sy) || is_blocked(gx, gy)) {
+        return false;
+    }
+
+    int start = calc_cell_index(sx, sy);
+    int goal = calc_cell_index(gx, gy);
+    arena.visit(start, 0.0, -1);
+    arena.open_set.push(start, hypot(sx - gx, sy - gy));
+
+    vector<vector<int>> dirs;
+    while (!arena.open_set.empty()) {
+        int current = arena.open_set.pop();
+        int cx = current % xw;
+        int cy = current / xw;
+        arena.closed[current] = true;
+        if (on_expand) {
+            on_expand(cx, cy, arena.expanded);
+        }
+        ++arena.expanded;
+
+        if (current == goal) {
+            return true;
+        }
+
+        get_successor_dirs(cx, cy, arena.parent[current], dirs);
+        for (const vector<int>& d : dirs) {
+            int n_id = jump(cx, cy, d[0], d[1], gx, gy);
+            if (n_id < 0) {
+                continue;
+            }
+            int nx = n_id % xw;
+            int ny = n_id / xw;
+            // segments between jump points are straight or pure diagonal
+            int steps = std::max(std::abs(nx - cx), std::abs(ny - cy));
+            double ncost = arena.cost[current] + steps * (d[0] != 0 && d[1] != 0 ? sqrt(2) : 1);
+            if (arena.visited(n_id) && (arena.closed[n_id] || arena.cost[n_id] <= ncost)) {
+                continue;
+            }
+            arena.visit(n_id, ncost, current);
+            arena.open_set.push(n_id, ncost + hypot(nx - gx, ny - gy));
+        }
+    }
+
+    return false;
+}
+
+// fill in the cells between consecutive jump points
+vector<vector<double>> JumpPointSearchPlanner::extract_path(const SearchArena& arena, int gx,
+                                                            int gy) const {
+    vector<vector<double>> path = {{calc_grid_position(gx, get_minx())},
+                                   {calc_grid_position(gy, get_miny())}};
+    if (is_blocked(gx, gy) || !arena.is_closed(calc_cell_index(gx, gy))) {
+        return path;
+    }
+
+    int x = gx;
+    int y = gy;
+    for (int index = arena.parent[calc_cell_index(gx, gy)]; index >= 0;
+         index = arena.parent[index]) {
+        int px = index % xw;
+        int py = index / xw;
+        while (x != px || y != py) {
+            x += (px > x) - (px < x);
+            y += (py > y) - (py < y);
+            path[0].emplace_back(calc_grid_position(x, get_minx()));
+            path[1].emplace_back(calc_grid_position(y, get_miny()));
+        }
+    }
+
+    return path;
+}
+
+vector<vector<double>> JumpPointSearchPlanner::planning(double sx, double sy, double gx,
+                                                        double gy) {
+    // the map may also have been replaced by calc_obstacle_map
+    if (bits_version != get_map_version()) {
+        build_blocked_bits();
+    }
+    int six = calc_xyindex(sx, get_minx());
+    int siy = calc_xyindex(sy, get_miny());
+    int gix = calc_xyindex(gx, get_minx());
+    int giy = calc_xyindex(gy, get_miny());
+
+    std::function<void(int, int, size_t)> on_expand = nullptr;
+    if (show_animation) {
+        on_expand = [this](int ix, int iy, size_t nclosed) {
+            plt::plot({calc_grid_position(ix, get_minx())}, {calc_grid_position(iy, get_miny())},
+                      "xc");
+            if (nclosed % 10 == 0) {
+                plt::pause(0.001);
+            }
+        };
+    }
+
+    SearchArena& arena = get_search_arena();
+    if (search(arena, six, siy, gix, giy, on_expand)) {
+        fmt::print("Find goal\n");
+    } else {
+        fmt::print("Open set is empty..\n");
+    }
+    fmt::print("expanded jump points: {}\n", arena.expanded);
+    vector<vector<double>> path = extract_path(arena, gix, giy);
+
+    return path;
+}
+
+int main(int argc, char** argv) {
+    double start_x = 10;
+    double start_y = 10;
+    double goal_x = 50.0;
+    double goal_y = 50.0;
+    double grid_size = 2.0;
+    double robot_radius = 1.0;
+
+    std::vector<double> obstacle_x;
+    std::vector<double> obstacle_y;
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(-10.0);
+    }
+    for (int i = -10; i < 60; ++i) {
+        obstacle_x.emplace_back(60.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(i);
+        obstacle_y.emplace_back(60.0);
+    }
+    for (int i = -10; i < 61; ++i) {
+        obstacle_x.emplace_back(-10.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = -10; i < 40; ++i) {
+        obstacle_x.emplace_back(20.0);
+        obstacle_y.emplace_back(i);
+    }
+    for (int i = 0; i < 40; ++i) {
+        obstacle_x.emplace_back(40.0);
+        obstacle_y.emplace_back(60.0 - i);
+    }
+    if (show_animation) {
+        plt::plot(obstacle_x, obstacle_y, "sk");
+        plt::plot({start_x}, {start_y}, "og");
+        plt::plot({goal_x}, {goal_x}, "xb");
+        plt::grid(true);
+        plt::title("Jump Point Search");
+        plt::axis("equal");
+    }
+
+    JumpPointSearchPlanner jps(obstacle_x, obstacle_y, grid_size, robot_radius);
+    vector<vector<double>> path = jps.planning(start_x, start_y, goal_x, goal_y);
+
+    if (show_animation) {
+        plt::plot(path[0], path[1], "-r");
+        plt::pause(0.01);
+        plt::show();
+    }
+
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include "prm_roadmap.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <utility>
+
+#include "byte_order.hpp"
+
+using std::vector;
+using namespace Eigen;
+
+static constexpr char MAGIC[8] = {'P', 'R', 'M', 'R', 'O', 'A', 'D', '\0'};
+static constexpr uint32_t FORMAT_VERSION = 2;
+
+class RoadmapHeader {
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t vertices;
+    uint32_t edges;
+    uint32_t num_obstacles;
+    uint32_t n_knn;
+    uint32_t reserved;
+    double robot_radius;
+    double max_edge_len;
+};
+
+// host order to the little-endian order of the file and back
+static void convert_header(RoadmapHeader& header) {
+    header.version = utils::little_endian(header.version);
+    header.vertices = utils::little_endian(header.vertices);
+    header.edges = utils::little_endian(header.edges);
+    header.num_obstacles = utils::little_endian(header.num_obstacles);
+    header.n_knn = utils::little_endian(header.n_knn);
+    header.reserved = utils::little_endian(header.reserved);
+    header.robot_radius = utils::little_endian(header.robot_radius);
+    header.max_edge_len = utils::little_endian(header.max_edge_len);
+}
+
+bool Roadmap::is_free(double px, double py) const {
+    for (const vector<double>& obs : obstacles) {
+        if (hypot(obs[0] - px, obs[1] - py) <= obs[2] + robot_radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Roadmap::is_free(Vector2d node1, Vector2d node2) const {
+    if (hypot(node2[0] - node1[0], node2[1] - node1[1]) < 0.01) {
+        return true;
+    }
+
+    for (const vector<double>& obs : obstacles) {
+        double d1 = hypot(node1[0] - obs[0], node1[1] - obs[1]);
+        double d2 = hypot(node2[0] - obs[0], node2[1] - obs[1]);
+
+        if (d1 > d2) {
+            std::swap(d1, d2);
+            std::swap(node1, node2);
+        }
+
+        if (obs[2] >= d1 && obs[2] <= d2) {
+            return false;
+        } else if (obs[2] <= d1) {
+            double d = std::abs((node2[0] - node1[0]) * (node1[1] - obs[1]) -
+                                (node1[0] - obs[0]) * (node2[1] - node1[1])) /
+                       hypot(node2[0] - node1[0], node2[1] - node1[1]);
+            Vector2d v1(obs[0] - node1[0], obs[1] - node1[1]);
+            Vector2d v2(node2[0] - node1[0], node2[1] - node1[1]);
+            if (d <= obs[2] && (v1[0] * v2[0] + v1[1] * v2[1]) >= 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void Roadmap::build(int n, double min_rand, double max_rand, unsigned int seed, int _n_knn,
+                    double _max_edge_len, bool lazy) {
+    n_knn = _n_knn;
+    max_edge_len = _max_edge_len;
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> dist_xy(min_rand, max_rand);
+    x.clear();
+    y.clear();
+    while (static_cast<int>(x.size()) < n) {
+        double px = dist_xy(engine);
+        double py = dist_xy(engine);
+        if (is_free(px, py)) {
+            x.push_back(px);
+            y.push_back(py);
+        }
+    }
+    tree.build(vector<vector<double>>{x, y});
+
+    // every undirected edge once as (low, high)
+    vector<std::pair<int, int>> edges;
+    edges.reserve(static_cast<size_t>(n) * n_knn);
+    knn_index.resize(n_knn + 1);
+    knn_dist2.resize(n_knn + 1);
+    for (int i = 0; i < n; ++i) {
+        size_t found = tree.knn({x[i], y[i]}, n_knn + 1, knn_index.data(), knn_dist2.data());
+        for (size_t k = 0; k < found; ++k) {
+            int j = knn_index[k];
+            if (j == i || knn_dist2[k] > max_edge_len * max_edge_len) {
+                continue;
+            }
+            if (lazy || is_free({x[i], y[i]}, {x[j], y[j]})) {
+                edges.emplace_back(std::min(i, j), std::max(i, j));
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    offsets.assign(n + 1, 0);
+    for (const std::pair<int, int>& e : edges) {
+        ++offsets[e.first + 1];
+        ++offsets[e.second + 1];
+    }
+    for (int v = 0; v < n; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    targets.resize(2 * edges.size());
+    weights.resize(2 * edges.size());
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (const std::pair<int, int>& e : edges) {
+        double w = hypot(x[e.first] - x[e.second], y[e.first] - y[e.second]);
+        targets[fill[e.first]] = e.second;
+        weights[fill[e.first]++] = w;
+        targets[fill[e.second]] = e.first;
+        weights[fill[e.second]++] = w;
+    }
+    edge_state.assign(targets.size(), lazy ? UNCHECKED : FREE);
+    init_query_state();
+}
+
+void Roadmap::init_query_state(void) {
+    size_t n = x.size();
+    // vertex n is the start, n + 1 the goal
+    g.assign(n + 2, 0.0);
+    parent.assign(n + 2, -1);
+    parent_edge.assign(n + 2, -1);
+    stamp.assign(n + 2, 0);
+    goal_link.assign(n, 0.0);
+    goal_stamp.assign(n, 0);
+    query_id = 0;
+    search_id = 0;
+    open_set = IndexedHeap<>(n + 2);
+    knn_index.resize(n_knn);
+    knn_dist2.resize(n_knn);
+}
+
+// fn(vertex, length) for the n_knn nearest vertices of (px, py) with a free edge to it
+template <typename Fn>
+void Roadmap::link_point(double px, double py, Fn fn) {
+    size_t found = tree.knn({px, py}, n_knn, knn_index.data(), knn_dist2.data());
+    for (size_t k = 0; k < found; ++k) {
+        int v = knn_index[k];
+        if (knn_dist2[k] <= max_edge_len * max_edge_len && is_free({px, py}, {x[v], y[v]})) {
+            fn(v, sqrt(knn_dist2[k]));
+        }
+    }
+}
+
+vector<vector<double>> Roadmap::query(const Vector2d& start, const Vector2d& goal,
+                                      bool use_heuristic) {
+    vector<vector<double>> path(2);
+    expanded = 0;
+    checked = 0;
+    if (x.empty()) {
+        return path;
+    }
+    int n = x.size();
+    int s_id = n;
+    int g_id = n + 1;
+    if (++query_id == 0) {
+        std::fill(goal_stamp.begin(), goal_stamp.end(), 0);
+        query_id = 1;
+    }
+    link_point(goal[0], goal[1], [&](int v, double length) {
+        goal_link[v] = length;
+        goal_stamp[v] = query_id;
+    });
+    start_link.clear();
+    link_point(start[0], start[1],
+               [&](int v, double length) { start_link.emplace_back(v, length); });
+    direct_link = hypot(goal[0] - start[0], goal[1] - start[1]);
+    if (direct_link > max_edge_len || !is_free(start, goal)) {
+        direct_link = -1.0;
+    }
+
+    // every round blocks at least one more edge, a path with no unchecked edge is final
+    bool found = search(start, goal, use_heuristic);
+    while (found && !check_path()) {
+        found = search(start, goal, use_heuristic);
+    }
+    if (!found) {
+        return path;
+    }
+
+    for (int v = g_id; v >= 0; v = parent[v]) {
+        path[0].push_back(v == g_id ? goal[0] : v == s_id ? start[0] : x[v]);
+        path[1].push_back(v == g_id ? goal[1] : v == s_id ? start[1] : y[v]);
+    }
+    std::reverse(path[0].begin(), path[0].end());
+    std::reverse(path[1].begin(), path[1].end());
+
+    return path;
+}
+
+// A* over the edges that are not known to be blocked, true if the goal is reached
+bool Roadmap::search(const Vector2d& start, const Vector2d& goal, bool use_heuristic) {
+    int n = x.size();
+    int s_id = n;
+    int g_id = n + 1;
+    if (++search_id == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        search_id = 1;
+    }
+
+    auto heuristic = [&](int v) {
+        if (!use_heuristic || v == g_id) {
+            return 0.0;
+        }
+        double vx = v == s_id ? start[0] : x[v];
+        double vy = v == s_id ? start[1] : y[v];
+        return hypot(goal[0] - vx, goal[1] - vy);
+    };
+    auto relax = [&](int u, int v, double length, int e) {
+        double cost = g[u] + length;
+        if (stamp[v] != search_id || cost < g[v]) {
+            stamp[v] = search_id;
+            g[v] = cost;
+            parent[v] = u;
+            parent_edge[v] = e;
+            open_set.push(v, cost + heuristic(v));
+        }
+    };
+
+    open_set.clear();
+    stamp[s_id] = search_id;
+    g[s_id] = 0.0;
+    parent[s_id] = -1;
+    open_set.push(s_id, heuristic(s_id));
+    bool found = false;
+
+    while (!open_set.empty()) {
+        int u = open_set.pop();
+        ++expanded;
+        if (u == g_id) {
+            found = true;
+            break;
+        }
+        if (u == s_id) {
+            for (const std::pair<int, double>& link : start_link) {
+                relax(u, link.first, link.second, -1);
+            }
+            if (direct_link >= 0.0) {
+                relax(u, g_id, direct_link, -1);
+            }
+            continue;
+        }
+        for (int e = offsets[u]; e < offsets[u + 1]; ++e) {
+            if (edge_state[e] != BLOCKED) {
+                relax(u, targets[e], weights[e], e);
+            }
+        }
+        if (goal_stamp[u] == query_id) {
+            relax(u, g_id, goal_link[u], -1);
+        }
+    }
+    open_set.clear();
+
+    return found;
+}
+
+// checks the unchecked roadmap edges of the path found by search, true if all are free
+bool Roadmap::check_path(void) {
+    bool all_free = true;
+    for (int v = x.size() + 1; parent[v] >= 0; v = parent[v]) {
+        int e = parent_edge[v];
+        if (e < 0 || edge_state[e] != UNCHECKED) {
+            continue;
+        }
+        int u = parent[v];
+        uint8_t state = is_free({x[u], y[u]}, {x[v], y[v]}) ? FREE : BLOCKED;
+        ++checked;
+        edge_state[e] = state;
+        for (int r = offsets[v]; r < offsets[v + 1]; ++r) {
+            if (targets[r] == u) {
+                edge_state[r] = state;
+                break;
+            }
+        }
+        all_free = all_free && state == FREE;
+    }
+
+    return all_free;
+}
+
+bool Roadmap::save(const std::string& file) const {
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (fp == nullptr) {
+        fmt::print("Roadmap: cannot open {} for writing\n", file);
+        return false;
+    }
+
+    RoadmapHeader header;
+    memcpy(header.magic, MAGIC, 8);
+    header.version = FORMAT_VERSION;
+    header.vertices = x.size();
+    header.edges = targets.size();
+    header.num_obstacles = obstacles.size();
+    header.n_knn = n_knn;
+    header.reserved = 0;
+    header.robot_radius = robot_radius;
+    header.max_edge_len = max_edge_len;
+    vector<double> obs_data;
+    for (const vector<double>& obs : obstacles) {
+        obs_data.insert(obs_data.end(), {obs[0], obs[1], obs[2]});
+    }
+
+    convert_header(header);
+
+    size_t nv = x.size();
+    size_t ne = targets.size();
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              utils::write_little_endian(fp, obs_data.data(), obs_data.size()) &&
+              utils::write_little_endian(fp, x.data(), nv) &&
+              utils::write_little_endian(fp, y.data(), nv) &&
+              utils::write_little_endian(fp, offsets.data(), nv + 1) &&
+              utils::write_little_endian(fp, targets.data(), ne) &&
+              utils::write_little_endian(fp, weights.data(), ne) &&
+              fwrite(edge_state.data(), sizeof(uint8_t), ne, fp) == ne;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        fmt::print("Roadmap: failed to write {}\n", file);
+    }
+
+    return ok;
+}
+
+bool Roadmap::load(const std::string& file) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (fp == nullptr) {
+        fmt::print("Roadmap: cannot open {}\n", file);
+        return false;
+    }
+
+    // the counts of the header are checked against the obstacles and the size of the file
+    // before anything is allocated for them
+    long file_size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        file_size = ftell(fp);
+    }
+    RoadmapHeader header;
+    bool ok = file_size >= 0 && fseek(fp, 0, SEEK_SET) == 0 &&
+              fread(&header, sizeof(header), 1, fp) == 1;
+    convert_header(header);
+    ok = ok && memcmp(header.magic, MAGIC, 8) == 0 && header.version >= 1 &&
+         header.version <= FORMAT_VERSION;
+    // a roadmap is only valid for the obstacles it was built among
+    ok = ok && header.num_obstacles == obstacles.size() && header.robot_radius == robot_radius;
+    vector<double> obs_data;
+    if (ok) {
+        obs_data.resize(3 * header.num_obstacles);
+        ok = utils::read_little_endian(fp, obs_data.data(), obs_data.size());
+    }
+    for (size_t idx = 0; ok && idx < obstacles.size(); ++idx) {
+        ok = obstacles[idx][0] == obs_data[3 * idx] && obstacles[idx][1] == obs_data[3 * idx + 1] &&
+             obstacles[idx][2] == obs_data[3 * idx + 2];
+    }
+    if (!ok) {
+        fclose(fp);
+        fmt::print("Roadmap: {} is not a roadmap of these obstacles\n", file);
+        return false;
+    }
+
+    size_t nv = header.vertices;
+    size_t ne = header.edges;
+    // x, y, offsets, then targets, weights and the edge states
+    size_t vertex_bytes = 2 * sizeof(double) + sizeof(int);
+    size_t edge_bytes = sizeof(int) + sizeof(double) + (header.version >= 2 ? sizeof(uint8_t) : 0);
+    long pos = ftell(fp);
+    size_t remaining = pos >= 0 && pos <= file_size ? file_size - pos : 0;
+    if (nv > remaining / vertex_bytes || ne > remaining / edge_bytes ||
+        nv * vertex_bytes + sizeof(int) + ne * edge_bytes > remaining) {
+        fclose(fp);
+        fmt::print("Roadmap: {} is truncated or corrupt\n", file);
+        return false;
+    }
+    vector<double> _x(nv), _y(nv), _weights(ne);
+    vector<int> _offsets(nv + 1), _targets(ne);
+    vector<uint8_t> _edge_state(ne, FREE);
+    ok = utils::read_little_endian(fp, _x.data(), nv) &&
+         utils::read_little_endian(fp, _y.data(), nv) &&
+         utils::read_little_endian(fp, _offsets.data(), nv + 1) &&
+         utils::read_little_endian(fp, _targets.data(), ne) &&
+         utils::read_little_endian(fp, _weights.data(), ne);
+    if (ok && header.version >= 2) {
+        ok = fread(_edge_state.data(), sizeof(uint8_t), ne, fp) == ne;
+    }
+    fclose(fp);
+    ok = ok && _offsets.front() == 0 && _offsets.back() == static_cast<int>(ne);
+    for (size_t v = 0; ok && v < nv; ++v) {
+        ok = _offsets[v] <= _offsets[v + 1];
+    }
+    for (size_t e = 0; ok && e < ne; ++e) {
+        ok = _targets[e] >= 0 && _targets[e] < static_cast<int>(nv) &&
+             _edge_state[e] <= BLOCKED;
+    }
+    if (!ok) {
+        fmt::print("Roadmap: {} is truncated or corrupt\n", file);
+        return false;
+    }
+
+    n_knn = header.n_knn;
+    max_edge_len = header.max_edge_len;
+    x = std::move(_x);
+    y = std::move(_y);
+    offsets = std::move(_offsets);
+    targets = std::move(_targets);
+    weights = std::move(_weights);
+    edge_state = std::move(_edge_state);
+    tree.build(vector<vector<double>>{x, y});
+    init_query_state();
+
+    return true;
+}
@@ -4,59 +4,43 @@
 #include <cmath>
 #include <random>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "matplotlibcpp.h"
+#include "prm_roadmap.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::string;
 using std::vector;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
-
-class Node {
-public:
-    double x;
-    double y;
-    double cost;
-    int parent_index;
-
-    Node() {}
-    Node(double _x, double _y, double _cost = 0., int parent = -1)
-        : x(_x), y(_y), cost(_cost), parent_index(parent) {}
-    ~Node() {}
-};
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class PRM {
 private:
     Vector2d start;
     Vector2d goal;
-    double robot_radius;
     double min_rand;
     double max_rand;
     int sample_num;
     vector<vector<double>> obstacle_list;
-    vector<vector<double>> boundary;
     std::mt19937 engine;
 
-    bool check_collision(Vector2d node);
-    bool check_collision(Vector2d node1, Vector2d node2);
-    vector<vector<double>> calc_final_path(const vector<vector<double>>& vertex,
-                                           const vector<vector<double>>& edge);
-    void plot_road_map(const vector<vector<double>>& vertex, const vector<vector<double>>& edge);
+    void plot_road_map(void);
     void plot_circle(double x, double y, double size, bool is_fill = false, string style = "-b");
 
 public:
+    Roadmap roadmap;
+
     PRM(Vector2d _start, Vector2d _goal, vector<vector<double>> obs, Vector2d rand_area,
-        double _robot_radius = 1., int _sample_num = 160) {
+        double _robot_radius = 1., int _sample_num = 160)
+        : roadmap(obs, _robot_radius) {
         start = _start;
         goal = _goal;
         obstacle_list = obs;
         min_rand = rand_area[0];
         max_rand = rand_area[1];
-        robot_radius = _robot_radius;
         sample_num = _sample_num;
         std::random_device seed;
         engine.seed(seed());
@@ -67,8 +51,6 @@ public:
 };
 
 vector<vector<double>> PRM::planning(void) {
-    vector<vector<double>> vertex = {{start[0], goal[0]}, {start[1], goal[1]}};
-
     if (show_animation) {
         plt::plot({start[0]}, {start[1]}, "xr");
         plt::plot({goal[0]}, {goal[1]}, "xr");
@@ -77,153 +59,29 @@ vector<vector<double>> PRM::planning(void) {
         }
     }
 
-    while (vertex[0].size() < sample_num + 2) {
-        std::uniform_real_distribution<double> dist_xy(min_rand, max_rand);
-        Vector2d rnd(dist_xy(engine), dist_xy(engine));
-        if (check_collision(rnd)) {
-            vertex[0].push_back(rnd[0]);
-            vertex[1].push_back(rnd[1]);
-        }
-        if (show_animation && vertex[0].size() % 10 == 0) {
-            plt::plot(vertex[0], vertex[1], ".b");
-            plt::pause(0.02);
-        }
-    }
-
-    vector<vector<double>> edge(sample_num + 2, vector<double>(sample_num + 2, -1.));
-    for (size_t i = 0; i < sample_num + 2; ++i) {
-        for (size_t j = 0; j < sample_num + 2; ++j) {
-            double node_distance = hypot(vertex[0][i] - vertex[0][j], vertex[1][i] - vertex[1][j]);
-            if (node_distance < 3 &&
-                check_collision({vertex[0][i], vertex[1][i]}, {vertex[0][j], vertex[1][j]})) {
-                edge[i][j] = node_distance;
-            }
-        }
-    }
-
+    // edges up to 3 m to the 10 nearest vertices
+    roadmap.build(sample_num, min_rand, max_rand, engine(), 10, 3.0);
     if (show_animation) {
-        plot_road_map(vertex, edge);
+        plot_road_map();
     }
 
-    vector<vector<double>> path = calc_final_path(vertex, edge);
-
-    return path;
-}
-
-// Use dijkstra to implement single source shortest path search
-vector<vector<double>> PRM::calc_final_path(const vector<vector<double>>& vertex,
-                                            const vector<vector<double>>& edge) {
-    bool path_found = true;
-    vector<vector<double>> path(2);
-    Node start_node(vertex[0][0], vertex[1][0], 1000, -1);
-    std::unordered_map<int, Node> open_set;
-    std::unordered_map<int, Node> closed_set;
-    open_set[0] = start_node;
-
-    while (true) {
-        if (open_set.size() == 0) {
-            fmt::print("Cannot find path..\n");
-            path_found = false;
-            break;
-        }
-
-        int c_id = -1;
-        for (const auto& n : open_set) {
-            if (c_id == -1 || open_set[c_id].cost > n.second.cost) {
-                c_id = n.first;
-            }
-        }
-        Node current = open_set[c_id];
-        open_set.erase(c_id);
-        closed_set[c_id] = current;
-
-        if (c_id == 1) {
-            break;
-        }
-
-        for (int idx = 0; idx < edge.size(); ++idx) {
-            if (edge[c_id][idx] > 0 && idx != c_id) {
-                Node node(vertex[0][idx], vertex[1][idx], current.cost + edge[c_id][idx], c_id);
-                if (closed_set.find(idx) != closed_set.end()) {
-                    continue;
-                }
-                if (open_set.find(idx) != open_set.end()) {
-                    if (open_set[idx].cost > node.cost) {
-                        open_set[idx].cost = node.cost;
-                        open_set[idx].parent_index = c_id;
-                    }
-                } else {
-                    open_set[idx] = node;
-                }
-            }
-        }
-    }
-
-    if (!path_found) {
-        return path;
-    }
-
-    int parent_index = 1;
-    while (parent_index != -1) {
-        Node n = closed_set[parent_index];
-        path[0].push_back(n.x);
-        path[1].push_back(n.y);
-        parent_index = n.parent_index;
+    vector<vector<double>> path = roadmap.query(start, goal);
+    if (path[0].empty()) {
+        fmt::print("Cannot find path..\n");
     }
 
     return path;
 }
 
-bool PRM::check_collision(Vector2d node) {
-    for (vector<double> obs : obstacle_list) {
-        double dx = obs[0] - node[0];
-        double dy = obs[1] - node[1];
-        double d = hypot(dx, dy);
-
-        if (d <= obs[2] + robot_radius) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-bool PRM::check_collision(Vector2d node1, Vector2d node2) {
-    if (hypot(node2[0] - node1[0], node2[1] - node1[1]) < 0.01) {
-        return true;
-    }
-
-    for (vector<double> obs : obstacle_list) {
-        double d1 = hypot(node1[0] - obs[0], node1[1] - obs[1]);
-        double d2 = hypot(node2[0] - obs[0], node2[1] - obs[1]);
-
-        if (d1 > d2) {
-            std::swap(d1, d2);
-            std::swap(node1, node2);
-        }
-
-        if (obs[2] >= d1 && obs[2] <= d2) {
-            return false;
-        } else if (obs[2] <= d1) {
-            double d = abs((node2[0] - node1[0]) * (node1[1] - obs[1]) -
-                           (node1[0] - obs[0]) * (node2[1] - node1[1])) /
-                       hypot(node2[0] - node1[0], node2[1] - node1[1]);
-            Vector2d v1(obs[0] - node1[0], obs[1] - node1[1]);
-            Vector2d v2(node2[0] - node1[0], node2[1] - node1[1]);
-            if (d <= obs[2] && (v1[0] * v2[0] + v1[1] * v2[1]) >= 0) {
-                return false;
-            }
-        }
-    }
-
-    return true;
-}
-
-void PRM::plot_road_map(const vector<vector<double>>& vertex, const vector<vector<double>>& edge) {
-    for (size_t i = 0; i < edge.size(); ++i) {
-        for (size_t j = i + 1; j < edge.size(); ++j) {
-            if (edge[i][j] > 0) {
-                plt::plot({vertex[0][i], vertex[0][j]}, {vertex[1][i], vertex[1][j]}, "-g");
+void PRM::plot_road_map(void) {
+    const vector<double>& x = roadmap.get_x();
+    const vector<double>& y = roadmap.get_y();
+    const vector<int>& offsets = roadmap.get_offsets();
+    const vector<int>& targets = roadmap.get_targets();
+    for (size_t i = 0; i < roadmap.size(); ++i) {
+        for (int e = offsets[i]; e < offsets[i + 1]; ++e) {
+            if (targets[e] > static_cast<int>(i)) {
+                plt::plot({x[i], x[targets[e]]}, {y[i], y[targets[e]]}, "-g");
             }
         }
         if (i % 5 == 0) {
@@ -233,7 +91,7 @@ void PRM::plot_road_map(const vector<vector<double>>& vertex, const vector<vecto
     // Avoid edge lines covering vertex
     plt::plot({start[0]}, {start[1]}, "xr");
     plt::plot({goal[0]}, {goal[1]}, "xr");
-    plt::plot(vertex[0], vertex[1], ".b");
+    plt::plot(x, y, ".b");
 }
 
 void PRM::plot_circle(double x, double y, double size, bool is_fill, string style) {
@@ -278,6 +136,30 @@ int main(int argc, char** argv) {
 
     PRM prm(start, goal, obstacle_list, area);
     vector<vector<double>> path = prm.planning();
+    fmt::print("roadmap: {} vertices, {} edges, {:.3f} ms\n", prm.roadmap.size(),
+               prm.roadmap.num_edges(), t_m.toc());
+
+    // a saved roadmap answers later queries without sampling again
+    const string file = utils::cache_file("prm_roadmap.bin");
+    Roadmap roadmap(obstacle_list, 1.0);
+    if (prm.roadmap.save(file) && roadmap.load(file)) {
+        constexpr int queries = 1000;
+        utils::TicToc t_q;
+        for (int i = 0; i < queries; ++i) {
+            roadmap.query(start, goal);
+        }
+        fmt::print("{} queries: {:.3f} us each, {} vertices expanded\n", queries,
+                   t_q.toc() * 1000.0 / queries, roadmap.get_expanded());
+    }
+
+    // lazy: no edge is checked until a query path runs over it
+    Roadmap lazy_roadmap(obstacle_list, 1.0);
+    utils::TicToc t_l;
+    lazy_roadmap.build(10000, area[0], area[1], 0, 10, 3.0, true);
+    double build_time = t_l.toc();
+    lazy_roadmap.query(start, goal);
+    fmt::print("lazy roadmap: {:.3f} ms build, {} of {} edges checked by the first query\n",
+               build_time, lazy_roadmap.get_checked(), lazy_roadmap.num_edges());
     if (show_animation) {
         plt::plot(path[0], path[1], "-r");
         plt::show();
@@ -1,62 +1,80 @@
 #include <fmt/core.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <random>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "matplotlibcpp.h"
+#include "point_grid.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::string;
 using std::vector;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 class Node {
 public:
     double x;
     double y;
-    Node* parent;
+    int parent;   // index in the node list, -1 for the root
+    double cost;  // path length from the root, only kept up to date by RRT*
 
-    Node() : x(0), y(0), parent(nullptr) {}
-    Node(double _x, double _y, Node* p = nullptr) : x(_x), y(_y), parent(p) {}
+    Node() : x(0), y(0), parent(-1), cost(0) {}
+    Node(double _x, double _y, int p = -1, double c = 0.0) : x(_x), y(_y), parent(p), cost(c) {}
     ~Node() {}
 };
 
+// the tree is a contiguous node list with parent indices, the nodes are also kept in a uniform
+// grid of expand_dis cells so nearest and near node queries only look at a few cells
 class RRT {
-private:
-    Node* start;
-    Node* goal;
+protected:
+    Node start;
+    Node goal;
     double min_rand;
     double max_rand;
     double expand_dis;
     double goal_sample_rate;
     int max_iter;
     double robot_radius;
-    vector<Node*> node_list;
+    vector<Node> node_list;
+    utils::PointGrid node_index;
     vector<vector<double>> obstacle_list;
     vector<vector<double>> boundary;
     std::mt19937 engine;
+    const std::atomic<bool>* cancel = nullptr;
+    // the tree is drawn, or recorded with VIZ_BACKEND=record, every few iterations
+    bool animate = show_animation || utils::viz::RECORD;
 
+    bool is_cancelled(void) const {
+        return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+    }
     Node get_random_node(void);
-    Node* get_nearest_node(Node rnd_node);
-    Node* steer(Node* from_node, Node* to_node);
-    Vector2d calc_distance_and_angle(Node* from_node, Node* to_node);
-    bool check_collision(Node* new_node);
+    int get_nearest_node(const Node& rnd_node) const;
+    Node steer(int from_index, const Node& to_node, double extend_length);
+    Vector2d calc_distance_and_angle(const Node& from_node, const Node& to_node) const;
+    bool check_collision(const Node& new_node) const;
+    bool check_collision(const Node& from_node, const Node& to_node) const;
+    int add_node(const Node& node);
+    void init_tree(void);
     void plot_circle(double x, double y, double size, bool is_fill = false, string style = "-b");
-    void draw_graph(Node rnd);
+    void draw_graph(const Node& rnd);
     vector<vector<double>> generate_final_course(void);
 
 public:
     RRT(Vector2d _start, Vector2d _goal, vector<vector<double>> obs, Vector2d rand_area,
         double expand = 0.5, double goal_sample = 0.5, int _max_iter = 1000,
         double _robot_radius = 0.5) {
-        start = new Node(_start[0], _start[1]);
-        goal = new Node(_goal[0], _goal[1]);
+        start = Node(_start[0], _start[1]);
+        goal = Node(_goal[0], _goal[1]);
         min_rand = rand_area[0];
         max_rand = rand_area[1];
         expand_dis = expand;
@@ -67,19 +85,21 @@ public:
         std::random_device seed;
         engine.seed(seed());
     }
-    ~RRT();
+    ~RRT() {}
 
     vector<vector<double>> planning(void);
-};
 
-RRT::~RRT() {
-    for (Node* n : node_list) {
-        delete n;
-    }
-}
+    // the random stream of the planner, the same seed gives the same tree
+    void set_seed(unsigned int seed) { engine.seed(seed); }
 
-vector<vector<double>> RRT::planning(void) {
-    boundary.resize(2);
+    // planning gives up, returning no path, once flag is set
+    void set_cancel(const std::atomic<bool>* flag) { cancel = flag; }
+
+    void set_animation(bool on) { animate = on; }
+};
+
+void RRT::init_tree(void) {
+    boundary.assign(2, {});
     for (double i = min_rand - 1; i < (max_rand + 1); i += 0.2) {
         boundary[0].push_back(i);
         boundary[0].push_back(max_rand + 1);
@@ -91,26 +111,45 @@ vector<vector<double>> RRT::planning(void) {
         boundary[1].push_back(i);
     }
 
-    node_list.push_back(start);
+    // the tree stays inside the box of the samples, the start and the goal
+    double minxy = std::min({min_rand, start.x, start.y, goal.x, goal.y});
+    double maxxy = std::max({max_rand, start.x, start.y, goal.x, goal.y});
+    node_index = utils::PointGrid(minxy, minxy, maxxy, maxxy, expand_dis);
+    node_index.reserve(max_iter + 1);
+    node_list.clear();
+    node_list.reserve(max_iter + 1);
+    goal.parent = -1;
+    start.parent = -1;
+    start.cost = 0.0;
+    add_node(start);
+}
+
+int RRT::add_node(const Node& node) {
+    node_list.push_back(node);
+    node_index.insert(node.x, node.y);
 
-    for (int iter = 0; iter < max_iter; ++iter) {
+    return node_list.size() - 1;
+}
+
+vector<vector<double>> RRT::planning(void) {
+    init_tree();
+
+    for (int iter = 0; iter < max_iter && !is_cancelled(); ++iter) {
         Node rnd_node = get_random_node();
-        Node* nearest_node = get_nearest_node(rnd_node);
-        Node* new_node = steer(nearest_node, &rnd_node);
+        int nearest_index = get_nearest_node(rnd_node);
+        Node new_node = steer(nearest_index, rnd_node, expand_dis);
 
         if (check_collision(new_node)) {
-            node_list.emplace_back(new_node);
-        } else {
-            delete new_node;
+            add_node(new_node);
         }
 
-        if (show_animation && (iter % 5 == 0)) {
+        if (animate && (iter % 5 == 0)) {
             draw_graph(rnd_node);
         }
 
         Vector2d d_angle = calc_distance_and_angle(node_list.back(), goal);
         if (d_angle[0] <= expand_dis) {
-            goal->parent = node_list.back();
+            goal.parent = node_list.size() - 1;
             break;
         }
     }
@@ -125,41 +164,30 @@ Node RRT::get_random_node(void) {
         std::uniform_real_distribution<double> dist_xy(min_rand, max_rand);
         rnd = Node(dist_xy(engine), dist_xy(engine));
     } else {
-        rnd = Node(goal->x, goal->y);
+        rnd = Node(goal.x, goal.y);
     }
 
     return rnd;
 }
 
-Node* RRT::get_nearest_node(Node rnd_node) {
-    Node* min_node = new Node(node_list[0]->x, node_list[0]->y);
-    double distance = hypot(min_node->x - rnd_node.x, min_node->y - rnd_node.y);
-    for (int idx = 1; idx < node_list.size(); ++idx) {
-        double tmp = hypot(node_list[idx]->x - rnd_node.x, node_list[idx]->y - rnd_node.y);
-        if (tmp < distance) {
-            min_node = node_list[idx];
-            distance = tmp;
-        }
-    }
-
-    return min_node;
+int RRT::get_nearest_node(const Node& rnd_node) const {
+    return node_index.nearest(rnd_node.x, rnd_node.y);
 }
 
-Node* RRT::steer(Node* from_node, Node* to_node) {
-    Node new_node(from_node->x, from_node->x);
+// at most extend_length from node from_index towards to_node, from_index is the parent
+Node RRT::steer(int from_index, const Node& to_node, double extend_length) {
+    const Node& from_node = node_list[from_index];
     Vector2d d_angle = calc_distance_and_angle(from_node, to_node);
-    double dist = std::min(expand_dis, d_angle[0]);
-    Node* node_new =
-        new Node(from_node->x + dist * cos(d_angle[1]), from_node->y + dist * sin(d_angle[1]));
-    node_new->parent = from_node;
+    double dist = std::min(extend_length, d_angle[0]);
 
-    return node_new;
+    return Node(from_node.x + dist * cos(d_angle[1]), from_node.y + dist * sin(d_angle[1]),
+                from_index, from_node.cost + dist);
 }
 
-Vector2d RRT::calc_distance_and_angle(Node* from_node, Node* to_node) {
+Vector2d RRT::calc_distance_and_angle(const Node& from_node, const Node& to_node) const {
     Vector2d d_angle;
-    double dx = to_node->x - from_node->x;
-    double dy = to_node->y - from_node->y;
+    double dx = to_node.x - from_node.x;
+    double dy = to_node.y - from_node.y;
     double d = hypot(dx, dy);
     double angle = atan2(dy, dx);
     d_angle << d, angle;
@@ -167,15 +195,30 @@ Vector2d RRT::calc_distance_and_angle(Node* from_node, Node* to_node) {
     return d_angle;
 }
 
-bool RRT::check_collision(Node* new_node) {
-    if (new_node == nullptr) {
-        return true;
+bool RRT::check_collision(const Node& new_node) const {
+    for (const vector<double>& obs : obstacle_list) {
+        double dx = obs[0] - new_node.x;
+        double dy = obs[1] - new_node.y;
+        double d = hypot(dx, dy);
+
+        if (d <= (obs[2] + robot_radius)) {
+            return false;
+        }
     }
 
-    for (vector<double> obs : obstacle_list) {
-        double dx = obs[0] - new_node->x;
-        double dy = obs[1] - new_node->y;
-        double d = hypot(dx, dy);
+    return true;
+}
+
+// the whole segment from from_node to to_node, true if it is collision free
+bool RRT::check_collision(const Node& from_node, const Node& to_node) const {
+    double vx = to_node.x - from_node.x;
+    double vy = to_node.y - from_node.y;
+    double len2 = vx * vx + vy * vy;
+    for (const vector<double>& obs : obstacle_list) {
+        double t = len2 > 0.0 ? ((obs[0] - from_node.x) * vx + (obs[1] - from_node.y) * vy) / len2
+                              : 0.0;
+        t = std::clamp(t, 0.0, 1.0);
+        double d = hypot(from_node.x + t * vx - obs[0], from_node.y + t * vy - obs[1]);
 
         if (d <= (obs[2] + robot_radius)) {
             return false;
@@ -185,6 +228,162 @@ bool RRT::check_collision(Node* new_node) {
     return true;
 }
 
+// RRT* (Karaman and Frazzoli): a new node takes the cheapest collision free parent within the
+// connect radius, then becomes the parent of the near nodes it shortens. the near nodes come
+// from the same grid as the nearest node, the cost change of a rewired node is pushed down its
+// subtree through child lists.
+class RRTStar : public RRT {
+public:
+    RRTStar(Vector2d _start, Vector2d _goal, vector<vector<double>> obs, Vector2d rand_area,
+            double expand = 1.0, double goal_sample = 0.2, int _max_iter = 1000,
+            double _connect_circle_dist = 50.0, bool _search_until_max_iter = false,
+            double _robot_radius = 0.8)
+        : RRT(_start, _goal, obs, rand_area, expand, goal_sample, _max_iter, _robot_radius),
+          connect_circle_dist(_connect_circle_dist),
+          search_until_max_iter(_search_until_max_iter) {}
+    ~RRTStar() {}
+
+    vector<vector<double>> planning(void);
+
+private:
+    double connect_circle_dist;
+    bool search_until_max_iter;
+    vector<int> first_child;
+    vector<int> next_sibling;
+    vector<int> near_inds;
+    vector<int> stack;
+
+    void find_near_nodes(const Node& new_node);
+    void choose_parent(Node& new_node);
+    void rewire(int new_index);
+    void link(int index);
+    void unlink(int index);
+    void propagate_cost_to_leaves(int index, double delta);
+    int search_best_goal_node(void);
+};
+
+vector<vector<double>> RRTStar::planning(void) {
+    init_tree();
+    first_child.assign(1, -1);
+    next_sibling.assign(1, -1);
+
+    for (int iter = 0; iter < max_iter && !is_cancelled(); ++iter) {
+        Node rnd_node = get_random_node();
+        int nearest_index = get_nearest_node(rnd_node);
+        Node new_node = steer(nearest_index, rnd_node, expand_dis);
+
+        // a sample on top of its nearest node, e.g. the goal once it is reached, adds nothing
+        bool is_new = new_node.cost > node_list[nearest_index].cost;
+        if (is_new && check_collision(node_list[nearest_index], new_node)) {
+            find_near_nodes(new_node);
+            choose_parent(new_node);
+            int new_index = add_node(new_node);
+            first_child.push_back(-1);
+            next_sibling.push_back(-1);
+            link(new_index);
+            rewire(new_index);
+        }
+
+        if (animate && (iter % 25 == 0)) {
+            draw_graph(rnd_node);
+        }
+
+        if (!search_until_max_iter) {
+            int last_index = search_best_goal_node();
+            if (last_index >= 0) {
+                goal.parent = last_index;
+                return generate_final_course();
+            }
+        }
+    }
+
+    goal.parent = is_cancelled() ? -1 : search_best_goal_node();
+
+    return generate_final_course();
+}
+
+// the connect radius shrinks with the tree size, but never beyond expand_dis
+void RRTStar::find_near_nodes(const Node& new_node) {
+    double nnode = node_list.size() + 1;
+    double r = std::min(connect_circle_dist * sqrt(log(nnode) / nnode), expand_dis);
+    near_inds.clear();
+    node_index.radius(new_node.x, new_node.y, r,
+                      [this](int index, double) { near_inds.push_back(index); });
+}
+
+// new_node comes with the nearest node as parent, that edge is already known to be free
+void RRTStar::choose_parent(Node& new_node) {
+    for (int index : near_inds) {
+        const Node& near_node = node_list[index];
+        double cost = near_node.cost + hypot(new_node.x - near_node.x, new_node.y - near_node.y);
+        if (cost < new_node.cost && check_collision(near_node, new_node)) {
+            new_node.cost = cost;
+            new_node.parent = index;
+        }
+    }
+}
+
+void RRTStar::rewire(int new_index) {
+    const Node new_node = node_list[new_index];
+    for (int index : near_inds) {
+        Node& near_node = node_list[index];
+        double cost = new_node.cost + hypot(near_node.x - new_node.x, near_node.y - new_node.y);
+        if (cost < near_node.cost && check_collision(new_node, near_node)) {
+            double delta = cost - near_node.cost;
+            unlink(index);
+            near_node.parent = new_index;
+            near_node.cost = cost;
+            link(index);
+            propagate_cost_to_leaves(index, delta);
+        }
+    }
+}
+
+void RRTStar::link(int index) {
+    int parent = node_list[index].parent;
+    next_sibling[index] = first_child[parent];
+    first_child[parent] = index;
+}
+
+void RRTStar::unlink(int index) {
+    int parent = node_list[index].parent;
+    int* slot = &first_child[parent];
+    while (*slot != index) {
+        slot = &next_sibling[*slot];
+    }
+    *slot = next_sibling[index];
+}
+
+void RRTStar::propagate_cost_to_leaves(int index, double delta) {
+    stack.clear();
+    for (int child = first_child[index]; child >= 0; child = next_sibling[child]) {
+        stack.push_back(child);
+    }
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        node_list[node].cost += delta;
+        for (int child = first_child[node]; child >= 0; child = next_sibling[child]) {
+            stack.push_back(child);
+        }
+    }
+}
+
+// cheapest node within expand_dis of the goal with a collision free segment to it, -1 if none
+int RRTStar::search_best_goal_node(void) {
+    int best = -1;
+    double best_cost = std::numeric_limits<double>::max();
+    node_index.radius(goal.x, goal.y, expand_dis, [&](int index, double dist) {
+        double cost = node_list[index].cost + dist;
+        if (cost < best_cost && check_collision(node_list[index], goal)) {
+            best_cost = cost;
+            best = index;
+        }
+    });
+
+    return best;
+}
+
 void RRT::plot_circle(double x, double y, double size, bool is_fill, string style) {
     vector<double> xl;
     vector<double> yl;
@@ -199,7 +398,24 @@ void RRT::plot_circle(double x, double y, double size, bool is_fill, string styl
     }
 }
 
-void RRT::draw_graph(Node rnd) {
+void RRT::draw_graph(const Node& rnd) {
+    if (utils::viz::RECORD) {
+        static const uint16_t tree = utils::viz::channel("rrt/tree");
+        static const uint16_t sample = utils::viz::channel("rrt/sample");
+        utils::viz::frame(tree);
+        utils::viz::frame(sample);
+        utils::viz::node(sample, rnd.x, rnd.y);
+        for (const Node& n : node_list) {
+            if (n.parent >= 0) {
+                const Node& p = node_list[n.parent];
+                utils::viz::path(tree, {n.x, p.x}, {n.y, p.y});
+            }
+        }
+    }
+    if (!show_animation) {
+        return;
+    }
+
     plt::clf();
 
     plt::plot(boundary[0], boundary[1], "sk");
@@ -208,9 +424,10 @@ void RRT::draw_graph(Node rnd) {
         plot_circle(rnd.x, rnd.y, robot_radius, false, "-r");
     }
 
-    for (Node* n : node_list) {
-        if (n->parent != nullptr) {
-            plt::plot({n->x, n->parent->x}, {n->y, n->parent->y}, "-g");
+    for (const Node& n : node_list) {
+        if (n.parent >= 0) {
+            const Node& p = node_list[n.parent];
+            plt::plot({n.x, p.x}, {n.y, p.y}, "-g");
         }
     }
 
@@ -218,8 +435,8 @@ void RRT::draw_graph(Node rnd) {
         plot_circle(obs[0], obs[1], obs[2], true);
     }
 
-    plt::plot({start->x}, {start->y}, "xr");
-    plt::plot({goal->x}, {goal->y}, "xr");
+    plt::plot({start.x}, {start.y}, "xr");
+    plt::plot({goal.x}, {goal.y}, "xr");
     plt::axis("equal");
     plt::grid(true);
     plt::title("Rapid-exploration Random Tree");
@@ -228,17 +445,43 @@ void RRT::draw_graph(Node rnd) {
 
 vector<vector<double>> RRT::generate_final_course(void) {
     vector<vector<double>> final_path(2);
-    Node* n = goal;
+    if (goal.parent < 0) {
+        return final_path;
+    }
 
-    while (n != nullptr) {
-        final_path[0].emplace_back(n->x);
-        final_path[1].emplace_back(n->y);
-        n = n->parent;
+    final_path[0].emplace_back(goal.x);
+    final_path[1].emplace_back(goal.y);
+    for (int index = goal.parent; index >= 0; index = node_list[index].parent) {
+        final_path[0].emplace_back(node_list[index].x);
+        final_path[1].emplace_back(node_list[index].y);
     }
 
     return final_path;
 }
 
+// races num_trees copies of planner, RRT or RRTStar, on pool. tree k draws its samples from
+// the seed stream seed + k, so every tree is reproducible on its own, and the first one that
+// finds a path cancels the others. which tree wins depends on the timing
+template <typename Planner>
+vector<vector<double>> race_planning(const Planner& planner, utils::ThreadPool& pool,
+                                     int num_trees, unsigned int seed) {
+    std::atomic<bool> solved{false};
+    vector<vector<double>> path(2);
+
+    pool.parallel_for(num_trees, [&](size_t k, int) {
+        Planner tree = planner;
+        tree.set_seed(seed + k);
+        tree.set_cancel(&solved);
+        tree.set_animation(false);
+        vector<vector<double>> tree_path = tree.planning();
+        if (tree_path[0].size() >= 2 && !solved.exchange(true)) {
+            path = std::move(tree_path);
+        }
+    });
+
+    return path;
+}
+
 int main(int argc, char** argv) {
     vector<vector<double>> obstacle_list = {{5, 5, 1}, {3, 6, 2}, {3, 8, 2}, {3, 10, 2},
                                             {7, 5, 2}, {9, 5, 2}, {8, 10, 1}};
@@ -255,8 +498,26 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    utils::TicToc t_s;
+    RRTStar rrt_star(start, goal, obstacle_list, area);
+    vector<vector<double>> path_star = rrt_star.planning();
+    fmt::print("rrt* planning costtime: {:.3f} s\n", t_s.toc() / 1000);
+
+    utils::ThreadPool pool;
+    utils::TicToc t_r;
+    RRT racer(start, goal, obstacle_list, area);
+    vector<vector<double>> path_race = race_planning(racer, pool, 4 * pool.size(), 0);
+    fmt::print("rrt race of {} trees on {} threads costtime: {:.3f} s\n", 4 * pool.size(),
+               pool.size(), t_r.toc() / 1000);
+
     if (show_animation) {
         plt::plot(path[0], path[1], "-r");
+        if (path_star[0].size() >= 2) {
+            plt::plot(path_star[0], path_star[1], "-b");
+        }
+        if (path_race[0].size() >= 2) {
+            plt::plot(path_race[0], path_race[1], "-m");
+        }
         plt::grid(true);
         plt::show();
     }
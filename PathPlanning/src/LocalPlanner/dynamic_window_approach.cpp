@@ -7,8 +7,11 @@
 #include <memory>
 #include <vector>
 
+#include "distance_field.hpp"
 #include "matplotlibcpp.h"
+#include "thread_pool.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::shared_ptr;
 using std::vector;
@@ -16,7 +19,7 @@ using namespace Eigen;
 // x(m), y(m), yaw(rad), v(m/s), omega(rad/s)
 typedef Eigen::Matrix<double, 5, 1> RobotState;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 enum class RobotType { Circle, Rectangle };
 
@@ -34,8 +37,8 @@ public:
     double max_yaw_rate = 40.0 * M_PI / 180.0;
     double max_accel = 0.3;
     double max_delta_yaw_rate = 40.0 * M_PI / 180.0;
-    double v_resolution = 0.05;
-    double yaw_rate_resolution = 0.5 * M_PI / 180.0;
+    double v_resolution = 0.0125;
+    double yaw_rate_resolution = 0.125 * M_PI / 180.0;
     double dt = 0.1;
     double predict_time = 3.0;
     double to_goal_cost_gain = 0.15;
@@ -78,106 +81,234 @@ RobotState motion(RobotState x, double v, double w, double dt) {
     return x_pre;
 }
 
-vector<RobotState> predict_trajectory(RobotState x_init, double v, double w, Config* config) {
-    RobotState x = x_init;
-    vector<RobotState> trajectory = {x_init};
-    double time = 0.0;
-
-    while (time <= config->predict_time) {
-        x = motion(x, v, w, config->dt);
-        trajectory.emplace_back(x);
-        time += config->dt;
+// number of motion() steps of a predicted trajectory
+int calc_predict_steps(Config* config) {
+    int steps = 0;
+    for (double time = 0.0; time <= config->predict_time; time += config->dt) {
+        ++steps;
     }
 
-    return trajectory;
+    return steps;
+}
+
+// the poses motion() reaches from (x0, y0, yaw0) at constant (v, w). the heading after k steps
+// is yaw0 + k * w * dt, its cosine and sine follow by rotating with (cos(w * dt), sin(w * dt)),
+// so an arc costs two trig calls however long it is. the buffers hold steps + 1 poses
+void predict_trajectory(double x0, double y0, double yaw0, double v, double w, double dt,
+                        int steps, double* x, double* y, double* yaw, double* c, double* s) {
+    double dc = cos(w * dt);
+    double ds = sin(w * dt);
+    x[0] = x0;
+    y[0] = y0;
+    yaw[0] = yaw0;
+    c[0] = cos(yaw0);
+    s[0] = sin(yaw0);
+    for (int k = 0; k < steps; ++k) {
+        x[k + 1] = x[k] + v * c[k] * dt;
+        y[k + 1] = y[k] + v * s[k] * dt;
+        yaw[k + 1] = yaw0 + (k + 1) * w * dt;
+        c[k + 1] = c[k] * dc - s[k] * ds;
+        s[k + 1] = s[k] * dc + c[k] * ds;
+    }
 }
 
-double calc_to_goal_cost(vector<RobotState> trajectory, Vector2d goal) {
-    double dx = goal[0] - trajectory.back()[0];
-    double dy = goal[1] - trajectory.back()[1];
+double calc_to_goal_cost(double x, double y, double yaw, Vector2d goal) {
+    double dx = goal[0] - x;
+    double dy = goal[1] - y;
     double error_angle = atan2(dy, dx);
-    double cost_angle = error_angle - trajectory.back()[2];
+    double cost_angle = error_angle - yaw;
     double cost = abs(atan2(sin(cost_angle), cos(cost_angle)));
 
     return cost;
 }
 
-double calc_obstacle_cost(vector<RobotState> trajectory, const vector<vector<double>>& ob,
-                          Config* config) {
-    double minr = std::numeric_limits<double>::max();
-
-    for (int i = 0; i < ob.size(); ++i) {
-        for (int j = 0; j < trajectory.size(); ++j) {
-            double ox = ob[i][0];
-            double oy = ob[i][1];
-            double yaw = trajectory[j][2];
-            double dx = trajectory[j][0] - ox;
-            double dy = trajectory[j][1] - oy;
-            double r = hypot(dx, dy);
-
-            if (config->robot_type == RobotType::Rectangle) {
-                double obsx = ox * cos(yaw) - oy * sin(yaw);
-                double obsy = ox * sin(yaw) + oy * cos(yaw);
-                bool upper_check = (obsy <= config->robot_length / 2);
-                bool right_check = (obsx <= config->robot_width / 2);
-                bool bottom_check = (obsy >= -config->robot_length / 2);
-                bool left_check = (obsx >= -config->robot_width / 2);
-                if (upper_check && right_check && bottom_check && left_check) {
-                    return std::numeric_limits<double>::max() / 2.0;
-                }
-            } else if (config->robot_type == RobotType::Circle) {
-                if (r <= config->robot_radius) {
-                    return std::numeric_limits<double>::max() / 2.0;
-                }
-            }
-            minr = std::min(minr, r);
-        }
+utils::DiskFootprint calc_footprint(Config* config) {
+    if (config->robot_type == RobotType::Rectangle) {
+        double half_length = config->robot_length / 2;
+        return utils::DiskFootprint::rectangle(half_length, half_length, config->robot_width / 2,
+                                               0.1);
     }
 
-    return 1.0 / minr;
+    return utils::DiskFootprint::circle(config->robot_radius);
 }
 
-vector<RobotState> calc_control_and_trajectory(RobotState x, Vector2d& control, Vector4d dw,
-                                               Config* config, Vector2d goal,
-                                               const vector<vector<double>>& ob) {
-    RobotState x_init = x;
-    double min_cost = std::numeric_limits<double>::max();
-    Vector2d best_u(0.0, 0.0);
-    vector<RobotState> best_trajectory = {x};
+// scores the (v, w) grid of a dynamic window. the velocity rows are spread over the pool, every
+// worker rolls its samples out into its own buffers and keeps only its best sample, the best
+// trajectory is rolled out again at the end. a sample is dropped as soon as the obstacle cost
+// seen so far makes it worse than the best of its worker, the obstacle cost is at least
+// obstacle_cost_gain / max_dist of the field. nothing is allocated after the first call
+class DWAPlanner {
+public:
+    explicit DWAPlanner(Config* _config, utils::ThreadPool* _pool = nullptr)
+        : config(_config), pool(_pool), footprint(calc_footprint(_config)) {
+        workers.resize(pool != nullptr ? pool->size() : 1);
+    }
+    ~DWAPlanner() {}
+
+    // the best control in the window dw for the robot at x and its predicted trajectory, ties
+    // go to the sample with the larger v, then the larger w
+    void planning(const RobotState& x, const Vector4d& dw, Vector2d goal,
+                  const utils::DistanceField& field, Vector2d& control,
+                  vector<RobotState>& trajectory);
 
-    for (double v = dw[0]; v <= dw[1]; v += config->v_resolution) {
-        for (double w = dw[2]; w <= dw[3]; w += config->yaw_rate_resolution) {
-            vector<RobotState> trajectory = predict_trajectory(x_init, v, w, config);
-
-            double to_goal_cost = config->to_goal_cost_gain * calc_to_goal_cost(trajectory, goal);
-            double speed_cost =
-                config->speed_cost_gain * (config->max_speed - trajectory.back()[3]);
-            double ob_cost =
-                config->obstacle_cost_gain * calc_obstacle_cost(trajectory, ob, config);
-            double final_cost = to_goal_cost + speed_cost + ob_cost;
-
-            if (min_cost >= final_cost) {
-                min_cost = final_cost;
-                best_u << v, w;
-                best_trajectory = trajectory;
-                if (best_u[0] < config->robot_stuck_flag_cons &&
-                    abs(x[3]) < config->robot_stuck_flag_cons) {
-                    best_u[1] = -config->max_delta_yaw_rate;
-                }
+    // samples of the last call, rolled out / scored to the end
+    size_t get_samples(void) const { return vs.size() * ws.size(); }
+    size_t get_scored(void) const;
+
+private:
+    class Worker {
+    public:
+        vector<double> x;
+        vector<double> y;
+        vector<double> yaw;
+        vector<double> cos_yaw;
+        vector<double> sin_yaw;
+        double cost;
+        long index;  // v row * ws.size() + w column, -1 if none
+        size_t scored;
+    };
+
+    Config* config;
+    utils::ThreadPool* pool;
+    utils::DiskFootprint footprint;
+    vector<double> vs;
+    vector<double> ws;
+    vector<Worker> workers;
+
+    void evaluate_row(const RobotState& x, size_t row, Vector2d goal,
+                      const utils::DistanceField& field, Worker& worker);
+};
+
+size_t DWAPlanner::get_scored(void) const {
+    size_t scored = 0;
+    for (const Worker& worker : workers) {
+        scored += worker.scored;
+    }
+
+    return scored;
+}
+
+void DWAPlanner::evaluate_row(const RobotState& x, size_t row, Vector2d goal,
+                              const utils::DistanceField& field, Worker& worker) {
+    int steps = worker.x.size() - 1;
+    double min_ob_cost = config->obstacle_cost_gain / field.get_max_dist();
+    double collision_cost = std::numeric_limits<double>::max() / 2.0;
+
+    for (size_t col = 0; col < ws.size(); ++col) {
+        long index = row * ws.size() + col;
+        predict_trajectory(x[0], x[1], x[2], vs[row], ws[col], config->dt, steps,
+                           worker.x.data(), worker.y.data(), worker.yaw.data(),
+                           worker.cos_yaw.data(), worker.sin_yaw.data());
+
+        double to_goal_cost = config->to_goal_cost_gain *
+                              calc_to_goal_cost(worker.x[steps], worker.y[steps],
+                                                worker.yaw[steps], goal);
+        double speed_cost = config->speed_cost_gain * (config->max_speed - vs[row]);
+        double base_cost = to_goal_cost + speed_cost;
+        // samples costing as much as the best are kept, a later one wins the tie
+        auto worse = [&](double cost) {
+            return cost > worker.cost || (cost == worker.cost && index < worker.index);
+        };
+        if (worse(base_cost + min_ob_cost)) {
+            continue;
+        }
+
+        double minr = std::numeric_limits<double>::max();
+        bool pruned = false;
+        double ob_cost = 0.0;
+        for (int k = 0; k <= steps; ++k) {
+            if (field.clearance(footprint, worker.x[k], worker.y[k], worker.cos_yaw[k],
+                                worker.sin_yaw[k]) <= 0.0) {
+                ob_cost = collision_cost;
+                break;
+            }
+            minr = std::min(minr, field.clearance(worker.x[k], worker.y[k]));
+            if (worse(base_cost + config->obstacle_cost_gain * (1.0 / minr))) {
+                pruned = true;
+                break;
             }
         }
-    }
-    control = best_u;
+        if (pruned) {
+            continue;
+        }
+        if (ob_cost == 0.0) {
+            ob_cost = config->obstacle_cost_gain * (1.0 / minr);
+        }
+        ++worker.scored;
 
-    return best_trajectory;
+        double final_cost = base_cost + ob_cost;
+        if (!worse(final_cost)) {
+            worker.cost = final_cost;
+            worker.index = index;
+        }
+    }
 }
 
-vector<RobotState> dwa_control(RobotState x, Vector2d& control, Config* config, Vector2d goal,
-                               const vector<vector<double>>& ob) {
-    Vector4d dw = calc_dynamic_window(x, config);
-    vector<RobotState> traj = calc_control_and_trajectory(x, control, dw, config, goal, ob);
+void DWAPlanner::planning(const RobotState& x, const Vector4d& dw, Vector2d goal,
+                          const utils::DistanceField& field, Vector2d& control,
+                          vector<RobotState>& trajectory) {
+    vs.clear();
+    ws.clear();
+    for (double v = dw[0]; v <= dw[1]; v += config->v_resolution) {
+        vs.push_back(v);
+    }
+    for (double w = dw[2]; w <= dw[3]; w += config->yaw_rate_resolution) {
+        ws.push_back(w);
+    }
+    int steps = calc_predict_steps(config);
+    for (Worker& worker : workers) {
+        worker.x.resize(steps + 1);
+        worker.y.resize(steps + 1);
+        worker.yaw.resize(steps + 1);
+        worker.cos_yaw.resize(steps + 1);
+        worker.sin_yaw.resize(steps + 1);
+        worker.cost = std::numeric_limits<double>::max();
+        worker.index = -1;
+        worker.scored = 0;
+    }
+
+    if (ws.empty()) {
+        vs.clear();
+    }
+    if (pool != nullptr) {
+        pool->parallel_for(vs.size(), [&](size_t row, int id) {
+            evaluate_row(x, row, goal, field, workers[id]);
+        });
+    } else {
+        for (size_t row = 0; row < vs.size(); ++row) {
+            evaluate_row(x, row, goal, field, workers[0]);
+        }
+    }
+
+    const Worker* best = &workers[0];
+    for (const Worker& worker : workers) {
+        if (worker.index >= 0 &&
+            (best->index < 0 || worker.cost < best->cost ||
+             (worker.cost == best->cost && worker.index > best->index))) {
+            best = &worker;
+        }
+    }
+    if (best->index < 0) {
+        control << 0.0, 0.0;
+        trajectory.assign(1, x);
+        return;
+    }
+
+    double v = vs[best->index / ws.size()];
+    double w = ws[best->index % ws.size()];
+    control << v, w;
+    if (control[0] < config->robot_stuck_flag_cons && abs(x[3]) < config->robot_stuck_flag_cons) {
+        control[1] = -config->max_delta_yaw_rate;
+    }
 
-    return traj;
+    Worker& out = workers[0];
+    predict_trajectory(x[0], x[1], x[2], v, w, config->dt, steps, out.x.data(), out.y.data(),
+                       out.yaw.data(), out.cos_yaw.data(), out.sin_yaw.data());
+    trajectory.resize(steps + 1);
+    trajectory[0] = x;
+    for (int k = 1; k <= steps; ++k) {
+        trajectory[k] << out.x[k], out.y[k], out.yaw[k], v, w;
+    }
 }
 
 int main(int argc, char** argv) {
@@ -192,32 +323,64 @@ int main(int argc, char** argv) {
     vector<RobotState> trajectory = {x};
     utils::VehicleConfig vc(0.5);
 
+    // the predicted trajectories stay within max_speed * predict_time of the robot, the
+    // obstacle cost needs the distance to the nearest obstacle up to about as far
+    vector<double> ox, oy;
+    for (const vector<double>& ob : obs) {
+        ox.push_back(ob[0]);
+        oy.push_back(ob[1]);
+    }
+    double margin = config->max_speed * config->predict_time + config->robot_length;
+    double minx = std::min({utils::min(ox), x[0], goal[0]}) - margin;
+    double miny = std::min({utils::min(oy), x[1], goal[1]}) - margin;
+    double maxx = std::max({utils::max(ox), x[0], goal[0]}) + margin;
+    double maxy = std::max({utils::max(oy), x[1], goal[1]}) + margin;
+    utils::DistanceField field =
+        utils::DistanceField::from_bounds(minx, miny, maxx, maxy, 0.1, 10.0);
+    field.update(ox, oy);
+
+    utils::ThreadPool pool;
+    DWAPlanner planner(config, &pool);
+    vector<RobotState> predicted_trajectory;
+    uint16_t predicted = utils::viz::channel("dwa/predicted");
+    uint16_t robot = utils::viz::channel("dwa/robot");
+    if (utils::viz::RECORD) {
+        uint16_t obstacles = utils::viz::channel("dwa/obstacles");
+        for (size_t i = 0; i < ox.size(); ++i) {
+            utils::viz::node(obstacles, ox[i], oy[i]);
+        }
+    }
     while (true) {
         Vector2d u;
         // utils::TicToc t_m;
-        vector<RobotState> predicted_trajectory = dwa_control(x, u, config, goal, obs);
+        planner.planning(x, calc_dynamic_window(x, config), goal, field, u, predicted_trajectory);
         // fmt::print("dwa_control() costtime: {:.3f} ms\n", t_m.toc());
         x = motion(x, u[0], u[1], config->dt);
 
-        if (show_animation) {
-            plt::cla();
+        if (show_animation || utils::viz::RECORD) {
             vector<double> trajx, trajy;
-            for (RobotState traj : predicted_trajectory) {
+            for (const RobotState& traj : predicted_trajectory) {
                 trajx.emplace_back(traj[0]);
                 trajy.emplace_back(traj[1]);
             }
-            plt::named_plot("Planning trajectory", trajx, trajy, "-r");
-
-            plt::named_plot("Goal", vector<double>{goal[0]}, vector<double>{goal[1]}, "xg");
-            for (vector<double> ob : obs) {
-                plt::plot({ob[0]}, {ob[1]}, "ok");
+            utils::viz::frame(predicted);
+            utils::viz::path(predicted, trajx, trajy);
+            utils::viz::pose(robot, x[0], x[1], x[2]);
+            if (show_animation) {
+                plt::cla();
+                plt::named_plot("Planning trajectory", trajx, trajy, "-r");
+
+                plt::named_plot("Goal", vector<double>{goal[0]}, vector<double>{goal[1]}, "xg");
+                for (vector<double> ob : obs) {
+                    plt::plot({ob[0]}, {ob[1]}, "ok");
+                }
+                utils::draw_vehicle({x[0], x[1], x[2]}, u[1], vc);
+                plt::axis("equal");
+                plt::grid(true);
+                plt::title("Dynamic Window Approach");
+                plt::legend();
+                plt::pause(0.0001);
             }
-            utils::draw_vehicle({x[0], x[1], x[2]}, u[1], vc);
-            plt::axis("equal");
-            plt::grid(true);
-            plt::title("Dynamic Window Approach");
-            plt::legend();
-            plt::pause(0.0001);
         }
         double dist_to_goal = hypot(x[0] - goal[0], x[1] - goal[1]);
         if (dist_to_goal <= config->robot_radius) {
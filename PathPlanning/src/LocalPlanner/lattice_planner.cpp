@@ -2,15 +2,25 @@
 
 #include <Eigen/Core>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "cubic_spline.hpp"
+#include "distance_field.hpp"
 #include "matplotlibcpp.h"
+#include "plan_track_runtime.hpp"
 #include "quartic_polynomial.hpp"
 #include "quintic_polynomial.hpp"
 #include "road_line.hpp"
+#include "time_basis.hpp"
+#include "triple_buffer.hpp"
 #include "utils.hpp"
 
 using std::vector;
@@ -28,25 +38,25 @@ constexpr double K_TIME = 1.0;
 constexpr double K_V_DIFF = 1.0;
 constexpr double K_OFFSET = 1.5;
 constexpr double K_COLLISION = 500;
+constexpr double COLLISION_RESO = 0.5;  // [m]
 
 constexpr double MAX_SPEED = 50.0 / 3.6;
 constexpr double MAX_ACCEL = 8.0;
 constexpr double MAX_CURVATURE = 6.0;
 
+// tracker of the pipelined case
+constexpr double KP_SPEED = 1.0;
+constexpr double LOOKAHEAD_GAIN = 0.5;
+constexpr double LOOKAHEAD_MIN = 4.0;  // [m]
+
 class Path {
 public:
-    vector<double> t;
+    std::shared_ptr<const TimeBasis> basis;
     double cost = 0.0;
 
-    vector<double> l;
-    vector<double> l_v;
-    vector<double> l_a;
-    vector<double> l_jerk;
-
-    vector<double> s;
-    vector<double> s_v;
-    vector<double> s_a;
-    vector<double> s_jerk;
+    PolynomialSamples lat;  // l and its derivatives
+    // s and its derivatives, shared by all lateral samples of one longitudinal profile
+    std::shared_ptr<const PolynomialSamples> lon;
 
     vector<double> x;
     vector<double> y;
@@ -59,22 +69,23 @@ public:
 
     void SL_2_XY(CubicSpline2D& ref_path);
     void calc_yaw_curv(void);
-    bool operator<(const Path& other) const { return cost < other.cost; }
 };
 
 void Path::SL_2_XY(CubicSpline2D& ref_path) {
     x.clear();
     y.clear();
 
+    const vector<double>& s = lon->p;
+    int segment = 0;
     for (size_t i = 0; i < s.size(); ++i) {
         if (s[i] > ref_path.s.back()) {
             break;
         }
 
-        Vector2d xy_ref = ref_path.calc_position(s[i]);
-        double yaw = ref_path.calc_yaw(s[i]);
-        double x_ref = xy_ref[0] + l[i] * cos(yaw + M_PI_2);
-        double y_ref = xy_ref[1] + l[i] * sin(yaw + M_PI_2);
+        double rx, ry, yaw;
+        ref_path.evaluate(s[i], segment, &rx, &ry, &yaw, nullptr);
+        double x_ref = rx + lat.p[i] * cos(yaw + M_PI_2);
+        double y_ref = ry + lat.p[i] * sin(yaw + M_PI_2);
 
         x.push_back(x_ref);
         y.push_back(y_ref);
@@ -119,10 +130,10 @@ vector<vector<double>> get_reference_line(vector<double> cx, vector<double> cy,
     return traj;
 }
 
-bool verify_path(const Path& path) {
-    for (size_t i = 0; i < path.s_v.size(); ++i) {
-        if (path.s_v[i] > MAX_SPEED || abs(path.s_a[i]) > MAX_ACCEL ||
-            abs(path.curv[i]) > MAX_CURVATURE) {
+// speed and acceleration limits, shared by all candidates of the profile
+bool verify_profile(const PolynomialSamples& lon) {
+    for (size_t i = 0; i < lon.v.size(); ++i) {
+        if (lon.v[i] > MAX_SPEED || abs(lon.a[i]) > MAX_ACCEL) {
             return false;
         }
     }
@@ -130,86 +141,69 @@ bool verify_path(const Path& path) {
     return true;
 }
 
-double is_path_collision(const Path& path, const utils::VehicleConfig& vc,
-                         const vector<vector<double>>& obs) {
-    vector<double> x;
-    vector<double> y;
-    vector<double> yaw;
-    for (size_t i = 0; i < path.x.size(); i += 3) {
-        x.push_back(path.x[i]);
-        y.push_back(path.y[i]);
-        yaw.push_back(path.yaw[i]);
+// curvature limit, the profile is checked by sampling_paths already
+bool verify_path(const Path& path) {
+    // the xy path, and so curv, stops at the end of the reference line
+    for (double c : path.curv) {
+        if (abs(c) > MAX_CURVATURE) {
+            return false;
+        }
     }
 
-    for (size_t i = 0; i < x.size(); ++i) {
-        double d = 1.8;
-        double dl = (vc.RF - vc.RB) / 2.0;
-        double r = hypot((vc.RF + vc.RB) / 2.0, vc.W / 2.0) + d;
-
-        double cx = x[i] + dl * cos(yaw[i]);
-        double cy = y[i] + dl * sin(yaw[i]);
+    return true;
+}
 
-        for (size_t j = 0; j < obs[0].size(); ++j) {
-            double xo = obs[0][j] - cx;
-            double yo = obs[1][j] - cy;
-            double dx = xo * cos(yaw[i]) + yo * sin(yaw[i]);
-            double dy = -xo * sin(yaw[i]) + yo * cos(yaw[i]);
+// vehicle rectangle around its center, stretched to the diagonal and with a 1.8 m margin
+utils::DiskFootprint calc_footprint(const utils::VehicleConfig& vc) {
+    double d = 1.8;
+    double dl = (vc.RF - vc.RB) / 2.0;
+    double r = hypot((vc.RF + vc.RB) / 2.0, vc.W / 2.0) + d;
 
-            if (abs(dx) < r && abs(dy) < vc.W / 2 + d) {
-                return 1.0;
-            }
-        }
-    }
+    return utils::DiskFootprint::rectangle(dl + r, r - dl, vc.W / 2 + d, COLLISION_RESO);
+}
 
-    return 0.0;
+double is_path_collision(const Path& path, const utils::DistanceField& field,
+                         const utils::DiskFootprint& footprint) {
+    return field.min_clearance(footprint, path.x, path.y, path.yaw, 3) <= 0.0 ? 1.0 : 0.0;
 }
 
+// candidates within the speed and acceleration limits with their Frenet cost, the xy paths are
+// left to extract_optimal_path
 vector<Path> sampling_paths(double l0, double l0_v, double l0_a, double s0, double s0_v,
-                            double s0_a, CubicSpline2D& ref_path, const utils::VehicleConfig& vc,
-                            const vector<vector<double>>& obs) {
+                            double s0_a) {
     vector<Path> paths;
+    vector<double> t1_samples;
+    vector<std::shared_ptr<const TimeBasis>> bases;
+    for (double t1 = 4.5; t1 < 5.5; t1 += 0.2) {
+        t1_samples.push_back(t1);
+        bases.push_back(std::make_shared<const TimeBasis>(t1, T_STEP));
+    }
 
     for (double s1_v = TARGET_SPEED * 0.6; s1_v < TARGET_SPEED * 1.4; s1_v += TARGET_SPEED * 0.2) {
-        for (double t1 = 4.5; t1 < 5.5; t1 += 0.2) {
-            Path path_pre;
-            QuarticPolynomial path_lon(s0, s0_v, s0_a, s1_v, 0.0, t1);
-
-            for (double t = 0.0; t < t1; t += T_STEP) {
-                path_pre.t.push_back(t);
-                path_pre.s.push_back(path_lon.calc_point(t));
-                path_pre.s_v.push_back(path_lon.calc_first_derivative(t));
-                path_pre.s_a.push_back(path_lon.calc_second_derivative(t));
-                path_pre.s_jerk.push_back(path_lon.calc_third_derivative(t));
+        for (size_t k = 0; k < t1_samples.size(); ++k) {
+            double t1 = t1_samples[k];
+            std::shared_ptr<PolynomialSamples> lon = std::make_shared<PolynomialSamples>();
+            QuarticPolynomial(s0, s0_v, s0_a, s1_v, 0.0, t1).calc_batch(*bases[k], *lon);
+            if (!verify_profile(*lon)) {
+                continue;
             }
 
             for (double l1 = -ROAD_WIDTH; l1 < ROAD_WIDTH; l1 += ROAD_SAMPLE_STEP) {
-                Path path = path_pre;
-                QuinticPolynomial path_lat(l0, l0_v, l0_a, l1, 0.0, 0.0, t1);
-
-                for (double t : path_pre.t) {
-                    path.l.push_back(path_lat.calc_point(t));
-                    path.l_v.push_back(path_lat.calc_first_derivative(t));
-                    path.l_a.push_back(path_lat.calc_second_derivative(t));
-                    path.l_jerk.push_back(path_lat.calc_third_derivative(t));
-                }
-
-                path.SL_2_XY(ref_path);
-                path.calc_yaw_curv();
-                if (path.yaw.empty()) {
-                    continue;
-                }
+                Path path;
+                path.basis = bases[k];
+                path.lon = lon;
+                QuinticPolynomial(l0, l0_v, l0_a, l1, 0.0, 0.0, t1).calc_batch(*bases[k], path.lat);
 
                 double l_jerk_sum = 0.0;
                 double s_jerk_sum = 0.0;
-                double v_diff = abs(TARGET_SPEED - path.s_v.back());
-                for (size_t i = 0; i < path.l_jerk.size(); ++i) {
-                    l_jerk_sum += abs(path.l_jerk[i]);
-                    s_jerk_sum += abs(path.s_jerk[i]);
+                double v_diff = abs(TARGET_SPEED - lon->v.back());
+                for (size_t i = 0; i < path.lat.jerk.size(); ++i) {
+                    l_jerk_sum += abs(path.lat.jerk[i]);
+                    s_jerk_sum += abs(lon->jerk[i]);
                 }
 
                 path.cost = K_JERK * (l_jerk_sum + s_jerk_sum) + K_V_DIFF * v_diff +
-                            K_TIME * t1 * 2 + K_OFFSET * abs(path.l.back()) +
-                            K_COLLISION * is_path_collision(path, vc, obs);
+                            K_TIME * t1 * 2 + K_OFFSET * abs(path.lat.p.back());
 
                 paths.emplace_back(path);
             }
@@ -220,52 +214,44 @@ vector<Path> sampling_paths(double l0, double l0_v, double l0_a, double s0, doub
 }
 
 vector<Path> sampling_paths_for_stopping(double l0, double l0_v, double l0_a, double s0,
-                                         double s0_v, double s0_a, CubicSpline2D& ref_path) {
+                                         double s0_v, double s0_a) {
     vector<Path> paths;
     vector<double> s1_v_vec = {-2.0, -1.0, 0.0, 1.0, 2.0};
 
+    vector<double> t1_samples;
+    vector<std::shared_ptr<const TimeBasis>> bases;
+    for (double t1 = 0.0; t1 < 16.0; t1 += 1.0) {
+        t1_samples.push_back(t1);
+        bases.push_back(std::make_shared<const TimeBasis>(t1, T_STEP));
+    }
+
     for (double s1_v : s1_v_vec) {
-        for (double t1 = 0.0; t1 < 16.0; t1 += 1.0) {
-            Path path_pre;
-            QuinticPolynomial path_lon(s0, s0_v, s0_a, 55.0, s1_v, 0.0, t1);
-
-            for (double t = 0.0; t < t1; t += T_STEP) {
-                path_pre.t.push_back(t);
-                path_pre.s.push_back(path_lon.calc_point(t));
-                path_pre.s_v.push_back(path_lon.calc_first_derivative(t));
-                path_pre.s_a.push_back(path_lon.calc_second_derivative(t));
-                path_pre.s_jerk.push_back(path_lon.calc_third_derivative(t));
+        for (size_t k = 0; k < t1_samples.size(); ++k) {
+            double t1 = t1_samples[k];
+            std::shared_ptr<PolynomialSamples> lon = std::make_shared<PolynomialSamples>();
+            QuinticPolynomial(s0, s0_v, s0_a, 55.0, s1_v, 0.0, t1).calc_batch(*bases[k], *lon);
+            if (!verify_profile(*lon)) {
+                continue;
             }
 
             for (double l1 = 0.0; l1 <= 0.1; l1 += ROAD_SAMPLE_STEP) {
-                Path path = path_pre;
-                QuinticPolynomial path_lat(l0, l0_v, l0_a, l1, 0.0, 0.0, t1);
-
-                for (double t : path_pre.t) {
-                    path.l.push_back(path_lat.calc_point(t));
-                    path.l_v.push_back(path_lat.calc_first_derivative(t));
-                    path.l_a.push_back(path_lat.calc_second_derivative(t));
-                    path.l_jerk.push_back(path_lat.calc_third_derivative(t));
-                }
-
-                path.SL_2_XY(ref_path);
-                path.calc_yaw_curv();
-                if (path.yaw.empty()) {
-                    continue;
-                }
+                Path path;
+                path.basis = bases[k];
+                path.lon = lon;
+                QuinticPolynomial(l0, l0_v, l0_a, l1, 0.0, 0.0, t1).calc_batch(*bases[k], path.lat);
 
                 double l_jerk_sum = 0.0;
                 double s_jerk_sum = 0.0;
                 double s_v_sum = 0.0;
-                double v_diff = pow(path.s_v.back(), 2);
-                for (size_t i = 0; i < path.l_jerk.size(); ++i) {
-                    l_jerk_sum += abs(path.l_jerk[i]);
-                    s_jerk_sum += abs(path.s_jerk[i]);
-                    s_v_sum += abs(path.s_v[i]);
+                double v_diff = pow(lon->v.back(), 2);
+                for (size_t i = 0; i < path.lat.jerk.size(); ++i) {
+                    l_jerk_sum += abs(path.lat.jerk[i]);
+                    s_jerk_sum += abs(lon->jerk[i]);
+                    s_v_sum += abs(lon->v[i]);
                 }
 
                 path.cost = K_JERK * (l_jerk_sum + s_jerk_sum) + K_V_DIFF * v_diff +
-                            K_TIME * t1 * 2 + K_OFFSET * abs(path.l.back()) + 5.0 * s_v_sum;
+                            K_TIME * t1 * 2 + K_OFFSET * abs(path.lat.p.back()) + 5.0 * s_v_sum;
 
                 paths.emplace_back(path);
             }
@@ -275,37 +261,58 @@ vector<Path> sampling_paths_for_stopping(double l0, double l0_v, double l0_a, do
     return paths;
 }
 
-Path extract_optimal_path(vector<Path>& paths) {
-    Path path;
-    if (paths.empty()) {
-        return path;
+// the cheapest candidate is converted to xy and verified first. a collision adds K_COLLISION to
+// its cost and puts it back, so candidates are only converted while they can still be the
+// cheapest valid one, the result is the same as sorting all of them by their full cost.
+// field is nullptr when there are no obstacles
+Path extract_optimal_path(vector<Path>& paths, CubicSpline2D& ref_path,
+                          const utils::DistanceField* field,
+                          const utils::DiskFootprint* footprint) {
+    // cost, candidate index
+    std::priority_queue<std::pair<double, int>, vector<std::pair<double, int>>,
+                        std::greater<std::pair<double, int>>>
+        open_set;
+    vector<char> converted(paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        open_set.emplace(paths[i].cost, i);
     }
 
-    std::sort(paths.begin(), paths.end());
-    for (Path& p : paths) {
-        if (verify_path(p)) {
-            path = p;
-            break;
-            ;
+    while (!open_set.empty()) {
+        int i = open_set.top().second;
+        open_set.pop();
+        Path& p = paths[i];
+        if (converted[i]) {
+            return p;
+        }
+
+        converted[i] = 1;
+        p.SL_2_XY(ref_path);
+        p.calc_yaw_curv();
+        if (p.yaw.empty() || !verify_path(p)) {
+            continue;
+        }
+        if (field != nullptr) {
+            p.cost += K_COLLISION * is_path_collision(p, *field, *footprint);
         }
+        open_set.emplace(p.cost, i);
     }
 
-    return path;
+    return Path();
 }
 
 Path lattice_planner(double l0, double l0_v, double l0_a, double s0, double s0_v, double s0_a,
-                     CubicSpline2D& ref_path, const utils::VehicleConfig& vc,
-                     const vector<vector<double>>& obs) {
-    vector<Path> paths = sampling_paths(l0, l0_v, l0_a, s0, s0_v, s0_a, ref_path, vc, obs);
-    Path path = extract_optimal_path(paths);
+                     CubicSpline2D& ref_path, const utils::DistanceField& field,
+                     const utils::DiskFootprint& footprint) {
+    vector<Path> paths = sampling_paths(l0, l0_v, l0_a, s0, s0_v, s0_a);
+    Path path = extract_optimal_path(paths, ref_path, &field, &footprint);
 
     return path;
 }
 
 Path lattice_planner_for_stopping(double l0, double l0_v, double l0_a, double s0, double s0_v,
                                   double s0_a, CubicSpline2D& ref_path) {
-    vector<Path> paths = sampling_paths_for_stopping(l0, l0_v, l0_a, s0, s0_v, s0_a, ref_path);
-    Path path = extract_optimal_path(paths);
+    vector<Path> paths = sampling_paths_for_stopping(l0, l0_v, l0_a, s0, s0_v, s0_a);
+    Path path = extract_optimal_path(paths, ref_path, nullptr, nullptr);
 
     return path;
 }
@@ -319,6 +326,15 @@ void cruise_case(const utils::VehicleConfig& vc) {
     CubicSpline2D spline;
     vector<vector<double>> traj = get_reference_line(wxy[0], wxy[1], spline);
 
+    // the candidate paths stay within ROAD_WIDTH of the reference line, so the distance field
+    // only has to cover that band, and only the sign of the footprint clearance matters
+    utils::DiskFootprint footprint = calc_footprint(vc);
+    double margin = ROAD_WIDTH + footprint.get_reach();
+    utils::DistanceField field = utils::DistanceField::from_bounds(
+        utils::min(traj[0]) - margin, utils::min(traj[1]) - margin, utils::max(traj[0]) + margin,
+        utils::max(traj[1]) + margin, COLLISION_RESO, footprint.get_reach());
+    field.update(obs[0], obs[1]);
+
     double l0 = 0.0;           // current lateral position [m]
     double l0_v = 0.0;         // current lateral speed [m/s]
     double l0_a = 0.0;         // current lateral acceleration [m/s]
@@ -327,21 +343,21 @@ void cruise_case(const utils::VehicleConfig& vc) {
     double s0_a = 0.0;
 
     while (true) {
-        // Path path = lattice_planner(l0, l0_v, l0_a, s0, s0_v, s0_a, spline, vc, obs);
-        vector<Path> paths = sampling_paths(l0, l0_v, l0_a, s0, s0_v, s0_a, spline, vc, obs);
-        Path path = extract_optimal_path(paths);
+        // Path path = lattice_planner(l0, l0_v, l0_a, s0, s0_v, s0_a, spline, field, footprint);
+        vector<Path> paths = sampling_paths(l0, l0_v, l0_a, s0, s0_v, s0_a);
+        Path path = extract_optimal_path(paths, spline, &field, &footprint);
 
         if (path.x.empty()) {
             fmt::print("No feasible path found!!\n");
             break;
         }
 
-        l0 = path.l[1];
-        l0_v = path.l_v[1];
-        l0_a = path.l_a[1];
-        s0 = path.s[1];
-        s0_v = path.s_v[1];
-        s0_a = path.s_a[1];
+        l0 = path.lat.p[1];
+        l0_v = path.lat.v[1];
+        l0_a = path.lat.a[1];
+        s0 = path.lon->p[1];
+        s0_v = path.lon->v[1];
+        s0_a = path.lon->a[1];
 
         if (hypot(path.x[1] - traj[0].back(), path.y[1] - traj[1].back()) <= 2.0) {
             fmt::print("Goal\n");
@@ -352,9 +368,18 @@ void cruise_case(const utils::VehicleConfig& vc) {
         double steer = utils::pi_2_pi(atan(1.2 * vc.WB * dy));
 
         plt::cla();
-        plt::named_plot("Candidate trajectories", paths[0].x, paths[0].y, "-c");
-        for (size_t i = 1; i < paths.size(); i += (paths.size() / 10)) {
-            plt::plot(paths[i].x, paths[i].y, "-c");
+        // only the candidates extract_optimal_path had to convert have an xy path
+        bool named = false;
+        for (const Path& p : paths) {
+            if (p.x.empty()) {
+                continue;
+            }
+            if (!named) {
+                plt::named_plot("Candidate trajectories", p.x, p.y, "-c");
+                named = true;
+            } else {
+                plt::plot(p.x, p.y, "-c");
+            }
         }
         plt::plot(wxy[0], wxy[1], {{"linestyle", "--"}, {"color", "gray"}});
         plt::plot(inxy[0], inxy[1], {{"linewidth", "2"}, {"color", "k"}});
@@ -394,12 +419,12 @@ void stop_case(const utils::VehicleConfig& vc) {
             break;
         }
 
-        l0 = path.l[1];
-        l0_v = path.l_v[1];
-        l0_a = path.l_a[1];
-        s0 = path.s[1];
-        s0_v = path.s_v[1];
-        s0_a = path.s_a[1];
+        l0 = path.lat.p[1];
+        l0_v = path.lat.v[1];
+        l0_a = path.lat.a[1];
+        s0 = path.lon->p[1];
+        s0_v = path.lon->v[1];
+        s0_a = path.lon->a[1];
         if (hypot(path.x[1] - 56.0, path.y[1] - 0.0) <= 2.0) {
             fmt::print("Goal\n");
             break;
@@ -423,6 +448,191 @@ void stop_case(const utils::VehicleConfig& vc) {
     plt::show();
 }
 
+// the cruising scene with the planner at 10 Hz and a pure pursuit tracker at 100 Hz on their own
+// threads. the tracker drives a simulated vehicle, the planner continues its last trajectory
+// from where the vehicle is and the main thread only draws
+void pipelined_case(const utils::VehicleConfig& vc) {
+    CruiseRoadLine cruise_line;
+    vector<vector<double>> wxy = cruise_line.design_reference_line();
+    vector<vector<double>> inxy = cruise_line.design_boundary_left();
+    vector<vector<double>> outxy = cruise_line.design_boundary_right();
+    vector<vector<double>> obs = {{50, 96, 70, 40, 25}, {10, 25, 40, 50, 75}};
+    CubicSpline2D spline;
+    vector<vector<double>> traj = get_reference_line(wxy[0], wxy[1], spline);
+
+    utils::DiskFootprint footprint = calc_footprint(vc);
+    double margin = ROAD_WIDTH + footprint.get_reach();
+    utils::DistanceField field = utils::DistanceField::from_bounds(
+        utils::min(traj[0]) - margin, utils::min(traj[1]) - margin, utils::max(traj[0]) + margin,
+        utils::max(traj[1]) + margin, COLLISION_RESO, footprint.get_reach());
+    field.update(obs[0], obs[1]);
+
+    utils::RuntimeConfig config;
+    config.plan_period = 0.1;
+    config.control_period = 0.01;
+    config.plan_latency = 0.1;
+    config.control_priority = 10;
+
+    // what the planner and the tracker last did, for drawing
+    utils::TripleBuffer<utils::Trajectory> shown_plan;
+    utils::TripleBuffer<utils::TrajectoryPoint> shown_state;
+
+    // the last plan in Frenet coordinates, a stitched start is looked up in it
+    Path last_path;
+    double last_t0 = 0.0;
+    int segment = 0;
+    auto planner = [&](const utils::TrajectoryPoint& start, utils::Trajectory& out) {
+        double l0, l0_v, l0_a, s0, s0_v, s0_a;
+        if (!out.points.empty()) {
+            const TimeBasis& basis = *last_path.basis;
+            double dt = start.t - last_t0;
+            size_t k = std::upper_bound(basis.t.begin(), basis.t.end(), dt) - basis.t.begin();
+            k = std::min(std::max<size_t>(k, 1), basis.t.size() - 1);
+            double r = std::min(1.0, (dt - basis.t[k - 1]) / (basis.t[k] - basis.t[k - 1]));
+            auto at = [&](const vector<double>& v) { return v[k - 1] + r * (v[k] - v[k - 1]); };
+            l0 = at(last_path.lat.p);
+            l0_v = at(last_path.lat.v);
+            l0_a = at(last_path.lat.a);
+            s0 = at(last_path.lon->p);
+            s0_v = at(last_path.lon->v);
+            s0_a = at(last_path.lon->a);
+        } else {
+            // the first plan or the vehicle left the last one, project it onto the reference line
+            double s_prev = last_path.lon ? last_path.lon->p.front() : 0.0;
+            s0 = spline.calc_nearest_s({start.x, start.y}, std::max(0.0, s_prev - 5.0),
+                                       std::min(spline.s.back(), s_prev + 10.0), segment);
+            double rx, ry, ryaw, rkappa;
+            spline.evaluate(s0, segment, &rx, &ry, &ryaw, &rkappa);
+            double dyaw = utils::pi_2_pi(start.yaw - ryaw);
+            l0 = (start.y - ry) * cos(ryaw) - (start.x - rx) * sin(ryaw);
+            l0_v = start.v * sin(dyaw);
+            l0_a = 0.0;
+            s0_v = start.v * cos(dyaw) / (1.0 - rkappa * l0);
+            s0_a = start.a * cos(dyaw);
+        }
+
+        vector<Path> paths = sampling_paths(l0, l0_v, l0_a, s0, s0_v, s0_a);
+        Path path = extract_optimal_path(paths, spline, &field, &footprint);
+        if (path.x.empty()) {
+            return false;
+        }
+        last_path = path;
+        last_t0 = start.t;
+
+        double s = start.s;
+        for (size_t i = 0; i < path.x.size(); ++i) {
+            utils::TrajectoryPoint p;
+            p.t = start.t + path.basis->t[i];
+            p.x = path.x[i];
+            p.y = path.y[i];
+            p.yaw = path.yaw[i];
+            p.kappa = path.curv[std::min(i, path.curv.size() - 1)];
+            // the speed along the xy path, s_v of the reference line is off by its curvature
+            p.v = path.ds[i] / T_STEP;
+            p.s = s;
+            s += path.ds[i];
+            out.points.push_back(p);
+        }
+        for (size_t i = out.points.size() - path.x.size(); i + 1 < out.points.size(); ++i) {
+            out.points[i].a = (out.points[i + 1].v - out.points[i].v) / T_STEP;
+        }
+        shown_plan.back() = out;
+        shown_plan.publish();
+
+        return true;
+    };
+
+    double x0, y0, yaw0;
+    int start_segment = 0;
+    spline.evaluate(0.0, start_segment, &x0, &y0, &yaw0, nullptr);
+    utils::VehicleState vehicle(vc, x0, y0, yaw0, 30.0 / 3.6);
+    double dt = config.control_period;
+    auto controller = [&](const utils::Trajectory& plan, double t, utils::TrajectoryPoint& state) {
+        double acc = 0.0;
+        double delta = 0.0;
+        utils::TrajectoryPoint ref = plan.sample(t);
+        if (!plan.empty() && t <= plan.end_time()) {
+            acc = std::clamp(ref.a + KP_SPEED * (ref.v - vehicle.v), -MAX_ACCEL, MAX_ACCEL);
+            // pure pursuit of the point the trajectory reaches a lookahead distance later
+            double ld = LOOKAHEAD_GAIN * vehicle.v + LOOKAHEAD_MIN;
+            utils::TrajectoryPoint target = plan.sample(t + ld / std::max(vehicle.v, 1.0));
+            double alpha = atan2(target.y - vehicle.y, target.x - vehicle.x) - vehicle.yaw;
+            delta = atan2(2.0 * vc.WB * sin(alpha),
+                          std::max(1.0, hypot(target.x - vehicle.x, target.y - vehicle.y)));
+            delta = std::clamp(delta, -vc.MAX_STEER, vc.MAX_STEER);
+        } else if (!plan.empty()) {
+            // the planner fell behind the end of its last trajectory
+            acc = -std::min(MAX_ACCEL, vehicle.v / dt);
+        }
+        vehicle.update(acc, delta, dt);
+
+        state.x = vehicle.x;
+        state.y = vehicle.y;
+        state.yaw = vehicle.yaw;
+        state.v = vehicle.v;
+        state.a = acc;
+        state.kappa = tan(delta) / vc.WB;
+        state.s = ref.s;
+        shown_state.back() = state;
+        shown_state.publish();
+    };
+
+    utils::PlanTrackRuntime runtime(config, planner, controller);
+    runtime.start();
+
+    vector<double> px;
+    vector<double> py;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (runtime.now() < 60.0) {
+        next += std::chrono::milliseconds(100);
+        std::this_thread::sleep_until(next);
+        shown_plan.update();
+        shown_state.update();
+        const utils::Trajectory& plan = shown_plan.front();
+        const utils::TrajectoryPoint& car = shown_state.front();
+        if (plan.empty()) {
+            continue;
+        }
+        if (hypot(car.x - traj[0].back(), car.y - traj[1].back()) <= 2.0) {
+            fmt::print("Goal\n");
+            break;
+        }
+
+        px.clear();
+        py.clear();
+        for (const utils::TrajectoryPoint& p : plan.points) {
+            px.push_back(p.x);
+            py.push_back(p.y);
+        }
+        plt::cla();
+        plt::plot(wxy[0], wxy[1], {{"linestyle", "--"}, {"color", "gray"}});
+        plt::plot(inxy[0], inxy[1], {{"linewidth", "2"}, {"color", "k"}});
+        plt::plot(outxy[0], outxy[1], {{"linewidth", "2"}, {"color", "k"}});
+        plt::named_plot("Stitched trajectory", px, py, "-r");
+        plt::plot(obs[0], obs[1], "ok");
+        utils::draw_vehicle({car.x, car.y, car.yaw}, atan(car.kappa * vc.WB), vc);
+        plt::title("Pipelined Lattice Planner V[km/h]:" + std::to_string(car.v * 3.6).substr(0, 4));
+        plt::axis("equal");
+        plt::legend();
+        plt::pause(0.001);
+    }
+    runtime.stop();
+
+    auto print_stats = [](const char* name, const utils::LoopStats& stats) {
+        uint64_t ticks = std::max<uint64_t>(1, stats.ticks.load());
+        fmt::print("{:<10} {} ticks, {} deadline misses, {} skipped, {} failed, "
+                   "mean {:.3f} ms, max {:.3f} ms, max jitter {:.3f} ms\n",
+                   name, stats.ticks.load(), stats.misses.load(), stats.skipped.load(),
+                   stats.failures.load(), stats.total_ns.load() * 1e-6 / ticks,
+                   stats.max_ns.load() * 1e-6, stats.max_jitter_ns.load() * 1e-6);
+    };
+    print_stats("planner", runtime.planner_stats());
+    print_stats("controller", runtime.controller_stats());
+    fmt::print("{} stitch resets, controller {} real-time\n", runtime.stitch_resets(),
+               runtime.is_realtime() ? "is" : "is not");
+    plt::show();
+}
+
 int main(int argc, char** argv) {
     utils::VehicleConfig vc;
     vc.RF = 6.75;
@@ -433,7 +643,9 @@ int main(int argc, char** argv) {
     vc.TR = 0.75;
     vc.TW = 1.5;
 
-    if (argc > 1) {
+    if (argc > 1 && std::string(argv[1]) == "pipelined") {
+        pipelined_case(vc);
+    } else if (argc > 1) {
         stop_case(vc);
     } else {
         cruise_case(vc);
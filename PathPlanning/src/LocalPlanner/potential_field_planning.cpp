@@ -3,18 +3,22 @@
 #include <Eigen/Core>
 #include <algorithm>
 #include <cmath>
+#include <iterator>
 #include <limits>
 #include <queue>
 #include <set>
+#include <utility>
 #include <vector>
 
+#include "flat_kdtree.hpp"
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::vector;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 constexpr double KP = 5.0;
 constexpr double ETA = 100.0;
 constexpr double AREA_WIDTH = 30.0;
@@ -24,21 +28,7 @@ double calc_attractive_potential(Vector2d xy, Vector2d g) {
     return 0.5 * KP * hypot(xy[0] - g[0], xy[1] - g[1]);
 }
 
-double calc_repulsive_potential(Vector2d xy, const vector<vector<double>>& obs, double rr) {
-    if (obs[0].size() < 1) {
-        return 0.0;
-    }
-    int minid = 0;
-    double dmin = hypot(xy[0] - obs[0][0], xy[1] - obs[1][0]);
-    for (size_t idx = 1; idx < obs[0].size(); ++idx) {
-        double d = hypot(xy[0] - obs[0][idx], xy[1] - obs[1][idx]);
-        if (dmin >= d) {
-            dmin = d;
-            minid = idx;
-        }
-    }
-    double dq = hypot(xy[0] - obs[0][minid], xy[1] - obs[1][minid]);
-
+double calc_repulsive_potential(double dq, double rr) {
     if (dq <= rr) {
         if (dq <= 0.1) {
             dq = 0.1;
@@ -49,29 +39,140 @@ double calc_repulsive_potential(Vector2d xy, const vector<vector<double>>& obs,
     return 0.0;
 }
 
-Vector2d calc_potential_field(Vector2d s, Vector2d g, const vector<vector<double>>& obs,
-                              double reso, double rr, vector<vector<double>>& pmap) {
+// potential of the cells (ix * reso + minx, iy * reso + miny), evaluated the first time the
+// descent reads them. cells are computed and cached a TILE x TILE tile at a time, every tile
+// gathers the obstacles within rr of it from a KD tree once, so a cell costs the few obstacles
+// near it instead of all of them. update() moves the obstacles and drops only the tiles within
+// rr of a point that was added or removed
+class PotentialField {
+public:
+    static constexpr int TILE = 16;
+
+    PotentialField() {}
+    PotentialField(double _minx, double _miny, int _xwidth, int _ywidth, double _reso, double _rr,
+                   Vector2d _goal)
+        : minx(_minx), miny(_miny), xwidth(_xwidth), ywidth(_ywidth), reso(_reso), rr(_rr),
+          goal(_goal) {
+        tiles_x = (xwidth + TILE - 1) / TILE;
+        tiles_y = (ywidth + TILE - 1) / TILE;
+        tiles.resize(static_cast<size_t>(tiles_x) * tiles_y);
+    }
+    ~PotentialField() {}
+
+    // the obstacle points are now (ox, oy)
+    void update(const vector<double>& _ox, const vector<double>& _oy);
+
+    double get(int ix, int iy) {
+        vector<double>& tile = tiles[(iy / TILE) * tiles_x + ix / TILE];
+        if (tile.empty()) {
+            calc_tile(ix / TILE, iy / TILE);
+            ++computed_tiles;
+        }
+        return tile[(iy % TILE) * TILE + ix % TILE];
+    }
+
+    int get_xwidth(void) const { return xwidth; }
+    int get_ywidth(void) const { return ywidth; }
+    double get_minx(void) const { return minx; }
+    double get_miny(void) const { return miny; }
+    // tiles computed since construction
+    int get_computed_tiles(void) const { return computed_tiles; }
+    int get_num_tiles(void) const { return tiles.size(); }
+
+private:
+    double minx = 0.0;
+    double miny = 0.0;
+    int xwidth = 0;
+    int ywidth = 0;
+    double reso = 1.0;
+    double rr = 0.0;
+    Vector2d goal = Vector2d::Zero();
+    int tiles_x = 0;
+    int tiles_y = 0;
+    int computed_tiles = 0;
+    vector<vector<double>> tiles;  // empty until read
+    vector<double> ox;
+    vector<double> oy;
+    utils::KDTree<2> tree;
+    vector<size_t> near;
+
+    void calc_tile(int tx, int ty);
+};
+
+void PotentialField::update(const vector<double>& _ox, const vector<double>& _oy) {
+    // points in only one of the old and the new list
+    vector<std::pair<double, double>> old_points, new_points, changed;
+    for (size_t i = 0; i < ox.size(); ++i) {
+        old_points.emplace_back(ox[i], oy[i]);
+    }
+    for (size_t i = 0; i < _ox.size(); ++i) {
+        new_points.emplace_back(_ox[i], _oy[i]);
+    }
+    std::sort(old_points.begin(), old_points.end());
+    std::sort(new_points.begin(), new_points.end());
+    std::set_symmetric_difference(old_points.begin(), old_points.end(), new_points.begin(),
+                                  new_points.end(), std::back_inserter(changed));
+
+    for (const std::pair<double, double>& p : changed) {
+        int tx0 = std::max(0, static_cast<int>(floor((p.first - rr - minx) / reso)) / TILE);
+        int tx1 =
+            std::min(tiles_x - 1, static_cast<int>(ceil((p.first + rr - minx) / reso)) / TILE);
+        int ty0 = std::max(0, static_cast<int>(floor((p.second - rr - miny) / reso)) / TILE);
+        int ty1 =
+            std::min(tiles_y - 1, static_cast<int>(ceil((p.second + rr - miny) / reso)) / TILE);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                vector<double>().swap(tiles[ty * tiles_x + tx]);
+            }
+        }
+    }
+
+    ox = _ox;
+    oy = _oy;
+    tree.build(vector<vector<double>>{ox, oy});
+}
+
+void PotentialField::calc_tile(int tx, int ty) {
+    vector<double>& tile = tiles[ty * tiles_x + tx];
+    tile.assign(TILE * TILE, 0.0);
+    int ix0 = tx * TILE;
+    int iy0 = ty * TILE;
+
+    // every obstacle within rr of a cell of the tile is within rr + half the diagonal of its
+    // center
+    double half = (TILE - 1) * reso / 2.0;
+    tree.radius({ix0 * reso + minx + half, iy0 * reso + miny + half}, rr + half * sqrt(2.0),
+                near);
+
+    for (int cy = 0; cy < TILE && iy0 + cy < ywidth; ++cy) {
+        double y = (iy0 + cy) * reso + miny;
+        for (int cx = 0; cx < TILE && ix0 + cx < xwidth; ++cx) {
+            double x = (ix0 + cx) * reso + minx;
+            double dq = std::numeric_limits<double>::max();
+            for (size_t i : near) {
+                dq = std::min(dq, hypot(ox[i] - x, oy[i] - y));
+            }
+            double ug = calc_attractive_potential({x, y}, goal);
+            double uo = calc_repulsive_potential(dq, rr);
+            tile[cy * TILE + cx] = ug + uo;
+        }
+    }
+}
+
+// grid over the obstacles, start and goal with AREA_WIDTH / 2 around them
+PotentialField calc_potential_field(Vector2d s, Vector2d g, const vector<vector<double>>& obs,
+                                    double reso, double rr) {
     double minx = std::min(utils::min(obs[0]), std::min(s[0], g[0])) - AREA_WIDTH / 2.0;
     double miny = std::min(utils::min(obs[1]), std::min(s[1], g[1])) - AREA_WIDTH / 2.0;
     double maxx = std::max(utils::max(obs[0]), std::max(s[0], g[0])) + AREA_WIDTH / 2.0;
     double maxy = std::max(utils::max(obs[1]), std::max(s[1], g[1])) + AREA_WIDTH / 2.0;
     int xw = static_cast<int>(round((maxx - minx) / reso));
     int yw = static_cast<int>(round((maxy - miny) / reso));
-    vector<vector<double>> pmap_tmp(xw, vector<double>(yw, 0));
-
-    for (int ix = 0; ix < xw; ++ix) {
-        double x = ix * reso + minx;
-        for (int iy = 0; iy < yw; ++iy) {
-            double y = iy * reso + miny;
-            double ug = calc_attractive_potential({x, y}, g);
-            double uo = calc_repulsive_potential({x, y}, obs, rr);
-            double uf = ug + uo;
-            pmap_tmp[ix][iy] = uf;
-        }
-    }
-    pmap = pmap_tmp;
 
-    return {minx, miny};
+    PotentialField field(minx, miny, xw, yw, reso, rr, g);
+    field.update(obs[0], obs[1]);
+
+    return field;
 }
 
 vector<vector<int>> get_motion_model(void) {
@@ -105,10 +206,8 @@ bool oscillations_detection(std::queue<Vector2i> previous_ids, Vector2i ixy) {
 }
 
 vector<vector<double>> potential_field_planning(Vector2d start, Vector2d goal,
-                                                const vector<vector<double>>& obs, double reso,
-                                                double rr) {
-    vector<vector<double>> pmap;
-    Vector2d minxy = calc_potential_field(start, goal, obs, reso, rr, pmap);
+                                                PotentialField& field, double reso) {
+    Vector2d minxy(field.get_minx(), field.get_miny());
     double d = hypot(start[0] - goal[0], start[1] - goal[1]);
     int ix = round((start[0] - minxy[0]) / reso);
     int iy = round((start[1] - minxy[1]) / reso);
@@ -116,19 +215,13 @@ vector<vector<double>> potential_field_planning(Vector2d start, Vector2d goal,
     int giy = round((goal[1] - minxy[1]) / reso);
 
     if (show_animation) {
-        int nrows = pmap.size();
-        int ncols = pmap[0].size();
+        // the image needs every cell, so the whole field is computed here
+        int nrows = field.get_xwidth();
+        int ncols = field.get_ywidth();
         vector<float> im(nrows * ncols);
-        vector<vector<double>> pmap_t(ncols, vector<double>(nrows, 0.0));
-
-        for (int i = 0; i < nrows; i++) {
-            for (int j = 0; j < ncols; j++) {
-                pmap_t[j][i] = pmap[i][j];
-            }
-        }
-        for (size_t j = 0; j < ncols; ++j) {
-            for (size_t i = 0; i < nrows; ++i) {
-                im.at(nrows * j + i) = pmap_t[j][i];
+        for (int j = 0; j < ncols; ++j) {
+            for (int i = 0; i < nrows; ++i) {
+                im[nrows * j + i] = field.get(i, j);
             }
         }
 
@@ -155,8 +248,8 @@ vector<vector<double>> potential_field_planning(Vector2d start, Vector2d goal,
             int inx = ix + motion[0];
             int iny = iy + motion[1];
             double p = std::numeric_limits<double>::max() - 10;
-            if (inx < pmap.size() && iny < pmap[0].size() && inx >= 0 && iny >= 0) {
-                p = pmap[inx][iny];
+            if (inx < field.get_xwidth() && iny < field.get_ywidth() && inx >= 0 && iny >= 0) {
+                p = field.get(inx, iny);
             }
 
             if (minp > p) {
@@ -196,8 +289,10 @@ int main(int argc, char** argv) {
     vector<vector<double>> obstacles = {{15.0, 5.0, 20.0, 25.0}, {25.0, 15.0, 26.0, 25.0}};
 
     utils::TicToc t_m;
-    potential_field_planning(start, goal, obstacles, grid_size, robot_radius);
-    fmt::print("potential_field_planning costtime: {:.3f} s\n", t_m.toc() / 1000);
+    PotentialField field = calc_potential_field(start, goal, obstacles, grid_size, robot_radius);
+    potential_field_planning(start, goal, field, grid_size);
+    fmt::print("potential_field_planning costtime: {:.3f} s, {} of {} tiles computed\n",
+               t_m.toc() / 1000, field.get_computed_tiles(), field.get_num_tiles());
     if (show_animation) {
         plt::show();
     }
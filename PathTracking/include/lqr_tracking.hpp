@@ -0,0 +1,107 @@
+#pragma once
+#ifndef __LQR_TRACKING_HPP
+#define __LQR_TRACKING_HPP
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "lqr_gain_table.hpp"
+#include "thread_pool.hpp"
+#include "trajectory_index.hpp"
+#include "utils.hpp"
+
+// LQR on the cartesian error state x = [e, dot_e, th_e, dot_th_e, delta_v], steering and
+// acceleration at once. the speed dependent entries A(1, 2) and B(3, 0) are solved every tick,
+// or interpolated from a gain table after schedule_gains()
+class LQRController {
+private:
+    Eigen::MatrixXd A;
+    Eigen::MatrixXd B;
+    Eigen::MatrixXd Q;
+    Eigen::MatrixXd R;
+    double dt;
+    double pe;
+    double pth_e;
+
+    utils::LQRGainTable<5, 2> gains;  // empty unless scheduled
+
+    Eigen::MatrixXd solve_LQR(void);
+    Eigen::MatrixXd solve_dare(double tolerance = 0.01, size_t max_iter = 150);
+
+public:
+    LQRController(Eigen::MatrixXd a, Eigen::MatrixXd b, Eigen::MatrixXd q, Eigen::MatrixXd r,
+                  double _dt = 0.1)
+        : A(a), B(b), Q(q), R(r), dt(_dt), pe(0.), pth_e(0.) {}
+    ~LQRController() {}
+
+    // precomputes the gains at n speeds in [v_min, v_max] for a wheelbase wb
+    void schedule_gains(double v_min, double v_max, int n, double wb,
+                        utils::ThreadPool* pool = nullptr);
+    // target is [x, y, yaw, curvature] of the course point, tv the target speed there.
+    // returns [acceleration, steering angle]
+    Eigen::Vector2d compute_input(const utils::VehicleState& state, Eigen::Vector4d target,
+                                  double tv);
+};
+
+// target speed at every course point, it changes sign at cusps and slows down to the end
+std::vector<double> calc_speed_profile(const std::vector<double>& cyaw, double target_speed);
+
+// the errors of a vehicle against a course with yaw and curvature
+class TrajectoryAnalyzer {
+private:
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> yaw;
+    std::vector<double> k;
+    TrajectoryIndex index;
+
+public:
+    TrajectoryAnalyzer() {}
+    TrajectoryAnalyzer(std::vector<double> _x, std::vector<double> _y, std::vector<double> _yaw,
+                       std::vector<double> _k)
+        : x(_x), y(_y), yaw(_yaw), k(_k), index(_x, _y) {}
+    ~TrajectoryAnalyzer() {}
+
+    // theta_e, e_cg, yaw_ref and k_ref at the nearest course point
+    Eigen::Vector4d to_trajectory_frame(const utils::VehicleState& state);
+};
+
+// lateral LQR in the frenet frame on x = [e_cg, dot_e_cg, theta_e, dot_theta_e]
+class LatController {
+private:
+    double dt;
+    double e_cg_old;
+    double theta_e_old;
+
+    Eigen::MatrixXd A;
+    Eigen::MatrixXd B;
+    Eigen::MatrixXd Q;
+    Eigen::MatrixXd R;
+    utils::LQRGainTable<4, 1> gains;  // empty unless scheduled
+
+public:
+    explicit LatController(double _dt = 0.1);
+    ~LatController() {}
+
+    double compute_input(const utils::VehicleState& vehicle_state,
+                         TrajectoryAnalyzer& ref_trajectory);
+    Eigen::MatrixXd solve_LQR(double tolerance = 0.01, size_t max_iter = 150);
+    // precomputes the gains at n speeds in [v_min, v_max] for a wheelbase wb
+    void schedule_gains(double v_min, double v_max, int n, double wb,
+                        utils::ThreadPool* pool = nullptr);
+};
+
+// proportional speed control that brakes within 10 m of the goal
+class LonController {
+private:
+    double kp;
+
+public:
+    explicit LonController(double _kp = 0.3) : kp(_kp) {}
+    ~LonController() {}
+
+    double compute_input(double target_speed, const utils::VehicleState& vehicle_state,
+                         double dist);
+};
+
+#endif
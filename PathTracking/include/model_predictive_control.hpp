@@ -45,10 +45,28 @@ private:
     VectorG gd_;
     // x_{k+1} = Ad * x_{k} + Bd * u_k + gd
 
-    Eigen::SparseMatrix<double> P_, q_, A_, l_, u_;
-    Eigen::SparseMatrix<double> Cx_, lx_, ux_;  // p, v constrains
-    Eigen::SparseMatrix<double> Cu_, lu_, uu_;  // a delta vs constrains
-    Eigen::SparseMatrix<double> Qx_;
+    // condensed QP over the inputs. P_ (upper triangle) and A_ are built once with their full
+    // sparsity pattern, a tick only writes their values, so the solver is set up once and kept
+    Eigen::SparseMatrix<double> P_, A_;
+    Eigen::VectorXd q_, l_, u_;
+    Eigen::SparseMatrix<double> Cu_;  // a delta vs constrains
+    Eigen::VectorXd lu_, uu_;
+    Eigen::VectorXd Qx_;  // diagonal of the state cost
+    Eigen::VectorXd qx_;
+
+    // X = BB * U + xfree, BB is block lower triangular
+    Eigen::MatrixXd BB_, QBB_, PP_;
+    Eigen::VectorXd xfree_;
+
+    OsqpEigen::Solver solver_;
+    Eigen::SparseMatrix<double> P_setup_, A_setup_;  // the patterns the solver was set up with
+    Eigen::VectorXd primal_, dual_;  // last solution, shifted by a tick to warm start the next
+
+    // recorded nonlinear problem of solve_with_taped_ipopt, created on its first call
+    Ipopt::SmartPtr<Ipopt::TNLP> taped_problem_;
+    Ipopt::SmartPtr<Ipopt::IpoptApplication> ipopt_app_;
+
+    int setup_osqp(const utils::VehicleState& x0, const Eigen::MatrixXd& traj_ref);
 
 public:
     using Dvector = CPPAD_TESTVECTOR(double);
@@ -56,8 +74,10 @@ public:
     MPCController();
     ~MPCController() {}
 
-    int solve_with_ipopt(utils::VehicleState& x0, Eigen::MatrixXd traj_ref);
-    int solve_with_osqp(utils::VehicleState& x0, Eigen::MatrixXd traj_ref);
+    int solve_with_ipopt(utils::VehicleState& x0, const Eigen::MatrixXd& traj_ref);
+    int solve_with_osqp(utils::VehicleState& x0, const Eigen::MatrixXd& traj_ref);
+    // solve_with_ipopt without recording the problem again on every call
+    int solve_with_taped_ipopt(utils::VehicleState& x0, const Eigen::MatrixXd& traj_ref);
     void linearization(const double& phi, const double& v, const double& delta);
     void getPredictXU(std::vector<VectorX>& state, std::vector<VectorU>& input) {
         state = predictState_;
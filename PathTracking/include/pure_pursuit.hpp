@@ -0,0 +1,36 @@
+#pragma once
+#ifndef __PURE_PURSUIT_HPP
+#define __PURE_PURSUIT_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "trajectory_index.hpp"
+#include "utils.hpp"
+
+// a course for pure pursuit, the lookahead distance grows with the speed: Lf = k * v + Lfc
+class TargetCourse {
+public:
+    std::vector<double> cx;
+    std::vector<double> cy;
+    TrajectoryIndex index;
+    double k;    // lookahead gain
+    double Lfc;  // [m] lookahead distance at standstill
+
+    TargetCourse(std::vector<double> _cx, std::vector<double> _cy, double _k = 0.1,
+                 double _Lfc = 2.0)
+        : cx(_cx), cy(_cy), index(_cx, _cy), k(_k), Lfc(_Lfc) {}
+    ~TargetCourse() {}
+
+    // index of the lookahead point and the lookahead distance
+    std::tuple<int, double> search_target_index(const utils::VehicleState& state);
+};
+
+double proportional_control(double target, double current, double Kp = 1.0);
+
+// steering angle towards the lookahead point, it never goes back behind the last target pind.
+// returns the new target index and the steering angle
+std::tuple<int, double> pure_pursuit_steer_control(const utils::VehicleState& state,
+                                                   TargetCourse& trajectory, int pind);
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#ifndef __STANLEY_HPP
+#define __STANLEY_HPP
+
+#include <utility>
+#include <vector>
+
+#include "trajectory_index.hpp"
+#include "utils.hpp"
+
+// course point nearest to the front axle and the cross track error of the front axle
+std::pair<size_t, double> stanley_target_index(const utils::VehicleState& state,
+                                               TrajectoryIndex& course);
+
+// steering angle of the Stanley controller with gain k on the cross track error. cyaw is the
+// yaw of the course points, last_target_idx only moves forward and is updated
+double stanley_control(const utils::VehicleState& state, TrajectoryIndex& course,
+                       const std::vector<double>& cyaw, size_t& last_target_idx,
+                       double k = 0.5);
+
+#endif
@@ -0,0 +1,244 @@
+#pragma once
+#ifndef __TRAJECTORY_INDEX_HPP
+#define __TRAJECTORY_INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// nearest point and lookahead queries on a course given as points. the points are hashed into
+// square cells of about two point spacings, only the cells holding points are stored, so a
+// course of any extent costs O(n) memory and a nearest query near the course visits a few
+// cells. while tracking, a cursor only moves forward along the course and is bounded by a
+// window of arc length per tick, it falls back to the hash when the vehicle is off the course.
+// a looped course wraps around from the last point to the first.
+class TrajectoryIndex {
+public:
+    TrajectoryIndex() {}
+    TrajectoryIndex(const std::vector<double>& _x, const std::vector<double>& _y,
+                    bool _loop = false, double _window = 5.0, double _relocalize = 3.0)
+        : px(_x), py(_y), loop(_loop), window(_window), relocalize(_relocalize) {
+        build();
+    }
+    ~TrajectoryIndex() {}
+
+    size_t size(void) const { return px.size(); }
+    bool looped(void) const { return loop; }
+    double x(size_t i) const { return px[i]; }
+    double y(size_t i) const { return py[i]; }
+    // arc length from the first point to point i
+    double s(size_t i) const { return cum_s[i]; }
+    // arc length of the course, with the closing segment of a loop
+    double length(void) const { return total; }
+
+    // forgets the cursor, the next track() searches the whole course
+    void reset(void) { cursor = -1; }
+    int current(void) const { return cursor; }
+
+    // index of the point nearest to (qx, qy) over the whole course. an empty course has none,
+    // the queries then return 0 at an infinite distance
+    size_t nearest(double qx, double qy, double* dist = nullptr) const {
+        if (px.empty()) {
+            if (dist != nullptr) {
+                *dist = std::numeric_limits<double>::infinity();
+            }
+            return 0;
+        }
+        int cx = cell_of(qx);
+        int cy = cell_of(qy);
+        int max_ring =
+            std::max(std::max(cx - min_cx, max_cx - cx), std::max(cy - min_cy, max_cy - cy));
+        size_t best = 0;
+        double best_d2 = std::numeric_limits<double>::max();
+        size_t visited = 0;
+
+        for (int r = 0; r <= max_ring; ++r) {
+            // far away from the course most of the cells are empty, a scan is cheaper then
+            visited += r == 0 ? 1 : 8 * r;
+            if (visited > 4 * cells.size()) {
+                for (size_t i = 0; i < px.size(); ++i) {
+                    check(i, qx, qy, best, best_d2);
+                }
+                break;
+            }
+            for (int iy = cy - r; iy <= cy + r; ++iy) {
+                int step = (iy == cy - r || iy == cy + r) ? 1 : 2 * r;
+                for (int ix = cx - r; ix <= cx + r; ix += step) {
+                    auto it = cells.find(key(ix, iy));
+                    if (it == cells.end()) {
+                        continue;
+                    }
+                    for (int j = it->second.first; j < it->second.second; ++j) {
+                        check(order[j], qx, qy, best, best_d2);
+                    }
+                }
+            }
+            // a point in ring r + 1 is at least r cells away from the query
+            double reach = r * cell;
+            if (best_d2 <= reach * reach) {
+                break;
+            }
+        }
+
+        if (dist != nullptr) {
+            *dist = sqrt(best_d2);
+        }
+        return best;
+    }
+
+    // index of the point nearest to (qx, qy) found by moving the cursor forward while the next
+    // point is not farther, at most window ahead. a vehicle farther than relocalize from it is
+    // searched on the whole course
+    size_t track(double qx, double qy, double* dist = nullptr) {
+        return track(qx, qy, cursor, dist);
+    }
+
+    // track() with a cursor owned by the caller, so many vehicles can share one index. a
+    // negative cursor searches the whole course
+    size_t track(double qx, double qy, int& _cursor, double* dist = nullptr) const {
+        double d;
+        if (px.empty()) {
+            return nearest(qx, qy, dist);
+        }
+        if (_cursor < 0) {
+            _cursor = nearest(qx, qy, &d);
+        } else {
+            size_t i = _cursor;
+            d = hypot(qx - px[i], qy - py[i]);
+            double walked = 0.0;
+            while (walked < window) {
+                size_t j = i + 1;
+                if (j == px.size()) {
+                    if (!loop) {
+                        break;
+                    }
+                    j = 0;
+                }
+                double dj = hypot(qx - px[j], qy - py[j]);
+                if (dj > d) {
+                    break;
+                }
+                walked += seg[i];
+                i = j;
+                d = dj;
+            }
+            if (d > relocalize) {
+                double dn;
+                size_t n = nearest(qx, qy, &dn);
+                if (dn < d) {
+                    i = n;
+                    d = dn;
+                }
+            }
+            _cursor = i;
+        }
+
+        if (dist != nullptr) {
+            *dist = d;
+        }
+        return _cursor;
+    }
+
+    // first point at least ds of arc length ahead of point i. the last point if the course
+    // ends before, a looped course wraps around
+    size_t lookahead(size_t i, double ds) const {
+        if (px.empty()) {
+            return 0;
+        }
+        double target = cum_s[i] + ds;
+        if (loop && total > 0.0) {
+            target = fmod(target, total);
+        }
+        auto it = std::lower_bound(cum_s.begin(), cum_s.end(), target);
+        if (it == cum_s.end()) {
+            return loop ? 0 : px.size() - 1;
+        }
+        return it - cum_s.begin();
+    }
+
+private:
+    std::vector<double> px;
+    std::vector<double> py;
+    bool loop = false;
+    double window = 5.0;
+    double relocalize = 3.0;
+
+    std::vector<double> cum_s;
+    std::vector<double> seg;  // length of the segment from point i to the next one
+    double total = 0.0;
+
+    double cell = 1.0;
+    int min_cx = 0;
+    int min_cy = 0;
+    int max_cx = 0;
+    int max_cy = 0;
+    std::vector<int> order;  // point indices sorted by cell
+    std::unordered_map<int64_t, std::pair<int, int>> cells;  // cell -> range in order
+
+    int cursor = -1;
+
+    int cell_of(double v) const { return static_cast<int>(floor(v / cell)); }
+    static int64_t key(int ix, int iy) {
+        return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(ix)) << 32) |
+                                    static_cast<uint32_t>(iy));
+    }
+
+    void check(size_t i, double qx, double qy, size_t& best, double& best_d2) const {
+        double d2 = (px[i] - qx) * (px[i] - qx) + (py[i] - qy) * (py[i] - qy);
+        if (d2 < best_d2) {
+            best_d2 = d2;
+            best = i;
+        }
+    }
+
+    void build(void) {
+        size_t n = px.size();
+        cum_s.assign(n, 0.0);
+        seg.assign(n, 0.0);
+        for (size_t i = 0; i + 1 < n; ++i) {
+            seg[i] = hypot(px[i + 1] - px[i], py[i + 1] - py[i]);
+            cum_s[i + 1] = cum_s[i] + seg[i];
+        }
+        total = n > 0 ? cum_s[n - 1] : 0.0;
+        if (loop && n > 1) {
+            seg[n - 1] = hypot(px[0] - px[n - 1], py[0] - py[n - 1]);
+            total += seg[n - 1];
+        }
+
+        cell = n > 1 ? 2.0 * total / (n - 1) : 1.0;
+        if (!(cell > 0.0)) {
+            cell = 1.0;
+        }
+        std::vector<int64_t> keys(n);
+        min_cx = min_cy = std::numeric_limits<int>::max();
+        max_cx = max_cy = std::numeric_limits<int>::min();
+        for (size_t i = 0; i < n; ++i) {
+            int ix = cell_of(px[i]);
+            int iy = cell_of(py[i]);
+            keys[i] = key(ix, iy);
+            min_cx = std::min(min_cx, ix);
+            max_cx = std::max(max_cx, ix);
+            min_cy = std::min(min_cy, iy);
+            max_cy = std::max(max_cy, iy);
+        }
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+        cells.clear();
+        for (size_t j = 0; j < n;) {
+            size_t k = j;
+            while (k < n && keys[order[k]] == keys[order[j]]) {
+                ++k;
+            }
+            cells[keys[order[j]]] = std::make_pair(static_cast<int>(j), static_cast<int>(k));
+            j = k;
+        }
+    }
+};
+
+#endif
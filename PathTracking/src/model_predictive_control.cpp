@@ -4,6 +4,7 @@
 #include <fmt/core.h>
 
 #include <Eigen/Core>
+#include <algorithm>
 #include <cmath>
 #include <cppad/cppad.hpp>
 #include <cppad/ipopt/solve.hpp>
@@ -11,7 +12,9 @@
 
 #include "PathPlanning/include/cubic_spline.hpp"
 #include "matplotlibcpp.h"
+#include "profiler.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using CppAD::AD;
 using std::vector;
@@ -30,7 +33,7 @@ constexpr double MAX_ACCEL = 2.0;          // maximum accel [m/ss]
 constexpr double TARGET_SPEED = 10.0 / 3.6;  // [m/s] target speed
 constexpr double DT = 0.2;                   // [s] time tick
 constexpr double WB = 2.5;
-constexpr double show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 constexpr size_t x_start = 0;
 constexpr size_t y_start = x_start + TT;
@@ -40,67 +43,63 @@ constexpr size_t v_start = yaw_start + TT;
 constexpr size_t delta_start = v_start + TT;
 constexpr size_t a_start = delta_start + TT - 1;
 
-double find_nearest_s(Vector2d p, const CubicSpline2D& sp) {
-    static double last_min_s = sp.s.front();
-    double min_dist = (sp.calc_position(sp.s.front()) - p).norm();
-    double min_s = last_min_s;
+// the reference ahead of a vehicle following a course. the projection of the vehicle is kept
+// between ticks, so every controller needs its own tracker
+class CourseTracker {
+public:
+    CourseTracker(const CubicSpline2D* _sp) : sp(_sp), last_s(_sp->s.front()) {}
+    ~CourseTracker() {}
 
-    for (double s = last_min_s; s < sp.s.back() && s < last_min_s + 5; s += 0.01) {
-        double dist = (sp.calc_position(s) - p).norm();
-        if (dist < min_dist) {
-            min_s = s;
-            min_dist = dist;
-        }
+    // s of the course point nearest to p, searched at most 5 m ahead of the last one
+    double find_nearest_s(const Vector2d& p) {
+        last_s = sp->calc_nearest_s(p, last_s, last_s + 5, segment);
+        return last_s;
     }
-    last_min_s = min_s;
 
-    return min_s;
-}
+    // x y yaw delta v of the TT points ahead of state, ref_traj is resized only once
+    void calc_ref_trajectory(const utils::VehicleState& state, MatrixXd& ref_traj) {
+        ref_traj.resize(5, TT);
+        double s0 = find_nearest_s({state.x, state.y});
+        int seg = segment;
+
+        Vector2d xy, dxy, ddxy;
+        for (size_t i = 0; i < TT; ++i) {
+            sp->calc_derivatives(s0, seg, xy, dxy, ddxy);
+            double dphi = (ddxy.y() * dxy.x() - dxy.y() * ddxy.x()) / dxy.squaredNorm();
+            ref_traj(0, i) = xy.x();
+            ref_traj(1, i) = xy.y();
+            ref_traj(2, i) = atan2(dxy.y(), dxy.x());
+            ref_traj(3, i) = atan2(WB * dphi, 1.0);
+            ref_traj(4, i) = sp->s.back() - s0 < TT * TARGET_SPEED * DT ? 0 : TARGET_SPEED;
+
+            s0 += TARGET_SPEED * DT;
+            s0 = s0 < sp->s.back() ? s0 : sp->s.back();
+        }
+    }
 
-void cal_ref_point(double s0, Vector4d& state, const CubicSpline2D& sp) {
-    Vector2d xy = sp(s0, 0);
-    Vector2d dxy = sp(s0, 1);
-    Vector2d ddxy = sp(s0, 2);
-    double dx = dxy.x();
-    double dy = dxy.y();
-    double ddx = ddxy.x();
-    double ddy = ddxy.y();
-    double dphi = (ddy * dx - dy * ddx) / (dx * dx + dy * dy);
-    state[0] = xy.x();
-    state[1] = xy.y();
-    state[2] = atan2(dy, dx);
-    state[3] = atan2(WB * dphi, 1.0);
-}
+private:
+    const CubicSpline2D* sp;
+    double last_s;
+    int segment = 0;
+};
 
-MatrixXd calc_ref_trajectory(const utils::VehicleState& state, const CubicSpline2D& sp) {
-    MatrixXd ref_traj = Matrix<double, 5, TT>::Zero();
-    double s0 = find_nearest_s({state.x, state.y}, sp);
-
-    for (int i = 0; i < TT; ++i) {
-        Vector4d ref_state;
-        cal_ref_point(s0, ref_state, sp);
-        ref_traj(0, i) = ref_state[0];
-        ref_traj(1, i) = ref_state[1];
-        ref_traj(2, i) = ref_state[2];
-        ref_traj(3, i) = ref_state[3];
-        if (sp.s.back() - s0 < TT * TARGET_SPEED * DT) {
-            ref_traj(4, i) = 0;
-        } else {
-            ref_traj(4, i) = TARGET_SPEED;
-        }
+typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
 
-        s0 += TARGET_SPEED * DT;
-        s0 = s0 < sp.s.back() ? s0 : sp.s.back();
-    }
+// traj_ref read from the dynamic parameters of a tape, stored column by column
+class ADReference {
+public:
+    const ADvector* p = nullptr;
 
-    return ref_traj;
-}
+    AD<double> operator()(size_t row, size_t col) const { return (*p)[col * 5 + row]; }
+};
 
+// Reference is a 5 x TT matrix or anything indexed like one
+template <class Reference>
 class FG_EVAL {
 public:
-    Matrix<double, 5, TT> traj_ref;
+    Reference traj_ref;
 
-    FG_EVAL(Matrix<double, 5, TT> traj_ref) { this->traj_ref = traj_ref; }
+    FG_EVAL(const Reference& _traj_ref) : traj_ref(_traj_ref) {}
 
     typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
 
@@ -161,6 +160,364 @@ public:
     }
 };
 
+// the FG_EVAL problem handed to Ipopt directly. CppAD::ipopt::solve records the tape and
+// computes the sparsity patterns of the jacobian and the hessian on every call, here they are
+// built once: traj_ref is a dynamic parameter of the tape, so a tick only sets its values.
+// the solution and its multipliers are kept and shifted by a stage to warm start the next tick
+class TapedMPCProblem : public Ipopt::TNLP {
+public:
+    typedef Ipopt::Index Index;
+    typedef Ipopt::Number Number;
+    typedef CppAD::vector<double> DoubleVector;
+    typedef CppAD::vector<size_t> SizeVector;
+
+    DoubleVector x;  // last solution and its multipliers
+    DoubleVector z_l;
+    DoubleVector z_u;
+    DoubleVector lambda;
+    bool warm = false;  // the last solve succeeded, x and the multipliers are worth reusing
+
+    TapedMPCProblem(size_t _n_vars, size_t _n_constraints);
+    ~TapedMPCProblem() {}
+
+    // bounds, initial state and starting point of the next solve
+    void set_problem(const utils::VehicleState& x0, const MatrixXd& traj_ref);
+
+    bool get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_lag,
+                      IndexStyleEnum& index_style) override;
+    bool get_bounds_info(Index n, Number* x_l, Number* x_u, Index m, Number* g_l,
+                         Number* g_u) override;
+    bool get_starting_point(Index n, bool init_x, Number* x_init, bool init_z, Number* z_L,
+                            Number* z_U, Index m, bool init_lambda, Number* lambda_init) override;
+    bool eval_f(Index n, const Number* x_in, bool new_x, Number& obj_value) override;
+    bool eval_grad_f(Index n, const Number* x_in, bool new_x, Number* grad_f) override;
+    bool eval_g(Index n, const Number* x_in, bool new_x, Index m, Number* g) override;
+    bool eval_jac_g(Index n, const Number* x_in, bool new_x, Index m, Index nele_jac, Index* iRow,
+                    Index* jCol, Number* values) override;
+    bool eval_h(Index n, const Number* x_in, bool new_x, Number obj_factor, Index m,
+                const Number* lambda_in, bool new_lambda, Index nele_hess, Index* iRow,
+                Index* jCol, Number* values) override;
+    void finalize_solution(Ipopt::SolverReturn status, Index n, const Number* x_out,
+                           const Number* z_L, const Number* z_U, Index m, const Number* g,
+                           const Number* lambda_out, Number obj_value,
+                           const Ipopt::IpoptData* ip_data,
+                           Ipopt::IpoptCalculatedQuantities* ip_cq) override;
+
+private:
+    size_t n_vars;
+    size_t n_constraints;
+    CppAD::ADFun<double> fun;  // vars -> fg of FG_EVAL, traj_ref as dynamic parameters
+    DoubleVector vars_lowerbound, vars_upperbound;
+    DoubleVector constraints_lowerbound, constraints_upperbound;
+
+    DoubleVector x_eval;  // point of fg and jac
+    DoubleVector fg;
+    bool fg_valid = false;
+    bool jac_valid = false;
+    // jacobian of fg, row 0 is the gradient of the objective
+    CppAD::sparse_rc<SizeVector> jac_pattern;
+    CppAD::sparse_rcv<SizeVector, DoubleVector> jac;
+    CppAD::sparse_jac_work jac_work;
+    std::vector<size_t> grad_entries;  // entries of jac in row 0
+    std::vector<size_t> g_entries;     // and in the constraint rows
+    // lower triangle of the hessian of sum of w[i] fg[i]
+    CppAD::sparse_rc<SizeVector> hes_pattern;
+    CppAD::sparse_rcv<SizeVector, DoubleVector> hes;
+    CppAD::sparse_hes_work hes_work;
+
+    void update_point(const Number* x_in, bool new_x);
+    void update_jacobian(void);
+};
+
+TapedMPCProblem::TapedMPCProblem(size_t _n_vars, size_t _n_constraints)
+    : n_vars(_n_vars), n_constraints(_n_constraints) {
+    // record
+    ADvector ax(n_vars);
+    ADvector ap(5 * TT);
+    for (size_t idx = 0; idx < n_vars; ++idx) {
+        ax[idx] = 0.0;
+    }
+    for (size_t idx = 0; idx < ap.size(); ++idx) {
+        ap[idx] = 0.0;
+    }
+    CppAD::Independent(ax, 0, false, ap);
+    ADReference reference;
+    reference.p = &ap;
+    FG_EVAL<ADReference> fg_eval(reference);
+    ADvector afg(1 + n_constraints);
+    fg_eval(afg, ax);
+    fun.Dependent(ax, afg);
+    fun.optimize();
+
+    // jacobian pattern
+    size_t n = n_vars;
+    CppAD::sparse_rc<SizeVector> identity(n, n, n);
+    for (size_t k = 0; k < n; ++k) {
+        identity.set(k, k, k);
+    }
+    fun.for_jac_sparsity(identity, false, false, false, jac_pattern);
+    jac = CppAD::sparse_rcv<SizeVector, DoubleVector>(jac_pattern);
+    for (size_t k = 0; k < jac_pattern.nnz(); ++k) {
+        if (jac_pattern.row()[k] == 0) {
+            grad_entries.push_back(k);
+        } else {
+            g_entries.push_back(k);
+        }
+    }
+
+    // hessian pattern, only its lower triangle goes to ipopt
+    CppAD::vector<bool> select_domain(n, true);
+    CppAD::vector<bool> select_range(1 + n_constraints, true);
+    fun.for_hes_sparsity(select_domain, select_range, false, hes_pattern);
+    size_t nnz_lower = 0;
+    for (size_t k = 0; k < hes_pattern.nnz(); ++k) {
+        nnz_lower += hes_pattern.row()[k] >= hes_pattern.col()[k];
+    }
+    CppAD::sparse_rc<SizeVector> lower(n, n, nnz_lower);
+    nnz_lower = 0;
+    for (size_t k = 0; k < hes_pattern.nnz(); ++k) {
+        if (hes_pattern.row()[k] >= hes_pattern.col()[k]) {
+            lower.set(nnz_lower++, hes_pattern.row()[k], hes_pattern.col()[k]);
+        }
+    }
+    hes = CppAD::sparse_rcv<SizeVector, DoubleVector>(lower);
+
+    // the same bounds as solve_with_ipopt
+    vars_lowerbound.resize(n_vars);
+    vars_upperbound.resize(n_vars);
+    for (size_t idx = 0; idx < n_vars; ++idx) {
+        vars_lowerbound[idx] = -1e7;
+        vars_upperbound[idx] = 1e7;
+    }
+    for (size_t idx = delta_start; idx < delta_start + TT - 1; ++idx) {
+        vars_lowerbound[idx] = -MAX_STEER;
+        vars_upperbound[idx] = MAX_STEER;
+    }
+    for (size_t idx = a_start; idx < a_start + TT - 1; ++idx) {
+        vars_lowerbound[idx] = -MAX_ACCEL;
+        vars_upperbound[idx] = MAX_ACCEL;
+    }
+    for (size_t idx = v_start; idx < v_start + TT; ++idx) {
+        vars_lowerbound[idx] = MIN_SPEED;
+        vars_upperbound[idx] = MAX_SPEED;
+    }
+    constraints_lowerbound.resize(n_constraints);
+    constraints_upperbound.resize(n_constraints);
+    for (size_t idx = 0; idx < n_constraints; ++idx) {
+        constraints_lowerbound[idx] = 0;
+        constraints_upperbound[idx] = 0;
+    }
+
+    x.resize(n_vars);
+    z_l.resize(n_vars);
+    z_u.resize(n_vars);
+    lambda.resize(n_constraints);
+    for (size_t idx = 0; idx < n_vars; ++idx) {
+        x[idx] = 0.0;
+        z_l[idx] = 0.0;
+        z_u[idx] = 0.0;
+    }
+    for (size_t idx = 0; idx < n_constraints; ++idx) {
+        lambda[idx] = 0.0;
+    }
+    x_eval.resize(n_vars);
+}
+
+// moves the stages of v one step ahead, the last stage repeats
+static void shift_stages(CppAD::vector<double>& v, size_t start, size_t len) {
+    for (size_t idx = start; idx + 1 < start + len; ++idx) {
+        v[idx] = v[idx + 1];
+    }
+}
+
+void TapedMPCProblem::set_problem(const utils::VehicleState& x0, const MatrixXd& traj_ref) {
+    DoubleVector p(5 * TT);
+    for (size_t col = 0; col < TT; ++col) {
+        for (size_t row = 0; row < 5; ++row) {
+            p[col * 5 + row] = traj_ref(row, col);
+        }
+    }
+    fun.new_dynamic(p);
+    fg_valid = false;
+    jac_valid = false;
+
+    const size_t state_starts[4] = {x_start, y_start, yaw_start, v_start};
+    const double state[4] = {x0.x, x0.y, x0.yaw, x0.v};
+    if (warm) {
+        for (size_t start : {x_start, y_start, yaw_start, v_start}) {
+            shift_stages(x, start, TT);
+            shift_stages(z_l, start, TT);
+            shift_stages(z_u, start, TT);
+            // row start fixes the initial state, the dynamics of stage i are row start + i
+            shift_stages(lambda, start + 1, TT - 1);
+        }
+        for (size_t start : {delta_start, a_start}) {
+            shift_stages(x, start, TT - 1);
+            shift_stages(z_l, start, TT - 1);
+            shift_stages(z_u, start, TT - 1);
+        }
+    } else {
+        for (size_t idx = 0; idx < n_vars; ++idx) {
+            x[idx] = 0.0;
+        }
+    }
+    for (int k = 0; k < 4; ++k) {
+        x[state_starts[k]] = state[k];
+        constraints_lowerbound[state_starts[k]] = state[k];
+        constraints_upperbound[state_starts[k]] = state[k];
+    }
+}
+
+bool TapedMPCProblem::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_lag,
+                                   IndexStyleEnum& index_style) {
+    n = n_vars;
+    m = n_constraints;
+    nnz_jac_g = g_entries.size();
+    nnz_h_lag = hes.nnz();
+    index_style = C_STYLE;
+
+    return true;
+}
+
+bool TapedMPCProblem::get_bounds_info(Index n, Number* x_l, Number* x_u, Index m, Number* g_l,
+                                      Number* g_u) {
+    for (Index idx = 0; idx < n; ++idx) {
+        x_l[idx] = vars_lowerbound[idx];
+        x_u[idx] = vars_upperbound[idx];
+    }
+    for (Index idx = 0; idx < m; ++idx) {
+        g_l[idx] = constraints_lowerbound[idx];
+        g_u[idx] = constraints_upperbound[idx];
+    }
+
+    return true;
+}
+
+bool TapedMPCProblem::get_starting_point(Index n, bool init_x, Number* x_init, bool init_z,
+                                         Number* z_L, Number* z_U, Index m, bool init_lambda,
+                                         Number* lambda_init) {
+    for (Index idx = 0; init_x && idx < n; ++idx) {
+        x_init[idx] = x[idx];
+    }
+    for (Index idx = 0; init_z && idx < n; ++idx) {
+        z_L[idx] = z_l[idx];
+        z_U[idx] = z_u[idx];
+    }
+    for (Index idx = 0; init_lambda && idx < m; ++idx) {
+        lambda_init[idx] = lambda[idx];
+    }
+
+    return true;
+}
+
+void TapedMPCProblem::update_point(const Number* x_in, bool new_x) {
+    if (fg_valid && !new_x) {
+        return;
+    }
+    for (size_t idx = 0; idx < n_vars; ++idx) {
+        x_eval[idx] = x_in[idx];
+    }
+    fg = fun.Forward(0, x_eval);
+    fg_valid = true;
+    jac_valid = false;
+}
+
+void TapedMPCProblem::update_jacobian(void) {
+    if (!jac_valid) {
+        fun.sparse_jac_rev(x_eval, jac, jac_pattern, "cppad", jac_work);
+        jac_valid = true;
+    }
+}
+
+bool TapedMPCProblem::eval_f(Index n, const Number* x_in, bool new_x, Number& obj_value) {
+    update_point(x_in, new_x);
+    obj_value = fg[0];
+
+    return true;
+}
+
+bool TapedMPCProblem::eval_grad_f(Index n, const Number* x_in, bool new_x, Number* grad_f) {
+    update_point(x_in, new_x);
+    update_jacobian();
+    for (Index idx = 0; idx < n; ++idx) {
+        grad_f[idx] = 0.0;
+    }
+    for (size_t k : grad_entries) {
+        grad_f[jac.col()[k]] = jac.val()[k];
+    }
+
+    return true;
+}
+
+bool TapedMPCProblem::eval_g(Index n, const Number* x_in, bool new_x, Index m, Number* g) {
+    update_point(x_in, new_x);
+    for (Index idx = 0; idx < m; ++idx) {
+        g[idx] = fg[idx + 1];
+    }
+
+    return true;
+}
+
+bool TapedMPCProblem::eval_jac_g(Index n, const Number* x_in, bool new_x, Index m,
+                                 Index nele_jac, Index* iRow, Index* jCol, Number* values) {
+    if (values == nullptr) {
+        for (size_t k = 0; k < g_entries.size(); ++k) {
+            iRow[k] = jac_pattern.row()[g_entries[k]] - 1;
+            jCol[k] = jac_pattern.col()[g_entries[k]];
+        }
+        return true;
+    }
+
+    update_point(x_in, new_x);
+    update_jacobian();
+    for (size_t k = 0; k < g_entries.size(); ++k) {
+        values[k] = jac.val()[g_entries[k]];
+    }
+
+    return true;
+}
+
+bool TapedMPCProblem::eval_h(Index n, const Number* x_in, bool new_x, Number obj_factor, Index m,
+                             const Number* lambda_in, bool new_lambda, Index nele_hess,
+                             Index* iRow, Index* jCol, Number* values) {
+    if (values == nullptr) {
+        for (size_t k = 0; k < hes.nnz(); ++k) {
+            iRow[k] = hes.row()[k];
+            jCol[k] = hes.col()[k];
+        }
+        return true;
+    }
+
+    update_point(x_in, new_x);
+    DoubleVector w(1 + m);
+    w[0] = obj_factor;
+    for (Index idx = 0; idx < m; ++idx) {
+        w[idx + 1] = lambda_in[idx];
+    }
+    fun.sparse_hes(x_eval, w, hes, hes_pattern, "cppad.symmetric", hes_work);
+    for (size_t k = 0; k < hes.nnz(); ++k) {
+        values[k] = hes.val()[k];
+    }
+
+    return true;
+}
+
+void TapedMPCProblem::finalize_solution(Ipopt::SolverReturn status, Index n, const Number* x_out,
+                                        const Number* z_L, const Number* z_U, Index m,
+                                        const Number* g, const Number* lambda_out,
+                                        Number obj_value, const Ipopt::IpoptData* ip_data,
+                                        Ipopt::IpoptCalculatedQuantities* ip_cq) {
+    for (Index idx = 0; idx < n; ++idx) {
+        x[idx] = x_out[idx];
+        z_l[idx] = z_L[idx];
+        z_u[idx] = z_U[idx];
+    }
+    for (Index idx = 0; idx < m; ++idx) {
+        lambda[idx] = lambda_out[idx];
+    }
+    warm = status == Ipopt::SUCCESS || status == Ipopt::STOP_AT_ACCEPTABLE_POINT;
+}
+
 MPCController::MPCController(void) {
     ll_ = WB;
     dt_ = DT;
@@ -187,31 +544,38 @@ MPCController::MPCController(void) {
     Bd_.setZero();
     Bd_(3, 0) = dt_;
     gd_.setZero();
-    // set size of sparse matrices
-    P_.resize(NU * N_, NU * N_);
-    q_.resize(NU * N_, 1);
-    Qx_.resize(NX * N_, NX * N_);
     // stage cost
-    Qx_.setIdentity();
+    Qx_.setOnes(NX * N_);
     for (int i = 1; i < N_; ++i) {
-        Qx_.coeffRef(i * NX - 2, i * NX - 2) = rho_;
-        Qx_.coeffRef(i * NX - 1, i * NX - 1) = 0;
+        Qx_(i * NX - 2) = rho_;
+        Qx_(i * NX - 1) = 0;
+    }
+    Qx_(N_ * NX - 4) = rhoN_;
+    Qx_(N_ * NX - 3) = rhoN_;
+    Qx_(N_ * NX - 2) = rhoN_ * rho_;
+    qx_.setZero(NX * N_);
+    BB_.setZero(NX * N_, NU * N_);
+    QBB_.setZero(NX * N_, NU * N_);
+    PP_.setZero(NU * N_, NU * N_);
+    xfree_.setZero(NX * N_);
+
+    // P is dense, its upper triangle is passed to the solver
+    vector<Eigen::Triplet<double>> triplets;
+    for (int col = 0; col < NU * N_; ++col) {
+        for (int row = 0; row <= col; ++row) {
+            triplets.emplace_back(row, col, 0.0);
+        }
     }
-    Qx_.coeffRef(N_ * NX - 4, N_ * NX - 4) = rhoN_;
-    Qx_.coeffRef(N_ * NX - 3, N_ * NX - 3) = rhoN_;
-    Qx_.coeffRef(N_ * NX - 2, N_ * NX - 2) = rhoN_ * rho_;
+    P_.resize(NU * N_, NU * N_);
+    P_.setFromTriplets(triplets.begin(), triplets.end());
+    P_.makeCompressed();
+    q_.setZero(NU * N_);
+
     int n_cons = 4;  // v a delta ddelta
-    A_.resize(n_cons * N_, NU * N_);
-    l_.resize(n_cons * N_, 1);
-    u_.resize(n_cons * N_, 1);
-    // v constrains
-    Cx_.resize(1 * N_, NX * N_);
-    lx_.resize(1 * N_, 1);
-    ux_.resize(1 * N_, 1);
     // a delta constrains
     Cu_.resize(3 * N_, NU * N_);
-    lu_.resize(3 * N_, 1);
-    uu_.resize(3 * N_, 1);
+    lu_.setZero(3 * N_);
+    uu_.setZero(3 * N_);
     // set lower and upper boundaries
     for (int i = 0; i < N_; ++i) {
         // set stage constraints of inputs (a, delta, ddelta)
@@ -219,22 +583,40 @@ MPCController::MPCController(void) {
         Cu_.coeffRef(i * 3 + 0, i * NU + 0) = 1;
         Cu_.coeffRef(i * 3 + 1, i * NU + 1) = 1;
         Cu_.coeffRef(i * 3 + 2, i * NU + 1) = 1;
-        lu_.coeffRef(i * 3 + 0, 0) = -a_max_;
-        uu_.coeffRef(i * 3 + 0, 0) = a_max_;
-        lu_.coeffRef(i * 3 + 1, 0) = -delta_max_;
-        uu_.coeffRef(i * 3 + 1, 0) = delta_max_;
-        lu_.coeffRef(i * 3 + 2, 0) = -ddelta_max_ * dt_;
-        uu_.coeffRef(i * 3 + 2, 0) = ddelta_max_ * dt_;
+        lu_(i * 3 + 0) = -a_max_;
+        uu_(i * 3 + 0) = a_max_;
+        lu_(i * 3 + 1) = -delta_max_;
+        uu_(i * 3 + 1) = delta_max_;
+        lu_(i * 3 + 2) = -ddelta_max_ * dt_;
+        uu_(i * 3 + 2) = ddelta_max_ * dt_;
         if (i > 0) {
             Cu_.coeffRef(i * 3 + 2, (i - 1) * NU + 1) = -1;
         }
+    }
 
-        // set stage constraints of states (v)
-        // -v_max <= v <= v_max
-        Cx_.coeffRef(i, i * NX + 3) = 1;
-        lx_.coeffRef(i, 0) = -0.1;
-        ux_.coeffRef(i, 0) = v_max_;
+    // the first N rows bound v of every stage (-0.1 <= v <= v_max), the speed of stage i
+    // depends on the inputs up to i. the input constraints Cu follow
+    triplets.clear();
+    for (int i = 0; i < N_; ++i) {
+        for (int col = 0; col < NU * (i + 1); ++col) {
+            triplets.emplace_back(i, col, 0.0);
+        }
+    }
+    for (int k = 0; k < Cu_.outerSize(); ++k) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(Cu_, k); it; ++it) {
+            triplets.emplace_back(N_ + it.row(), it.col(), it.value());
+        }
     }
+    A_.resize(n_cons * N_, NU * N_);
+    A_.setFromTriplets(triplets.begin(), triplets.end());
+    A_.makeCompressed();
+    l_.setZero(n_cons * N_);
+    u_.setZero(n_cons * N_);
+    l_.tail(3 * N_) = lu_;
+    u_.tail(3 * N_) = uu_;
+    primal_.setZero(NU * N_);
+    dual_.setZero(n_cons * N_);
+
     // set predict mats size
     predictState_.resize(N_);
     predictInput_.resize(N_);
@@ -243,7 +625,7 @@ MPCController::MPCController(void) {
     }
 }
 
-int MPCController::solve_with_ipopt(utils::VehicleState& x0, MatrixXd traj_ref) {
+int MPCController::solve_with_ipopt(utils::VehicleState& x0, const MatrixXd& traj_ref) {
     double x = x0.x;
     double y = x0.y;
     double yaw = x0.yaw;
@@ -293,14 +675,16 @@ int MPCController::solve_with_ipopt(utils::VehicleState& x0, MatrixXd traj_ref)
     constraints_upperbound[yaw_start] = yaw;
     constraints_upperbound[v_start] = v;
 
-    FG_EVAL fg_eval(traj_ref);
+    typedef FG_EVAL<Matrix<double, 5, TT>> FixedFG_EVAL;
+    FixedFG_EVAL fg_eval(traj_ref);
     // place to return solution
     CppAD::ipopt::solve_result<Dvector> solution;
 
     // solve the problem
-    CppAD::ipopt::solve<Dvector, FG_EVAL>(optimize_options, vars, vars_lowerbound, vars_upperbound,
-                                          constraints_lowerbound, constraints_upperbound, fg_eval,
-                                          solution);
+    PROFILE_ZONE("mpc/nlp_solve");
+    CppAD::ipopt::solve<Dvector, FixedFG_EVAL>(optimize_options, vars, vars_lowerbound,
+                                               vars_upperbound, constraints_lowerbound,
+                                               constraints_upperbound, fg_eval, solution);
 
     bool ok = true;
     ok &= solution.status == CppAD::ipopt::solve_result<Dvector>::success;
@@ -311,8 +695,10 @@ int MPCController::solve_with_ipopt(utils::VehicleState& x0, MatrixXd traj_ref)
     }
 
     for (int i = 0; i < N_; ++i) {
-        predictInput_[i][0] = solution.x[a_start + i];
-        predictInput_[i][1] = solution.x[delta_start + i];
+        // there are TT - 1 inputs, the last stage keeps the one before
+        size_t k = std::min<size_t>(i, TT - 2);
+        predictInput_[i][0] = solution.x[a_start + k];
+        predictInput_[i][1] = solution.x[delta_start + k];
         predictState_[i][0] = solution.x[x_start + i];
         predictState_[i][1] = solution.x[y_start + i];
         predictState_[i][2] = solution.x[yaw_start + i];
@@ -326,6 +712,54 @@ int MPCController::solve_with_ipopt(utils::VehicleState& x0, MatrixXd traj_ref)
     return 0;
 }
 
+int MPCController::solve_with_taped_ipopt(utils::VehicleState& x0, const MatrixXd& traj_ref) {
+    if (Ipopt::IsNull(taped_problem_)) {
+        // both are kept only once the application is initialized, a failure retries next call
+        Ipopt::SmartPtr<Ipopt::IpoptApplication> app = new Ipopt::IpoptApplication();
+        app->Options()->SetIntegerValue("print_level", 0);
+        app->Options()->SetStringValue("sb", "yes");
+        app->Options()->SetIntegerValue("max_iter", 300);
+        app->Options()->SetNumericValue("tol", 1e-6);
+        app->Options()->SetNumericValue("max_cpu_time", 0.5);
+        // keep a warm start near the last solution
+        app->Options()->SetNumericValue("warm_start_bound_push", 1e-6);
+        app->Options()->SetNumericValue("warm_start_mult_bound_push", 1e-6);
+        if (app->Initialize() != Ipopt::Solve_Succeeded) {
+            return -1;
+        }
+        ipopt_app_ = app;
+        taped_problem_ = new TapedMPCProblem(n_vars, n_constraints);
+    }
+    TapedMPCProblem* problem = static_cast<TapedMPCProblem*>(Ipopt::GetRawPtr(taped_problem_));
+    {
+        PROFILE_ZONE("mpc/nlp_setup");
+        problem->set_problem(x0, traj_ref);
+    }
+    ipopt_app_->Options()->SetStringValue("warm_start_init_point", problem->warm ? "yes" : "no");
+    Ipopt::ApplicationReturnStatus status;
+    {
+        PROFILE_ZONE("mpc/nlp_solve");
+        status = ipopt_app_->OptimizeTNLP(taped_problem_);
+    }
+
+    for (int i = 0; i < N_; ++i) {
+        // there are TT - 1 inputs, the last stage keeps the one before
+        size_t k = std::min<size_t>(i, TT - 2);
+        predictInput_[i][0] = problem->x[a_start + k];
+        predictInput_[i][1] = problem->x[delta_start + k];
+        predictState_[i][0] = problem->x[x_start + i];
+        predictState_[i][1] = problem->x[y_start + i];
+        predictState_[i][2] = problem->x[yaw_start + i];
+        predictState_[i][3] = problem->x[v_start + i];
+    }
+
+    if (status != Ipopt::Solve_Succeeded && status != Ipopt::Solved_To_Acceptable_Level) {
+        return -1;
+    }
+
+    return 0;
+}
+
 void MPCController::linearization(const double& phi, const double& v, const double& delta) {
     // set values to Ad_, Bd_, gd_
     Ad_(0, 2) = -v * sin(phi) * dt_;
@@ -339,19 +773,25 @@ void MPCController::linearization(const double& phi, const double& v, const doub
     gd_(2) = -v / ll_ / cos(delta) / cos(delta) * dt_ * delta;
 }
 
-int MPCController::solve_with_osqp(utils::VehicleState& x0_, MatrixXd traj_ref) {
-    lu_.coeffRef(2, 0) = predictInput_.front()(1) - ddelta_max_ * dt_;
-    uu_.coeffRef(2, 0) = predictInput_.front()(1) + ddelta_max_ * dt_;
+static bool same_pattern(const Eigen::SparseMatrix<double>& a,
+                         const Eigen::SparseMatrix<double>& b) {
+    return a.rows() == b.rows() && a.cols() == b.cols() && a.nonZeros() == b.nonZeros() &&
+           std::equal(a.outerIndexPtr(), a.outerIndexPtr() + a.outerSize() + 1,
+                      b.outerIndexPtr()) &&
+           std::equal(a.innerIndexPtr(), a.innerIndexPtr() + a.nonZeros(), b.innerIndexPtr());
+}
+
+// condensed QP of the linearized model around the last prediction, the matrices are written into
+// the fixed sparsity patterns and handed to the solver
+int MPCController::setup_osqp(const utils::VehicleState& x0_, const MatrixXd& traj_ref) {
+    PROFILE_ZONE("mpc/qp_setup");
+    l_(N_ + 2) = predictInput_.front()(1) - ddelta_max_ * dt_;
+    u_(N_ + 2) = predictInput_.front()(1) + ddelta_max_ * dt_;
     VectorX x0 = {x0_.x, x0_.y, x0_.yaw, x0_.v};
 
-    MatrixXd BB, AA, gg;
-    BB.setZero(NX * N_, NU * N_);
-    AA.setZero(NX * N_, NX);
-    gg.setZero(NX * N_, 1);
     double phi, v, delta;
     double last_phi = x0(2);
-    Eigen::SparseMatrix<double> qx;
-    qx.resize(NX * N_, 1);
+    VectorX xfree = x0;
 
     for (int i = 0; i < N_; ++i) {
         phi = traj_ref(2, i);
@@ -385,82 +825,100 @@ int MPCController::solve_with_osqp(utils::VehicleState& x0_, MatrixXd traj_ref)
          * ...   |     ...  ...  ... 0 |    | ... |
          * xN    \A^(n-1)B  ...  ... B /    \ A^N /
          *
-         *     X = BB * U + AA * x0 + gg
+         *     X = BB * U + xfree, xfree = AA * x0 + gg
          * */
-        if (i == 0) {
-            BB.block(0, 0, NX, NU) = Bd_;
-            AA.block(0, 0, NX, NX) = Ad_;
-            gg.block(0, 0, NX, 1) = gd_;
-        } else {
-            // set BB AA gg
-            BB.block(NX * i, 0, NX, NU * N_) = Ad_ * BB.block(NX * (i - 1), 0, NX, NU * N_);
-            BB.block(NX * i, NU * i, NX, NU) = Bd_;
-            AA.block(NX * i, 0, NX, NX) = Ad_ * AA.block(NX * (i - 1), 0, NX, NX);
-            gg.block(NX * i, 0, NX, 1) = Ad_ * gg.block(NX * (i - 1), 0, NX, 1) + gd_;
+        // only the first i blocks of a row are non-zero, the ones above the diagonal stay zero
+        if (i > 0) {
+            BB_.block(NX * i, 0, NX, NU * i).noalias() =
+                Ad_ * BB_.block(NX * (i - 1), 0, NX, NU * i);
         }
+        BB_.block(NX * i, NU * i, NX, NU) = Bd_;
+        xfree = Ad_ * xfree + gd_;
+        xfree_.segment<NX>(NX * i) = xfree;
         // set qx
-        qx.coeffRef(i * NX + 0, 0) = -traj_ref(0, i);
-        qx.coeffRef(i * NX + 1, 0) = -traj_ref(1, i);
-        qx.coeffRef(i * NX + 2, 0) = -rho_ * phi;
+        qx_(i * NX + 0) = -traj_ref(0, i);
+        qx_(i * NX + 1) = -traj_ref(1, i);
+        qx_(i * NX + 2) = -rho_ * phi;
         if (i == N_ - 1) {
-            qx.coeffRef(i * NX + 0, 0) *= rhoN_;
-            qx.coeffRef(i * NX + 1, 0) *= rhoN_;
-            qx.coeffRef(i * NX + 2, 0) *= rhoN_;
-        }
-    }
-
-    Eigen::SparseMatrix<double> BB_sparse = BB.sparseView();
-    Eigen::SparseMatrix<double> AA_sparse = AA.sparseView();
-    Eigen::SparseMatrix<double> gg_sparse = gg.sparseView();
-    Eigen::SparseMatrix<double> x0_sparse = x0.sparseView();
-
-    Eigen::SparseMatrix<double> Cx = Cx_ * BB_sparse;
-    Eigen::SparseMatrix<double> lx = lx_ - Cx_ * AA_sparse * x0_sparse - Cx_ * gg_sparse;
-    Eigen::SparseMatrix<double> ux = ux_ - Cx_ * AA_sparse * x0_sparse - Cx_ * gg_sparse;
-    Eigen::SparseMatrix<double> A_T = A_.transpose();
-    A_T.middleCols(0, Cx.rows()) = Cx.transpose();
-    A_T.middleCols(Cx.rows(), Cu_.rows()) = Cu_.transpose();
-    A_ = A_T.transpose();
-    for (int i = 0; i < lx.rows(); ++i) {
-        l_.coeffRef(i, 0) = lx.coeff(i, 0);
-        u_.coeffRef(i, 0) = ux.coeff(i, 0);
-    }
-    for (int i = 0; i < lu_.rows(); ++i) {
-        l_.coeffRef(i + lx.rows(), 0) = lu_.coeff(i, 0);
-        u_.coeffRef(i + lx.rows(), 0) = uu_.coeff(i, 0);
-    }
-    Eigen::SparseMatrix<double> BBT_sparse = BB_sparse.transpose();
-    P_ = BBT_sparse * Qx_ * BB_sparse;
-    q_ = BBT_sparse * Qx_.transpose() * (AA_sparse * x0_sparse + gg_sparse) + BBT_sparse * qx;
-
-    // osqp
-    OsqpEigen::Solver solver;
-    Eigen::VectorXd q_d = q_.toDense();
-    Eigen::VectorXd l_d = l_.toDense();
-    Eigen::VectorXd u_d = u_.toDense();
-
-    solver.settings()->setVerbosity(false);
-    solver.settings()->setWarmStart(true);
-    solver.data()->setNumberOfVariables(P_.rows());
-    solver.data()->setNumberOfConstraints(A_.rows());
-    solver.data()->setHessianMatrix(P_);
-    solver.data()->setGradient(q_d);
-    solver.data()->setLinearConstraintsMatrix(A_);
-    solver.data()->setLowerBound(l_d);
-    solver.data()->setUpperBound(u_d);
-
-    if (!solver.initSolver()) {
-        return -1;
+            qx_(i * NX + 0) *= rhoN_;
+            qx_(i * NX + 1) *= rhoN_;
+            qx_(i * NX + 2) *= rhoN_;
+        }
     }
 
-    if (solver.solveProblem() != OsqpEigen::ErrorExitFlag::NoError) {
+    // P = BB' Q BB, q = BB' (Q xfree + qx), written into the fixed patterns
+    QBB_.noalias() = Qx_.asDiagonal() * BB_;
+    PP_.noalias() = BB_.transpose() * QBB_;
+    q_.noalias() = BB_.transpose() * (Qx_.cwiseProduct(xfree_) + qx_);
+    for (int k = 0; k < P_.outerSize(); ++k) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(P_, k); it; ++it) {
+            it.valueRef() = PP_(it.row(), k);
+        }
+    }
+    for (int k = 0; k < A_.outerSize(); ++k) {
+        for (Eigen::SparseMatrix<double>::InnerIterator it(A_, k); it && it.row() < N_; ++it) {
+            it.valueRef() = BB_(NX * it.row() + 3, k);
+        }
+    }
+    for (int i = 0; i < N_; ++i) {
+        l_(i) = -0.1 - xfree_(NX * i + 3);
+        u_(i) = v_max_ - xfree_(NX * i + 3);
+    }
+
+    // osqp. the update functions only take new values for the patterns the solver was set up
+    // with, OsqpEigen silently sets a changed one up again and loses the warm start, so a change
+    // would go unnoticed. the patterns are fixed in the constructor and this never happens
+    if (solver_.isInitialized() && (!same_pattern(P_, P_setup_) || !same_pattern(A_, A_setup_))) {
+        fmt::print("mpc: the qp sparsity pattern changed, set up osqp again\n");
+        solver_.clearSolver();
+        solver_.data()->clearHessianMatrix();
+        solver_.data()->clearLinearConstraintsMatrix();
+    }
+    if (!solver_.isInitialized()) {
+        solver_.settings()->setVerbosity(false);
+        solver_.settings()->setWarmStart(true);
+        solver_.data()->setNumberOfVariables(P_.rows());
+        solver_.data()->setNumberOfConstraints(A_.rows());
+        if (!solver_.data()->setHessianMatrix(P_) || !solver_.data()->setGradient(q_) ||
+            !solver_.data()->setLinearConstraintsMatrix(A_) ||
+            !solver_.data()->setLowerBound(l_) || !solver_.data()->setUpperBound(u_) ||
+            !solver_.initSolver()) {
+            return -1;
+        }
+        P_setup_ = P_;
+        A_setup_ = A_;
+    } else {
+        if (!solver_.updateHessianMatrix(P_) || !solver_.updateGradient(q_) ||
+            !solver_.updateLinearConstraintsMatrix(A_) || !solver_.updateBounds(l_, u_)) {
+            return -1;
+        }
+        // the last solution a tick later: every input and every stage row moves one stage up,
+        // the last stage repeats
+        std::copy(primal_.data() + NU, primal_.data() + NU * N_, primal_.data());
+        std::copy(dual_.data() + 1, dual_.data() + N_, dual_.data());
+        std::copy(dual_.data() + N_ + 3, dual_.data() + 4 * N_, dual_.data() + N_);
+        solver_.setWarmStart(primal_, dual_);
+    }
+
+    return 0;
+}
+
+int MPCController::solve_with_osqp(utils::VehicleState& x0_, const MatrixXd& traj_ref) {
+    if (setup_osqp(x0_, traj_ref) != 0) {
         return -1;
     }
+    {
+        PROFILE_ZONE("mpc/qp_solve");
+        if (solver_.solveProblem() != OsqpEigen::ErrorExitFlag::NoError) {
+            return -1;
+        }
+    }
 
-    VectorXd sol = solver.getSolution();
-    MatrixXd solMat = Eigen::Map<const MatrixXd>(sol.data(), NU, N_);
+    primal_ = solver_.getSolution();
+    dual_ = solver_.getDualSolution();
+    MatrixXd solMat = Eigen::Map<const MatrixXd>(primal_.data(), NU, N_);
 
-    VectorXd solState = BB * sol + AA * x0 + gg;
+    VectorXd solState = BB_ * primal_ + xfree_;
     MatrixXd predictMat = Eigen::Map<const MatrixXd>(solState.data(), NX, N_);
 
     for (int i = 0; i < N_; ++i) {
@@ -472,7 +930,7 @@ int MPCController::solve_with_osqp(utils::VehicleState& x0_, MatrixXd traj_ref)
     return 0;
 }
 
-enum class MPC_Solver { IPOPT, OSQP };
+enum class MPC_Solver { IPOPT, OSQP, TAPED_IPOPT, TAPED_VS_IPOPT };
 
 int main(int argc, char** argv) {
     // vector<double> ax = {0.0, 60.0, 125.0, 50.0, 75.0, 35.0, -10.0};
@@ -486,6 +944,12 @@ int main(int argc, char** argv) {
     if (argc > 1 && atoi(argv[1]) == 1) {
         mpc_solver = MPC_Solver::OSQP;
         fmt::print("use osqp to solve\n");
+    } else if (argc > 1 && atoi(argv[1]) == 2) {
+        mpc_solver = MPC_Solver::TAPED_IPOPT;
+        fmt::print("use ipopt on a recorded tape to solve\n");
+    } else if (argc > 1 && atoi(argv[1]) == 3) {
+        mpc_solver = MPC_Solver::TAPED_VS_IPOPT;
+        fmt::print("use ipopt on a recorded tape to solve and compare it with ipopt\n");
     } else {
         fmt::print("use ipopt to solve\n");
     }
@@ -502,6 +966,10 @@ int main(int argc, char** argv) {
     vc.WB = WB;
     utils::VehicleState state(vc, 0, 0, 0, 0);
     MPCController mpc;
+    MPCController reference;  // solve_with_ipopt on the same problems, to compare the taped one
+    double max_deviation = 0.0;
+    CourseTracker tracker(&sp);
+    MatrixXd ref_traj;
 
     double time = 0.0;
 
@@ -511,20 +979,37 @@ int main(int argc, char** argv) {
     vector<double> t_h;
     vector<VectorX> x;
     vector<VectorU> u;
+    int solves = 0;
+    int failures = 0;
     while (MAX_SIM_TIME >= time) {
-        MatrixXd ref_traj = calc_ref_trajectory(state, sp);
+        tracker.calc_ref_trajectory(state, ref_traj);
 
         int ret = 0;
         if (mpc_solver == MPC_Solver::IPOPT) {
             ret = mpc.solve_with_ipopt(state, ref_traj);
+        } else if (mpc_solver == MPC_Solver::TAPED_IPOPT ||
+                   mpc_solver == MPC_Solver::TAPED_VS_IPOPT) {
+            ret = mpc.solve_with_taped_ipopt(state, ref_traj);
         } else {
             ret = mpc.solve_with_osqp(state, ref_traj);
         }
+        ++solves;
         if (ret != 0) {
+            ++failures;
             fmt::print("mpc solve error !\n");
         }
 
         mpc.getPredictXU(x, u);
+        if (mpc_solver == MPC_Solver::TAPED_VS_IPOPT && ret == 0 &&
+            reference.solve_with_ipopt(state, ref_traj) == 0) {
+            vector<VectorX> x_ref;
+            vector<VectorU> u_ref;
+            reference.getPredictXU(x_ref, u_ref);
+            for (size_t idx = 0; idx < TT; ++idx) {
+                max_deviation = std::max(
+                    max_deviation, hypot(x[idx][0] - x_ref[idx][0], x[idx][1] - x_ref[idx][1]));
+            }
+        }
 
         vector<vector<double>> ooxy(2);
         for (size_t idx = 1; idx < TT; ++idx) {
@@ -563,6 +1048,10 @@ int main(int argc, char** argv) {
             plt::pause(0.01);
         }
     }
+    fmt::print("{} of {} mpc solves failed\n", failures, solves);
+    if (mpc_solver == MPC_Solver::TAPED_VS_IPOPT) {
+        fmt::print("predictions at most {:.2e} m from solve_with_ipopt\n", max_deviation);
+    }
     plt::show();
 
     return 0;
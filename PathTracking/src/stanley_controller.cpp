@@ -1,70 +1,24 @@
 #include <fmt/core.h>
 
-#include <Eigen/Eigen>
-#include <algorithm>
 #include <cmath>
 #include <string>
 #include <vector>
 
 #include "PathPlanning/include/cubic_spline.hpp"
 #include "matplotlibcpp.h"
+#include "stanley.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::vector;
-using namespace Eigen;
 namespace plt = matplotlibcpp;
 
 constexpr double DT = 0.1;
 constexpr double MAX_SIM_TIME = 100.0;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
-double k = 0.5;   // control gain
-double Kp = 1.0;  // speed proportional gain
-
-std::pair<size_t, double> calc_target_index(const utils::VehicleState& state,
-                                            const vector<double>& cx, const vector<double>& cy) {
-    double fx = state.x + (state.vc.RF) * cos(state.yaw);
-    double fy = state.y + (state.vc.RF) * sin(state.yaw);
-    double min_d = std::numeric_limits<double>::max();
-    size_t target_idx = -1;
-    Vector2d error_vec;
-
-    for (size_t idx = 0; idx < cx.size(); ++idx) {
-        double dx = fx - cx[idx];
-        double dy = fy - cy[idx];
-        double d = hypot(dx, dy);
-        if (d <= min_d) {
-            min_d = d;
-            target_idx = idx;
-            error_vec << dx, dy;
-        }
-    }
-
-    Vector2d front_axle_vec(-cos(state.yaw + M_PI_2), -sin(state.yaw + M_PI_2));
-    double error_front_axle = error_vec.dot(front_axle_vec);
-
-    return std::make_pair(target_idx, error_front_axle);
-}
-
-double stanley_control(const utils::VehicleState& state, const vector<double>& cx,
-                       const vector<double>& cy, const vector<double>& cyaw,
-                       size_t& last_target_idx) {
-    auto _target = calc_target_index(state, cx, cy);
-    size_t current_target_idx = _target.first;
-    double error_front_axle = _target.second;
-
-    if (last_target_idx >= current_target_idx) {
-        current_target_idx = last_target_idx;
-    }
-
-    // Sometimes you need to set a scaling factor for theta_e, e.g. 0.8
-    double theta_e = utils::pi_2_pi(cyaw[current_target_idx] - state.yaw) * 0.8;
-    double theta_d = atan2(k * error_front_axle, state.v);
-    double delta = theta_e + theta_d;
-    last_target_idx = current_target_idx;
-
-    return delta;
-}
+constexpr double k = 0.5;   // control gain
+constexpr double Kp = 1.0;  // speed proportional gain
 
 int main(int argc, char** argv) {
     vector<double> ax = {0.0, 50.0, 50.0, 25.0, 30.0};
@@ -84,13 +38,14 @@ int main(int argc, char** argv) {
     vector<double> yaw = {state.yaw};
     vector<double> v = {state.v};
     vector<double> t = {0.0};
-    auto _target = calc_target_index(state, cx, cy);
+    TrajectoryIndex course(cx, cy);
+    auto _target = stanley_target_index(state, course);
     size_t target_idx = _target.first;
     utils::TicToc t_m;
 
     while (MAX_SIM_TIME >= time && last_idx > target_idx) {
         double ai = Kp * (target_speed - state.v);
-        double di = stanley_control(state, cx, cy, cyaw, target_idx);
+        double di = stanley_control(state, course, cyaw, target_idx, k);
         state.update(ai, di, DT);
 
         time += DT;
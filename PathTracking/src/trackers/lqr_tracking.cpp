@@ -0,0 +1,236 @@
+#include "lqr_tracking.hpp"
+
+#include <Eigen/LU>
+#include <cmath>
+
+using std::vector;
+using namespace Eigen;
+
+void LQRController::schedule_gains(double v_min, double v_max, int n, double wb,
+                                   utils::ThreadPool* pool) {
+    auto model = [wb](double v, Matrix<double, 5, 5>& a, Matrix<double, 5, 2>& b) {
+        a(1, 2) = v;
+        b(3, 0) = v / wb;
+    };
+    gains = utils::LQRGainTable<5, 2>(A, B, model, Q, R);
+    gains.build(v_min, v_max, n, pool);
+}
+
+MatrixXd LQRController::solve_LQR(void) {
+    MatrixXd P = solve_dare();
+    // compute the LQR gain
+    MatrixXd K = ((B.transpose() * P * B + R)).inverse() * (B.transpose() * P * A);
+
+    return K;
+}
+
+// solve a Discrete-time Algebraic Riccati Equation (DARE)
+// x_{k+1} = A * x_{k} + B * u_{k}
+// J = sum{ x_{k}.T * Q * x_{k} + u_{k}.T * R * u_{k} }
+MatrixXd LQRController::solve_dare(double tolerance, size_t max_iter) {
+    MatrixXd p = Q;
+    MatrixXd p_next = Q;
+
+    for (size_t i = 0; i < max_iter; ++i) {
+        p_next =
+            A.transpose() * p * A -
+            A.transpose() * p * B * (R + B.transpose() * p * B).inverse() * B.transpose() * p * A +
+            Q;
+
+        if ((p_next - p).array().abs().maxCoeff() < tolerance) {
+            break;
+        }
+        p = p_next;
+    }
+
+    return p_next;
+}
+
+Vector2d LQRController::compute_input(const utils::VehicleState& state, Vector4d target,
+                                      double tv) {
+    double dxl = target[0] - state.x;
+    double dyl = target[1] - state.y;
+    double e = hypot(dxl, dyl);
+    double angle = utils::pi_2_pi(target[2] - atan2(dyl, dxl));
+    if (angle < 0) {
+        e *= -1;
+    }
+
+    double v = state.v;
+    double th_e = utils::pi_2_pi(state.yaw - target[2]);
+    Matrix<double, 2, 5> K;
+    if (gains.empty()) {
+        A(1, 2) = v;
+        B(3, 0) = v / state.vc.WB;
+        K = solve_LQR();
+    } else {
+        K = gains.gain(v);
+    }
+    // state vector x = [e, dot_e, th_e, dot_th_e, delta_v]
+    Matrix<double, 5, 1> x = Matrix<double, 5, 1>::Zero();
+    x << e, (e - pe) / dt, th_e, (th_e - pth_e) / dt, v - tv;
+
+    Vector2d ustar = -K * x;
+    double steer_angle_feedforward = atan2(state.vc.WB * target[3], 1);
+    double steer_angle_feedback = utils::pi_2_pi(ustar(0, 0));
+    double delta = steer_angle_feedforward + steer_angle_feedback;
+    double accel = ustar(1, 0);
+
+    pe = e;
+    pth_e = th_e;
+
+    return {accel, delta};
+}
+
+vector<double> calc_speed_profile(const vector<double>& cyaw, double target_speed) {
+    int len = cyaw.size();
+    vector<double> speed_profile(len, target_speed);
+    int direction = 1;
+
+    for (size_t idx = 0; idx < len - 1; ++idx) {
+        double dyaw = abs(cyaw[idx + 1] - cyaw[idx]);
+        bool sw = (M_PI_4 <= dyaw && dyaw < M_PI_2);
+
+        if (sw) {
+            direction *= -1;
+        }
+        if (direction < 0) {
+            speed_profile[idx] = -target_speed;
+        } else {
+            speed_profile[idx] = target_speed;
+        }
+        if (sw) {
+            speed_profile[idx] = 0;
+        }
+    }
+
+    for (size_t idx = 0; idx < 30; ++idx) {
+        speed_profile[len - 1 - idx] = target_speed / (30 - idx);
+        if (speed_profile[len - 1 - idx] <= 1.0 / 3.6) {
+            speed_profile[len - 1 - idx] = 1.0 / 3.6;
+        }
+    }
+
+    return speed_profile;
+}
+
+Vector4d TrajectoryAnalyzer::to_trajectory_frame(const utils::VehicleState& vehicle_state) {
+    double x_cg = vehicle_state.x;
+    double y_cg = vehicle_state.y;
+    double cyaw = vehicle_state.yaw;
+    // theta_e, e_cg, yaw_ref, k_ref
+    Vector4d ret(0, 0, 0, 0);
+
+    double dist;
+    size_t ind = index.track(x_cg, y_cg, &dist);
+    Vector3d min_dist(x_cg - x[ind], y_cg - y[ind], dist);
+
+    Vector2d vec_axle_rot_90(cos(cyaw + M_PI_2), sin(cyaw + M_PI_2));
+    Vector2d vec_path_2_cg(min_dist[0], min_dist[1]);
+    if (vec_axle_rot_90.transpose() * vec_path_2_cg > 0) {
+        ret[1] = min_dist[2];
+    } else {
+        ret[1] = -1 * min_dist[2];
+    }
+
+    ret[2] = yaw[ind];
+    ret[0] = utils::pi_2_pi(cyaw - ret[2]);
+    ret[3] = k[ind];
+
+    return ret;
+}
+
+LatController::LatController(double _dt) : dt(_dt), e_cg_old(0), theta_e_old(0) {
+    A = Matrix4d::Zero();
+    A(0, 0) = 1.0;
+    A(0, 1) = dt;
+    A(2, 2) = 1.0;
+    A(2, 3) = dt;
+    B = Matrix<double, 4, 1>::Zero();
+    Q = Matrix4d::Identity();
+    Q(0, 0) = 0.1;
+    Q(2, 2) = 0.1;
+    R = Matrix<double, 1, 1>::Identity();
+}
+
+void LatController::schedule_gains(double v_min, double v_max, int n, double wb,
+                                   utils::ThreadPool* pool) {
+    auto model = [wb](double v, Matrix4d& a, Matrix<double, 4, 1>& b) {
+        a(1, 2) = v;
+        b(3, 0) = v / wb;
+    };
+    gains = utils::LQRGainTable<4, 1>(A, B, model, Q, R);
+    gains.build(v_min, v_max, n, pool);
+}
+
+double LatController::compute_input(const utils::VehicleState& vehicle_state,
+                                    TrajectoryAnalyzer& ref_trajectory) {
+    Vector4d traj_vec = ref_trajectory.to_trajectory_frame(vehicle_state);
+    double theta_e = traj_vec[0];
+    double e_cg = traj_vec[1];
+    double yaw_ref = traj_vec[2];
+    double k_ref = traj_vec[3];
+
+    Matrix<double, 1, 4> K;
+    if (gains.empty()) {
+        A(1, 2) = vehicle_state.v;
+        B(3, 0) = vehicle_state.v / vehicle_state.vc.WB;
+        K = solve_LQR();
+    } else {
+        K = gains.gain(vehicle_state.v);
+    }
+    Matrix<double, 4, 1> x = Matrix<double, 4, 1>::Zero();
+    x << e_cg, (e_cg - e_cg_old) / dt, theta_e, (theta_e - theta_e_old) / dt;
+
+    Matrix<double, 1, 1> ustar = -K * x;
+    double steer_angle_feedback = utils::pi_2_pi(ustar(0, 0));
+    double steer_angle_feedforward = atan2(vehicle_state.vc.WB * k_ref, 1);
+    double steer_angle = steer_angle_feedback + steer_angle_feedforward;
+
+    e_cg_old = e_cg;
+    theta_e_old = theta_e;
+
+    return steer_angle;
+}
+
+MatrixXd LatController::solve_LQR(double tolerance, size_t max_iter) {
+    MatrixXd P = Q;
+    MatrixXd P_next = Q;
+
+    // solve a Discrete-time Algebraic Riccati Equation
+    for (size_t i = 0; i < max_iter; ++i) {
+        P_next =
+            A.transpose() * P * A -
+            A.transpose() * P * B * (R + B.transpose() * P * B).inverse() * B.transpose() * P * A +
+            Q;
+
+        if ((P_next - P).array().abs().maxCoeff() < tolerance) {
+            P = P_next;
+            break;
+        }
+        P = P_next;
+    }
+
+    MatrixXd K = ((B.transpose() * P * B + R)).inverse() * (B.transpose() * P * A);
+
+    return K;
+}
+
+double LonController::compute_input(double target_speed, const utils::VehicleState& vehicle_state,
+                                    double dist) {
+    // Longitudinal Controller using PID
+    // Currently, the planned path is not converted to the frenet coordinate,
+    // and this is not a longitudinal control in the frenet coordinate.
+    // Fortunately, if there is a trajectory in the frenet coordinate, it can be easily converted.
+    double accel = kp * (target_speed - vehicle_state.v);
+
+    if (dist < 10.0) {
+        if (vehicle_state.v > 2.0) {
+            accel = -3.0;
+        } else if (vehicle_state.v < -2) {
+            accel = -1.0;
+        }
+    }
+
+    return accel;
+}
@@ -0,0 +1,44 @@
+#include "pure_pursuit.hpp"
+
+#include <cmath>
+
+using std::tuple;
+using std::vector;
+
+tuple<int, double> TargetCourse::search_target_index(const utils::VehicleState& state) {
+    size_t ind = index.track(state.x, state.y);
+    double Lf = k * state.v + Lfc;
+
+    return std::make_tuple(index.lookahead(ind, Lf), Lf);
+}
+
+double proportional_control(double target, double current, double Kp) {
+    return Kp * (target - current);
+}
+
+tuple<int, double> pure_pursuit_steer_control(const utils::VehicleState& state,
+                                              TargetCourse& trajectory, int pind) {
+    tuple<int, double> ret = trajectory.search_target_index(state);
+    int ind = std::get<0>(ret);
+    double Lf = std::get<1>(ret);
+
+    if (pind >= ind) {
+        ind = pind;
+    }
+
+    double tx;
+    double ty;
+    if (ind < trajectory.cx.size()) {
+        tx = trajectory.cx[ind];
+        ty = trajectory.cy[ind];
+    } else {
+        tx = trajectory.cx.back();
+        ty = trajectory.cy.back();
+        ind = trajectory.cx.size() - 1;
+    }
+
+    double alpha = atan2(ty - state.y, tx - state.x) - state.yaw;
+    double delta = atan2(2.0 * state.vc.WB * sin(alpha) / Lf, 1.0);
+
+    return std::make_tuple(ind, delta);
+}
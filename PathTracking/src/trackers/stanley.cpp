@@ -0,0 +1,39 @@
+#include "stanley.hpp"
+
+#include <Eigen/Core>
+#include <cmath>
+
+using std::vector;
+using namespace Eigen;
+
+std::pair<size_t, double> stanley_target_index(const utils::VehicleState& state,
+                                               TrajectoryIndex& course) {
+    double fx = state.x + (state.vc.RF) * cos(state.yaw);
+    double fy = state.y + (state.vc.RF) * sin(state.yaw);
+    size_t target_idx = course.track(fx, fy);
+    Vector2d error_vec(fx - course.x(target_idx), fy - course.y(target_idx));
+
+    Vector2d front_axle_vec(-cos(state.yaw + M_PI_2), -sin(state.yaw + M_PI_2));
+    double error_front_axle = error_vec.dot(front_axle_vec);
+
+    return std::make_pair(target_idx, error_front_axle);
+}
+
+double stanley_control(const utils::VehicleState& state, TrajectoryIndex& course,
+                       const vector<double>& cyaw, size_t& last_target_idx, double k) {
+    auto _target = stanley_target_index(state, course);
+    size_t current_target_idx = _target.first;
+    double error_front_axle = _target.second;
+
+    if (last_target_idx >= current_target_idx) {
+        current_target_idx = last_target_idx;
+    }
+
+    // Sometimes you need to set a scaling factor for theta_e, e.g. 0.8
+    double theta_e = utils::pi_2_pi(cyaw[current_target_idx] - state.yaw) * 0.8;
+    double theta_d = atan2(k * error_front_axle, state.v);
+    double delta = theta_e + theta_d;
+    last_target_idx = current_target_idx;
+
+    return delta;
+}
@@ -0,0 +1,252 @@
+#pragma once
+#ifndef __EKF_BANK_HPP
+#define __EKF_BANK_HPP
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+
+#include "thread_pool.hpp"
+
+// N extended Kalman filters of the model of extend_kalman_filter_location: state [x y yaw v],
+// input [v yawrate], a position measurement [x y]. the states and the 10 distinct entries of
+// the symmetric covariances are stored as columns of N doubles, so predict and update are
+// loops over filters that only do element-wise arithmetic. the 2x2 innovation covariance is
+// inverted in closed form and the covariance update is the Joseph form
+// (I - KH) P (I - KH)' + K R K', which stays symmetric and positive definite under rounding.
+// a ThreadPool shards the filters into blocks of BLOCK.
+//
+// measurements may arrive from other threads: push() puts one into a single producer single
+// consumer queue of filter i, update_queued() drains every queue.
+class EKFBank {
+public:
+    static constexpr size_t BLOCK = 256;
+    static constexpr size_t QUEUE_SIZE = 8;
+
+    // column k of X is state component k of every filter
+    Eigen::Array<double, Eigen::Dynamic, 4> X;
+    // columns P00 P01 P02 P03 P11 P12 P13 P22 P23 P33
+    Eigen::Array<double, Eigen::Dynamic, 10> P;
+
+    EKFBank(size_t n, double _dt, const Eigen::Matrix4d& _Q, const Eigen::Matrix2d& _R)
+        : dt(_dt), Q(_Q), R(_R), queues(new MeasurementQueue[n]) {
+        X.setZero(n, 4);
+        P.setZero(n, 10);
+        P.col(0).setOnes();
+        P.col(4).setOnes();
+        P.col(7).setOnes();
+        P.col(9).setOnes();
+    }
+    ~EKFBank() {}
+
+    size_t size(void) const { return X.rows(); }
+
+    Eigen::Vector4d state(size_t i) const { return X.row(i).transpose(); }
+    Eigen::Matrix4d covariance(size_t i) const {
+        Eigen::Matrix4d c;
+        c << P(i, 0), P(i, 1), P(i, 2), P(i, 3), P(i, 1), P(i, 4), P(i, 5), P(i, 6), P(i, 2),
+            P(i, 5), P(i, 7), P(i, 8), P(i, 3), P(i, 6), P(i, 8), P(i, 9);
+        return c;
+    }
+    void set(size_t i, const Eigen::Vector4d& x, const Eigen::Matrix4d& c) {
+        X.row(i) = x.transpose();
+        P.row(i) << c(0, 0), c(0, 1), c(0, 2), c(0, 3), c(1, 1), c(1, 2), c(1, 3), c(2, 2),
+            c(2, 3), c(3, 3);
+    }
+
+    // row i of U is the input of filter i
+    void predict(const Eigen::Array<double, Eigen::Dynamic, 2>& U,
+                 utils::ThreadPool* pool = nullptr) {
+        for_blocks([&](size_t begin, size_t end) { predict_range(begin, end, U); }, pool);
+    }
+
+    // row i of Z is the measurement of filter i, filters with mask(i) == 0 keep their estimate
+    void update(const Eigen::Array<double, Eigen::Dynamic, 2>& Z, const Eigen::ArrayXd& mask,
+                utils::ThreadPool* pool = nullptr) {
+        for_blocks([&](size_t begin, size_t end) { update_range(begin, end, Z, mask); }, pool);
+    }
+    void update(const Eigen::Array<double, Eigen::Dynamic, 2>& Z,
+                utils::ThreadPool* pool = nullptr) {
+        update(Z, Eigen::ArrayXd::Ones(size()), pool);
+    }
+
+    // queues a measurement of filter i, false if the queue is full. one producer per filter
+    bool push(size_t i, double zx, double zy) { return queues[i].push(zx, zy); }
+
+    // applies the queued measurements in arrival order, one batch update per round
+    void update_queued(utils::ThreadPool* pool = nullptr) {
+        size_t n = size();
+        Eigen::Array<double, Eigen::Dynamic, 2> Z(n, 2);
+        Eigen::ArrayXd mask(n);
+        while (true) {
+            bool any = false;
+            for (size_t i = 0; i < n; ++i) {
+                bool got = queues[i].pop(Z(i, 0), Z(i, 1));
+                mask[i] = got ? 1.0 : 0.0;
+                any = any || got;
+            }
+            if (!any) {
+                break;
+            }
+            update(Z, mask, pool);
+        }
+    }
+
+private:
+    class MeasurementQueue {
+    public:
+        bool push(double zx, double zy) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == QUEUE_SIZE) {
+                return false;
+            }
+            slots[t % QUEUE_SIZE] = {zx, zy};
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+        bool pop(double& zx, double& zy) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            zx = slots[h % QUEUE_SIZE][0];
+            zy = slots[h % QUEUE_SIZE][1];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<std::array<double, 2>, QUEUE_SIZE> slots;
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+    };
+
+    double dt;
+    Eigen::Matrix4d Q;
+    Eigen::Matrix2d R;
+    std::unique_ptr<MeasurementQueue[]> queues;
+
+    template <typename Fn>
+    void for_blocks(Fn&& fn, utils::ThreadPool* pool) {
+        size_t n = size();
+        size_t blocks = (n + BLOCK - 1) / BLOCK;
+        if (pool == nullptr || blocks <= 1) {
+            fn(0, n);
+            return;
+        }
+        pool->parallel_for(
+            blocks, [&](size_t b, int) { fn(b * BLOCK, std::min(n, (b + 1) * BLOCK)); });
+    }
+
+    // x = f(x, u) and P = F P F' + Q with the jacobian F = I + [0 0 a b; 0 0 c d; 0; 0]
+    // evaluated at the predicted state
+    void predict_range(size_t begin, size_t end,
+                       const Eigen::Array<double, Eigen::Dynamic, 2>& U) {
+        double* x = &X(0, 0);
+        double* y = &X(0, 1);
+        double* yaw = &X(0, 2);
+        double* v = &X(0, 3);
+        double* p[10];
+        for (int k = 0; k < 10; ++k) {
+            p[k] = &P(0, k);
+        }
+        const double* uv = &U(0, 0);
+        const double* uw = &U(0, 1);
+
+        for (size_t i = begin; i < end; ++i) {
+            x[i] += dt * cos(yaw[i]) * uv[i];
+            y[i] += dt * sin(yaw[i]) * uv[i];
+            yaw[i] += dt * uw[i];
+            v[i] += uv[i];
+
+            double a = -dt * uv[i] * sin(yaw[i]);
+            double b = dt * cos(yaw[i]);
+            double c = dt * uv[i] * cos(yaw[i]);
+            double d = dt * sin(yaw[i]);
+            double p00 = p[0][i], p01 = p[1][i], p02 = p[2][i], p03 = p[3][i];
+            double p11 = p[4][i], p12 = p[5][i], p13 = p[6][i];
+            double p22 = p[7][i], p23 = p[8][i], p33 = p[9][i];
+            // rows 0 and 1 of F P
+            double g00 = p00 + a * p02 + b * p03;
+            double g01 = p01 + a * p12 + b * p13;
+            double g02 = p02 + a * p22 + b * p23;
+            double g03 = p03 + a * p23 + b * p33;
+            double g11 = p11 + c * p12 + d * p13;
+            double g12 = p12 + c * p22 + d * p23;
+            double g13 = p13 + c * p23 + d * p33;
+
+            p[0][i] = g00 + a * g02 + b * g03 + Q(0, 0);
+            p[1][i] = g01 + c * g02 + d * g03 + Q(0, 1);
+            p[2][i] = g02 + Q(0, 2);
+            p[3][i] = g03 + Q(0, 3);
+            p[4][i] = g11 + c * g12 + d * g13 + Q(1, 1);
+            p[5][i] = g12 + Q(1, 2);
+            p[6][i] = g13 + Q(1, 3);
+            p[7][i] = p22 + Q(2, 2);
+            p[8][i] = p23 + Q(2, 3);
+            p[9][i] = p33 + Q(3, 3);
+        }
+    }
+
+    // H = [I 0], so S = P[0:2, 0:2] + R and K = P[:, 0:2] S^-1. with C = P[:, 0:2] the Joseph
+    // form is P - K C' - C K' + K S K'. the mask scales K, a masked filter is left unchanged
+    void update_range(size_t begin, size_t end, const Eigen::Array<double, Eigen::Dynamic, 2>& Z,
+                      const Eigen::ArrayXd& mask) {
+        double* xs[4];
+        for (int k = 0; k < 4; ++k) {
+            xs[k] = &X(0, k);
+        }
+        double* p[10];
+        for (int k = 0; k < 10; ++k) {
+            p[k] = &P(0, k);
+        }
+        const double* zx = &Z(0, 0);
+        const double* zy = &Z(0, 1);
+        const double* m = mask.data();
+        const double r00 = R(0, 0), r01 = R(0, 1), r11 = R(1, 1);
+
+        for (size_t i = begin; i < end; ++i) {
+            // C rows
+            double c[4][2] = {{p[0][i], p[1][i]},
+                              {p[1][i], p[4][i]},
+                              {p[2][i], p[5][i]},
+                              {p[3][i], p[6][i]}};
+            double s00 = p[0][i] + r00;
+            double s01 = p[1][i] + r01;
+            double s11 = p[4][i] + r11;
+            double inv_det = m[i] / (s00 * s11 - s01 * s01);
+            double i00 = s11 * inv_det;
+            double i01 = -s01 * inv_det;
+            double i11 = s00 * inv_det;
+
+            double k[4][2];
+            for (int r = 0; r < 4; ++r) {
+                k[r][0] = c[r][0] * i00 + c[r][1] * i01;
+                k[r][1] = c[r][0] * i01 + c[r][1] * i11;
+            }
+            double y0 = zx[i] - xs[0][i];
+            double y1 = zy[i] - xs[1][i];
+            for (int r = 0; r < 4; ++r) {
+                xs[r][i] += k[r][0] * y0 + k[r][1] * y1;
+            }
+
+            // (r, s) entries of the upper triangle in storage order
+            int e = 0;
+            for (int r = 0; r < 4; ++r) {
+                double ks0 = k[r][0] * s00 + k[r][1] * s01;
+                double ks1 = k[r][0] * s01 + k[r][1] * s11;
+                for (int s = r; s < 4; ++s, ++e) {
+                    p[e][i] += -(k[r][0] * c[s][0] + k[r][1] * c[s][1]) -
+                               (c[r][0] * k[s][0] + c[r][1] * k[s][1]) +
+                               (ks0 * k[s][0] + ks1 * k[s][1]);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -3,11 +3,17 @@
 #define __SIMULATOR_HPP
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <functional>
+#include <limits>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include "matplotlibcpp.h"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 class VehicleSimulator {
@@ -41,29 +47,38 @@ public:
 
     std::vector<Eigen::Vector2d> interpolate(std::vector<Eigen::Vector2d>& xy);
     void update(double dt, double a, double omega);
-    std::vector<std::vector<double>> calc_global_contour(void);
+    std::vector<std::vector<double>> calc_global_contour(void) const;
+    // the contour in the global frame into gx and gy, which hold contour_size() entries
+    void calc_global_contour(double* gx, double* gy) const;
+    size_t contour_size(void) const { return vc_xy.size(); }
     void plot(void);
 };
 
-int VehicleSimulator::global_id = 0;
+inline int VehicleSimulator::global_id = 0;
 
-std::vector<Eigen::Vector2d> VehicleSimulator::interpolate(std::vector<Eigen::Vector2d>& xy_vec) {
+inline std::vector<Eigen::Vector2d> VehicleSimulator::interpolate(
+    std::vector<Eigen::Vector2d>& xy_vec) {
     std::vector<Eigen::Vector2d> rxy;
-    double d_theta = 0.05;
+    // theta counts in integer steps, summing up 0.05 ends the edges short of 1.0
+    int steps = 20;
 
-    for (size_t idx = 0; idx < xy_vec.size() - 1; ++idx) {
-        for (double theta = 0; theta <= 1.0; theta += d_theta) {
+    for (size_t idx = 0; idx + 1 < xy_vec.size(); ++idx) {
+        for (int i = 0; i < steps; ++i) {
+            double theta = static_cast<double>(i) / steps;
             Eigen::Vector2d xy;
             xy[0] = (1.0 - theta) * xy_vec[idx][0] + theta * xy_vec[idx + 1][0];
             xy[1] = (1.0 - theta) * xy_vec[idx][1] + theta * xy_vec[idx + 1][1];
             rxy.emplace_back(xy);
         }
     }
+    if (!xy_vec.empty()) {
+        rxy.emplace_back(xy_vec.back());
+    }
 
     return rxy;
 }
 
-void VehicleSimulator::update(double dt, double a, double omega) {
+inline void VehicleSimulator::update(double dt, double a, double omega) {
     x += v * cos(yaw) * dt;
     y += v * sin(yaw) * dt;
     yaw += omega * dt;
@@ -73,7 +88,7 @@ void VehicleSimulator::update(double dt, double a, double omega) {
     }
 }
 
-std::vector<std::vector<double>> VehicleSimulator::calc_global_contour(void) {
+inline std::vector<std::vector<double>> VehicleSimulator::calc_global_contour(void) const {
     std::vector<std::vector<double>> gxy(2);
 
     for (size_t idx = 0; idx < vc_xy.size(); ++idx) {
@@ -87,7 +102,16 @@ std::vector<std::vector<double>> VehicleSimulator::calc_global_contour(void) {
     return gxy;
 }
 
-void VehicleSimulator::plot(void) {
+inline void VehicleSimulator::calc_global_contour(double* gx, double* gy) const {
+    double c = cos(yaw);
+    double s = sin(yaw);
+    for (size_t idx = 0; idx < vc_xy.size(); ++idx) {
+        gx[idx] = vc_xy[idx][0] * c - vc_xy[idx][1] * s + x;
+        gy[idx] = vc_xy[idx][0] * s + vc_xy[idx][1] * c + y;
+    }
+}
+
+inline void VehicleSimulator::plot(void) {
     matplotlibcpp::plot({x}, {y}, ".b");
     std::vector<std::vector<double>> gxy = calc_global_contour();
     if (id < 1) {
@@ -109,20 +133,20 @@ public:
     }
     ~LidarSimulator() {}
 
-    std::vector<std::vector<double>> get_observation_points(std::vector<VehicleSimulator> v_list,
-                                                            double angle_resolution);
-    std::vector<std::vector<double>> ray_casting_filter(std::vector<double> theta_l,
-                                                        std::vector<double> range_l,
+    std::vector<std::vector<double>> get_observation_points(
+        const std::vector<VehicleSimulator>& v_list, double angle_resolution);
+    std::vector<std::vector<double>> ray_casting_filter(const std::vector<double>& theta_l,
+                                                        const std::vector<double>& range_l,
                                                         double angle_resolution);
 };
 
-std::vector<std::vector<double>> LidarSimulator::get_observation_points(
-    std::vector<VehicleSimulator> v_list, double angle_resolution) {
+inline std::vector<std::vector<double>> LidarSimulator::get_observation_points(
+    const std::vector<VehicleSimulator>& v_list, double angle_resolution) {
     std::vector<double> angle;
     std::vector<double> r;
     std::normal_distribution<> gaussian_d(0, range_noise);
 
-    for (VehicleSimulator v : v_list) {
+    for (const VehicleSimulator& v : v_list) {
         std::vector<std::vector<double>> gxy = v.calc_global_contour();
         for (size_t idx = 0; idx < gxy[0].size(); ++idx) {
             double v_angle = atan2(gxy[1][idx], gxy[0][idx]);
@@ -136,9 +160,9 @@ std::vector<std::vector<double>> LidarSimulator::get_observation_points(
     return rxy;
 }
 
-std::vector<std::vector<double>> LidarSimulator::ray_casting_filter(std::vector<double> theta_l,
-                                                                    std::vector<double> range_l,
-                                                                    double angle_resolution) {
+inline std::vector<std::vector<double>> LidarSimulator::ray_casting_filter(
+    const std::vector<double>& theta_l, const std::vector<double>& range_l,
+    double angle_resolution) {
     std::vector<std::vector<double>> rxy(2);
     std::vector<double> range_db(static_cast<int>(floor(M_PI * 2 / angle_resolution) + 1),
                                  std::numeric_limits<double>::max());
@@ -161,4 +185,211 @@ std::vector<std::vector<double>> LidarSimulator::ray_casting_filter(std::vector<
     return rxy;
 }
 
+// one scan of LidarScanner. range has one entry per beam, beam b points at b * resolution and
+// is max() where it hit nothing. xy holds the hit points in beam order as {x}, {y} rows
+class LidarScan {
+public:
+    double time = 0.0;
+    std::vector<double> range;
+    std::vector<std::vector<double>> xy = std::vector<std::vector<double>>(2);
+
+    LidarScan() {}
+    ~LidarScan() {}
+
+    // exchanges the buffers, nothing is copied
+    void swap(LidarScan& other) {
+        std::swap(time, other.time);
+        range.swap(other.range);
+        xy.swap(other.xy);
+    }
+};
+
+// scan generation that casts every beam against the vehicle contours as segments. the beams
+// are split into a fixed number of angular sectors, a sector is cast by one pool worker into
+// its own part of the range buffer with its own noise engine, so a scan is reproducible for
+// any thread count. every buffer is kept across scans, a steady stream does not allocate.
+//
+// scans go out through a callback, called on the scanning thread, and through a ring of RING
+// scans for one consumer thread. a full ring drops the new scan and counts it in dropped().
+class LidarScanner {
+public:
+    static constexpr size_t RING = 8;
+
+    LidarScanner(double _resolution, double _range_noise = 0.01, int _sectors = 16,
+                 unsigned int seed = 0)
+        : resolution(_resolution), range_noise(_range_noise), sectors(_sectors) {
+        beams = static_cast<int>(ceil(2.0 * M_PI / resolution - 1e-9));
+        cos_beam.resize(beams);
+        sin_beam.resize(beams);
+        for (int b = 0; b < beams; ++b) {
+            cos_beam[b] = cos(b * resolution);
+            sin_beam[b] = sin(b * resolution);
+        }
+        for (int s = 0; s < sectors; ++s) {
+            engines.emplace_back(seed + s);
+        }
+        work.range.resize(beams);
+    }
+    ~LidarScanner() {}
+
+    int get_beams(void) const { return beams; }
+    size_t dropped(void) const { return drop_count.load(std::memory_order_relaxed); }
+
+    void set_callback(std::function<void(const LidarScan&)> fn) { callback = std::move(fn); }
+
+    // scans the vehicles at time, hands the scan to the callback and the ring
+    void scan(const std::vector<VehicleSimulator>& vehicles, double time,
+              utils::ThreadPool* pool = nullptr);
+
+    // the oldest scan in the ring is swapped into out, false if there is none. the buffers of
+    // out go back to the ring, so a consumer that keeps out does not allocate either
+    bool pop(LidarScan& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out.swap(ring[h % RING]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    double resolution;
+    double range_noise;
+    int sectors;
+    int beams;
+    std::vector<double> cos_beam;
+    std::vector<double> sin_beam;
+    std::vector<std::mt19937> engines;
+
+    // contour segments of the current scan, from (x0, y0) to (x1, y1), hitting the beams
+    // first, first + 1, ..., first + count - 1 modulo beams
+    std::vector<double> x0, y0, x1, y1;
+    std::vector<int> first;
+    std::vector<int> count;
+
+    LidarScan work;
+    std::function<void(const LidarScan&)> callback;
+    LidarScan ring[RING];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    // written by the scanning thread, read by any
+    std::atomic<size_t> drop_count{0};
+
+    void cast_sector(int s);
+};
+
+inline void LidarScanner::scan(const std::vector<VehicleSimulator>& vehicles, double time,
+                               utils::ThreadPool* pool) {
+    size_t n = 0;
+    for (const VehicleSimulator& v : vehicles) {
+        n += v.contour_size();
+    }
+    x0.resize(n);
+    y0.resize(n);
+    x1.resize(n);
+    y1.resize(n);
+    first.resize(n);
+    count.resize(n);
+
+    // a contour of k points is k segments, the last one closes it back to the first point
+    size_t offset = 0;
+    for (const VehicleSimulator& v : vehicles) {
+        size_t k = v.contour_size();
+        if (k == 0) {
+            continue;
+        }
+        v.calc_global_contour(&x0[offset], &y0[offset]);
+        for (size_t idx = offset; idx < offset + k; ++idx) {
+            size_t next = idx + 1 < offset + k ? idx + 1 : offset;
+            x1[idx] = x0[next];
+            y1[idx] = y0[next];
+            double a0 = atan2(y0[idx], x0[idx]);
+            double width = utils::pi_2_pi(atan2(y1[idx], x1[idx]) - a0);
+            if (width < 0) {
+                a0 += width;
+                width = -width;
+            }
+            if (a0 < 0) {
+                a0 += 2.0 * M_PI;
+            }
+            int b0 = static_cast<int>(ceil(a0 / resolution));
+            int b1 = static_cast<int>(floor((a0 + width) / resolution));
+            first[idx] = b0 % beams;
+            count[idx] = std::max(b1 - b0 + 1, 0);
+        }
+        offset += k;
+    }
+
+    std::fill(work.range.begin(), work.range.end(), std::numeric_limits<double>::max());
+    if (pool != nullptr) {
+        pool->parallel_for(sectors, [this](size_t s, int) { cast_sector(s); });
+    } else {
+        for (int s = 0; s < sectors; ++s) {
+            cast_sector(s);
+        }
+    }
+
+    work.time = time;
+    work.xy[0].clear();
+    work.xy[1].clear();
+    for (int b = 0; b < beams; ++b) {
+        if (work.range[b] < std::numeric_limits<double>::max()) {
+            work.xy[0].push_back(work.range[b] * cos_beam[b]);
+            work.xy[1].push_back(work.range[b] * sin_beam[b]);
+        }
+    }
+
+    if (callback) {
+        callback(work);
+    }
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == RING) {
+        drop_count.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring[t % RING].swap(work);
+    tail.store(t + 1, std::memory_order_release);
+    work.range.resize(beams);
+}
+
+// the beams [lo, hi) of sector s against every segment, then the range noise
+inline void LidarScanner::cast_sector(int s) {
+    int lo = static_cast<int>(static_cast<int64_t>(beams) * s / sectors);
+    int hi = static_cast<int>(static_cast<int64_t>(beams) * (s + 1) / sectors);
+    double* range = work.range.data();
+
+    for (size_t idx = 0; idx < first.size(); ++idx) {
+        if (count[idx] == 0) {
+            continue;
+        }
+        double ex = x1[idx] - x0[idx];
+        double ey = y1[idx] - y0[idx];
+        double num = x0[idx] * ey - y0[idx] * ex;
+        // the beams of the segment are [first, first + count), possibly wrapped past beams
+        for (int shift = 0; shift <= beams; shift += beams) {
+            int b_lo = std::max(lo + shift, first[idx]);
+            int b_hi = std::min(hi + shift, first[idx] + count[idx]);
+            for (int b = b_lo; b < b_hi; ++b) {
+                int beam = b - shift;
+                double den = cos_beam[beam] * ey - sin_beam[beam] * ex;
+                if (den == 0.0) {
+                    continue;
+                }
+                double r = num / den;
+                if (r > 0.0 && r < range[beam]) {
+                    range[beam] = r;
+                }
+            }
+        }
+    }
+
+    std::normal_distribution<> gaussian_d(0, range_noise);
+    for (int b = lo; b < hi; ++b) {
+        if (range[b] < std::numeric_limits<double>::max()) {
+            range[b] *= 1 + gaussian_d(engines[s]);
+        }
+    }
+}
+
 #endif
@@ -9,13 +9,14 @@
 
 #include "matplotlibcpp.h"
 #include "utils.hpp"
+#include "visualization.hpp"
 
 using std::vector;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
 constexpr double DT = 0.1;
 constexpr double SIM_TIME = 50.0;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 Vector2d calc_input(void) {
     double v = 1.0;        // [m/s]
@@ -64,8 +65,8 @@ Matrix<double, 2, 4> jacob_h() {
     return jH;
 }
 
-void ekf_estimation(Vector4d& xEst, Matrix4d& PEst, Vector2d z, Vector2d u, Matrix4d Q,
-                    Matrix2d R) {
+void ekf_estimation(Vector4d& xEst, Matrix4d& PEst, const Vector2d& z, const Vector2d& u,
+                    const Matrix4d& Q, const Matrix2d& R) {
     Vector4d xPred = motion_model(xEst, u);
     Matrix4d jF = jacob_f(xPred, u);
     Matrix4d PPred = jF * PEst * jF.transpose() + Q;
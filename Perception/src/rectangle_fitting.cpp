@@ -2,25 +2,28 @@
 
 #include <Eigen/Core>
 #include <Eigen/Eigen>
+#include <algorithm>
 #include <cmath>
+#include <numeric>
 #include <random>
-#include <set>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "flat_kdtree.hpp"
 #include "matplotlibcpp.h"
 #include "simulator.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
+#include "visualization.hpp"
 
-using std::set;
 using std::tuple;
 using std::vector;
 using namespace Eigen;
 namespace plt = matplotlibcpp;
 constexpr double DT = 0.2;
 constexpr double SIM_TIME = 30.0;
-constexpr bool show_animation = true;
+constexpr bool show_animation = utils::viz::ANIMATE;
 
 enum class Criteria { AREA, CLOSENESS, VARIANCE };
 
@@ -68,6 +71,40 @@ tuple<double, double> RectangleData::calc_cross_point(vector<double> _a, vector<
     return std::make_tuple(x, y);
 }
 
+// disjoint sets of the points, with path halving and union by size
+class DisjointSet {
+public:
+    explicit DisjointSet(size_t n) : parent(n), rank_size(n, 1) {
+        std::iota(parent.begin(), parent.end(), 0);
+    }
+    ~DisjointSet() {}
+
+    int find(int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void unite(int i, int j) {
+        i = find(i);
+        j = find(j);
+        if (i == j) {
+            return;
+        }
+        if (rank_size[i] < rank_size[j]) {
+            std::swap(i, j);
+        }
+        parent[j] = i;
+        rank_size[i] += rank_size[j];
+    }
+
+private:
+    std::vector<int> parent;
+    std::vector<int> rank_size;
+};
+
 class LShapeFitting {
 private:
     Criteria criteria;
@@ -75,13 +112,15 @@ private:
     double d_theta_deg_for_search;
     double R0 = 3.0;
     double Rd = 0.001;
+    // the search angles and their sin and cos, fixed by d_theta_deg_for_search
+    vector<double> thetas;
+    vector<double> sin_thetas;
+    vector<double> cos_thetas;
 
-    Vector4d find_min_max(const vector<double>& c1, const vector<double>& c2);
     vector<vector<int>> adoptive_range_segmentation(const vector<vector<double>>& oxy);
-    RectangleData rectangle_search(const vector<vector<double>>& cxy);
-    double calc_area_criterion(const vector<double>& c1, const vector<double>& c2);
-    double calc_closeness_criterion(const vector<double>& c1, const vector<double>& c2);
-    double calc_variance_criterion(const vector<double>& c1, const vector<double>& c2);
+    RectangleData rectangle_search(const vector<double>& cx, const vector<double>& cy) const;
+    double calc_cost(const vector<double>& cx, const vector<double>& cy, double s,
+                     double c) const;
 
 public:
     LShapeFitting() {
@@ -90,180 +129,173 @@ public:
         d_theta_deg_for_search = 1.0;
         R0 = 3.0;
         Rd = 0.001;
+
+        double d_theta = d_theta_deg_for_search * M_PI / 180.0;
+        for (double theta = 0; theta < M_PI_2 - d_theta; theta += d_theta) {
+            thetas.push_back(theta);
+            sin_thetas.push_back(sin(theta));
+            cos_thetas.push_back(cos(theta));
+        }
     }
     ~LShapeFitting() {}
 
-    vector<RectangleData> fitting(const vector<vector<double>>& oxy, vector<vector<int>>& id_sets);
+    // pool, if not nullptr, fits the clusters in parallel
+    vector<RectangleData> fitting(const vector<vector<double>>& oxy, vector<vector<int>>& id_sets,
+                                  utils::ThreadPool* pool = nullptr);
 };
 
-Vector4d LShapeFitting::find_min_max(const vector<double>& c1, const vector<double>& c2) {
-    double c1_max = utils::max(c1);
-    double c2_max = utils::max(c2);
-    double c1_min = utils::min(c1);
-    double c2_min = utils::min(c2);
-    Vector4d min_max;
-    min_max << c1_max, c1_min, c2_max, c2_min;
-
-    return min_max;
-}
-
+// every point is joined with the points within its range dependent radius R0 + Rd * range,
+// the clusters are the connected components. they are numbered by their smallest point index,
+// the ids of a cluster are ascending
 vector<vector<int>> LShapeFitting::adoptive_range_segmentation(const vector<vector<double>>& oxy) {
-    vector<set<int>> segment_list;
+    size_t n = oxy[0].size();
+    utils::KDTree<2> tree(oxy);
+    DisjointSet sets(n);
 
-    for (size_t i = 0; i < oxy[0].size(); ++i) {
-        set<int> c;
+    for (size_t i = 0; i < n; ++i) {
         double r = R0 + Rd * sqrt(oxy[0][i] * oxy[0][i] + oxy[1][i] * oxy[1][i]);
-        for (size_t j = 0; j < oxy[0].size(); ++j) {
-            double d = hypot(oxy[0][i] - oxy[0][j], oxy[1][i] - oxy[1][j]);
-            if (d <= r) {
-                c.insert(j);
-            }
-        }
-        segment_list.emplace_back(c);
-    }
-
-    for (size_t i = 0; i < segment_list.size() - 1; ++i) {
-        for (size_t j = i + 1; j < segment_list.size(); ++j) {
-            std::set<int> tmp;
-            std::set_intersection(segment_list[i].begin(), segment_list[i].end(),
-                                  segment_list[j].begin(), segment_list[j].end(),
-                                  std::inserter(tmp, tmp.begin()));
-            if (!tmp.empty()) {
-                tmp.clear();
-                std::set_union(segment_list[i].begin(), segment_list[i].end(),
-                               segment_list[j].begin(), segment_list[j].end(),
-                               std::inserter(tmp, tmp.begin()));
-                segment_list[i].clear();
-                segment_list[j].clear();
-                segment_list[i] = tmp;
-            }
-        }
+        tree.radius({oxy[0][i], oxy[1][i]}, r, [&](size_t j, double) { sets.unite(i, j); });
     }
 
     vector<vector<int>> id_sets;
-    for (size_t idx = 0; idx < segment_list.size(); ++idx) {
-        if (!segment_list[idx].empty()) {
-            vector<int> tmp;
-            for (int id : segment_list[idx]) {
-                tmp.push_back(id);
-            }
-            id_sets.emplace_back(tmp);
+    vector<int> cluster_of_root(n, -1);
+    for (size_t i = 0; i < n; ++i) {
+        int root = sets.find(i);
+        if (cluster_of_root[root] < 0) {
+            cluster_of_root[root] = id_sets.size();
+            id_sets.emplace_back();
         }
+        id_sets[cluster_of_root[root]].push_back(i);
     }
 
     return id_sets;
 }
 
-double LShapeFitting::calc_area_criterion(const vector<double>& c1, const vector<double>& c2) {
-    Vector4d min_max = find_min_max(c1, c2);
-    double alpha = -(min_max[0] - min_max[1]) * (min_max[0] - min_max[1]);
-
-    return alpha;
-}
-
-double LShapeFitting::calc_closeness_criterion(const vector<double>& c1, const vector<double>& c2) {
-    Vector4d min_max = find_min_max(c1, c2);
-    double beta = 0.0;
-    for (size_t idx = 0; idx < c1.size(); ++idx) {
-        double d1 = std::min(min_max[0] - c1[idx], c1[idx] - min_max[1]);
-        double d2 = std::min(min_max[2] - c2[idx], c2[idx] - min_max(3));
-        double d = std::min(std::min(d1, d2), min_dist_of_closeness_criteria);
-        beta += (1.0 / d);
+// the criterion of the points projected on the axes (c, s) and (-s, c). the first pass finds
+// the bounds, the second one evaluates closeness or variance without storing the projections,
+// the variances from running sums
+double LShapeFitting::calc_cost(const vector<double>& cx, const vector<double>& cy, double s,
+                                double c) const {
+    size_t n = cx.size();
+    double c1_max = -std::numeric_limits<double>::max();
+    double c1_min = std::numeric_limits<double>::max();
+    double c2_max = -std::numeric_limits<double>::max();
+    double c2_min = std::numeric_limits<double>::max();
+    for (size_t idx = 0; idx < n; ++idx) {
+        double c1 = cx[idx] * c + cy[idx] * s;
+        double c2 = -cx[idx] * s + cy[idx] * c;
+        c1_max = std::max(c1_max, c1);
+        c1_min = std::min(c1_min, c1);
+        c2_max = std::max(c2_max, c2);
+        c2_min = std::min(c2_min, c2);
     }
 
-    return beta;
-}
+    if (criteria == Criteria::AREA) {
+        return -(c1_max - c1_min) * (c1_max - c1_min);
+    }
 
-double LShapeFitting::calc_variance_criterion(const vector<double>& c1, const vector<double>& c2) {
-    Vector4d min_max = find_min_max(c1, c2);
-    vector<double> e1;
-    vector<double> e2;
-    for (size_t idx = 0; idx < c1.size(); ++idx) {
-        double d1 = std::min(min_max[0] - c1[idx], c1[idx] - min_max[1]);
-        double d2 = std::min(min_max[2] - c2[idx], c2[idx] - min_max(3));
-        if (d1 < d2) {
-            e1.emplace_back(d1);
+    double beta = 0.0;
+    double sum[2] = {0.0, 0.0};
+    double sum2[2] = {0.0, 0.0};
+    int count[2] = {0, 0};
+    for (size_t idx = 0; idx < n; ++idx) {
+        double c1 = cx[idx] * c + cy[idx] * s;
+        double c2 = -cx[idx] * s + cy[idx] * c;
+        double d1 = std::min(c1_max - c1, c1 - c1_min);
+        double d2 = std::min(c2_max - c2, c2 - c2_min);
+        if (criteria == Criteria::CLOSENESS) {
+            beta += 1.0 / std::min(std::min(d1, d2), min_dist_of_closeness_criteria);
         } else {
-            e2.emplace_back(d2);
+            int k = d1 < d2 ? 0 : 1;
+            double e = d1 < d2 ? d1 : d2;
+            sum[k] += e;
+            sum2[k] += e * e;
+            count[k] += 1;
         }
     }
+    if (criteria == Criteria::CLOSENESS) {
+        return beta;
+    }
 
-    double v1 = -utils::variance(e1);
-    double v2 = -utils::variance(e2);
-    double gamma = v1 + v2;
+    double gamma = 0.0;
+    for (int k = 0; k < 2; ++k) {
+        if (count[k] > 0) {
+            double mean = sum[k] / count[k];
+            gamma -= std::max(sum2[k] / count[k] - mean * mean, 0.0);
+        }
+    }
 
     return gamma;
 }
 
-RectangleData LShapeFitting::rectangle_search(const vector<vector<double>>& cxy) {
-    double d_theta = d_theta_deg_for_search * M_PI / 180.0;
-    Vector2d min_cost(-1e6, 0.);
-
-    for (double theta = 0; theta < M_PI_2 - d_theta; theta += d_theta) {
-        vector<double> c1;
-        vector<double> c2;
-        Matrix2d l_rot = utils::rotation_matrix2d(theta);
-        for (size_t idx = 0; idx < cxy[0].size(); ++idx) {
-            Vector2d xy(cxy[0][idx], cxy[1][idx]);
-            Matrix<double, 1, 2> le_xy = xy.transpose() * l_rot;
-            c1.push_back(le_xy(0, 0));
-            c2.push_back(le_xy(0, 1));
-        }
-        double cost = 0.0;
-        if (criteria == Criteria::AREA) {
-            cost = calc_area_criterion(c1, c2);
-        } else if (criteria == Criteria::CLOSENESS) {
-            cost = calc_closeness_criterion(c1, c2);
-        } else if (criteria == Criteria::VARIANCE) {
-            cost = calc_variance_criterion(c1, c2);
-        }
+RectangleData LShapeFitting::rectangle_search(const vector<double>& cx,
+                                              const vector<double>& cy) const {
+    double max_cost = -1e6;
+    size_t best = 0;
 
-        if (min_cost[0] < cost) {
-            min_cost[0] = cost;
-            min_cost[1] = theta;
+    for (size_t t = 0; t < thetas.size(); ++t) {
+        double cost = calc_cost(cx, cy, sin_thetas[t], cos_thetas[t]);
+        if (max_cost < cost) {
+            max_cost = cost;
+            best = t;
         }
     }
 
-    double sin_s = sin(min_cost[1]);
-    double cos_s = cos(min_cost[1]);
-    vector<double> c1_s;
-    vector<double> c2_s;
-
-    for (size_t idx = 0; idx < cxy[0].size(); ++idx) {
-        c1_s.emplace_back(cxy[0][idx] * cos_s + cxy[1][idx] * sin_s);
-        c2_s.emplace_back(-cxy[0][idx] * sin_s + cxy[1][idx] * cos_s);
+    double sin_s = sin_thetas[best];
+    double cos_s = cos_thetas[best];
+    double c1_max = -std::numeric_limits<double>::max();
+    double c1_min = std::numeric_limits<double>::max();
+    double c2_max = -std::numeric_limits<double>::max();
+    double c2_min = std::numeric_limits<double>::max();
+    for (size_t idx = 0; idx < cx.size(); ++idx) {
+        double c1 = cx[idx] * cos_s + cy[idx] * sin_s;
+        double c2 = -cx[idx] * sin_s + cy[idx] * cos_s;
+        c1_max = std::max(c1_max, c1);
+        c1_min = std::min(c1_min, c1);
+        c2_max = std::max(c2_max, c2);
+        c2_min = std::min(c2_min, c2);
     }
 
     RectangleData rect;
     rect.a[0] = cos_s;
     rect.b[0] = sin_s;
-    rect.c[0] = utils::min(c1_s);
+    rect.c[0] = c1_min;
     rect.a[1] = -sin_s;
     rect.b[1] = cos_s;
-    rect.c[1] = utils::min(c2_s);
+    rect.c[1] = c2_min;
     rect.a[2] = cos_s;
     rect.b[2] = sin_s;
-    rect.c[2] = utils::max(c1_s);
+    rect.c[2] = c1_max;
     rect.a[3] = -sin_s;
     rect.b[3] = cos_s;
-    rect.c[3] = utils::max(c2_s);
+    rect.c[3] = c2_max;
 
     return rect;
 }
 
 vector<RectangleData> LShapeFitting::fitting(const vector<vector<double>>& oxy,
-                                             vector<vector<int>>& id_sets) {
+                                             vector<vector<int>>& id_sets,
+                                             utils::ThreadPool* pool) {
     id_sets = adoptive_range_segmentation(oxy);
-    vector<RectangleData> rects;
-
-    for (const vector<int>& ids : id_sets) {
-        vector<vector<double>> cxy(2);
-        for (int id : ids) {
-            cxy[0].push_back(oxy[0][id]);
-            cxy[1].push_back(oxy[1][id]);
+    vector<RectangleData> rects(id_sets.size());
+
+    auto fit = [&](size_t k, int) {
+        vector<double> cx;
+        vector<double> cy;
+        cx.reserve(id_sets[k].size());
+        cy.reserve(id_sets[k].size());
+        for (int id : id_sets[k]) {
+            cx.push_back(oxy[0][id]);
+            cy.push_back(oxy[1][id]);
+        }
+        rects[k] = rectangle_search(cx, cy);
+    };
+    if (pool != nullptr) {
+        pool->parallel_for(id_sets.size(), fit);
+    } else {
+        for (size_t k = 0; k < id_sets.size(); ++k) {
+            fit(k, 0);
         }
-        RectangleData rect = rectangle_search(cxy);
-        rects.emplace_back(rect);
     }
 
     return rects;
@@ -271,28 +303,34 @@ vector<RectangleData> LShapeFitting::fitting(const vector<vector<double>>& oxy,
 
 int main(int argc, char** argv) {
     double angle_resolution = 3 * M_PI / 180.0;
-    VehicleSimulator v1(-10.0, 0.0, M_PI_2, 0.0, 50.0 / 3.6, 3.0, 5.0);
-    VehicleSimulator v2(20.0, 10.0, M_PI, 0.0, 50.0 / 3.6, 4.0, 10.0);
+    vector<VehicleSimulator> vehicles = {
+        VehicleSimulator(-10.0, 0.0, M_PI_2, 0.0, 50.0 / 3.6, 3.0, 5.0),
+        VehicleSimulator(20.0, 10.0, M_PI, 0.0, 50.0 / 3.6, 4.0, 10.0)};
 
     LShapeFitting l_shape_fitting;
-    LidarSimulator lidar_sim;
+    LidarScanner lidar(angle_resolution);
+    LidarScan scan;
+    utils::ThreadPool pool;
     double time = 0.0;
 
     while (time <= SIM_TIME) {
         time += DT;
 
-        v1.update(DT, 0.1, 0.0);
-        v2.update(DT, 0.1, -0.05);
+        vehicles[0].update(DT, 0.1, 0.0);
+        vehicles[1].update(DT, 0.1, -0.05);
 
         vector<vector<int>> id_sets;
-        vector<vector<double>> oxy = lidar_sim.get_observation_points({v1, v2}, angle_resolution);
-        vector<RectangleData> rects = l_shape_fitting.fitting(oxy, id_sets);
+        lidar.scan(vehicles, time, &pool);
+        lidar.pop(scan);
+        const vector<vector<double>>& oxy = scan.xy;
+        vector<RectangleData> rects = l_shape_fitting.fitting(oxy, id_sets, &pool);
         if (show_animation) {
             plt::cla();
             plt::axis("equal");
             plt::plot({0.0}, {0.0}, "*r");
-            v1.plot();
-            v2.plot();
+            for (VehicleSimulator& v : vehicles) {
+                v.plot();
+            }
 
             for (const vector<int>& ids : id_sets) {
                 vector<vector<double>> sets_xy(2);
@@ -0,0 +1,111 @@
+#include <fmt/core.h>
+
+#include <Eigen/Core>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ekf_bank.hpp"
+#include "thread_pool.hpp"
+
+using std::string;
+using std::vector;
+
+// headless timing of EKFBank. every agent drives the circle of ekf_location from its own start
+// point with noisy odometry and gps, one predict and one update per frame for all agents:
+//   ekf_bank_benchmark --agents=100,1000,10000 --frames=500 --threads=1,4 --seed=0
+// rmse is the position error of the estimates over all agents and frames.
+
+constexpr double DT = 0.1;
+
+static vector<string> split(const string& value) {
+    vector<string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.push_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv) {
+    std::map<string, string> args = {
+        {"agents", "100,1000,10000"}, {"frames", "500"}, {"threads", "1"}, {"seed", "0"}};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos ||
+            args.count(arg.substr(2, eq - 2)) == 0) {
+            fmt::print(stderr, "unknown argument {}\n", arg);
+            return 1;
+        }
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+
+    Eigen::Matrix4d Q = Eigen::Matrix4d::Identity();
+    Q(0, 0) = 0.1 * 0.1;
+    Q(1, 1) = 0.1 * 0.1;
+    Q(2, 2) = (1.0 / 180 * M_PI) * (1.0 / 180 * M_PI);
+    Q(3, 3) = 0.1 * 0.1;
+    Eigen::Matrix2d R = Eigen::Matrix2d::Identity();
+    int frames = std::stoi(args["frames"]);
+
+    for (const string& agents : split(args["agents"])) {
+        for (const string& threads : split(args["threads"])) {
+            int n = std::stoi(agents);
+            int t = std::stoi(threads);
+            std::mt19937 engine(std::stoul(args["seed"]));
+            std::normal_distribution<> gaussian(0, 1);
+            std::uniform_real_distribution<double> start(-100.0, 100.0);
+
+            EKFBank bank(n, DT, Q, R);
+            Eigen::ArrayXXd truth = Eigen::ArrayXXd::Zero(n, 3);
+            for (int i = 0; i < n; ++i) {
+                truth(i, 0) = start(engine);
+                truth(i, 1) = start(engine);
+                bank.set(i, {truth(i, 0), truth(i, 1), 0.0, 0.0}, Eigen::Matrix4d::Identity());
+            }
+            Eigen::Array<double, Eigen::Dynamic, 2> U(n, 2);
+            Eigen::Array<double, Eigen::Dynamic, 2> Z(n, 2);
+            utils::ThreadPool pool(t);
+            double elapsed_ms = 0.0;
+            double sq_error = 0.0;
+
+            for (int f = 0; f < frames; ++f) {
+                for (int i = 0; i < n; ++i) {
+                    truth(i, 0) += DT * cos(truth(i, 2));
+                    truth(i, 1) += DT * sin(truth(i, 2));
+                    truth(i, 2) += DT * 0.1;
+                    U(i, 0) = 1.0 + gaussian(engine);
+                    U(i, 1) = 0.1 + gaussian(engine) * (30.0 / 180 * M_PI) * (30.0 / 180 * M_PI);
+                    Z(i, 0) = truth(i, 0) + gaussian(engine) * 0.5 * 0.5;
+                    Z(i, 1) = truth(i, 1) + gaussian(engine) * 0.5 * 0.5;
+                }
+                auto begin = std::chrono::steady_clock::now();
+                bank.predict(U, t > 1 ? &pool : nullptr);
+                bank.update(Z, t > 1 ? &pool : nullptr);
+                std::chrono::duration<double> frame = std::chrono::steady_clock::now() - begin;
+                elapsed_ms += frame.count() * 1000;
+                sq_error += (bank.X.leftCols(2) - truth.leftCols(2)).square().sum();
+            }
+
+            fmt::print("{{\"agents\": {}, \"frames\": {}, \"threads\": {}, \"total_ms\": {:.3f}, "
+                       "\"ns_per_filter_frame\": {:.1f}, \"rmse\": {:.4f}}}\n",
+                       n, frames, t, elapsed_ms,
+                       elapsed_ms * 1e6 / (static_cast<double>(n) * frames),
+                       sqrt(sq_error / (static_cast<double>(n) * frames)));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simulator.hpp"
+#include "thread_pool.hpp"
+
+using std::string;
+using std::vector;
+
+// headless timing of LidarScanner. targets are vehicles of random size and heading placed
+// uniformly 5 m to 60 m around the scanner, they drive while the scanner runs:
+//   lidar_benchmark --targets=10,200 --resolution=0.1 --scans=200 --threads=1,4 --seed=0
+// resolution is in degrees. hits is the mean number of beams that hit a target per scan, the
+// same for every thread count.
+
+constexpr double DT = 0.1;
+
+static vector<string> split(const string& value) {
+    vector<string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.push_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv) {
+    std::map<string, string> args = {{"targets", "10,200"},
+                                     {"resolution", "0.1"},
+                                     {"scans", "200"},
+                                     {"threads", "1"},
+                                     {"seed", "0"}};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos ||
+            args.count(arg.substr(2, eq - 2)) == 0) {
+            fmt::print(stderr, "unknown argument {}\n", arg);
+            return 1;
+        }
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+
+    double resolution = std::stod(args["resolution"]) * M_PI / 180.0;
+    int scans = std::stoi(args["scans"]);
+
+    for (const string& targets : split(args["targets"])) {
+        for (const string& threads : split(args["threads"])) {
+            int n = std::stoi(targets);
+            int t = std::stoi(threads);
+            std::mt19937 engine(std::stoul(args["seed"]));
+            std::uniform_real_distribution<double> distance(5.0, 60.0);
+            std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+            std::uniform_real_distribution<double> width(1.5, 3.0);
+            std::uniform_real_distribution<double> length(3.0, 12.0);
+
+            vector<VehicleSimulator> vehicles;
+            vehicles.reserve(n);
+            for (int i = 0; i < n; ++i) {
+                double d = distance(engine);
+                double a = angle(engine);
+                vehicles.emplace_back(d * cos(a), d * sin(a), angle(engine), 5.0, 50.0 / 3.6,
+                                      width(engine), length(engine));
+            }
+            LidarScanner lidar(resolution, 0.01, 16, std::stoul(args["seed"]));
+            utils::ThreadPool pool(t);
+            LidarScan scan;
+            double elapsed_ms = 0.0;
+            size_t hits = 0;
+
+            for (int s = 0; s < scans; ++s) {
+                for (VehicleSimulator& v : vehicles) {
+                    v.update(DT, 0.0, 0.0);
+                }
+                auto begin = std::chrono::steady_clock::now();
+                lidar.scan(vehicles, s * DT, t > 1 ? &pool : nullptr);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+                elapsed_ms += elapsed.count() * 1000;
+                while (lidar.pop(scan)) {
+                    hits += scan.xy[0].size();
+                }
+            }
+
+            fmt::print("{{\"targets\": {}, \"beams\": {}, \"threads\": {}, \"scans\": {}, "
+                       "\"ms_per_scan\": {:.3f}, \"hits\": {:.1f}}}\n",
+                       n, lidar.get_beams(), t, scans, elapsed_ms / scans,
+                       static_cast<double>(hits) / scans);
+        }
+    }
+
+    return 0;
+}
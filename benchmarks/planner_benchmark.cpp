@@ -0,0 +1,469 @@
+#include <fmt/core.h>
+#include <sys/resource.h>
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GraphSearchPlanner.hpp"
+#include "hybrid_astar.hpp"
+#include "occupancy_grid.hpp"
+#include "prm_roadmap.hpp"
+#include "profiler.hpp"
+#include "reeds_shepp_path.hpp"
+#include "steering_batch.hpp"
+#include "thread_pool.hpp"
+
+using std::string;
+using std::vector;
+
+// headless benchmark of the planners that are built as libraries. nothing here touches
+// matplotlib, every scenario is timed on its own and printed as one json object (or csv row)
+// per line:
+//   planner_benchmark --planners=astar,dijkstra --map_size=100,400 --density=0.1,0.3
+//                     --queries=200 --threads=1,4 --seed=0 --format=json
+// every list argument is swept, all combinations are run. planners without a search of their
+// own ignore threads. peak_rss_kb is the peak of the whole process up to that scenario.
+// planners: astar, weighted_astar, dijkstra (grid of 1 m cells), hybrid_astar, prm (blocks of
+// BLOCK m), reeds_shepp, rs_batch and dubins_batch (no map)
+// in a build with ENABLE_PROFILING, --profile=out writes the zone histograms of all scenarios
+// to out.json and the last zones of every thread to out_trace.json for chrome://tracing.
+
+class GridPlanner : public GraphSearchPlanner {
+public:
+    double weight;
+
+    GridPlanner(utils::OccupancyGrid grid, double _weight)
+        : GraphSearchPlanner(std::move(grid)), weight(_weight) {}
+    ~GridPlanner() override {}
+
+    bool search(SearchArena& arena, int sx, int sy, int gx, int gy,
+                const std::function<void(int, int, size_t)>& on_expand = nullptr) const override {
+        return best_first_search(arena, sx, sy, gx, gy, weight, on_expand);
+    }
+
+    std::vector<std::vector<double>> planning(double sx, double sy, double gx,
+                                              double gy) override {
+        SearchArena& arena = get_search_arena();
+        int gix = calc_xyindex(gx, get_minx());
+        int giy = calc_xyindex(gy, get_miny());
+        search(arena, calc_xyindex(sx, get_minx()), calc_xyindex(sy, get_miny()), gix, giy);
+        return extract_path(arena, gix, giy);
+    }
+};
+
+class Scenario {
+public:
+    string planner;
+    int map_size;
+    double density;
+    int queries;
+    int threads;
+    unsigned int seed;
+
+    Scenario() {}
+    ~Scenario() {}
+};
+
+class Result {
+public:
+    vector<double> latency;  // [ms] per query
+    double total_ms = 0.0;
+    double expanded = 0.0;
+    int solved = 0;
+
+    Result() {}
+    ~Result() {}
+};
+
+static double percentile(vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[std::min(values.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+// peak resident set of the process so far [kB], linux reports ru_maxrss in kB
+static long peak_memory_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// square map with a free border, interior cells are blocked with probability density
+static utils::OccupancyGrid make_random_grid(int size, double density, std::mt19937& engine) {
+    utils::OccupancyGrid grid(size, size, 0.0, 0.0, 1.0);
+    std::bernoulli_distribution blocked(density);
+    for (int iy = 1; iy < size - 1; ++iy) {
+        for (int ix = 1; ix < size - 1; ++ix) {
+            grid.set(ix, iy, blocked(engine));
+        }
+    }
+
+    return grid;
+}
+
+static vector<Query> make_queries(const utils::OccupancyGrid& grid, int count,
+                                  std::mt19937& engine) {
+    std::uniform_int_distribution<int> cell(0, grid.get_xwidth() - 1);
+    auto free_cell = [&](double& x, double& y) {
+        int ix, iy;
+        do {
+            ix = cell(engine);
+            iy = cell(engine);
+        } while (grid.is_occupied(ix, iy));
+        x = ix;
+        y = iy;
+    };
+
+    vector<Query> queries(count);
+    for (Query& q : queries) {
+        free_cell(q.sx, q.sy);
+        free_cell(q.gx, q.gy);
+    }
+
+    return queries;
+}
+
+static Result run_grid_search(const Scenario& s, double weight) {
+    std::mt19937 engine(s.seed);
+    utils::OccupancyGrid grid = make_random_grid(s.map_size, s.density, engine);
+    vector<Query> queries = make_queries(grid, s.queries, engine);
+    GridPlanner planner(std::move(grid), weight);
+
+    Result r;
+    auto start = std::chrono::steady_clock::now();
+    if (s.threads > 1) {
+        planner.plan_batch(queries, s.threads);
+    } else {
+        SearchArena& arena = planner.get_search_arena();
+        // the queries are world positions, the search takes grid indices
+        auto ix = [&planner](double x) {
+            return static_cast<int>(planner.calc_xyindex(x, planner.get_minx()));
+        };
+        auto iy = [&planner](double y) {
+            return static_cast<int>(planner.calc_xyindex(y, planner.get_miny()));
+        };
+        for (Query& q : queries) {
+            auto t = std::chrono::steady_clock::now();
+            q.found = planner.search(arena, ix(q.sx), iy(q.sy), ix(q.gx), iy(q.gy));
+            q.search_ms = elapsed_ms(t);
+            q.expanded = arena.expanded;
+        }
+    }
+    r.total_ms = elapsed_ms(start);
+    for (const Query& q : queries) {
+        r.latency.push_back(q.search_ms);
+        r.expanded += q.expanded;
+        r.solved += q.found;
+    }
+    r.expanded /= std::max(1, s.queries);
+
+    return r;
+}
+
+// analytic curves have no search, expanded counts the path points and map density is unused
+static Result run_reeds_shepp(const Scenario& s) {
+    std::mt19937 engine(s.seed);
+    std::uniform_real_distribution<double> pos(0.0, s.map_size);
+    std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+    constexpr double max_curvature = 0.2;
+
+    Result r;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < s.queries; ++i) {
+        Eigen::Vector3d from(pos(engine), pos(engine), yaw(engine));
+        Eigen::Vector3d to(pos(engine), pos(engine), yaw(engine));
+        auto t = std::chrono::steady_clock::now();
+        Path path = reeds_shepp_path(from, to, max_curvature);
+        r.latency.push_back(elapsed_ms(t));
+        r.expanded += path.x.size();
+        r.solved += !path.x.empty();
+    }
+    r.total_ms = elapsed_ms(start);
+    r.expanded /= std::max(1, s.queries);
+
+    return r;
+}
+
+// a query of the steering batch is one batch of STEER_BATCH random pairs, expanded counts the
+// pairs and a batch is solved when every pair has a word
+constexpr size_t STEER_BATCH = 256;
+
+static Result run_steering_batch(const Scenario& s, bool dubins) {
+    std::mt19937 engine(s.seed);
+    std::uniform_real_distribution<double> pos(0.0, s.map_size);
+    std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+    constexpr double max_curvature = 0.2;
+    vector<double> sx(STEER_BATCH), sy(STEER_BATCH), syaw(STEER_BATCH);
+    vector<double> gx(STEER_BATCH), gy(STEER_BATCH), gyaw(STEER_BATCH);
+    vector<int> word(STEER_BATCH);
+    vector<double> length(STEER_BATCH);
+
+    Result r;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < s.queries; ++i) {
+        for (size_t k = 0; k < STEER_BATCH; ++k) {
+            sx[k] = pos(engine);
+            sy[k] = pos(engine);
+            syaw[k] = yaw(engine);
+            gx[k] = pos(engine);
+            gy[k] = pos(engine);
+            gyaw[k] = yaw(engine);
+        }
+        PoseArrays from{sx.data(), sy.data(), syaw.data()};
+        PoseArrays to{gx.data(), gy.data(), gyaw.data()};
+        auto t = std::chrono::steady_clock::now();
+        if (dubins) {
+            calc_dubins_shortest_batch(from, to, STEER_BATCH, max_curvature, word.data(),
+                                       length.data());
+        } else {
+            calc_rs_shortest_batch(from, to, STEER_BATCH, max_curvature, word.data(),
+                                   length.data());
+        }
+        r.latency.push_back(elapsed_ms(t));
+        r.expanded += STEER_BATCH;
+        r.solved += std::all_of(word.begin(), word.end(), [](int w) { return w >= 0; });
+    }
+    r.total_ms = elapsed_ms(start);
+    r.expanded /= std::max(1, s.queries);
+
+    return r;
+}
+
+// the continuous planners see the map as square blocks of BLOCK m, an interior block is
+// blocked with probability density. starts and goals are the centers of free blocks
+constexpr double BLOCK = 20.0;
+
+class BlockMap {
+public:
+    vector<Eigen::Vector2d> blocked;
+    vector<Eigen::Vector2d> free;
+
+    BlockMap() {}
+    ~BlockMap() {}
+};
+
+static BlockMap make_block_map(int size, double density, std::mt19937& engine) {
+    BlockMap map;
+    int n = std::max(1, static_cast<int>(size / BLOCK));
+    std::bernoulli_distribution blocked(density);
+    for (int iy = 0; iy < n; ++iy) {
+        for (int ix = 0; ix < n; ++ix) {
+            Eigen::Vector2d center((ix + 0.5) * BLOCK, (iy + 0.5) * BLOCK);
+            bool border = ix == 0 || iy == 0 || ix == n - 1 || iy == n - 1;
+            if (!border && blocked(engine)) {
+                map.blocked.push_back(center);
+            } else {
+                map.free.push_back(center);
+            }
+        }
+    }
+
+    return map;
+}
+
+// obstacle points every 0.5 m on the outline of the map and of every blocked block, expanded
+// is the number of nodes of the search
+static Result run_hybrid_astar(const Scenario& s) {
+    std::mt19937 engine(s.seed);
+    BlockMap map = make_block_map(s.map_size, s.density, engine);
+    double extent = std::max(1, static_cast<int>(s.map_size / BLOCK)) * BLOCK;
+    vector<vector<double>> obs(2);
+    auto outline = [&obs](double x0, double y0, double side) {
+        for (double d = 0.0; d < side; d += 0.5) {
+            obs[0].insert(obs[0].end(), {x0 + d, x0 + side, x0 + side - d, x0});
+            obs[1].insert(obs[1].end(), {y0, y0 + d, y0 + side, y0 + side - d});
+        }
+    };
+    outline(0.0, 0.0, extent);
+    for (const Eigen::Vector2d& c : map.blocked) {
+        outline(c.x() - BLOCK / 2.0, c.y() - BLOCK / 2.0, BLOCK);
+    }
+
+    std::uniform_int_distribution<size_t> cell(0, map.free.size() - 1);
+    std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+    utils::VehicleConfig vc(4.5, 1.0, 3.0, 3.5, 0.5, 1.0, 0.6);
+    HybridAstar<CarModel> planner(vc);
+    utils::ThreadPool pool(s.threads);
+    if (s.threads > 1) {
+        planner.set_thread_pool(&pool);
+    }
+
+    Result r;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < s.queries; ++i) {
+        const Eigen::Vector2d& from = map.free[cell(engine)];
+        const Eigen::Vector2d& to = map.free[cell(engine)];
+        Eigen::Vector3d start_pose(from.x(), from.y(), yaw(engine));
+        Eigen::Vector3d goal_pose(to.x(), to.y(), yaw(engine));
+        auto t = std::chrono::steady_clock::now();
+        Path path = planner.planning(start_pose, goal_pose, obs);
+        r.latency.push_back(elapsed_ms(t));
+        r.expanded += planner.get_arena().nodes.size();
+        r.solved += !path.x.empty();
+    }
+    r.total_ms = elapsed_ms(start);
+    r.expanded /= std::max(1, s.queries);
+
+    return r;
+}
+
+// a lazy roadmap of one vertex per 25 m^2 among circles inscribed in the blocked blocks, for a
+// robot of 1 m radius. total_ms includes building the roadmap, the latencies are the queries
+// only, which check the edges they need and keep the results for the next ones
+static Result run_prm(const Scenario& s) {
+    std::mt19937 engine(s.seed);
+    BlockMap map = make_block_map(s.map_size, s.density, engine);
+    double extent = std::max(1, static_cast<int>(s.map_size / BLOCK)) * BLOCK;
+    vector<vector<double>> obstacles;
+    for (const Eigen::Vector2d& c : map.blocked) {
+        obstacles.push_back({c.x(), c.y(), BLOCK / 2.0});
+    }
+    std::uniform_int_distribution<size_t> cell(0, map.free.size() - 1);
+
+    Result r;
+    auto start = std::chrono::steady_clock::now();
+    Roadmap roadmap(obstacles, 1.0);
+    roadmap.build(static_cast<int>(extent * extent / 25.0), 0.0, extent, s.seed, 10, 10.0, true);
+    for (int i = 0; i < s.queries; ++i) {
+        Eigen::Vector2d from = map.free[cell(engine)];
+        Eigen::Vector2d to = map.free[cell(engine)];
+        auto t = std::chrono::steady_clock::now();
+        vector<vector<double>> path = roadmap.query(from, to);
+        r.latency.push_back(elapsed_ms(t));
+        r.expanded += roadmap.get_expanded();
+        r.solved += !path.empty() && !path[0].empty();
+    }
+    r.total_ms = elapsed_ms(start);
+    r.expanded /= std::max(1, s.queries);
+
+    return r;
+}
+
+static const std::map<string, std::function<Result(const Scenario&)>> planners = {
+    {"astar", [](const Scenario& s) { return run_grid_search(s, 1.0); }},
+    {"weighted_astar", [](const Scenario& s) { return run_grid_search(s, 2.0); }},
+    {"dijkstra", [](const Scenario& s) { return run_grid_search(s, 0.0); }},
+    {"hybrid_astar", run_hybrid_astar},
+    {"prm", run_prm},
+    {"reeds_shepp", run_reeds_shepp},
+    {"rs_batch", [](const Scenario& s) { return run_steering_batch(s, false); }},
+    {"dubins_batch", [](const Scenario& s) { return run_steering_batch(s, true); }},
+};
+
+static vector<string> split(const string& value) {
+    vector<string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.push_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv) {
+    std::map<string, string> args = {{"planners", "astar,dijkstra,reeds_shepp"},
+                                     {"map_size", "100,400"},
+                                     {"density", "0.1,0.3"},
+                                     {"queries", "100"},
+                                     {"threads", "1"},
+                                     {"seed", "0"},
+                                     {"format", "json"},
+                                     {"profile", ""}};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos ||
+            args.count(arg.substr(2, eq - 2)) == 0) {
+            fmt::print(stderr, "unknown argument {}\n", arg);
+            return 1;
+        }
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+    for (const string& name : split(args["planners"])) {
+        if (planners.count(name) == 0) {
+            fmt::print(stderr, "unknown planner {}\n", name);
+            return 1;
+        }
+    }
+    bool csv = args["format"] == "csv";
+    if (!args["profile"].empty()) {
+        if (!utils::prof::ENABLED) {
+            fmt::print(stderr, "--profile needs a build with ENABLE_PROFILING\n");
+        }
+        utils::prof::enable_trace(true);
+    }
+    if (csv) {
+        fmt::print("planner,map_size,density,queries,threads,solved,expanded,total_ms,p50_ms,"
+                   "p90_ms,p99_ms,max_ms,peak_rss_kb\n");
+    }
+
+    for (const string& name : split(args["planners"])) {
+        for (const string& size : split(args["map_size"])) {
+            for (const string& density : split(args["density"])) {
+                for (const string& threads : split(args["threads"])) {
+                    Scenario s;
+                    s.planner = name;
+                    s.map_size = std::stoi(size);
+                    s.density = std::stod(density);
+                    s.queries = std::stoi(args["queries"]);
+                    s.threads = std::stoi(threads);
+                    s.seed = std::stoul(args["seed"]);
+                    Result r = planners.at(name)(s);
+
+                    double p50 = percentile(r.latency, 50);
+                    double p90 = percentile(r.latency, 90);
+                    double p99 = percentile(r.latency, 99);
+                    double pmax = percentile(r.latency, 100);
+                    if (csv) {
+                        fmt::print("{},{},{},{},{},{},{:.1f},{:.3f},{:.4f},{:.4f},{:.4f},"
+                                   "{:.4f},{}\n",
+                                   s.planner, s.map_size, s.density, s.queries, s.threads,
+                                   r.solved, r.expanded, r.total_ms, p50, p90, p99, pmax,
+                                   peak_memory_kb());
+                    } else {
+                        fmt::print(
+                            "{{\"planner\": \"{}\", \"map_size\": {}, \"density\": {}, "
+                            "\"queries\": {}, \"threads\": {}, \"solved\": {}, "
+                            "\"expanded\": {:.1f}, \"total_ms\": {:.3f}, \"p50_ms\": {:.4f}, "
+                            "\"p90_ms\": {:.4f}, \"p99_ms\": {:.4f}, \"max_ms\": {:.4f}, "
+                            "\"peak_rss_kb\": {}}}\n",
+                            s.planner, s.map_size, s.density, s.queries, s.threads, r.solved,
+                            r.expanded, r.total_ms, p50, p90, p99, pmax, peak_memory_kb());
+                    }
+                }
+            }
+        }
+    }
+
+    if (!args["profile"].empty() && utils::prof::ENABLED) {
+        if (!utils::prof::write_json(args["profile"] + ".json") ||
+            !utils::prof::write_chrome_trace(args["profile"] + "_trace.json")) {
+            fmt::print(stderr, "cannot write the profile {}\n", args["profile"]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
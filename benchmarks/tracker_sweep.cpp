@@ -0,0 +1,165 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PathPlanning/include/cubic_spline.hpp"
+#include "thread_pool.hpp"
+#include "trajectory_index.hpp"
+#include "utils.hpp"
+#include "vehicle_batch.hpp"
+
+using std::string;
+using std::vector;
+
+// headless Monte Carlo sweep of the Stanley steering gain. every gain runs a batch of rollouts
+// from randomly perturbed start poses on the course of stanley_controller, all rollouts share
+// one utils::VehicleBatch and one TrajectoryIndex. one json object (or csv row) per line:
+//   tracker_sweep --gains=0.25,0.5,1.0 --rollouts=10000 --steps=400 --threads=1,4 --seed=0
+// a rollout stops once its target is the last course point. cte is the cross track error of
+// the front axle until then, reached is the share of rollouts that stopped.
+
+constexpr double DT = 0.1;
+constexpr double TARGET_SPEED = 20.0 / 3.6;
+constexpr double KP = 1.0;
+
+class SweepResult {
+public:
+    double total_ms = 0.0;
+    double mean_cte = 0.0;
+    double max_cte = 0.0;
+    double reached = 0.0;
+
+    SweepResult() {}
+    ~SweepResult() {}
+};
+
+static SweepResult run_sweep(const TrajectoryIndex& course, const vector<double>& cyaw,
+                             double gain, int rollouts, int steps, int threads,
+                             unsigned int seed) {
+    utils::VehicleConfig vc;
+    utils::VehicleBatch batch(vc, rollouts);
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> offset(-2.0, 2.0);
+    std::uniform_real_distribution<double> heading(-0.3, 0.3);
+    for (int i = 0; i < rollouts; ++i) {
+        batch.set(i, course.x(0) + offset(engine), course.y(0) + offset(engine),
+                  cyaw[0] + heading(engine), 0.0);
+    }
+    vector<int> cursor(rollouts, -1);
+    vector<int> last_target(rollouts, 0);
+    vector<double> cte_sum(rollouts, 0.0);
+    vector<double> cte_max(rollouts, 0.0);
+    vector<int> ticks(rollouts, 0);
+    const int last = course.size() - 1;
+
+    auto stanley = [&](size_t i, const utils::VehicleState& s, double& acc, double& delta) {
+        if (last_target[i] == last) {
+            acc = -s.v / DT;
+            delta = 0.0;
+            return;
+        }
+        double fx = s.x + s.vc.RF * cos(s.yaw);
+        double fy = s.y + s.vc.RF * sin(s.yaw);
+        int target = std::max<int>(course.track(fx, fy, cursor[i]), last_target[i]);
+        last_target[i] = target;
+        double error = -(fx - course.x(target)) * cos(s.yaw + M_PI_2) -
+                       (fy - course.y(target)) * sin(s.yaw + M_PI_2);
+        double theta_e = utils::pi_2_pi(cyaw[target] - s.yaw) * 0.8;
+        delta = theta_e + atan2(gain * error, s.v);
+        acc = KP * (TARGET_SPEED - s.v);
+        cte_sum[i] += std::abs(error);
+        cte_max[i] = std::max(cte_max[i], std::abs(error));
+        ticks[i] += 1;
+    };
+
+    utils::ThreadPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < steps; ++k) {
+        batch.step(stanley, DT, threads > 1 ? &pool : nullptr);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    SweepResult r;
+    r.total_ms = elapsed.count() * 1000;
+    for (int i = 0; i < rollouts; ++i) {
+        r.mean_cte += cte_sum[i] / std::max(ticks[i], 1) / rollouts;
+        r.max_cte = std::max(r.max_cte, cte_max[i]);
+        r.reached += last_target[i] == last ? 1.0 / rollouts : 0.0;
+    }
+
+    return r;
+}
+
+static vector<string> split(const string& value) {
+    vector<string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.push_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv) {
+    std::map<string, string> args = {{"gains", "0.25,0.5,1.0"}, {"rollouts", "10000"},
+                                     {"steps", "400"},          {"threads", "1"},
+                                     {"seed", "0"},             {"format", "json"}};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos ||
+            args.count(arg.substr(2, eq - 2)) == 0) {
+            fmt::print(stderr, "unknown argument {}\n", arg);
+            return 1;
+        }
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+
+    vector<double> ax = {0.0, 50.0, 50.0, 25.0, 30.0};
+    vector<double> ay = {0.0, 0.0, -15.0, -10.0, 0.0};
+    vector<vector<double>> c = CubicSpline2D::calc_spline_course(ax, ay, 0.1);
+    TrajectoryIndex course(c[0], c[1]);
+
+    int rollouts = std::stoi(args["rollouts"]);
+    int steps = std::stoi(args["steps"]);
+    unsigned int seed = std::stoul(args["seed"]);
+    bool csv = args["format"] == "csv";
+    if (csv) {
+        fmt::print("gain,rollouts,steps,threads,total_ms,ns_per_vehicle_step,mean_cte,max_cte,"
+                   "reached\n");
+    }
+
+    for (const string& gain : split(args["gains"])) {
+        for (const string& threads : split(args["threads"])) {
+            double k = std::stod(gain);
+            int t = std::stoi(threads);
+            SweepResult r = run_sweep(course, c[2], k, rollouts, steps, t, seed);
+            double ns = r.total_ms * 1e6 / (static_cast<double>(rollouts) * steps);
+            if (csv) {
+                fmt::print("{},{},{},{},{:.3f},{:.1f},{:.4f},{:.4f},{:.3f}\n", k, rollouts, steps,
+                           t, r.total_ms, ns, r.mean_cte, r.max_cte, r.reached);
+            } else {
+                fmt::print("{{\"gain\": {}, \"rollouts\": {}, \"steps\": {}, \"threads\": {}, "
+                           "\"total_ms\": {:.3f}, \"ns_per_vehicle_step\": {:.1f}, "
+                           "\"mean_cte\": {:.4f}, \"max_cte\": {:.4f}, \"reached\": {:.3f}}}\n",
+                           k, rollouts, steps, t, r.total_ms, ns, r.mean_cte, r.max_cte,
+                           r.reached);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+# installs the build into a scratch prefix and builds cmake/consumer against it, run by the
+# install_consumer test:
+#   cmake -DBINARY_DIR=<build> -DSOURCE_DIR=<tree> -P cmake/check_consumer.cmake
+set(WORK_DIR ${BINARY_DIR}/consumer_check)
+file(REMOVE_RECURSE ${WORK_DIR})
+
+file(MAKE_DIRECTORY ${WORK_DIR}/build)
+function(run_step)
+  execute_process(COMMAND ${ARGN} WORKING_DIRECTORY ${WORK_DIR}/build RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed: ${ARGN}")
+  endif()
+endfunction()
+
+run_step(${CMAKE_COMMAND} -DCMAKE_INSTALL_PREFIX=${WORK_DIR}/prefix
+         -P ${BINARY_DIR}/cmake_install.cmake)
+# the consumer gets the dependencies the build found, not others on its search path
+load_cache(${BINARY_DIR} READ_WITH_PREFIX BUILD_ fmt_DIR Eigen3_DIR CMAKE_PREFIX_PATH)
+run_step(${CMAKE_COMMAND} ${SOURCE_DIR}/cmake/consumer
+         "-DCMAKE_PREFIX_PATH=${WORK_DIR}/prefix;${BUILD_CMAKE_PREFIX_PATH}"
+         -Dfmt_DIR=${BUILD_fmt_DIR} -DEigen3_DIR=${BUILD_Eigen3_DIR})
+run_step(${CMAKE_COMMAND} --build .)
+run_step(${WORK_DIR}/build/consumer)
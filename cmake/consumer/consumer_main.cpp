@@ -0,0 +1,12 @@
+#include <cstdio>
+
+#include "all_headers.hpp"
+
+double plan_around_wall();
+
+int main() {
+    double length = plan_around_wall();
+    utils::VehicleConfig vc;
+    std::printf("path of %.0f points, wheelbase %.2f m\n", length, vc.WB);
+    return length > 0 ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "all_headers.hpp"
+
+class AStarPlanner : public GraphSearchPlanner {
+public:
+    AStarPlanner(std::vector<double> ox, std::vector<double> oy, double reso, double radius)
+        : GraphSearchPlanner(ox, oy, reso, radius) {}
+
+    std::vector<std::vector<double>> planning(double sx, double sy, double gx,
+                                              double gy) override {
+        SearchArena& arena = get_search_arena();
+        int gix = calc_xyindex(gx, get_minx());
+        int giy = calc_xyindex(gy, get_miny());
+        search(arena, calc_xyindex(sx, get_minx()), calc_xyindex(sy, get_miny()), gix, giy);
+        return extract_path(arena, gix, giy);
+    }
+};
+
+// the second translation unit, it plans on a grid with a wall through the middle
+double plan_around_wall() {
+    std::vector<double> ox, oy;
+    for (int i = 0; i <= 20; ++i) {
+        ox.push_back(i);
+        oy.push_back(0.0);
+        ox.push_back(i);
+        oy.push_back(20.0);
+        ox.push_back(0.0);
+        oy.push_back(i);
+        ox.push_back(20.0);
+        oy.push_back(i);
+    }
+    for (int i = 0; i < 15; ++i) {
+        ox.push_back(10.0);
+        oy.push_back(i);
+    }
+    AStarPlanner planner(ox, oy, 1.0, 0.5);
+    std::vector<std::vector<double>> path = planner.planning(5.0, 5.0, 15.0, 5.0);
+    return static_cast<double>(path.empty() ? 0 : path[0].size());
+}
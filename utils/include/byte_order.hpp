@@ -0,0 +1,67 @@
+#pragma once
+#ifndef __BYTE_ORDER_HPP
+#define __BYTE_ORDER_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace utils {
+
+// the binary files of the project are little-endian. a big-endian host swaps every value on
+// the way in and out, on a little-endian host the conversions compile to nothing
+constexpr bool LITTLE_ENDIAN_HOST = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+template <typename T>
+T byte_swap(T value) {
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+        unsigned char b = bytes[i];
+        bytes[i] = bytes[sizeof(T) - 1 - i];
+        bytes[sizeof(T) - 1 - i] = b;
+    }
+    memcpy(&value, bytes, sizeof(T));
+
+    return value;
+}
+
+// host order to little-endian and back, the same swap both ways
+template <typename T>
+T little_endian(T value) {
+    return LITTLE_ENDIAN_HOST ? value : byte_swap(value);
+}
+
+template <typename T>
+void little_endian(T* values, size_t n) {
+    if (!LITTLE_ENDIAN_HOST) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = byte_swap(values[i]);
+        }
+    }
+}
+
+// fwrite / fread of n values stored little-endian, true if all of them were transferred
+template <typename T>
+bool write_little_endian(FILE* fp, const T* values, size_t n) {
+    if (LITTLE_ENDIAN_HOST) {
+        return fwrite(values, sizeof(T), n, fp) == n;
+    }
+    std::vector<T> swapped(values, values + n);
+    little_endian(swapped.data(), n);
+    return fwrite(swapped.data(), sizeof(T), n, fp) == n;
+}
+
+template <typename T>
+bool read_little_endian(FILE* fp, T* values, size_t n) {
+    if (fread(values, sizeof(T), n, fp) != n) {
+        return false;
+    }
+    little_endian(values, n);
+    return true;
+}
+
+}  // namespace utils
+
+#endif
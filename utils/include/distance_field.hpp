@@ -0,0 +1,102 @@
+#pragma once
+#ifndef __DISTANCE_FIELD_HPP
+#define __DISTANCE_FIELD_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+// disks covering a robot footprint, (dx, dy) is the center of a disk in the robot frame
+// (x along the heading) and radius its radius [m]
+class DiskFootprint {
+public:
+    std::vector<double> dx;
+    std::vector<double> dy;
+    std::vector<double> radius;
+
+    static DiskFootprint circle(double _radius);
+    // rectangle spanning [-back, front] along the heading and [-half_width, half_width] across
+    // it, covered by disks in a row. the disks reach at most max_bulge past its long sides,
+    // farther at its ends
+    static DiskFootprint rectangle(double front, double back, double half_width,
+                                   double max_bulge);
+
+    // farthest a disk reaches from the reference point [m]
+    double get_reach(void) const;
+};
+
+// euclidean distance from the cell centers (ix * reso + minx, iy * reso + miny) to the nearest
+// obstacle point, clamped to max_dist. only the TILE x TILE cell tiles with an obstacle within
+// max_dist are allocated, all other tiles read max_dist. update() recomputes just the tiles
+// near the points that were added or removed, so a moving obstacle does not rebuild the field.
+//
+// a query interpolates the four surrounding cell centers in O(1) regardless of the number of
+// obstacles. the interpolation can exceed the true distance by up to reso * sqrt(2) / 2 in the
+// middle of a cell, so a query returns it minus that bound, clamped to 0: the clearance is never
+// overestimated and at most reso * sqrt(2) below the true distance. callers compare it with
+// their radii as is. queries outside the grid read the border cells.
+class DistanceField {
+public:
+    static constexpr int TILE = 32;
+
+    DistanceField() {}
+    DistanceField(int _xwidth, int _ywidth, double _minx, double _miny, double _reso,
+                  double _max_dist);
+    ~DistanceField() {}
+
+    // grid covering [minx, maxx] x [miny, maxy]
+    static DistanceField from_bounds(double minx, double miny, double maxx, double maxy,
+                                     double reso, double max_dist);
+
+    // the obstacle points are now (ox, oy)
+    void update(const std::vector<double>& ox, const std::vector<double>& oy);
+
+    // lower bound of the distance [m] from (x, y) to the nearest obstacle, at most max_dist
+    double clearance(double x, double y) const;
+    void clearance(const double* x, const double* y, size_t n, double* out) const;
+    double min_clearance(const std::vector<double>& x, const std::vector<double>& y) const;
+
+    // smallest gap [m] between the footprint at pose (x, y, yaw) and an obstacle, negative if
+    // they overlap
+    double clearance(const DiskFootprint& fp, double x, double y, double yaw) const;
+    // the same with the heading given as its cosine and sine
+    double clearance(const DiskFootprint& fp, double x, double y, double cos_yaw,
+                     double sin_yaw) const;
+    // smallest gap over every step-th pose
+    double min_clearance(const DiskFootprint& fp, const std::vector<double>& x,
+                         const std::vector<double>& y, const std::vector<double>& yaw,
+                         size_t step = 1) const;
+
+    double get_max_dist(void) const { return max_dist; }
+    // tiles recomputed by the last update
+    int get_updated_tiles(void) const { return updated_tiles; }
+    size_t get_bytes(void) const;
+
+private:
+    int xwidth = 0;
+    int ywidth = 0;
+    double minx = 0.0;
+    double miny = 0.0;
+    double reso = 1.0;
+    double max_dist = 0.0;
+    int tiles_x = 0;
+    int tiles_y = 0;
+    int tile_reach = 0;  // tiles an obstacle can affect in every direction
+    int updated_tiles = 0;
+    std::vector<std::vector<float>> tiles;  // empty when every cell reads max_dist
+    std::vector<double> ox;
+    std::vector<double> oy;
+    std::vector<std::vector<int>> tile_points;  // obstacle points bucketed by tile
+
+    float cell(int ix, int iy) const {
+        const std::vector<float>& tile = tiles[(iy / TILE) * tiles_x + ix / TILE];
+        return tile.empty() ? max_dist : tile[(iy % TILE) * TILE + ix % TILE];
+    }
+    int tile_of(double x, double y) const;
+    void calc_tile(int tx, int ty);
+};
+
+}  // namespace utils
+
+#endif
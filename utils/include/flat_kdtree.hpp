@@ -0,0 +1,281 @@
+#pragma once
+#ifndef __FLAT_KDTREE_HPP
+#define __FLAT_KDTREE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace utils {
+
+// static k-d tree over Dim dimensional points. the tree is implicit: the points are stored
+// contiguously in build order and split into 2^levels leaf buckets of at most about LEAF_SIZE
+// points by halving the range at every level, so a node is only its split value and dimension,
+// stored at heap positions (children of node i are 2i + 1 and 2i + 2).
+//
+// queries write into caller buffers or call back, none of them allocates. indices are the
+// positions of the points in the build input.
+template <int Dim, typename Scalar = double>
+class KDTree {
+public:
+    using Point = std::array<Scalar, Dim>;
+    static constexpr size_t LEAF_SIZE = 16;
+
+    KDTree() {}
+    explicit KDTree(const std::vector<Point>& _points, ThreadPool* pool = nullptr) {
+        build(_points, pool);
+    }
+    explicit KDTree(const std::vector<std::vector<Scalar>>& rows, ThreadPool* pool = nullptr) {
+        build(rows, pool);
+    }
+    ~KDTree() {}
+
+    // pool, if not nullptr, builds the subtrees below the first levels in parallel
+    void build(const std::vector<Point>& _points, ThreadPool* pool = nullptr);
+
+    // points given as coordinate rows, rows[d][i] is coordinate d of point i, e.g. the
+    // {x, y} lists of the demos
+    void build(const std::vector<std::vector<Scalar>>& rows, ThreadPool* pool = nullptr);
+
+    size_t size(void) const { return points.size(); }
+    bool empty(void) const { return points.empty(); }
+
+    // the k nearest points of q, closest first, into index and dist2 which both hold k
+    // entries. returns the number found, min(k, size())
+    size_t knn(const Point& q, size_t k, size_t* index, Scalar* dist2) const;
+
+    // index of the nearest point of q, the tree must not be empty
+    size_t nearest(const Point& q, Scalar* dist2 = nullptr) const {
+        size_t index = 0;
+        Scalar d2 = 0;
+        knn(q, 1, &index, &d2);
+        if (dist2 != nullptr) {
+            *dist2 = d2;
+        }
+        return index;
+    }
+
+    // fn(index, dist2) for every point with distance <= r from q, in no particular order
+    template <typename Fn>
+    void radius(const Point& q, Scalar r, Fn&& fn) const {
+        if (!empty()) {
+            radius_node(0, 0, points.size(), 0, q, r * r, fn);
+        }
+    }
+
+    // indices of the points with distance <= r from q. out is cleared first, so a reused
+    // buffer does not allocate
+    void radius(const Point& q, Scalar r, std::vector<size_t>& out) const {
+        out.clear();
+        radius(q, r, [&out](size_t index, Scalar) { out.push_back(index); });
+    }
+
+    // heap memory held by the tree [bytes]
+    size_t get_bytes(void) const {
+        return points.capacity() * sizeof(Point) + ids.capacity() * sizeof(uint32_t) +
+               split.capacity() * sizeof(Scalar) + split_dim.capacity() * sizeof(uint8_t);
+    }
+
+private:
+    // the k best of a knn query, sorted by distance
+    class Best {
+    public:
+        size_t* index;
+        Scalar* dist2;
+        size_t k;
+        size_t count;
+
+        Scalar worst(void) const {
+            return count < k ? std::numeric_limits<Scalar>::max() : dist2[count - 1];
+        }
+
+        void insert(size_t id, Scalar d2) {
+            size_t pos = count < k ? count++ : k - 1;
+            while (pos > 0 && dist2[pos - 1] > d2) {
+                dist2[pos] = dist2[pos - 1];
+                index[pos] = index[pos - 1];
+                --pos;
+            }
+            dist2[pos] = d2;
+            index[pos] = id;
+        }
+    };
+
+    std::vector<Point> points;  // in build order
+    std::vector<uint32_t> ids;  // input index of every stored point
+    std::vector<Scalar> split;
+    std::vector<uint8_t> split_dim;
+    int levels = 0;
+
+    static Scalar distance2(const Point& a, const Point& b) {
+        Scalar d2 = 0;
+        for (int d = 0; d < Dim; ++d) {
+            Scalar diff = a[d] - b[d];
+            d2 += diff * diff;
+        }
+        return d2;
+    }
+
+    void build_node(const std::vector<Point>& input, size_t node, size_t lo, size_t hi,
+                    int level, int stop_level, std::vector<std::array<size_t, 3>>* subtrees);
+    void knn_node(size_t node, size_t lo, size_t hi, int level, const Point& q,
+                  Best& best) const;
+
+    template <typename Fn>
+    void radius_node(size_t node, size_t lo, size_t hi, int level, const Point& q, Scalar r2,
+                     Fn& fn) const {
+        if (level == levels) {
+            for (size_t i = lo; i < hi; ++i) {
+                Scalar d2 = distance2(points[i], q);
+                if (d2 <= r2) {
+                    fn(ids[i], d2);
+                }
+            }
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        Scalar diff = q[split_dim[node]] - split[node];
+        if (diff <= 0 || diff * diff <= r2) {
+            radius_node(2 * node + 1, lo, mid, level + 1, q, r2, fn);
+        }
+        if (diff >= 0 || diff * diff <= r2) {
+            radius_node(2 * node + 2, mid, hi, level + 1, q, r2, fn);
+        }
+    }
+};
+
+template <int Dim, typename Scalar>
+void KDTree<Dim, Scalar>::build(const std::vector<std::vector<Scalar>>& rows, ThreadPool* pool) {
+    size_t n = rows.empty() ? 0 : rows[0].size();
+    std::vector<Point> input(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (int d = 0; d < Dim; ++d) {
+            input[i][d] = rows[d][i];
+        }
+    }
+    build(input, pool);
+}
+
+template <int Dim, typename Scalar>
+void KDTree<Dim, Scalar>::build(const std::vector<Point>& input, ThreadPool* pool) {
+    size_t n = input.size();
+    levels = 0;
+    while ((n >> levels) > LEAF_SIZE) {
+        ++levels;
+    }
+    ids.resize(n);
+    std::iota(ids.begin(), ids.end(), 0);
+    split.assign((size_t(1) << levels) - 1, 0);
+    split_dim.assign(split.size(), 0);
+
+    // a few subtrees per thread, so the ones that finish early pick up more
+    int stop_level = levels;
+    std::vector<std::array<size_t, 3>> subtrees;
+    if (pool != nullptr && pool->size() > 1) {
+        stop_level = 0;
+        while (stop_level < levels && (1 << stop_level) < 4 * pool->size()) {
+            ++stop_level;
+        }
+    }
+    build_node(input, 0, 0, n, 0, stop_level, &subtrees);
+    if (!subtrees.empty()) {
+        pool->parallel_for(subtrees.size(), [&](size_t idx, int) {
+            const std::array<size_t, 3>& sub = subtrees[idx];
+            build_node(input, sub[0], sub[1], sub[2], stop_level, levels, nullptr);
+        });
+    }
+
+    points.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        points[i] = input[ids[i]];
+    }
+}
+
+// splits [lo, hi) of ids at its middle along the dimension of largest extent, down to
+// stop_level. the nodes at stop_level are left to the caller in subtrees
+template <int Dim, typename Scalar>
+void KDTree<Dim, Scalar>::build_node(const std::vector<Point>& input, size_t node, size_t lo,
+                                     size_t hi, int level, int stop_level,
+                                     std::vector<std::array<size_t, 3>>* subtrees) {
+    if (level == levels) {
+        return;
+    }
+    if (level == stop_level) {
+        subtrees->push_back({node, lo, hi});
+        return;
+    }
+
+    Point minp = input[ids[lo]];
+    Point maxp = minp;
+    for (size_t i = lo + 1; i < hi; ++i) {
+        const Point& p = input[ids[i]];
+        for (int d = 0; d < Dim; ++d) {
+            minp[d] = std::min(minp[d], p[d]);
+            maxp[d] = std::max(maxp[d], p[d]);
+        }
+    }
+    int dim = 0;
+    for (int d = 1; d < Dim; ++d) {
+        if (maxp[d] - minp[d] > maxp[dim] - minp[dim]) {
+            dim = d;
+        }
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    std::nth_element(ids.begin() + lo, ids.begin() + mid, ids.begin() + hi,
+                     [&](uint32_t a, uint32_t b) { return input[a][dim] < input[b][dim]; });
+    split[node] = input[ids[mid]][dim];
+    split_dim[node] = dim;
+
+    build_node(input, 2 * node + 1, lo, mid, level + 1, stop_level, subtrees);
+    build_node(input, 2 * node + 2, mid, hi, level + 1, stop_level, subtrees);
+}
+
+template <int Dim, typename Scalar>
+size_t KDTree<Dim, Scalar>::knn(const Point& q, size_t k, size_t* index, Scalar* dist2) const {
+    Best best = {index, dist2, std::min(k, points.size()), 0};
+    if (best.k > 0) {
+        knn_node(0, 0, points.size(), 0, q, best);
+    }
+
+    return best.count;
+}
+
+// the child on the side of q first, the other one only if it can still hold a better point
+template <int Dim, typename Scalar>
+void KDTree<Dim, Scalar>::knn_node(size_t node, size_t lo, size_t hi, int level, const Point& q,
+                                   Best& best) const {
+    if (level == levels) {
+        for (size_t i = lo; i < hi; ++i) {
+            Scalar d2 = distance2(points[i], q);
+            if (d2 < best.worst()) {
+                best.insert(ids[i], d2);
+            }
+        }
+        return;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    Scalar diff = q[split_dim[node]] - split[node];
+    if (diff <= 0) {
+        knn_node(2 * node + 1, lo, mid, level + 1, q, best);
+        if (diff * diff < best.worst()) {
+            knn_node(2 * node + 2, mid, hi, level + 1, q, best);
+        }
+    } else {
+        knn_node(2 * node + 2, mid, hi, level + 1, q, best);
+        if (diff * diff < best.worst()) {
+            knn_node(2 * node + 1, lo, mid, level + 1, q, best);
+        }
+    }
+}
+
+}  // namespace utils
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef __FOOTPRINT_CHECKER_HPP
+#define __FOOTPRINT_CHECKER_HPP
+
+#include <vector>
+
+#include "occupancy_grid.hpp"
+
+namespace utils {
+
+// collision test of a rectangular footprint against an OccupancyGrid. the rectangle spans
+// [-back, front] along the heading and [-half_width, half_width] across it, measured from the
+// reference point of the pose. it is rasterized once per yaw bin into row intervals of cell
+// offsets, so a pose costs one OccupancyGrid::is_row_occupied per row and no trigonometry.
+//
+// the masks are conservative: a cell is part of a mask if the rectangle can reach it for any
+// reference point inside the pose cell, any obstacle inside the cell and any yaw inside the bin,
+// so the footprint grows by up to reso * sqrt(2) + radius * bin_width / 2.
+class FootprintChecker {
+public:
+    FootprintChecker() {}
+    // reso has to be the resolution of the grids the checker is used with
+    FootprintChecker(double _front, double _back, double _half_width, double _reso,
+                     int _yaw_bins = 72);
+    ~FootprintChecker() {}
+
+    bool is_collision(const OccupancyGrid& grid, double x, double y, double yaw) const;
+    bool is_collision(const OccupancyGrid& grid, const std::vector<double>& x,
+                      const std::vector<double>& y, const std::vector<double>& yaw) const;
+
+    // farthest offset a mask covers [m], grids need this much room around the obstacles
+    double get_reach(void) const { return reach * reso; }
+
+private:
+    class Row {
+    public:
+        int dy;
+        int lo;
+        int hi;
+    };
+
+    double front = 0.0;
+    double back = 0.0;
+    double half_width = 0.0;
+    double reso = 1.0;
+    double radius = 0.0;
+    int reach = 0;
+    int yaw_bins = 0;
+    std::vector<std::vector<Row>> masks;
+};
+
+// point obstacle map of (ox, oy) at resolution reso, covering the obstacles plus margin [m] on
+// every side, so footprints up to that size never leave the grid next to an obstacle
+OccupancyGrid calc_footprint_grid(const std::vector<double>& ox, const std::vector<double>& oy,
+                                  double reso, double margin);
+
+}  // namespace utils
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef __GRID_INFLATION_HPP
+#define __GRID_INFLATION_HPP
+
+#include <vector>
+
+#include "occupancy_grid.hpp"
+
+namespace utils {
+
+// distance from every cell center (ix * reso + minx, iy * reso + miny) to the nearest obstacle
+// point, only resolved up to max_dist; cells farther away keep max double.
+// every point is stamped onto the cells inside its disk, so the cost is
+// O(points * (max_dist / reso)^2) instead of O(cells * points).
+std::vector<std::vector<double>> calc_obstacle_distance_map(const std::vector<double>& ox,
+                                                            const std::vector<double>& oy,
+                                                            double minx, double miny, double reso,
+                                                            int xwidth, int ywidth,
+                                                            double max_dist);
+
+// a cell is occupied when some obstacle point lies within radius of its center
+OccupancyGrid calc_inflated_obstacle_map(const std::vector<double>& ox,
+                                         const std::vector<double>& oy, double minx, double miny,
+                                         double reso, int xwidth, int ywidth, double radius);
+
+// a cell is occupied when some obstacle point lies inside it, i.e. rounds to its center
+OccupancyGrid calc_point_obstacle_map(const std::vector<double>& ox, const std::vector<double>& oy,
+                                      double minx, double miny, double reso, int xwidth,
+                                      int ywidth);
+
+}  // namespace utils
+
+#endif
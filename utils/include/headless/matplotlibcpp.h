@@ -0,0 +1,80 @@
+#pragma once
+#ifndef __HEADLESS_MATPLOTLIBCPP_H
+#define __HEADLESS_MATPLOTLIBCPP_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// stand-in for utils/include/matplotlibcpp.h when VIZ_BACKEND is not matplotlib. the include
+// path puts this directory first, so the demos compile unchanged against calls that do nothing
+// and nothing links Python. the non-template overloads take the braced initializer calls that
+// the variadic ones can not deduce.
+namespace matplotlibcpp {
+
+template <typename... Args>
+inline bool plot(const Args&...) {
+    return true;
+}
+inline bool plot(const std::vector<double>&, const std::vector<double>&,
+                 const std::string& = "") {
+    return true;
+}
+inline bool plot(const std::vector<double>&, const std::string& = "") { return true; }
+template <typename NumericX, typename NumericY>
+inline bool plot(const NumericX&, const NumericY&, const std::map<std::string, std::string>&) {
+    return true;
+}
+
+template <typename... Args>
+inline bool named_plot(const Args&...) {
+    return true;
+}
+
+template <typename NumericX, typename NumericY>
+inline bool fill(const NumericX&, const NumericY&, const std::map<std::string, std::string>&) {
+    return true;
+}
+
+template <typename... Args>
+inline bool arrow(const Args&...) {
+    return true;
+}
+
+template <typename T>
+inline void imshow(const T*, int, int, int, const std::map<std::string, std::string>& = {}) {}
+
+template <typename... Args>
+inline void text(const Args&...) {}
+
+template <typename... Args>
+inline void title(const Args&...) {}
+
+template <typename... Args>
+inline void xlabel(const Args&...) {}
+
+template <typename... Args>
+inline void ylabel(const Args&...) {}
+
+template <typename... Args>
+inline void xlim(const Args&...) {}
+
+template <typename... Args>
+inline void ylim(const Args&...) {}
+
+inline void legend() {}
+inline void legend(const std::map<std::string, std::string>&) {}
+
+inline void axis(const std::string&) {}
+inline void grid(bool) {}
+inline long figure(long number = -1) { return number; }
+inline void show(const bool = true) {}
+inline void cla() {}
+inline void clf() {}
+
+template <typename Numeric>
+inline void pause(Numeric) {}
+
+}  // namespace matplotlibcpp
+
+#endif
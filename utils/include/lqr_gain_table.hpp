@@ -0,0 +1,133 @@
+#pragma once
+#ifndef __LQR_GAIN_TABLE_HPP
+#define __LQR_GAIN_TABLE_HPP
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace utils {
+
+// LQR gains of a model that depends on the speed only, x_{k+1} = A(v) x_k + B(v) u_k. the
+// gains are solved on a grid of speeds once, a tick interpolates between the two grid speeds
+// around v. a speed off the grid solves the DARE, starting from the solution of the nearest
+// grid speed.
+template <int StateDim, int InputDim>
+class LQRGainTable {
+public:
+    using MatrixA = Eigen::Matrix<double, StateDim, StateDim>;
+    using MatrixB = Eigen::Matrix<double, StateDim, InputDim>;
+    using MatrixR = Eigen::Matrix<double, InputDim, InputDim>;
+    using MatrixK = Eigen::Matrix<double, InputDim, StateDim>;
+    // sets the speed dependent entries of A and B, the others keep their initial values
+    using Model = std::function<void(double v, MatrixA& A, MatrixB& B)>;
+
+    LQRGainTable() {}
+    LQRGainTable(const MatrixA& _A, const MatrixB& _B, const Model& _model, const MatrixA& _Q,
+                 const MatrixR& _R, double _tolerance = 0.01, size_t _max_iter = 150)
+        : A0(_A), B0(_B), model(_model), Q(_Q), R(_R), tolerance(_tolerance),
+          max_iter(_max_iter) {}
+    ~LQRGainTable() {}
+
+    // n speeds evenly covering [v_min, v_max], every one solved from Q like a single solve
+    // would. n = 1 only holds v_min, n <= 0 leaves the table empty and every gain is solved.
+    // pool, if not nullptr, solves them in parallel
+    void build(double _v_min, double _v_max, int n, ThreadPool* pool = nullptr) {
+        n = std::max(n, 0);
+        v_min = _v_min;
+        step = n > 1 ? (_v_max - _v_min) / (n - 1) : 1.0;
+        P.resize(n);
+        K.resize(n);
+        auto solve = [&](size_t i, int) {
+            MatrixA A;
+            MatrixB B;
+            model_at(v_min + i * step, A, B);
+            P[i] = solve_dare(A, B, Q);
+            K[i] = calc_gain(A, B, P[i]);
+        };
+        if (pool != nullptr) {
+            pool->parallel_for(n, solve);
+        } else {
+            for (int i = 0; i < n; ++i) {
+                solve(i, 0);
+            }
+        }
+    }
+
+    bool empty(void) const { return K.empty(); }
+
+    MatrixK gain(double v) const {
+        double f = (v - v_min) / step;
+        int n = K.size();
+        if (n == 0 || f < 0.0 || f > n - 1) {
+            MatrixA A;
+            MatrixB B;
+            model_at(v, A, B);
+            const MatrixA& p0 = n == 0 ? Q : P[f < 0.0 ? 0 : n - 1];
+            return calc_gain(A, B, solve_dare(A, B, p0));
+        }
+        if (n == 1) {
+            return K[0];
+        }
+        int i = std::min(static_cast<int>(f), n - 2);
+        double w = f - i;
+
+        return K[i] + w * (K[i + 1] - K[i]);
+    }
+
+    // fixed point iteration of the discrete-time algebraic Riccati equation from p0
+    // x_{k+1} = A * x_{k} + B * u_{k}
+    // J = sum{ x_{k}.T * Q * x_{k} + u_{k}.T * R * u_{k} }
+    MatrixA solve_dare(const MatrixA& A, const MatrixB& B, const MatrixA& p0) const {
+        MatrixA p = p0;
+        MatrixA p_next = p0;
+        for (size_t i = 0; i < max_iter; ++i) {
+            MatrixB pb = p * B;
+            Eigen::Matrix<double, InputDim, StateDim> gain =
+                (R + B.transpose() * pb).ldlt().solve(pb.transpose() * A);
+            p_next = A.transpose() * p * A - A.transpose() * pb * gain + Q;
+
+            if ((p_next - p).array().abs().maxCoeff() < tolerance) {
+                break;
+            }
+            p = p_next;
+        }
+
+        return p_next;
+    }
+
+    MatrixK calc_gain(const MatrixA& A, const MatrixB& B, const MatrixA& p) const {
+        MatrixB pb = p * B;
+        return (B.transpose() * pb + R).ldlt().solve(pb.transpose() * A);
+    }
+
+private:
+    MatrixA A0;
+    MatrixB B0;
+    Model model;
+    MatrixA Q;
+    MatrixR R;
+    double tolerance = 0.01;
+    size_t max_iter = 150;
+
+    double v_min = 0.0;
+    double step = 1.0;
+    std::vector<MatrixA> P;
+    std::vector<MatrixK> K;
+
+    void model_at(double v, MatrixA& A, MatrixB& B) const {
+        A = A0;
+        B = B0;
+        model(v, A, B);
+    }
+};
+
+}  // namespace utils
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef __OCCUPANCY_GRID_HPP
+#define __OCCUPANCY_GRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// bit-packed occupancy grid. cells are grouped in 8x8 tiles stored as one uint64_t each
+// (bit (iy % 8) * 8 + ix % 8), tiles are laid out row by row, so a cell and all of its
+// 8-connected neighbors are usually in the same or the adjacent word.
+//
+// file format, little-endian, tile data starts at byte 64 so a mapped file is 8-byte aligned:
+//   0   char[8]   magic "OCCGRID\0"
+//   8   uint32    format version (1)
+//   12  uint32    tile size (8)
+//   16  int32     xwidth [cells]
+//   20  int32     ywidth [cells]
+//   24  double    minx [m], position of cell ix = 0
+//   32  double    miny [m], position of cell iy = 0
+//   40  double    resolution [m]
+//   48  uint64    reserved
+//   56  uint64    reserved
+//   64  uint64[]  tiles_x * tiles_y tiles, tiles_x = ceil(xwidth / 8)
+// every value is converted to and from little-endian, see byte_order.hpp. load() maps the file
+// copy-on-write, so opening a map is O(1) in its size and set() on a loaded grid never writes
+// back to the file. a big-endian host reads a swapped copy instead.
+class OccupancyGrid {
+public:
+    static constexpr int TILE = 8;
+
+    OccupancyGrid() {}
+    OccupancyGrid(int _xwidth, int _ywidth, double _minx, double _miny, double _resolution);
+    OccupancyGrid(const OccupancyGrid& other);
+    OccupancyGrid(OccupancyGrid&& other) noexcept;
+    OccupancyGrid& operator=(OccupancyGrid other) noexcept;
+    ~OccupancyGrid();
+
+    // cells outside the grid count as occupied
+    bool is_occupied(int ix, int iy) const {
+        if (ix < 0 || iy < 0 || ix >= xwidth || iy >= ywidth) {
+            return true;
+        }
+        return (tiles[(iy >> 3) * tiles_x + (ix >> 3)] >> (((iy & 7) << 3) | (ix & 7))) & 1;
+    }
+
+    // true if any cell ix0 <= ix <= ix1 of row iy is occupied, tested 8 cells per AND
+    bool is_row_occupied(int iy, int ix0, int ix1) const {
+        if (iy < 0 || iy >= ywidth || ix0 < 0 || ix1 >= xwidth) {
+            return true;
+        }
+        const uint64_t* row = tiles + (iy >> 3) * tiles_x;
+        int shift = (iy & 7) << 3;
+        for (int t = ix0 >> 3; t <= ix1 >> 3; ++t) {
+            uint64_t bits = row[t] >> shift;
+            int lo = t == (ix0 >> 3) ? ix0 & 7 : 0;
+            int hi = t == (ix1 >> 3) ? ix1 & 7 : 7;
+            if (bits & (0xffu >> (7 - hi)) & (0xffu << lo)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void set(int ix, int iy, bool occupied);
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+    int get_xwidth(void) const { return xwidth; }
+
+    int get_ywidth(void) const { return ywidth; }
+
+    double get_minx(void) const { return minx; }
+
+    double get_miny(void) const { return miny; }
+
+    double get_resolution(void) const { return resolution; }
+
+    bool is_mapped(void) const { return mapping != nullptr; }
+
+private:
+    int xwidth = 0;
+    int ywidth = 0;
+    int tiles_x = 0;
+    int tiles_y = 0;
+    double minx = 0.0;
+    double miny = 0.0;
+    double resolution = 1.0;
+    uint64_t* tiles = nullptr;
+    std::vector<uint64_t> storage;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    void release(void);
+};
+
+}  // namespace utils
+
+#endif
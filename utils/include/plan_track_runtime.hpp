@@ -0,0 +1,160 @@
+#pragma once
+#ifndef __PLAN_TRACK_RUNTIME_HPP
+#define __PLAN_TRACK_RUNTIME_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "triple_buffer.hpp"
+
+namespace utils {
+
+// t is the time of the runtime clock [s], s the distance along the trajectory
+class TrajectoryPoint {
+public:
+    double t = 0.0;
+    double x = 0.0;
+    double y = 0.0;
+    double yaw = 0.0;
+    double v = 0.0;
+    double a = 0.0;
+    double kappa = 0.0;
+    double s = 0.0;
+
+    TrajectoryPoint() {}
+    ~TrajectoryPoint() {}
+};
+
+class Trajectory {
+public:
+    // counts the published trajectories from 1, 0 before the first one
+    uint64_t sequence = 0;
+    std::vector<TrajectoryPoint> points;
+
+    Trajectory() {}
+    ~Trajectory() {}
+
+    bool empty(void) const { return points.empty(); }
+    double start_time(void) const { return points.front().t; }
+    double end_time(void) const { return points.back().t; }
+    // interpolated between the points around t, clamped to the first and last point
+    TrajectoryPoint sample(double t) const;
+};
+
+class RuntimeConfig {
+public:
+    double plan_period = 0.1;      // [s]
+    double control_period = 0.01;  // [s]
+    // a plan starts this far ahead of the time the planner is called, the controller follows
+    // the previous trajectory until then. one plan period covers a planner that takes its
+    // whole period
+    double plan_latency = 0.1;  // [s]
+    // the vehicle may be this far off the previous trajectory before the next plan starts
+    // from the vehicle instead of from the previous trajectory
+    double max_lateral_error = 0.5;       // [m]
+    double max_longitudinal_error = 2.5;  // [m]
+    // length of the previous trajectory kept in front of a stitched plan
+    double keep_time = 0.3;  // [s]
+    // SCHED_FIFO priority of the controller thread, 0 keeps the default scheduling
+    int control_priority = 0;
+
+    RuntimeConfig() {}
+    ~RuntimeConfig() {}
+};
+
+// counters of one periodic loop. tick k is due at start + k * period, it misses its deadline
+// when it ends after the next tick is due. periods that pass entirely during an overrun are
+// skipped, the loop continues at the next due tick instead of running late ticks back to back.
+class LoopStats {
+public:
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> skipped{0};
+    // ticks whose callback reported no result, e.g. the planner found no path
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    // largest delay of a tick behind its due time
+    std::atomic<uint64_t> max_jitter_ns{0};
+
+    LoopStats() {}
+    ~LoopStats() {}
+};
+
+// continues prev from the vehicle state. when state lies within the error bounds of prev at
+// state.t, start is prev at t and prefix is set to the points of prev from t - keep_time up
+// to t, so the new trajectory follows them without a jump. otherwise start is state moved to t
+// along its arc and prefix is cleared. returns whether prev was continued.
+bool stitch_trajectory(const Trajectory& prev, const TrajectoryPoint& state, double t,
+                       const RuntimeConfig& config, std::vector<TrajectoryPoint>& prefix,
+                       TrajectoryPoint& start);
+
+// runs a planner and a tracker on two threads at their own rates:
+//   planner(start, trajectory) appends a trajectory that begins at start to trajectory.points
+//     and returns false when it has none. the points already in it are the stitched prefix.
+//   controller(trajectory, t, state) tracks the newest trajectory at time t and writes the
+//     measured vehicle state to state, from which the next plan is stitched. state.t is set to
+//     t before the call. the trajectory is empty until the first plan is published.
+// trajectories and states are handed over by triple buffers, the controller thread never waits
+// for the planner and does not allocate. the planner does not run before the controller has
+// reported a state.
+class PlanTrackRuntime {
+public:
+    using Planner = std::function<bool(const TrajectoryPoint&, Trajectory&)>;
+    using Controller = std::function<void(const Trajectory&, double, TrajectoryPoint&)>;
+
+    PlanTrackRuntime(const RuntimeConfig& _config, Planner _planner, Controller _controller)
+        : config(_config), planner(std::move(_planner)), controller(std::move(_controller)) {}
+    ~PlanTrackRuntime() { stop(); }
+    PlanTrackRuntime(const PlanTrackRuntime&) = delete;
+    PlanTrackRuntime& operator=(const PlanTrackRuntime&) = delete;
+
+    // time of the runtime clock [s], 0 at start()
+    double now(void) const;
+    void start(void);
+    // waits for the running ticks to end
+    void stop(void);
+    bool is_running(void) const { return running.load(std::memory_order_relaxed); }
+
+    const LoopStats& planner_stats(void) const { return plan_stats; }
+    const LoopStats& controller_stats(void) const { return control_stats; }
+    // plans started from the vehicle state because it left the previous trajectory
+    uint64_t stitch_resets(void) const { return resets.load(std::memory_order_relaxed); }
+    // whether the controller thread got its SCHED_FIFO priority
+    bool is_realtime(void) const { return realtime.load(std::memory_order_relaxed); }
+
+private:
+    const RuntimeConfig config;
+    Planner planner;
+    Controller controller;
+
+    TripleBuffer<Trajectory> trajectories;
+    TripleBuffer<TrajectoryPoint> states;
+    // the last published trajectory, kept by the planner thread
+    Trajectory previous;
+    uint64_t sequence = 0;
+    bool has_state = false;
+
+    std::chrono::steady_clock::time_point epoch;
+    std::thread plan_thread;
+    std::thread control_thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> resets{0};
+    std::atomic<bool> realtime{false};
+    LoopStats plan_stats;
+    LoopStats control_stats;
+
+    bool plan_tick(void);
+    bool control_tick(void);
+    void run_loop(double period, LoopStats& stats, bool (PlanTrackRuntime::*tick)(void));
+};
+
+}  // namespace utils
+
+#endif
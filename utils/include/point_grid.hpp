@@ -0,0 +1,157 @@
+#pragma once
+#ifndef __POINT_GRID_HPP
+#define __POINT_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace utils {
+
+// 2D points bucketed in a uniform grid of square cells over a fixed area, for trees that grow
+// one point at a time. every cell is the head of a list threaded through the points, so an
+// insert is amortized O(1). points outside the area are kept in the border cells, queries are
+// exact as long as the points and the query are inside the area. the cells start at the given
+// size and are halved whenever they hold more than MAX_LOAD points on average, so a tree that
+// fills the area does not slow the queries down.
+class PointGrid {
+public:
+    static constexpr int MAX_LOAD = 4;
+
+    PointGrid() {}
+    PointGrid(double _minx, double _miny, double _maxx, double _maxy, double _cell)
+        : minx(_minx), miny(_miny), maxx(_maxx), maxy(_maxy) {
+        resize_cells(_cell);
+    }
+    ~PointGrid() {}
+
+    void reserve(size_t n) {
+        x.reserve(n);
+        y.reserve(n);
+        next.reserve(n);
+    }
+
+    void clear(void) {
+        std::fill(head.begin(), head.end(), -1);
+        x.clear();
+        y.clear();
+        next.clear();
+    }
+
+    size_t size(void) const { return x.size(); }
+
+    // the points are numbered in insertion order from 0
+    int insert(double _x, double _y) {
+        int c = cell_index(cell_x(_x), cell_y(_y));
+        x.push_back(_x);
+        y.push_back(_y);
+        next.push_back(head[c]);
+        head[c] = x.size() - 1;
+        if (x.size() > MAX_LOAD * head.size()) {
+            resize_cells(cell / 2.0);
+        }
+
+        return x.size() - 1;
+    }
+
+    // index of the point nearest to (qx, qy), -1 if there is none. the cells are searched in
+    // rings around the cell of the query until no closer point can be in the next ring
+    int nearest(double qx, double qy, double* dist = nullptr) const {
+        int cx = cell_x(qx);
+        int cy = cell_y(qy);
+        int max_ring = std::max(std::max(cx, nx - 1 - cx), std::max(cy, ny - 1 - cy));
+        int best = -1;
+        double best_d2 = std::numeric_limits<double>::max();
+
+        for (int r = 0; r <= max_ring; ++r) {
+            for (int iy = std::max(cy - r, 0); iy <= std::min(cy + r, ny - 1); ++iy) {
+                bool edge_row = iy == cy - r || iy == cy + r;
+                int step = edge_row ? 1 : 2 * r;
+                for (int ix = cx - r; ix <= cx + r; ix += step) {
+                    if (ix >= 0 && ix < nx) {
+                        scan_cell(cell_index(ix, iy), qx, qy, best, best_d2);
+                    }
+                }
+            }
+            // a point in ring r + 1 is at least r cells away from the query
+            double reach = r * cell;
+            if (best >= 0 && best_d2 <= reach * reach) {
+                break;
+            }
+        }
+
+        if (dist != nullptr) {
+            *dist = best >= 0 ? sqrt(best_d2) : std::numeric_limits<double>::max();
+        }
+        return best;
+    }
+
+    // fn(index, dist) for every point within r of (qx, qy), in no particular order
+    template <typename Fn>
+    void radius(double qx, double qy, double r, Fn&& fn) const {
+        int x0 = cell_x(qx - r);
+        int x1 = cell_x(qx + r);
+        int y0 = cell_y(qy - r);
+        int y1 = cell_y(qy + r);
+        double r2 = r * r;
+        for (int iy = y0; iy <= y1; ++iy) {
+            for (int ix = x0; ix <= x1; ++ix) {
+                for (int i = head[cell_index(ix, iy)]; i >= 0; i = next[i]) {
+                    double d2 = (x[i] - qx) * (x[i] - qx) + (y[i] - qy) * (y[i] - qy);
+                    if (d2 <= r2) {
+                        fn(i, sqrt(d2));
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    double minx = 0.0;
+    double miny = 0.0;
+    double maxx = 0.0;
+    double maxy = 0.0;
+    double cell = 1.0;
+    int nx = 0;
+    int ny = 0;
+    std::vector<int> head;
+    std::vector<int> next;
+    std::vector<double> x;
+    std::vector<double> y;
+
+    int cell_x(double _x) const {
+        return std::clamp(static_cast<int>(floor((_x - minx) / cell)), 0, nx - 1);
+    }
+    int cell_y(double _y) const {
+        return std::clamp(static_cast<int>(floor((_y - miny) / cell)), 0, ny - 1);
+    }
+    int cell_index(int ix, int iy) const { return iy * nx + ix; }
+
+    // new cell size, the points are bucketed again
+    void resize_cells(double _cell) {
+        cell = _cell;
+        nx = std::max(1, static_cast<int>(ceil((maxx - minx) / cell)));
+        ny = std::max(1, static_cast<int>(ceil((maxy - miny) / cell)));
+        head.assign(static_cast<size_t>(nx) * ny, -1);
+        for (size_t i = 0; i < x.size(); ++i) {
+            int c = cell_index(cell_x(x[i]), cell_y(y[i]));
+            next[i] = head[c];
+            head[c] = i;
+        }
+    }
+
+    void scan_cell(int c, double qx, double qy, int& best, double& best_d2) const {
+        for (int i = head[c]; i >= 0; i = next[i]) {
+            double d2 = (x[i] - qx) * (x[i] - qx) + (y[i] - qy) * (y[i] - qy);
+            if (d2 < best_d2) {
+                best_d2 = d2;
+                best = i;
+            }
+        }
+    }
+};
+
+}  // namespace utils
+
+#endif
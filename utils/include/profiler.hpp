@@ -0,0 +1,117 @@
+#pragma once
+#ifndef __PROFILER_HPP
+#define __PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// scoped profiling zones, compiled in with the ENABLE_PROFILING cmake option:
+//   PROFILE_ZONE("hybrid_astar/expansion");
+// times the rest of the enclosing scope. every thread counts into its own per zone histograms,
+// so the hot path takes no lock and shares no cache line with other threads. the exporters
+// merge the threads and may run while the zones are in use. without the option the macro is
+// empty and nothing is measured.
+#ifdef CPPROBOTICS_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name)                                                           \
+    static const uint16_t PROFILE_CONCAT(profile_id_, __LINE__) = utils::prof::zone(name); \
+    utils::prof::ScopedZone PROFILE_CONCAT(profile_zone_, __LINE__)(                 \
+        PROFILE_CONCAT(profile_id_, __LINE__))
+#else
+#define PROFILE_ZONE(name) (void)0
+#endif
+
+namespace utils {
+namespace prof {
+
+#ifdef CPPROBOTICS_PROFILING
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+constexpr size_t MAX_ZONES = 256;
+
+// latency histogram with 16 linear sub buckets per power of two: values below 16 ns are
+// exact, above the bucket width is 1/16 of the value, so quantiles are within 6.25%
+class Histogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+    static int bucket_of(uint64_t ns) {
+        if (ns < (1u << SUB_BITS)) {
+            return ns;
+        }
+        int e = 63 - __builtin_clzll(ns);
+        return ((e - SUB_BITS + 1) << SUB_BITS) + ((ns >> (e - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+    }
+    // smallest value of a bucket
+    static uint64_t lower_bound(int bucket) {
+        if (bucket < (1 << SUB_BITS)) {
+            return bucket;
+        }
+        int e = (bucket >> SUB_BITS) + SUB_BITS - 1;
+        uint64_t sub = bucket & ((1 << SUB_BITS) - 1);
+        return (uint64_t(1) << e) + (sub << (e - SUB_BITS));
+    }
+};
+
+class ZoneSummary {
+public:
+    std::string name;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::vector<uint64_t> histogram;
+
+    ZoneSummary() {}
+    ~ZoneSummary() {}
+
+    // q in [0, 1], the lower bound of the bucket holding the q quantile
+    uint64_t quantile(double q) const;
+};
+
+inline uint64_t now_ns(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// id of a named zone, the same name gives the same id
+uint16_t zone(const char* name);
+// adds one sample of zone id to the histograms of the calling thread
+void record(uint16_t id, uint64_t begin_ns, uint64_t end_ns);
+
+class ScopedZone {
+public:
+    explicit ScopedZone(uint16_t _id) : id(_id), begin(now_ns()) {}
+    ~ScopedZone() { record(id, begin, now_ns()); }
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+    uint16_t id;
+    uint64_t begin;
+};
+
+// every thread also keeps its last TRACE_SIZE zones for the chrome trace, off by default
+constexpr size_t TRACE_SIZE = 1 << 14;
+void enable_trace(bool on);
+
+// the zones merged over all threads that ever entered one, in registration order
+std::vector<ZoneSummary> summary(void);
+// {"zones": [{"name", "count", "total_ms", "mean_us", "p50_us", "p90_us", "p99_us", "max_us"}]}
+std::string to_json(void);
+// chrome://tracing or perfetto, one complete event per traced zone
+std::string to_chrome_trace(void);
+bool write_json(const std::string& path);
+bool write_chrome_trace(const std::string& path);
+
+}  // namespace prof
+}  // namespace utils
+
+#endif
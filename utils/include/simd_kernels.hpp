@@ -0,0 +1,28 @@
+#pragma once
+#ifndef __SIMD_KERNELS_HPP
+#define __SIMD_KERNELS_HPP
+
+#include <cstddef>
+
+namespace utils {
+namespace simd {
+
+// the inner loops with hand vectorized versions. with the ENABLE_SIMD_DISPATCH cmake option
+// x86-64 picks the AVX2 kernels at run time when the CPU has AVX2, so one binary runs on any
+// x86-64 and aarch64 always uses NEON. CPPROBOTICS_SIMD=scalar in the environment forces the
+// plain loops, e.g. to compare them. every version gives the same result bit for bit.
+enum class Isa { SCALAR, AVX2, NEON };
+
+// chosen on first use
+Isa active_isa(void);
+const char* isa_name(Isa isa);
+
+// row[i] = min(row[i], distance from (k * reso + x_min, dy) to (px, 0), max_dist) for
+// k = k0 + i and i in [0, n). returns whether a cell got smaller
+bool min_distance_row(float* row, int n, int k0, double reso, double x_min, double px,
+                      double dy, double max_dist);
+
+}  // namespace simd
+}  // namespace utils
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef __THREAD_POOL_HPP
+#define __THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// persistent workers for data-parallel loops. indices are handed out one at a time from a
+// shared counter, so a worker that finishes early keeps pulling work from the others.
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads = 0);
+    ~ThreadPool();
+
+    // number of threads taking part in parallel_for, including the caller
+    int size(void) const { return workers.size() + 1; }
+
+    // calls fn(index, worker_id) for every index in [0, n) with worker_id in [0, size()).
+    // blocks until all calls have returned.
+    void parallel_for(size_t n, const std::function<void(size_t, int)>& fn);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(size_t, int)>* job = nullptr;
+    size_t job_size = 0;
+    std::atomic<size_t> next_index{0};
+    size_t generation = 0;
+    int active = 0;
+    bool stop = false;
+
+    void worker_loop(int id);
+    void run_job(int id);
+};
+
+}  // namespace utils
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef __TRACE_RECORDER_HPP
+#define __TRACE_RECORDER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// one fixed size record of the trace. a path longer than MAX_POINTS is pushed as one PATH event
+// followed by PATH_CONT events that the replay appends to it.
+class TraceEvent {
+public:
+    enum Kind : uint8_t { NODE = 1, PATH = 2, PATH_CONT = 3, POSE = 4, FRAME = 5, NAME = 6 };
+    static constexpr size_t MAX_POINTS = 30;
+
+    uint64_t time_ns = 0;
+    uint16_t channel = 0;
+    uint8_t kind = 0;
+    uint8_t count = 0;
+    // NODE and PATH: count x, y pairs. POSE: x, y, yaw
+    float data[2 * MAX_POINTS];
+};
+
+// records visualization events for offline replay. producers on any thread push fixed size
+// events into a bounded lock-free queue, a background thread drains it to a little-endian
+// binary log (see byte_order.hpp), the same on every host:
+//   "CRTRACE1", then per event u8 kind, u16 channel, u8 count, u64 time_ns and the floats of
+//   the event. channel names are written once as NAME events carrying count chars.
+// a producer never blocks, an event that finds the queue full is dropped and counted.
+class TraceRecorder {
+public:
+    static constexpr size_t QUEUE_SIZE = 1 << 14;
+
+    explicit TraceRecorder(const std::string& path);
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // the recorder of the process, writes to $CPPROBOTICS_TRACE or trace.bin
+    static TraceRecorder& global(void);
+
+    bool is_open(void) const { return file != nullptr; }
+    // id of a named channel, the same name gives the same id
+    uint16_t channel(const std::string& name);
+
+    void node(uint16_t ch, double x, double y);
+    void path(uint16_t ch, const double* x, const double* y, size_t n);
+    void pose(uint16_t ch, double x, double y, double yaw);
+    void frame(uint16_t ch);
+
+    // blocks until every event pushed before the call is written
+    void flush(void);
+    size_t dropped(void) const { return num_dropped.load(std::memory_order_relaxed); }
+
+private:
+    // bounded multi producer queue of Vyukov: a slot is free for the producer of ticket t when
+    // its sequence is t and holds an event for the consumer when its sequence is t + 1
+    class Slot {
+    public:
+        std::atomic<size_t> sequence{0};
+        TraceEvent event;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+    std::atomic<size_t> num_dropped{0};
+    std::atomic<size_t> num_written{0};
+    std::atomic<bool> stop{false};
+
+    std::FILE* file = nullptr;
+    std::chrono::steady_clock::time_point start;
+    std::mutex names_mutex;
+    std::vector<std::string> names;
+    size_t names_written = 0;
+    std::thread writer;
+
+    bool push(const TraceEvent& event);
+    TraceEvent make_event(uint16_t ch, TraceEvent::Kind kind) const;
+    void writer_loop(void);
+    // writes every queued event, returns their number
+    size_t drain(void);
+    void write_event(const TraceEvent& event);
+};
+
+}  // namespace utils
+
+#endif
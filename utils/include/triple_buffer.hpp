@@ -0,0 +1,56 @@
+#pragma once
+#ifndef __TRIPLE_BUFFER_HPP
+#define __TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace utils {
+
+// hands the latest value from one writer thread to one reader thread without locks. the writer
+// fills back() and publishes it, the reader takes the newest published value into front().
+// neither side ever waits for the other and a value that is overwritten before it was read is
+// simply skipped. the three buffers are reused, a T holding vectors stops allocating once
+// their capacity is reached.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() {}
+    ~TripleBuffer() {}
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer side
+    T& back(void) { return buffers[back_index]; }
+    void publish(void) {
+        uint8_t old = middle.exchange(back_index | FRESH, std::memory_order_acq_rel);
+        back_index = old & INDEX;
+    }
+
+    // reader side, true when a value published since the last call was taken into front()
+    bool update(void) {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t old = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = old & INDEX;
+        return true;
+    }
+    T& front(void) { return buffers[front_index]; }
+    const T& front(void) const { return buffers[front_index]; }
+
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    std::array<T, 3> buffers;
+    // index of the buffer between the two sides, FRESH while the reader has not taken it
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back_index = 0;
+    alignas(64) uint8_t front_index = 2;
+};
+
+}  // namespace utils
+
+#endif
@@ -142,16 +142,17 @@ class TicToc {
 public:
     TicToc(void) { tic(); }
 
-    void tic(void) { start = std::chrono::system_clock::now(); }
+    void tic(void) { start = std::chrono::steady_clock::now(); }
 
+    // [ms] since the last tic
     double toc(void) {
-        end = std::chrono::system_clock::now();
+        end = std::chrono::steady_clock::now();
         std::chrono::duration<double> elapsed_seconds = end - start;
         return elapsed_seconds.count() * 1000;
     }
 
 private:
-    std::chrono::time_point<std::chrono::system_clock> start, end;
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
 };
 
 class VehicleConfig {
@@ -287,6 +288,11 @@ public:
     double calc_distance(double point_x, double point_y);
 };
 
+// path of a file the demos keep between runs, e.g. a precomputed table. it goes to
+// $CPPROBOTICS_CACHE_DIR, else to $XDG_CACHE_HOME/cpprobotics, else to ~/.cache/cpprobotics,
+// never to the working directory. the directory is created when missing
+std::string cache_file(const std::string& name);
+
 void draw_arrow(double x, double y, double theta, double L, std::string color);
 
 void draw_vehicle(Eigen::Vector3d state, double steer, VehicleConfig c, std::string color = "-k",
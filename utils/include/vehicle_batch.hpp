@@ -0,0 +1,85 @@
+#pragma once
+#ifndef __VEHICLE_BATCH_HPP
+#define __VEHICLE_BATCH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+namespace utils {
+
+// N vehicles of one config stepped together, the bicycle model of VehicleState::update. the
+// states are kept as structure of arrays, so the kinematic update is one loop over contiguous
+// doubles that the compiler can vectorize. a ThreadPool shards the vehicles into blocks of
+// BLOCK, every block is handled by one worker.
+class VehicleBatch {
+public:
+    static constexpr size_t BLOCK = 1024;
+
+    const VehicleConfig vc;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> yaw;
+    std::vector<double> v;
+    // inputs of the next update, set by the caller or by step()
+    std::vector<double> acc;
+    std::vector<double> delta;
+
+    explicit VehicleBatch(const VehicleConfig& _vc, size_t n = 0) : vc(_vc) { resize(n); }
+    ~VehicleBatch() {}
+
+    size_t size(void) const { return x.size(); }
+    // new vehicles start at rest at the origin
+    void resize(size_t n);
+    void set(size_t i, double _x, double _y, double _yaw, double _v);
+    // vehicle i as a VehicleState, for code written against a single vehicle
+    VehicleState state(size_t i) const;
+
+    // advances every vehicle by dt with the inputs in acc and delta
+    void update(double dt, ThreadPool* pool = nullptr);
+
+    // closed loop step: control(i, state, acc, delta) sets the inputs of vehicle i from its
+    // state, then every vehicle is advanced by dt. control is called from the pool workers, a
+    // worker reuses one VehicleState for all of its vehicles, so no config is copied per call
+    template <typename Controller>
+    void step(Controller&& control, double dt, ThreadPool* pool = nullptr) {
+        int workers = pool != nullptr ? pool->size() : 1;
+        std::vector<VehicleState> scratch(workers, VehicleState(vc));
+        for_blocks(
+            [&](size_t begin, size_t end, int worker) {
+                VehicleState& s = scratch[worker];
+                for (size_t i = begin; i < end; ++i) {
+                    s.x = x[i];
+                    s.y = y[i];
+                    s.yaw = yaw[i];
+                    s.v = v[i];
+                    control(i, static_cast<const VehicleState&>(s), acc[i], delta[i]);
+                }
+                update_range(begin, end, dt);
+            },
+            pool);
+    }
+
+private:
+    void update_range(size_t begin, size_t end, double dt);
+
+    template <typename Fn>
+    void for_blocks(Fn&& fn, ThreadPool* pool) {
+        size_t n = size();
+        size_t blocks = (n + BLOCK - 1) / BLOCK;
+        if (pool == nullptr || blocks <= 1) {
+            fn(0, n, 0);
+            return;
+        }
+        pool->parallel_for(blocks, [&](size_t b, int worker) {
+            fn(b * BLOCK, std::min(n, (b + 1) * BLOCK), worker);
+        });
+    }
+};
+
+}  // namespace utils
+
+#endif
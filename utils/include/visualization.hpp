@@ -0,0 +1,69 @@
+#pragma once
+#ifndef __VISUALIZATION_HPP
+#define __VISUALIZATION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trace_recorder.hpp"
+
+namespace utils {
+namespace viz {
+
+// the backend is chosen at build time by the VIZ_BACKEND cmake option:
+//   matplotlib  live plots through matplotlibcpp (default)
+//   record      no plots, the hooks below write a trace for trace_replay
+//   none        no plots and no trace, the hooks compile to nothing
+// without matplotlib the demos compile against headless/matplotlibcpp.h and do not link Python.
+#if defined(VIZ_BACKEND_RECORD) || defined(VIZ_BACKEND_NONE)
+constexpr bool ANIMATE = false;
+#else
+constexpr bool ANIMATE = true;
+#endif
+#ifdef VIZ_BACKEND_RECORD
+constexpr bool RECORD = true;
+#else
+constexpr bool RECORD = false;
+#endif
+
+// channel ids are looked up once per call site:
+//   static const uint16_t closed = utils::viz::channel("astar/closed");
+inline uint16_t channel(const std::string& name) {
+    if constexpr (RECORD) {
+        return TraceRecorder::global().channel(name);
+    }
+    return 0;
+}
+
+inline void node(uint16_t ch, double x, double y) {
+    if constexpr (RECORD) {
+        TraceRecorder::global().node(ch, x, y);
+    }
+}
+
+inline void path(uint16_t ch, const std::vector<double>& x, const std::vector<double>& y) {
+    if constexpr (RECORD) {
+        TraceRecorder::global().path(ch, x.data(), y.data(), std::min(x.size(), y.size()));
+    }
+}
+
+inline void pose(uint16_t ch, double x, double y, double yaw) {
+    if constexpr (RECORD) {
+        TraceRecorder::global().pose(ch, x, y, yaw);
+    }
+}
+
+// the events of ch after a frame replace the ones before it
+inline void frame(uint16_t ch) {
+    if constexpr (RECORD) {
+        TraceRecorder::global().frame(ch);
+    }
+}
+
+}  // namespace viz
+}  // namespace utils
+
+#endif
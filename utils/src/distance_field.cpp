@@ -0,0 +1,232 @@
+#include "distance_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#include "profiler.hpp"
+#include "simd_kernels.hpp"
+
+using std::vector;
+
+namespace utils {
+
+DiskFootprint DiskFootprint::circle(double _radius) {
+    DiskFootprint fp;
+    fp.dx = {0.0};
+    fp.dy = {0.0};
+    fp.radius = {_radius};
+
+    return fp;
+}
+
+DiskFootprint DiskFootprint::rectangle(double front, double back, double half_width,
+                                       double max_bulge) {
+    // a disk of radius half_width + max_bulge covers the full width over 2 * half_len
+    double r = half_width + max_bulge;
+    double half_len = sqrt(r * r - half_width * half_width);
+    double length = front + back;
+    int n = std::max(1, static_cast<int>(ceil(length / (2.0 * half_len))));
+    double seg = length / n;
+
+    DiskFootprint fp;
+    for (int k = 0; k < n; ++k) {
+        fp.dx.push_back(-back + (k + 0.5) * seg);
+        fp.dy.push_back(0.0);
+        fp.radius.push_back(hypot(seg / 2.0, half_width));
+    }
+
+    return fp;
+}
+
+double DiskFootprint::get_reach(void) const {
+    double reach = 0.0;
+    for (size_t k = 0; k < radius.size(); ++k) {
+        reach = std::max(reach, hypot(dx[k], dy[k]) + radius[k]);
+    }
+
+    return reach;
+}
+
+DistanceField::DistanceField(int _xwidth, int _ywidth, double _minx, double _miny, double _reso,
+                             double _max_dist)
+    : xwidth(_xwidth), ywidth(_ywidth), minx(_minx), miny(_miny), reso(_reso),
+      max_dist(_max_dist) {
+    tiles_x = (xwidth + TILE - 1) / TILE;
+    tiles_y = (ywidth + TILE - 1) / TILE;
+    tile_reach = ceil(max_dist / (TILE * reso));
+    tiles.resize(static_cast<size_t>(tiles_x) * tiles_y);
+    tile_points.resize(tiles.size());
+}
+
+DistanceField DistanceField::from_bounds(double minx, double miny, double maxx, double maxy,
+                                         double reso, double max_dist) {
+    int xw = std::max(2, static_cast<int>(ceil((maxx - minx) / reso)) + 1);
+    int yw = std::max(2, static_cast<int>(ceil((maxy - miny) / reso)) + 1);
+
+    return DistanceField(xw, yw, minx, miny, reso, max_dist);
+}
+
+// tile of the cell nearest to (x, y), points outside the grid go to the border tiles
+int DistanceField::tile_of(double x, double y) const {
+    int ix = std::clamp(static_cast<int>(round((x - minx) / reso)), 0, xwidth - 1);
+    int iy = std::clamp(static_cast<int>(round((y - miny) / reso)), 0, ywidth - 1);
+
+    return (iy / TILE) * tiles_x + ix / TILE;
+}
+
+void DistanceField::update(const vector<double>& _ox, const vector<double>& _oy) {
+    PROFILE_ZONE("distance_field/update");
+    // points in only one of the old and the new list
+    vector<std::pair<double, double>> old_points, new_points, changed;
+    for (size_t i = 0; i < ox.size(); ++i) {
+        old_points.emplace_back(ox[i], oy[i]);
+    }
+    for (size_t i = 0; i < _ox.size(); ++i) {
+        new_points.emplace_back(_ox[i], _oy[i]);
+    }
+    std::sort(old_points.begin(), old_points.end());
+    std::sort(new_points.begin(), new_points.end());
+    std::set_symmetric_difference(old_points.begin(), old_points.end(), new_points.begin(),
+                                  new_points.end(), std::back_inserter(changed));
+
+    vector<char> dirty(tiles.size(), 0);
+    for (const std::pair<double, double>& p : changed) {
+        int t = tile_of(p.first, p.second);
+        int tx = t % tiles_x;
+        int ty = t / tiles_x;
+        for (int y = std::max(0, ty - tile_reach); y <= std::min(tiles_y - 1, ty + tile_reach);
+             ++y) {
+            for (int x = std::max(0, tx - tile_reach); x <= std::min(tiles_x - 1, tx + tile_reach);
+                 ++x) {
+                dirty[y * tiles_x + x] = 1;
+            }
+        }
+    }
+
+    ox = _ox;
+    oy = _oy;
+    for (vector<int>& points : tile_points) {
+        points.clear();
+    }
+    for (size_t i = 0; i < ox.size(); ++i) {
+        tile_points[tile_of(ox[i], oy[i])].push_back(i);
+    }
+
+    updated_tiles = 0;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        if (dirty[t]) {
+            calc_tile(t % tiles_x, t / tiles_x);
+            ++updated_tiles;
+        }
+    }
+}
+
+// stamps the disk of every point within tile_reach onto the tile, the tile is released again
+// if no cell is within max_dist
+void DistanceField::calc_tile(int tx, int ty) {
+    vector<float>& tile = tiles[ty * tiles_x + tx];
+    tile.assign(TILE * TILE, max_dist);
+    int ix0 = tx * TILE;
+    int iy0 = ty * TILE;
+    bool used = false;
+
+    for (int y = std::max(0, ty - tile_reach); y <= std::min(tiles_y - 1, ty + tile_reach); ++y) {
+        for (int x = std::max(0, tx - tile_reach); x <= std::min(tiles_x - 1, tx + tile_reach);
+             ++x) {
+            for (int i : tile_points[y * tiles_x + x]) {
+                int lx = std::max(0, static_cast<int>(floor((ox[i] - max_dist - minx) / reso)) -
+                                         ix0);
+                int hx = std::min(TILE - 1,
+                                  static_cast<int>(ceil((ox[i] + max_dist - minx) / reso)) - ix0);
+                int ly = std::max(0, static_cast<int>(floor((oy[i] - max_dist - miny) / reso)) -
+                                         iy0);
+                int hy = std::min(TILE - 1,
+                                  static_cast<int>(ceil((oy[i] + max_dist - miny) / reso)) - iy0);
+                if (lx > hx) {
+                    continue;
+                }
+                for (int cy = ly; cy <= hy; ++cy) {
+                    double dy = (iy0 + cy) * reso + miny - oy[i];
+                    if (simd::min_distance_row(&tile[cy * TILE + lx], hx - lx + 1, ix0 + lx, reso,
+                                               minx, ox[i], dy, max_dist)) {
+                        used = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!used) {
+        vector<float>().swap(tile);
+    }
+}
+
+double DistanceField::clearance(double x, double y) const {
+    double fx = std::clamp((x - minx) / reso, 0.0, xwidth - 1.0);
+    double fy = std::clamp((y - miny) / reso, 0.0, ywidth - 1.0);
+    int ix = std::min(static_cast<int>(fx), xwidth - 2);
+    int iy = std::min(static_cast<int>(fy), ywidth - 2);
+    double wx = fx - ix;
+    double wy = fy - iy;
+
+    double d0 = cell(ix, iy) + wx * (cell(ix + 1, iy) - cell(ix, iy));
+    double d1 = cell(ix, iy + 1) + wx * (cell(ix + 1, iy + 1) - cell(ix, iy + 1));
+    // the distance changes by at most the distance to each corner, so the interpolation exceeds
+    // it by at most the weighted corner distances, which peak at the cell middle
+    return std::max(0.0, d0 + wy * (d1 - d0) - reso * M_SQRT1_2);
+}
+
+void DistanceField::clearance(const double* x, const double* y, size_t n, double* out) const {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = clearance(x[i], y[i]);
+    }
+}
+
+double DistanceField::min_clearance(const vector<double>& x, const vector<double>& y) const {
+    double d = max_dist;
+    for (size_t i = 0; i < x.size(); ++i) {
+        d = std::min(d, clearance(x[i], y[i]));
+    }
+
+    return d;
+}
+
+double DistanceField::clearance(const DiskFootprint& fp, double x, double y, double yaw) const {
+    return clearance(fp, x, y, cos(yaw), sin(yaw));
+}
+
+double DistanceField::clearance(const DiskFootprint& fp, double x, double y, double c,
+                                double s) const {
+    double d = max_dist;
+    for (size_t k = 0; k < fp.radius.size(); ++k) {
+        double px = x + fp.dx[k] * c - fp.dy[k] * s;
+        double py = y + fp.dx[k] * s + fp.dy[k] * c;
+        d = std::min(d, clearance(px, py) - fp.radius[k]);
+    }
+
+    return d;
+}
+
+double DistanceField::min_clearance(const DiskFootprint& fp, const vector<double>& x,
+                                    const vector<double>& y, const vector<double>& yaw,
+                                    size_t step) const {
+    double d = max_dist;
+    for (size_t i = 0; i < x.size(); i += step) {
+        d = std::min(d, clearance(fp, x[i], y[i], yaw[i]));
+    }
+
+    return d;
+}
+
+size_t DistanceField::get_bytes(void) const {
+    size_t bytes = tiles.capacity() * sizeof(vector<float>);
+    for (const vector<float>& tile : tiles) {
+        bytes += tile.capacity() * sizeof(float);
+    }
+
+    return bytes;
+}
+
+}  // namespace utils
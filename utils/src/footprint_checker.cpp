@@ -0,0 +1,92 @@
+#include "footprint_checker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "grid_inflation.hpp"
+
+using std::vector;
+
+namespace utils {
+
+FootprintChecker::FootprintChecker(double _front, double _back, double _half_width, double _reso,
+                                   int _yaw_bins)
+    : front(_front), back(_back), half_width(_half_width), reso(_reso), yaw_bins(_yaw_bins) {
+    radius = hypot(std::max(front, back), half_width);
+    double bin_width = 2.0 * M_PI / yaw_bins;
+    double margin = reso * sqrt(2.0) + radius * bin_width / 2.0;
+    reach = static_cast<int>(ceil((radius + margin) / reso));
+    double center = (front - back) / 2.0;
+    double half_length = (front + back) / 2.0;
+
+    masks.resize(yaw_bins);
+    for (int bin = 0; bin < yaw_bins; ++bin) {
+        double yaw = -M_PI + (bin + 0.5) * bin_width;
+        double c = cos(yaw);
+        double s = sin(yaw);
+        for (int dy = -reach; dy <= reach; ++dy) {
+            Row row = {dy, reach + 1, -reach - 1};
+            for (int dx = -reach; dx <= reach; ++dx) {
+                // distance from the cell offset to the rectangle, in the vehicle frame
+                double lx = c * dx * reso + s * dy * reso - center;
+                double ly = -s * dx * reso + c * dy * reso;
+                double ex = std::max(0.0, std::abs(lx) - half_length);
+                double ey = std::max(0.0, std::abs(ly) - half_width);
+                if (hypot(ex, ey) <= margin) {
+                    row.lo = std::min(row.lo, dx);
+                    row.hi = std::max(row.hi, dx);
+                }
+            }
+            // the dilated rectangle is convex, so every row is one interval
+            if (row.lo <= row.hi) {
+                masks[bin].push_back(row);
+            }
+        }
+    }
+}
+
+bool FootprintChecker::is_collision(const OccupancyGrid& grid, double x, double y,
+                                    double yaw) const {
+    int ix = static_cast<int>(round((x - grid.get_minx()) / reso));
+    int iy = static_cast<int>(round((y - grid.get_miny()) / reso));
+    int bin = static_cast<int>(floor((yaw + M_PI) / (2.0 * M_PI) * yaw_bins)) % yaw_bins;
+    if (bin < 0) {
+        bin += yaw_bins;
+    }
+
+    for (const Row& row : masks[bin]) {
+        if (grid.is_row_occupied(iy + row.dy, ix + row.lo, ix + row.hi)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FootprintChecker::is_collision(const OccupancyGrid& grid, const vector<double>& x,
+                                    const vector<double>& y, const vector<double>& yaw) const {
+    for (size_t idx = 0; idx < x.size(); ++idx) {
+        if (is_collision(grid, x[idx], y[idx], yaw[idx])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+OccupancyGrid calc_footprint_grid(const vector<double>& ox, const vector<double>& oy,
+                                  double reso, double margin) {
+    if (ox.empty()) {
+        return OccupancyGrid(1, 1, 0.0, 0.0, reso);
+    }
+    double minx = *std::min_element(ox.begin(), ox.end()) - margin;
+    double miny = *std::min_element(oy.begin(), oy.end()) - margin;
+    double maxx = *std::max_element(ox.begin(), ox.end()) + margin;
+    double maxy = *std::max_element(oy.begin(), oy.end()) + margin;
+    int xwidth = static_cast<int>(ceil((maxx - minx) / reso)) + 1;
+    int ywidth = static_cast<int>(ceil((maxy - miny) / reso)) + 1;
+
+    return calc_point_obstacle_map(ox, oy, minx, miny, reso, xwidth, ywidth);
+}
+
+}  // namespace utils
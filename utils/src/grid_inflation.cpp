@@ -0,0 +1,74 @@
+#include "grid_inflation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using std::vector;
+
+namespace utils {
+
+template <typename Visitor>
+static void visit_disk_cells(const vector<double>& ox, const vector<double>& oy, double minx,
+                             double miny, double reso, int xwidth, int ywidth, double radius,
+                             Visitor visit) {
+    for (size_t idx = 0; idx < ox.size(); ++idx) {
+        // bounding box of the disk in cell indices, one cell of slack against rounding
+        int ix_min = std::max(0, static_cast<int>(floor((ox[idx] - radius - minx) / reso)) - 1);
+        int ix_max =
+            std::min(xwidth - 1, static_cast<int>(ceil((ox[idx] + radius - minx) / reso)) + 1);
+        int iy_min = std::max(0, static_cast<int>(floor((oy[idx] - radius - miny) / reso)) - 1);
+        int iy_max =
+            std::min(ywidth - 1, static_cast<int>(ceil((oy[idx] + radius - miny) / reso)) + 1);
+
+        for (int ix = ix_min; ix <= ix_max; ++ix) {
+            double x = ix * reso + minx;
+            for (int iy = iy_min; iy <= iy_max; ++iy) {
+                double y = iy * reso + miny;
+                double rho = hypot(ox[idx] - x, oy[idx] - y);
+                if (rho <= radius) {
+                    visit(ix, iy, rho);
+                }
+            }
+        }
+    }
+}
+
+vector<vector<double>> calc_obstacle_distance_map(const vector<double>& ox,
+                                                  const vector<double>& oy, double minx,
+                                                  double miny, double reso, int xwidth,
+                                                  int ywidth, double max_dist) {
+    vector<vector<double>> dmap(xwidth, vector<double>(ywidth, std::numeric_limits<double>::max()));
+    visit_disk_cells(ox, oy, minx, miny, reso, xwidth, ywidth, max_dist,
+                     [&dmap](int ix, int iy, double rho) {
+                         if (rho < dmap[ix][iy]) {
+                             dmap[ix][iy] = rho;
+                         }
+                     });
+
+    return dmap;
+}
+
+OccupancyGrid calc_inflated_obstacle_map(const vector<double>& ox, const vector<double>& oy,
+                                         double minx, double miny, double reso, int xwidth,
+                                         int ywidth, double radius) {
+    OccupancyGrid obsmap(xwidth, ywidth, minx, miny, reso);
+    visit_disk_cells(ox, oy, minx, miny, reso, xwidth, ywidth, radius,
+                     [&obsmap](int ix, int iy, double) { obsmap.set(ix, iy, true); });
+
+    return obsmap;
+}
+
+OccupancyGrid calc_point_obstacle_map(const vector<double>& ox, const vector<double>& oy,
+                                      double minx, double miny, double reso, int xwidth,
+                                      int ywidth) {
+    OccupancyGrid obsmap(xwidth, ywidth, minx, miny, reso);
+    for (size_t idx = 0; idx < ox.size(); ++idx) {
+        obsmap.set(static_cast<int>(round((ox[idx] - minx) / reso)),
+                   static_cast<int>(round((oy[idx] - miny) / reso)), true);
+    }
+
+    return obsmap;
+}
+
+}  // namespace utils
@@ -0,0 +1,208 @@
+#include "occupancy_grid.hpp"
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "byte_order.hpp"
+
+namespace utils {
+
+static constexpr char MAGIC[8] = {'O', 'C', 'C', 'G', 'R', 'I', 'D', '\0'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 64;
+
+OccupancyGrid::OccupancyGrid(int _xwidth, int _ywidth, double _minx, double _miny,
+                             double _resolution)
+    : xwidth(_xwidth), ywidth(_ywidth), minx(_minx), miny(_miny), resolution(_resolution) {
+    tiles_x = (xwidth + TILE - 1) / TILE;
+    tiles_y = (ywidth + TILE - 1) / TILE;
+    storage.assign(static_cast<size_t>(tiles_x) * tiles_y, 0);
+    tiles = storage.data();
+}
+
+OccupancyGrid::OccupancyGrid(const OccupancyGrid& other)
+    : xwidth(other.xwidth),
+      ywidth(other.ywidth),
+      tiles_x(other.tiles_x),
+      tiles_y(other.tiles_y),
+      minx(other.minx),
+      miny(other.miny),
+      resolution(other.resolution) {
+    size_t ntiles = static_cast<size_t>(tiles_x) * tiles_y;
+    storage.assign(other.tiles, other.tiles + ntiles);
+    tiles = storage.data();
+}
+
+OccupancyGrid::OccupancyGrid(OccupancyGrid&& other) noexcept
+    : xwidth(other.xwidth),
+      ywidth(other.ywidth),
+      tiles_x(other.tiles_x),
+      tiles_y(other.tiles_y),
+      minx(other.minx),
+      miny(other.miny),
+      resolution(other.resolution),
+      storage(std::move(other.storage)),
+      mapping(other.mapping),
+      mapping_size(other.mapping_size) {
+    tiles = mapping != nullptr ? other.tiles : storage.data();
+    other.tiles = nullptr;
+    other.mapping = nullptr;
+    other.mapping_size = 0;
+    other.xwidth = other.ywidth = other.tiles_x = other.tiles_y = 0;
+}
+
+OccupancyGrid& OccupancyGrid::operator=(OccupancyGrid other) noexcept {
+    release();
+    xwidth = other.xwidth;
+    ywidth = other.ywidth;
+    tiles_x = other.tiles_x;
+    tiles_y = other.tiles_y;
+    minx = other.minx;
+    miny = other.miny;
+    resolution = other.resolution;
+    storage = std::move(other.storage);
+    mapping = other.mapping;
+    mapping_size = other.mapping_size;
+    tiles = mapping != nullptr ? other.tiles : storage.data();
+    other.tiles = nullptr;
+    other.mapping = nullptr;
+    other.mapping_size = 0;
+
+    return *this;
+}
+
+OccupancyGrid::~OccupancyGrid() { release(); }
+
+void OccupancyGrid::release(void) {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+    storage.clear();
+    tiles = nullptr;
+}
+
+void OccupancyGrid::set(int ix, int iy, bool occupied) {
+    if (ix < 0 || iy < 0 || ix >= xwidth || iy >= ywidth) {
+        return;
+    }
+    uint64_t& tile = tiles[(iy >> 3) * tiles_x + (ix >> 3)];
+    uint64_t bit = uint64_t(1) << (((iy & 7) << 3) | (ix & 7));
+    if (occupied) {
+        tile |= bit;
+    } else {
+        tile &= ~bit;
+    }
+}
+
+bool OccupancyGrid::save(const std::string& file) const {
+    unsigned char header[HEADER_SIZE] = {0};
+    uint32_t version = little_endian(FORMAT_VERSION);
+    uint32_t tile = little_endian(static_cast<uint32_t>(TILE));
+    int32_t xw = little_endian(static_cast<int32_t>(xwidth));
+    int32_t yw = little_endian(static_cast<int32_t>(ywidth));
+    double x0 = little_endian(minx);
+    double y0 = little_endian(miny);
+    double reso = little_endian(resolution);
+    memcpy(header, MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &tile, 4);
+    memcpy(header + 16, &xw, 4);
+    memcpy(header + 20, &yw, 4);
+    memcpy(header + 24, &x0, 8);
+    memcpy(header + 32, &y0, 8);
+    memcpy(header + 40, &reso, 8);
+
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (fp == nullptr) {
+        fmt::print("OccupancyGrid: cannot open {} for writing\n", file);
+        return false;
+    }
+    size_t ntiles = static_cast<size_t>(tiles_x) * tiles_y;
+    bool ok = fwrite(header, 1, HEADER_SIZE, fp) == HEADER_SIZE &&
+              write_little_endian(fp, tiles, ntiles);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok) {
+        fmt::print("OccupancyGrid: failed to write {}\n", file);
+    }
+
+    return ok;
+}
+
+bool OccupancyGrid::load(const std::string& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fmt::print("OccupancyGrid: cannot open {}\n", file);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+        fmt::print("OccupancyGrid: {} is not an occupancy grid\n", file);
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fmt::print("OccupancyGrid: mmap of {} failed\n", file);
+        return false;
+    }
+
+    const unsigned char* header = static_cast<const unsigned char*>(addr);
+    uint32_t version;
+    uint32_t tile;
+    int32_t xw;
+    int32_t yw;
+    memcpy(&version, header + 8, 4);
+    memcpy(&tile, header + 12, 4);
+    memcpy(&xw, header + 16, 4);
+    memcpy(&yw, header + 20, 4);
+    version = little_endian(version);
+    tile = little_endian(tile);
+    xw = little_endian(xw);
+    yw = little_endian(yw);
+    size_t ntiles = static_cast<size_t>((xw + TILE - 1) / TILE) * ((yw + TILE - 1) / TILE);
+    if (memcmp(header, MAGIC, 8) != 0 || version != FORMAT_VERSION || tile != TILE || xw < 0 ||
+        yw < 0 || size != HEADER_SIZE + ntiles * sizeof(uint64_t)) {
+        fmt::print("OccupancyGrid: {} has a bad header\n", file);
+        munmap(addr, size);
+        return false;
+    }
+
+    release();
+    xwidth = xw;
+    ywidth = yw;
+    tiles_x = (xw + TILE - 1) / TILE;
+    tiles_y = (yw + TILE - 1) / TILE;
+    memcpy(&minx, header + 24, 8);
+    memcpy(&miny, header + 32, 8);
+    memcpy(&resolution, header + 40, 8);
+    minx = little_endian(minx);
+    miny = little_endian(miny);
+    resolution = little_endian(resolution);
+    uint64_t* data = reinterpret_cast<uint64_t*>(static_cast<unsigned char*>(addr) + HEADER_SIZE);
+    if (LITTLE_ENDIAN_HOST) {
+        mapping = addr;
+        mapping_size = size;
+        tiles = data;
+    } else {
+        // the tiles have to be swapped, a big-endian host reads a copy instead of the mapping
+        storage.assign(data, data + ntiles);
+        little_endian(storage.data(), ntiles);
+        tiles = storage.data();
+        munmap(addr, size);
+    }
+
+    return true;
+}
+
+}  // namespace utils
@@ -0,0 +1,216 @@
+#include "plan_track_runtime.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "profiler.hpp"
+#include "utils.hpp"
+
+namespace utils {
+
+namespace {
+
+// the counters have a single writer, relaxed loads and stores let other threads read them
+void add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void raise_max(std::atomic<uint64_t>& counter, uint64_t n) {
+    if (n > counter.load(std::memory_order_relaxed)) {
+        counter.store(n, std::memory_order_relaxed);
+    }
+}
+
+uint64_t to_ns(std::chrono::steady_clock::duration d) {
+    return std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+}  // namespace
+
+TrajectoryPoint Trajectory::sample(double t) const {
+    if (points.empty()) {
+        return TrajectoryPoint();
+    }
+    if (t <= points.front().t) {
+        return points.front();
+    }
+    if (t >= points.back().t) {
+        return points.back();
+    }
+
+    auto it = std::upper_bound(points.begin(), points.end(), t,
+                               [](double time, const TrajectoryPoint& p) { return time < p.t; });
+    const TrajectoryPoint& p0 = *(it - 1);
+    const TrajectoryPoint& p1 = *it;
+    double r = (t - p0.t) / (p1.t - p0.t);
+    TrajectoryPoint p;
+    p.t = t;
+    p.x = p0.x + r * (p1.x - p0.x);
+    p.y = p0.y + r * (p1.y - p0.y);
+    p.yaw = pi_2_pi(p0.yaw + r * pi_2_pi(p1.yaw - p0.yaw));
+    p.v = p0.v + r * (p1.v - p0.v);
+    p.a = p0.a + r * (p1.a - p0.a);
+    p.kappa = p0.kappa + r * (p1.kappa - p0.kappa);
+    p.s = p0.s + r * (p1.s - p0.s);
+
+    return p;
+}
+
+bool stitch_trajectory(const Trajectory& prev, const TrajectoryPoint& state, double t,
+                       const RuntimeConfig& config, std::vector<TrajectoryPoint>& prefix,
+                       TrajectoryPoint& start) {
+    prefix.clear();
+    if (!prev.empty() && t < prev.end_time()) {
+        // error of the vehicle in the frame of the point it should be at
+        TrajectoryPoint ref = prev.sample(state.t);
+        double dx = state.x - ref.x;
+        double dy = state.y - ref.y;
+        double lon = dx * cos(ref.yaw) + dy * sin(ref.yaw);
+        double lat = -dx * sin(ref.yaw) + dy * cos(ref.yaw);
+        if (std::abs(lat) <= config.max_lateral_error &&
+            std::abs(lon) <= config.max_longitudinal_error) {
+            start = prev.sample(t);
+            for (const TrajectoryPoint& p : prev.points) {
+                if (p.t >= t) {
+                    break;
+                }
+                if (p.t >= t - config.keep_time) {
+                    prefix.push_back(p);
+                }
+            }
+            return true;
+        }
+    }
+
+    // the vehicle keeps its acceleration and curvature until t, a braking vehicle stops
+    double dt = std::max(0.0, t - state.t);
+    double v = state.v + state.a * dt;
+    double ds = (state.v + v) / 2.0 * dt;
+    if (state.v >= 0.0 && v < 0.0) {
+        v = 0.0;
+        ds = -state.v * state.v / (2.0 * state.a);
+    }
+    double dyaw = state.kappa * ds;
+    start = state;
+    start.t = t;
+    start.v = v;
+    start.s = state.s + ds;
+    start.x += ds * cos(state.yaw + dyaw / 2.0);
+    start.y += ds * sin(state.yaw + dyaw / 2.0);
+    start.yaw = pi_2_pi(state.yaw + dyaw);
+
+    return false;
+}
+
+double PlanTrackRuntime::now(void) const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void PlanTrackRuntime::start(void) {
+    if (running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    epoch = std::chrono::steady_clock::now();
+    running.store(true, std::memory_order_relaxed);
+    control_thread = std::thread([this]() {
+#ifdef __linux__
+        if (config.control_priority > 0) {
+            sched_param param;
+            param.sched_priority = config.control_priority;
+            realtime.store(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0,
+                           std::memory_order_relaxed);
+        }
+#endif
+        run_loop(config.control_period, control_stats, &PlanTrackRuntime::control_tick);
+    });
+    plan_thread = std::thread(
+        [this]() { run_loop(config.plan_period, plan_stats, &PlanTrackRuntime::plan_tick); });
+}
+
+void PlanTrackRuntime::stop(void) {
+    running.store(false, std::memory_order_relaxed);
+    if (plan_thread.joinable()) {
+        plan_thread.join();
+    }
+    if (control_thread.joinable()) {
+        control_thread.join();
+    }
+}
+
+bool PlanTrackRuntime::plan_tick(void) {
+    PROFILE_ZONE("runtime/plan");
+    if (states.update()) {
+        has_state = true;
+    }
+    if (!has_state) {
+        return true;
+    }
+
+    // the stitched prefix goes straight into the buffer the planner appends to
+    Trajectory& out = trajectories.back();
+    TrajectoryPoint start;
+    if (!stitch_trajectory(previous, states.front(), now() + config.plan_latency, config,
+                           out.points, start) &&
+        !previous.empty()) {
+        add(resets, 1);
+    }
+    if (!planner(start, out) || out.points.empty()) {
+        return false;
+    }
+
+    out.sequence = ++sequence;
+    previous.sequence = out.sequence;
+    previous.points.assign(out.points.begin(), out.points.end());
+    trajectories.publish();
+
+    return true;
+}
+
+bool PlanTrackRuntime::control_tick(void) {
+    PROFILE_ZONE("runtime/control");
+    trajectories.update();
+    double t = now();
+    TrajectoryPoint& state = states.back();
+    state.t = t;
+    controller(trajectories.front(), t, state);
+    states.publish();
+
+    return true;
+}
+
+void PlanTrackRuntime::run_loop(double period, LoopStats& stats,
+                                bool (PlanTrackRuntime::*tick)(void)) {
+    using clock = std::chrono::steady_clock;
+    const clock::duration step =
+        std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(period));
+    clock::time_point due = epoch;
+    while (running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_until(due);
+        clock::time_point begin = clock::now();
+        bool ok = (this->*tick)();
+        clock::time_point end = clock::now();
+
+        add(stats.ticks, 1);
+        if (!ok) {
+            add(stats.failures, 1);
+        }
+        add(stats.total_ns, to_ns(end - begin));
+        raise_max(stats.max_ns, to_ns(end - begin));
+        raise_max(stats.max_jitter_ns, to_ns(begin - due));
+
+        due += step;
+        if (end > due) {
+            add(stats.misses, 1);
+            int64_t behind = (end - due) / step;
+            add(stats.skipped, behind);
+            due += behind * step;
+        }
+    }
+}
+
+}  // namespace utils
@@ -0,0 +1,249 @@
+#include "profiler.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace utils {
+namespace prof {
+
+namespace {
+
+// counters of one zone on one thread. only the owner thread writes, relaxed atomics let the
+// exporters read them at any time
+class ZoneCounters {
+public:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::array<std::atomic<uint64_t>, Histogram::BUCKETS> histogram{};
+
+    void add(uint64_t ns) {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total_ns.store(total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max_ns.load(std::memory_order_relaxed)) {
+            max_ns.store(ns, std::memory_order_relaxed);
+        }
+        std::atomic<uint64_t>& bucket = histogram[Histogram::bucket_of(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+class Span {
+public:
+    std::atomic<uint64_t> begin_ns{0};
+    std::atomic<uint64_t> end_ns{0};
+    std::atomic<uint32_t> id{0};
+};
+
+// zones of one thread, counters are allocated when the thread first enters a zone and are kept
+// after the thread exits, so short lived workers still show up in the summary
+class ThreadProfile {
+public:
+    int index = 0;
+    std::array<std::atomic<ZoneCounters*>, MAX_ZONES> zones{};
+    std::atomic<Span*> trace{nullptr};
+    std::atomic<uint64_t> trace_head{0};
+    std::vector<std::unique_ptr<ZoneCounters>> owned;
+    std::unique_ptr<Span[]> owned_trace;
+};
+
+class Registry {
+public:
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<ThreadProfile>> threads;
+    std::atomic<bool> tracing{false};
+    const uint64_t epoch_ns = now_ns();
+};
+
+Registry& registry(void) {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+ThreadProfile& this_thread(void) {
+    thread_local ThreadProfile* profile = nullptr;
+    if (profile == nullptr) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threads.emplace_back(new ThreadProfile());
+        profile = reg.threads.back().get();
+        profile->index = reg.threads.size() - 1;
+    }
+    return *profile;
+}
+
+std::string escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+bool write_file(const std::string& path, const std::string& text) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+}  // namespace
+
+uint64_t ZoneSummary::quantile(double q) const {
+    uint64_t rank = std::min<uint64_t>(count, std::max<uint64_t>(1, q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < histogram.size(); ++b) {
+        seen += histogram[b];
+        if (seen >= rank) {
+            return std::min(Histogram::lower_bound(b), max_ns);
+        }
+    }
+
+    return max_ns;
+}
+
+uint16_t zone(const char* name) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto it = std::find(reg.names.begin(), reg.names.end(), name);
+    if (it != reg.names.end()) {
+        return it - reg.names.begin();
+    }
+    if (reg.names.size() == MAX_ZONES) {
+        fmt::print(stderr, "profiler: more than {} zones, {} is counted as {}\n", MAX_ZONES, name,
+                   reg.names.back());
+        return MAX_ZONES - 1;
+    }
+    reg.names.emplace_back(name);
+    return reg.names.size() - 1;
+}
+
+void record(uint16_t id, uint64_t begin_ns, uint64_t end_ns) {
+    ThreadProfile& profile = this_thread();
+    ZoneCounters* counters = profile.zones[id].load(std::memory_order_relaxed);
+    if (counters == nullptr) {
+        counters = new ZoneCounters();
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            profile.owned.emplace_back(counters);
+        }
+        profile.zones[id].store(counters, std::memory_order_release);
+    }
+    counters->add(end_ns - begin_ns);
+
+    if (!registry().tracing.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Span* trace = profile.trace.load(std::memory_order_relaxed);
+    if (trace == nullptr) {
+        trace = new Span[TRACE_SIZE];
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            profile.owned_trace.reset(trace);
+        }
+        profile.trace.store(trace, std::memory_order_release);
+    }
+    uint64_t head = profile.trace_head.load(std::memory_order_relaxed);
+    Span& span = trace[head % TRACE_SIZE];
+    span.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    span.end_ns.store(end_ns, std::memory_order_relaxed);
+    span.id.store(id, std::memory_order_relaxed);
+    profile.trace_head.store(head + 1, std::memory_order_release);
+}
+
+void enable_trace(bool on) { registry().tracing.store(on, std::memory_order_relaxed); }
+
+std::vector<ZoneSummary> summary(void) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::vector<ZoneSummary> zones(reg.names.size());
+    for (size_t id = 0; id < zones.size(); ++id) {
+        ZoneSummary& z = zones[id];
+        z.name = reg.names[id];
+        z.histogram.assign(Histogram::BUCKETS, 0);
+        for (const std::unique_ptr<ThreadProfile>& thread : reg.threads) {
+            const ZoneCounters* counters = thread->zones[id].load(std::memory_order_acquire);
+            if (counters == nullptr) {
+                continue;
+            }
+            z.count += counters->count.load(std::memory_order_relaxed);
+            z.total_ns += counters->total_ns.load(std::memory_order_relaxed);
+            z.max_ns = std::max(z.max_ns, counters->max_ns.load(std::memory_order_relaxed));
+            for (int b = 0; b < Histogram::BUCKETS; ++b) {
+                z.histogram[b] += counters->histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    return zones;
+}
+
+std::string to_json(void) {
+    std::string out = "{\"zones\": [";
+    std::vector<ZoneSummary> zones = summary();
+    for (size_t i = 0; i < zones.size(); ++i) {
+        const ZoneSummary& z = zones[i];
+        out += fmt::format(
+            "{}\n  {{\"name\": \"{}\", \"count\": {}, \"total_ms\": {:.3f}, \"mean_us\": {:.3f}, "
+            "\"p50_us\": {:.3f}, \"p90_us\": {:.3f}, \"p99_us\": {:.3f}, \"max_us\": {:.3f}}}",
+            i > 0 ? "," : "", escape(z.name), z.count, z.total_ns * 1e-6,
+            z.count > 0 ? z.total_ns * 1e-3 / z.count : 0.0, z.quantile(0.5) * 1e-3,
+            z.quantile(0.9) * 1e-3, z.quantile(0.99) * 1e-3, z.max_ns * 1e-3);
+    }
+    out += "\n]}\n";
+
+    return out;
+}
+
+// a span that the owner overwrites while it is read may come out torn, the trace is meant to
+// be taken once the instrumented threads are idle
+std::string to_chrome_trace(void) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::string out = "{\"traceEvents\": [";
+    bool first = true;
+    for (const std::unique_ptr<ThreadProfile>& thread : reg.threads) {
+        const Span* trace = thread->trace.load(std::memory_order_acquire);
+        if (trace == nullptr) {
+            continue;
+        }
+        uint64_t head = thread->trace_head.load(std::memory_order_acquire);
+        for (uint64_t k = head > TRACE_SIZE ? head - TRACE_SIZE : 0; k < head; ++k) {
+            const Span& span = trace[k % TRACE_SIZE];
+            uint64_t begin = span.begin_ns.load(std::memory_order_relaxed);
+            uint64_t end = span.end_ns.load(std::memory_order_relaxed);
+            uint32_t id = span.id.load(std::memory_order_relaxed);
+            if (id >= reg.names.size() || begin < reg.epoch_ns || end < begin) {
+                continue;
+            }
+            out += fmt::format(
+                "{}\n  {{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, "
+                "\"pid\": 0, \"tid\": {}}}",
+                first ? "" : ",", escape(reg.names[id]), (begin - reg.epoch_ns) * 1e-3,
+                (end - begin) * 1e-3, thread->index);
+            first = false;
+        }
+    }
+    out += "\n], \"displayTimeUnit\": \"ms\"}\n";
+
+    return out;
+}
+
+bool write_json(const std::string& path) { return write_file(path, to_json()); }
+
+bool write_chrome_trace(const std::string& path) { return write_file(path, to_chrome_trace()); }
+
+}  // namespace prof
+}  // namespace utils
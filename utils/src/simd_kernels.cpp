@@ -0,0 +1,149 @@
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(CPPROBOTICS_SIMD_DISPATCH) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(CPPROBOTICS_SIMD_DISPATCH) && defined(__aarch64__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace utils {
+namespace simd {
+
+namespace {
+
+using DistanceRowKernel = bool (*)(float*, int, int, double, double, double, double, double);
+
+// the kernels compute the same expressions in the same order as the scalar loops, without
+// fused multiply-adds
+bool min_distance_row_scalar(float* row, int n, int k0, double reso, double x_min, double px,
+                             double dy, double max_dist) {
+    bool used = false;
+    for (int i = 0; i < n; ++i) {
+        double dx = (k0 + i) * reso + x_min - px;
+        float d = std::min(sqrt(dx * dx + dy * dy), max_dist);
+        if (d < row[i]) {
+            row[i] = d;
+            used = true;
+        }
+    }
+
+    return used;
+}
+
+#ifdef SIMD_AVX2
+__attribute__((target("avx2"))) bool min_distance_row_avx2(float* row, int n, int k0,
+                                                           double reso, double x_min, double px,
+                                                           double dy, double max_dist) {
+    const __m256d v_reso = _mm256_set1_pd(reso);
+    const __m256d v_x_min = _mm256_set1_pd(x_min);
+    const __m256d v_px = _mm256_set1_pd(px);
+    const __m256d v_dy2 = _mm256_set1_pd(dy * dy);
+    const __m256d v_max = _mm256_set1_pd(max_dist);
+    __m128i k = _mm_add_epi32(_mm_set1_epi32(k0), _mm_setr_epi32(0, 1, 2, 3));
+    __m128 changed = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d dx = _mm256_sub_pd(
+            _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(k), v_reso), v_x_min), v_px);
+        __m256d d =
+            _mm256_min_pd(_mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), v_dy2)), v_max);
+        __m128 d_f = _mm256_cvtpd_ps(d);
+        __m128 value = _mm_loadu_ps(row + i);
+        changed = _mm_or_ps(changed, _mm_cmplt_ps(d_f, value));
+        _mm_storeu_ps(row + i, _mm_min_ps(d_f, value));
+        k = _mm_add_epi32(k, _mm_set1_epi32(4));
+    }
+    bool used = _mm_movemask_ps(changed) != 0;
+
+    return min_distance_row_scalar(row + i, n - i, k0 + i, reso, x_min, px, dy, max_dist) ||
+           used;
+}
+#endif
+
+#ifdef SIMD_NEON
+bool min_distance_row_neon(float* row, int n, int k0, double reso, double x_min, double px,
+                           double dy, double max_dist) {
+    const float64x2_t v_reso = vdupq_n_f64(reso);
+    const float64x2_t v_x_min = vdupq_n_f64(x_min);
+    const float64x2_t v_px = vdupq_n_f64(px);
+    const float64x2_t v_dy2 = vdupq_n_f64(dy * dy);
+    const float64x2_t v_max = vdupq_n_f64(max_dist);
+    const double offsets[2] = {0.0, 1.0};
+    float64x2_t k = vaddq_f64(vdupq_n_f64(k0), vld1q_f64(offsets));
+    uint32x2_t changed = vdup_n_u32(0);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t dx = vsubq_f64(vaddq_f64(vmulq_f64(k, v_reso), v_x_min), v_px);
+        float64x2_t d = vminq_f64(vsqrtq_f64(vaddq_f64(vmulq_f64(dx, dx), v_dy2)), v_max);
+        float32x2_t d_f = vcvt_f32_f64(d);
+        float32x2_t value = vld1_f32(row + i);
+        uint32x2_t less = vclt_f32(d_f, value);
+        changed = vorr_u32(changed, less);
+        vst1_f32(row + i, vbsl_f32(less, d_f, value));
+        k = vaddq_f64(k, vdupq_n_f64(2.0));
+    }
+    bool used = vmaxv_u32(changed) != 0;
+
+    return min_distance_row_scalar(row + i, n - i, k0 + i, reso, x_min, px, dy, max_dist) ||
+           used;
+}
+#endif
+
+class Kernels {
+public:
+    Isa isa = Isa::SCALAR;
+    DistanceRowKernel min_distance_row = min_distance_row_scalar;
+
+    Kernels() {
+        const char* env = std::getenv("CPPROBOTICS_SIMD");
+        if (env != nullptr && std::strcmp(env, "scalar") == 0) {
+            return;
+        }
+#if defined(SIMD_AVX2)
+        if (__builtin_cpu_supports("avx2")) {
+            isa = Isa::AVX2;
+            min_distance_row = min_distance_row_avx2;
+        }
+#elif defined(SIMD_NEON)
+        isa = Isa::NEON;
+        min_distance_row = min_distance_row_neon;
+#endif
+    }
+    ~Kernels() {}
+};
+
+const Kernels& kernels(void) {
+    static const Kernels instance;
+    return instance;
+}
+
+}  // namespace
+
+Isa active_isa(void) { return kernels().isa; }
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::NEON:
+            return "neon";
+        default:
+            return "scalar";
+    }
+}
+
+bool min_distance_row(float* row, int n, int k0, double reso, double x_min, double px,
+                      double dy, double max_dist) {
+    return kernels().min_distance_row(row, n, k0, reso, x_min, px, dy, max_dist);
+}
+
+}  // namespace simd
+}  // namespace utils
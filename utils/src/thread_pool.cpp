@@ -0,0 +1,82 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace utils {
+
+ThreadPool::ThreadPool(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int id = 1; id < num_threads; ++id) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, id);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run_job(int id) {
+    size_t index;
+    while ((index = next_index.fetch_add(1, std::memory_order_relaxed)) < job_size) {
+        (*job)(index, id);
+    }
+}
+
+void ThreadPool::worker_loop(int id) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+        }
+        run_job(id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0) {
+                done_cv.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, int)>& fn) {
+    if (n == 0) {
+        return;
+    }
+    if (workers.empty() || n == 1) {
+        for (size_t index = 0; index < n; ++index) {
+            fn(index, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        job_size = n;
+        next_index = 0;
+        active = workers.size();
+        ++generation;
+    }
+    start_cv.notify_all();
+    run_job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&] { return active == 0; });
+    job = nullptr;
+}
+
+}  // namespace utils
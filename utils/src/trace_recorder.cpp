@@ -0,0 +1,188 @@
+#include "trace_recorder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "byte_order.hpp"
+
+namespace utils {
+
+TraceRecorder::TraceRecorder(const std::string& path)
+    : slots(new Slot[QUEUE_SIZE]), start(std::chrono::steady_clock::now()) {
+    for (size_t i = 0; i < QUEUE_SIZE; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    std::fwrite("CRTRACE1", 1, 8, file);
+    writer = std::thread(&TraceRecorder::writer_loop, this);
+}
+
+TraceRecorder::~TraceRecorder() {
+    if (file == nullptr) {
+        return;
+    }
+    stop.store(true, std::memory_order_release);
+    writer.join();
+    std::fclose(file);
+}
+
+TraceRecorder& TraceRecorder::global(void) {
+    static TraceRecorder recorder([] {
+        const char* path = std::getenv("CPPROBOTICS_TRACE");
+        return std::string(path != nullptr ? path : "trace.bin");
+    }());
+    return recorder;
+}
+
+uint16_t TraceRecorder::channel(const std::string& name) {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    auto it = std::find(names.begin(), names.end(), name);
+    if (it != names.end()) {
+        return it - names.begin();
+    }
+    names.push_back(name.substr(0, 255));
+    return names.size() - 1;
+}
+
+TraceEvent TraceRecorder::make_event(uint16_t ch, TraceEvent::Kind kind) const {
+    TraceEvent event;
+    event.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    event.channel = ch;
+    event.kind = kind;
+    return event;
+}
+
+void TraceRecorder::node(uint16_t ch, double x, double y) {
+    TraceEvent event = make_event(ch, TraceEvent::NODE);
+    event.count = 1;
+    event.data[0] = x;
+    event.data[1] = y;
+    push(event);
+}
+
+void TraceRecorder::path(uint16_t ch, const double* x, const double* y, size_t n) {
+    TraceEvent event = make_event(ch, TraceEvent::PATH);
+    for (size_t begin = 0; begin < n || begin == 0; begin += TraceEvent::MAX_POINTS) {
+        size_t count = std::min(TraceEvent::MAX_POINTS, n - begin);
+        event.kind = begin == 0 ? TraceEvent::PATH : TraceEvent::PATH_CONT;
+        event.count = count;
+        for (size_t i = 0; i < count; ++i) {
+            event.data[2 * i] = x[begin + i];
+            event.data[2 * i + 1] = y[begin + i];
+        }
+        push(event);
+    }
+}
+
+void TraceRecorder::pose(uint16_t ch, double x, double y, double yaw) {
+    TraceEvent event = make_event(ch, TraceEvent::POSE);
+    event.data[0] = x;
+    event.data[1] = y;
+    event.data[2] = yaw;
+    push(event);
+}
+
+void TraceRecorder::frame(uint16_t ch) { push(make_event(ch, TraceEvent::FRAME)); }
+
+bool TraceRecorder::push(const TraceEvent& event) {
+    if (file == nullptr) {
+        num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    size_t t = tail.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[t % QUEUE_SIZE];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == t) {
+            if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+                slot.event = event;
+                slot.sequence.store(t + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (sequence < t) {
+            // the slot still holds the event of ticket t - QUEUE_SIZE
+            num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            t = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void TraceRecorder::flush(void) {
+    if (file == nullptr) {
+        return;
+    }
+    size_t target = tail.load(std::memory_order_acquire);
+    while (num_written.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void TraceRecorder::writer_loop(void) {
+    while (!stop.load(std::memory_order_acquire)) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    drain();
+}
+
+size_t TraceRecorder::drain(void) {
+    std::vector<TraceEvent> batch;
+    while (true) {
+        Slot& slot = slots[head % QUEUE_SIZE];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+        batch.push_back(slot.event);
+        slot.sequence.store(head + QUEUE_SIZE, std::memory_order_release);
+        ++head;
+    }
+    if (batch.empty()) {
+        return 0;
+    }
+
+    // a channel is registered before its first event, so every popped event finds its name
+    {
+        std::lock_guard<std::mutex> lock(names_mutex);
+        for (; names_written < names.size(); ++names_written) {
+            const std::string& name = names[names_written];
+            TraceEvent event;
+            event.kind = TraceEvent::NAME;
+            event.channel = names_written;
+            event.count = name.size();
+            write_event(event);
+            std::fwrite(name.data(), 1, name.size(), file);
+        }
+    }
+    for (const TraceEvent& event : batch) {
+        write_event(event);
+    }
+    std::fflush(file);
+    num_written.fetch_add(batch.size(), std::memory_order_release);
+
+    return batch.size();
+}
+
+void TraceRecorder::write_event(const TraceEvent& event) {
+    std::fwrite(&event.kind, sizeof(event.kind), 1, file);
+    write_little_endian(file, &event.channel, 1);
+    std::fwrite(&event.count, sizeof(event.count), 1, file);
+    write_little_endian(file, &event.time_ns, 1);
+    size_t floats = 0;
+    if (event.kind == TraceEvent::NODE || event.kind == TraceEvent::PATH ||
+        event.kind == TraceEvent::PATH_CONT) {
+        floats = 2 * event.count;
+    } else if (event.kind == TraceEvent::POSE) {
+        floats = 3;
+    }
+    write_little_endian(file, event.data, floats);
+}
+
+}  // namespace utils
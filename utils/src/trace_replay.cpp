@@ -0,0 +1,153 @@
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "byte_order.hpp"
+#include "matplotlibcpp.h"
+#include "trace_recorder.hpp"
+#include "utils.hpp"
+
+using std::string;
+using std::vector;
+namespace plt = matplotlibcpp;
+
+// plays back a trace of a planner built with VIZ_BACKEND=record:
+//   trace_replay trace.bin [--every=50]
+// the picture is redrawn on every frame event and after every `every` nodes.
+
+const char* STYLES[] = {"xc", "-g", "-r", "-b", "-m", "-y", "-k"};
+
+class ChannelState {
+public:
+    string name;
+    vector<double> node_x;
+    vector<double> node_y;
+    vector<vector<double>> path_x;
+    vector<vector<double>> path_y;
+    vector<double> pose;
+
+    ChannelState() {}
+    ~ChannelState() {}
+
+    void clear(void) {
+        node_x.clear();
+        node_y.clear();
+        path_x.clear();
+        path_y.clear();
+        pose.clear();
+    }
+};
+
+static void redraw(const vector<ChannelState>& channels) {
+    plt::cla();
+    for (size_t c = 0; c < channels.size(); ++c) {
+        const ChannelState& ch = channels[c];
+        string style = STYLES[c % (sizeof(STYLES) / sizeof(STYLES[0]))];
+        if (!ch.node_x.empty()) {
+            plt::plot(ch.node_x, ch.node_y, "x" + style.substr(1));
+        }
+        for (size_t i = 0; i < ch.path_x.size(); ++i) {
+            plt::plot(ch.path_x[i], ch.path_y[i], "-" + style.substr(1));
+        }
+        for (size_t i = 0; i + 2 < ch.pose.size(); i += 3) {
+            utils::draw_arrow(ch.pose[i], ch.pose[i + 1], ch.pose[i + 2], 1.0,
+                              style.substr(1));
+        }
+    }
+    plt::axis("equal");
+    plt::grid(true);
+    plt::pause(0.001);
+}
+
+// the trace is little-endian on every host
+template <typename T>
+static bool read(std::FILE* file, T* value, size_t n = 1) {
+    return utils::read_little_endian(file, value, n);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fmt::print(stderr, "usage: trace_replay trace.bin [--every=N]\n");
+        return 1;
+    }
+    size_t every = 50;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--every=", 8) == 0) {
+            every = std::max(1, std::stoi(argv[i] + 8));
+        }
+    }
+    std::FILE* file = std::fopen(argv[1], "rb");
+    char magic[8];
+    if (file == nullptr || !read(file, magic, 8) || std::memcmp(magic, "CRTRACE1", 8) != 0) {
+        fmt::print(stderr, "{} is not a trace\n", argv[1]);
+        return 1;
+    }
+
+    vector<ChannelState> channels;
+    size_t events = 0;
+    size_t nodes = 0;
+    uint8_t kind;
+    uint16_t channel;
+    uint8_t count;
+    uint64_t time_ns = 0;
+    float data[2 * utils::TraceEvent::MAX_POINTS];
+    while (read(file, &kind) && read(file, &channel) && read(file, &count) &&
+           read(file, &time_ns)) {
+        if (channel >= channels.size()) {
+            channels.resize(channel + 1);
+        }
+        ChannelState& ch = channels[channel];
+        ++events;
+
+        if (kind == utils::TraceEvent::NAME) {
+            ch.name.resize(count);
+            if (!read(file, &ch.name[0], count)) {
+                break;
+            }
+        } else if (kind == utils::TraceEvent::NODE) {
+            if (!read(file, data, 2)) {
+                break;
+            }
+            ch.node_x.push_back(data[0]);
+            ch.node_y.push_back(data[1]);
+            if (++nodes % every == 0) {
+                redraw(channels);
+            }
+        } else if (kind == utils::TraceEvent::PATH || kind == utils::TraceEvent::PATH_CONT) {
+            if (!read(file, data, 2 * count)) {
+                break;
+            }
+            if (kind == utils::TraceEvent::PATH || ch.path_x.empty()) {
+                ch.path_x.emplace_back();
+                ch.path_y.emplace_back();
+            }
+            for (int i = 0; i < count; ++i) {
+                ch.path_x.back().push_back(data[2 * i]);
+                ch.path_y.back().push_back(data[2 * i + 1]);
+            }
+        } else if (kind == utils::TraceEvent::POSE) {
+            if (!read(file, data, 3)) {
+                break;
+            }
+            ch.pose.insert(ch.pose.end(), data, data + 3);
+        } else if (kind == utils::TraceEvent::FRAME) {
+            redraw(channels);
+            ch.clear();
+        }
+    }
+    std::fclose(file);
+
+    fmt::print("{} events over {:.3f} s\n", events, time_ns * 1e-9);
+    for (const ChannelState& ch : channels) {
+        fmt::print("  {}\n", ch.name);
+    }
+    redraw(channels);
+    plt::show();
+
+    return 0;
+}
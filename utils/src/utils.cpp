@@ -2,6 +2,10 @@
 
 #include <fmt/core.h>
 
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
 #include "matplotlibcpp.h"
 
 using std::string;
@@ -19,8 +23,31 @@ static void plot(VectorXd vec_x, VectorXd vec_y, std::string style) {
     plt::plot(x, y, style);
 }
 
+
 namespace utils {
 
+string cache_file(const string& name) {
+    auto env = [](const char* var) {
+        const char* value = std::getenv(var);
+        return value != nullptr && value[0] != '\0' ? value : nullptr;
+    };
+    std::filesystem::path dir;
+    if (env("CPPROBOTICS_CACHE_DIR") != nullptr) {
+        dir = env("CPPROBOTICS_CACHE_DIR");
+    } else if (env("XDG_CACHE_HOME") != nullptr) {
+        dir = std::filesystem::path(env("XDG_CACHE_HOME")) / "cpprobotics";
+    } else if (env("HOME") != nullptr) {
+        dir = std::filesystem::path(env("HOME")) / ".cache" / "cpprobotics";
+    } else {
+        std::error_code ec;
+        dir = std::filesystem::temp_directory_path(ec) / "cpprobotics";
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    return (dir / name).string();
+}
+
 void draw_arrow(double x, double y, double theta, double L, std::string color) {
     double angle = M_PI / 6;
     double d = 0.3 * L;
@@ -0,0 +1,57 @@
+#include "vehicle_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace utils {
+
+void VehicleBatch::resize(size_t n) {
+    x.resize(n, 0.0);
+    y.resize(n, 0.0);
+    yaw.resize(n, 0.0);
+    v.resize(n, 0.0);
+    acc.resize(n, 0.0);
+    delta.resize(n, 0.0);
+}
+
+void VehicleBatch::set(size_t i, double _x, double _y, double _yaw, double _v) {
+    x[i] = _x;
+    y[i] = _y;
+    yaw[i] = _yaw;
+    v[i] = _v;
+}
+
+VehicleState VehicleBatch::state(size_t i) const {
+    return VehicleState(vc, x[i], y[i], yaw[i], v[i]);
+}
+
+void VehicleBatch::update(double dt, ThreadPool* pool) {
+    for_blocks([&](size_t begin, size_t end, int) { update_range(begin, end, dt); }, pool);
+}
+
+// branch free, the clamps are min/max, so the loop vectorizes wherever the math library has
+// vector versions of cos, sin and tan
+void VehicleBatch::update_range(size_t begin, size_t end, double dt) {
+    double* px = x.data();
+    double* py = y.data();
+    double* pyaw = yaw.data();
+    double* pv = v.data();
+    const double* pacc = acc.data();
+    const double* pdelta = delta.data();
+    const double max_steer = vc.MAX_STEER;
+    const double max_speed = vc.MAX_SPEED;
+    const double min_speed = vc.MIN_SPEED;
+    const double inv_wb = 1.0 / vc.WB;
+
+    for (size_t i = begin; i < end; ++i) {
+        double steer = std::min(std::max(pdelta[i], -max_steer), max_steer);
+        double vi = pv[i];
+        double th = pyaw[i];
+        px[i] += vi * cos(th) * dt;
+        py[i] += vi * sin(th) * dt;
+        pyaw[i] = th + vi * inv_wb * tan(steer) * dt;
+        pv[i] = std::min(std::max(vi + pacc[i] * dt, min_speed), max_speed);
+    }
+}
+
+}  // namespace utils